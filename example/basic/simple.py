@@ -30,7 +30,8 @@ if __name__ == "__main__":
         seed,
     )
 
-    var_counter, prg = plg.gcompile(inp)
+    var_counter, prg, int_vars = plg.gcompile(inp)
+    optimizer.int_vars = int_vars
 
     for i, instr in enumerate(prg):
         print(i, instr.toString())
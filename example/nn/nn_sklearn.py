@@ -44,9 +44,12 @@ if __name__ == "__main__":
     feature_names = [f"sv_{j}" for j in range(X_train.shape[1])]
     mlp_code = pmg.dump_sklearn_MLP(clf, feature_names)
 
-    # Prepare the condition that the adversarial example should satisfy
+    # Prepare the condition that the adversarial example should satisfy, where
+    # each feature is bounded by its own range
     param_low = X.min()
     param_high = X.max()
+    feature_low = X.min(axis=0)
+    feature_high = X.max(axis=0)
 
     num_symbolic_vars = 1
     symbolic_vars_id = random.sample(list(range(X_train.shape[1])), num_symbolic_vars)
@@ -67,7 +70,7 @@ if __name__ == "__main__":
         "("
         + " && ".join(
             [
-                f"(sv_{i} >= {param_low}) && (sv_{i} <= {param_high})"
+                f"(sv_{i} >= {feature_low[i]}) && (sv_{i} <= {feature_high[i]})"
                 for i in symbolic_vars_id
             ]
         )
@@ -79,7 +82,7 @@ if __name__ == "__main__":
     )
 
     # Compile the program
-    var_counter, prg = plg.gcompile(mlp_code)
+    var_counter, prg, _ = plg.gcompile(mlp_code)
 
     # Get the program counter of the target instrument
     target_pc = 0
@@ -104,6 +107,11 @@ if __name__ == "__main__":
         init_param_uniform_int,
         seed,
     )
+    optimizer.var_bounds = {
+        var_counter[f"sv_{i}"]: (feature_low[i], feature_high[i])
+        for i in symbolic_vars_id
+    }
+    optimizer.precondition = True
 
     # Execute attack
     start = time.time()
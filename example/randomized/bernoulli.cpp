@@ -57,27 +57,18 @@ int main(int argc, char *argv[]) {
     printf("Compiling the input program...\n");
     gymbo::Token *token = gymbo::tokenize(user_input, var_counter);
     gymbo::generate_ast(token, user_input, code);
-    gymbo::compile_ast(code, prg);
+    std::unordered_map<int, gymbo::DiscreteDist> var2dist;
+    gymbo::compile_ast(code, prg, var2dist);
 
     for (auto &vc : var_counter) {
         printf("%s:%d\n", vc.first.c_str(), vc.second);
     }
     printf("---\n");
 
-    std::unordered_map<int, gymbo::DiscreteDist> var2dist = {
-        {1, gymbo::BernoulliDist(0.5)}, {2, gymbo::BernoulliDist(0.5)}};
-
-    std::vector<std::vector<int>> val_candidates;
-    for (auto &vd : var2dist) {
-        val_candidates.emplace_back(vd.second.vals);
-    }
-    std::vector<std::vector<int>> D = gymbo::cartesianProduct(val_candidates);
-
     printf("Start Symbolic Execution...\n");
     gymbo::PSExecutor executor(optimizer, maxSAT, maxUNSAT, max_num_trials,
                                ignore_memory, use_dpll, verbose_level);
-    executor.register_random_var(1);
-    executor.register_random_var(2);
+    executor.register_random_vars(var2dist);
     executor.run(prg, target_pcs, init, max_depth);
     printf("---------------------------\n");
 
@@ -98,7 +89,7 @@ int main(int argc, char *argv[]) {
             for (auto &cc : executor.prob_constraints_table) {
                 for (auto &ccv : cc.second) {
                     printf("pc=%d: prob=%f, %s, constraints=%s\n", cc.first,
-                           std::get<2>(ccv).eval(params, eps, var2dist, D),
+                           executor.eval_prob(std::get<2>(ccv), params),
                            mem2string(std::get<1>(ccv)).c_str(),
                            std::get<0>(ccv).toString(true).c_str());
                 }
@@ -4,6 +4,7 @@
 
 #include "../../libgymbo/compiler.h"
 #include "../../libgymbo/psymbolic.h"
+#include "../../libgymbo/query.h"
 
 char *user_input;
 int max_depth = 65536;
@@ -67,23 +68,14 @@ int main(int argc, char *argv[]) {
     printf("Compiling the input program...\n");
     gymbo::Token *token = gymbo::tokenize(user_input, var_counter);
     gymbo::generate_ast(token, user_input, code);
-    gymbo::compile_ast(code, prg);
+    std::unordered_map<int, gymbo::DiscreteDist> var2dist;
+    gymbo::compile_ast(code, prg, var2dist);
 
     for (auto &vc : var_counter) {
         printf("%s:%d\n", vc.first.c_str(), vc.second);
     }
     printf("---\n");
 
-    std::unordered_map<int, gymbo::DiscreteDist> var2dist = {
-        {0, gymbo::DiscreteUniformDist(1, 3)},
-        {1, gymbo::DiscreteUniformDist(1, 3)}};
-
-    std::vector<std::vector<int>> val_candidates;
-    for (auto &vd : var2dist) {
-        val_candidates.emplace_back(vd.second.vals);
-    }
-    std::vector<std::vector<int>> D = gymbo::cartesianProduct(val_candidates);
-
     std::vector<int> doow_switch_candidates = {0, 1};
 
     for (int door_switch : doow_switch_candidates) {
@@ -92,8 +84,7 @@ int main(int argc, char *argv[]) {
 
         gymbo::PSExecutor executor(optimizer, maxSAT, maxUNSAT, max_num_trials,
                                    ignore_memory, use_dpll, verbose_level);
-        executor.register_random_var(0);
-        executor.register_random_var(1);
+        executor.register_random_vars(var2dist);
         executor.run(prg, target_pcs, init, max_depth);
 
         int num_unique_path_constraints = executor.constraints_cache.size();
@@ -107,12 +98,9 @@ int main(int argc, char *argv[]) {
         } else {
             printf("\n#Total Final States: %d\n", num_unique_final_states);
             printf("List of Final States\n");
-            float expected_value = 0.0f;
             for (auto &cc : executor.prob_constraints_table) {
                 for (auto &ccv : cc.second) {
-                    float p = std::get<2>(ccv).eval(params, eps, var2dist, D);
-                    expected_value += p * gymbo::wordToFloat(std::get<1>(
-                                              ccv)[var_counter["result"]]);
+                    float p = executor.eval_prob(std::get<2>(ccv), params);
                     if (p > 0.0f) {
                         printf("pc=%d: Prob=%f, %s, Constraints=%s\n", cc.first,
                                p, mem2string(std::get<1>(ccv)).c_str(),
@@ -120,7 +108,9 @@ int main(int argc, char *argv[]) {
                     }
                 }
             }
-            printf("E[result] = %f\n", expected_value);
+            gymbo::ProbQuery query(executor, params);
+            printf("E[result] = %f\n",
+                   query.expectation(var_counter["result"]));
         }
     }
 }
@@ -7,10 +7,13 @@
 #include <unistd.h>
 
 #include <chrono>
+#include <cstring>
 #include <unordered_map>
 #include <unordered_set>
 
 #include "libgymbo/compiler.h"
+#include "libgymbo/psymbolic.h"
+#include "libgymbo/query.h"
 #include "libgymbo/symbolic.h"
 
 char *user_input;
@@ -29,11 +32,24 @@ bool sign_grad = true;
 bool ignore_memory = false;
 bool use_dpll = false;
 bool init_param_uniform_int = true;
+bool best_first = false;
+float prob_threshold = 0.0f;
+int max_unroll = 64;
+bool summarize_loops = false;
+bool use_jit = false;
+gymbo::InitType init_type = gymbo::InitType::Uniform;
+bool reuse_models = false;
+bool use_intervals = false;
+bool init_within_intervals = false;
+bool use_portfolio = false;
+float sampling_precision = 0.0f;
+std::vector<std::string> queries;
 
 void parse_args(int argc, char *argv[]) {
     int opt;
     user_input = argv[1];
-    while ((opt = getopt(argc, argv, "d:v:i:a:e:t:l:h:s:gmrp")) != -1) {
+    while ((opt = getopt(argc, argv,
+                         "d:v:i:a:e:t:l:h:s:c:q:u:n:z:gmrpbojwxfk")) != -1) {
         switch (opt) {
             case 'd':
                 max_depth = atoi(optarg);
@@ -74,6 +90,50 @@ void parse_args(int argc, char *argv[]) {
             case 'p':
                 use_dpll = true;
                 break;
+            case 'c':
+                prob_threshold = atof(optarg);
+                break;
+            case 'b':
+                best_first = true;
+                break;
+            case 'q':
+                queries.emplace_back(optarg);
+                break;
+            case 'u':
+                max_unroll = atoi(optarg);
+                break;
+            case 'o':
+                summarize_loops = true;
+                break;
+            case 'j':
+                use_jit = true;
+                break;
+            case 'n':
+                if (strcmp(optarg, "halton") == 0) {
+                    init_type = gymbo::InitType::Halton;
+                } else if (strcmp(optarg, "lhs") == 0) {
+                    init_type = gymbo::InitType::LatinHypercube;
+                } else {
+                    init_type = gymbo::InitType::Uniform;
+                }
+                break;
+            case 'w':
+                reuse_models = true;
+                break;
+            case 'x':
+                // the bounds are inferred by the interval propagation
+                use_intervals = true;
+                init_within_intervals = true;
+                break;
+            case 'k':
+                use_intervals = true;
+                break;
+            case 'f':
+                use_portfolio = true;
+                break;
+            case 'z':
+                sampling_precision = atof(optarg);
+                break;
             default:
                 printf("unknown parameter %s is specified", optarg);
                 printf(
@@ -83,7 +143,12 @@ void parse_args(int argc, char *argv[]) {
                     "[-h: "
                     "param_high], [-s: seed], [-g off_sign_grad], [-r "
                     "off_init_param_uniform_int], [-m: "
-                    "ignore_memory] "
+                    "ignore_memory], [-c: prob_threshold], [-b: "
+                    "best_first], [-q: query], [-u: max_unroll], [-o: "
+                    "summarize_loops], [-j: use_jit], [-n: init_type], "
+                    "[-w: reuse_models], [-x: init_within_intervals], [-f: "
+                    "use_portfolio], [-k: use_intervals], [-z: "
+                    "sampling_precision] "
                     "...\n",
                     argv[0]);
                 break;
@@ -91,6 +156,92 @@ void parse_args(int argc, char *argv[]) {
     }
 }
 
+/**
+ * @brief Runs the probabilistic symbolic execution on a program declaring
+ * random variables (e.g., `x ~ bernoulli(0.3);`), and prints the probability
+ * of each final state.
+ *
+ * @param prg The compiled program.
+ * @param var2dist Map of variable index to the declared distribution.
+ * @param var_counter The mapping from variable name to variable id.
+ * @param optimizer The gradient descent optimizer.
+ * @param target_pcs Set of pc where path constraints are solved.
+ * @param init The initial symbolic state.
+ */
+void run_probabilistic(gymbo::Prog &prg,
+                       std::unordered_map<int, gymbo::DiscreteDist> &var2dist,
+                       std::unordered_map<std::string, int> &var_counter,
+                       gymbo::GDOptimizer &optimizer,
+                       std::unordered_set<int> &target_pcs,
+                       gymbo::SymState &init) {
+    gymbo::PSExecutor executor(optimizer, maxSAT, maxUNSAT, max_num_trials,
+                               ignore_memory, use_dpll, verbose_level);
+    executor.register_random_vars(var2dist);
+    executor.prob_threshold = prob_threshold;
+    executor.max_unroll = max_unroll;
+    executor.use_portfolio = use_portfolio;
+    executor.use_intervals = use_intervals;
+    if (sampling_precision > 0.0f) {
+        executor.prob_cache.use_sampling = true;
+        executor.prob_cache.sampling_precision = sampling_precision;
+        executor.prob_cache.sampling_seed = seed;
+    }
+
+    printf("Start Probabilistic Symbolic Execution...\n");
+    if (best_first) {
+        executor.run_best_first(prg, target_pcs, init, max_depth);
+    } else {
+        executor.run(prg, target_pcs, init, max_depth);
+    }
+    printf("---------------------------\n");
+
+    printf("Result Summary\n");
+    if (prob_threshold > 0.0f) {
+        printf("Pruned Probability Mass: %f\n", executor.pruned_mass);
+    }
+    int num_final_states = 0;
+    for (auto &cc : executor.prob_constraints_table) {
+        num_final_states += cc.second.size();
+    }
+    if (num_final_states == 0) {
+        printf("No Path Constraints Found\n");
+        return;
+    }
+
+    printf("#Total Final States: %d\n", num_final_states);
+    printf("List of Final States\n----\n");
+    std::unordered_map<int, float> params;
+    for (auto &cc : executor.prob_constraints_table) {
+        for (auto &ccv : cc.second) {
+            float p = executor.eval_prob(std::get<2>(ccv), params);
+            printf("pc=%d: Prob=%f, Concrete Memory: {", cc.first, p);
+            for (auto &t : std::get<1>(ccv)) {
+                float v = gymbo::wordToFloat(t.second);
+                if (gymbo::is_integer(v)) {
+                    printf("var_%d: %d, ", (int)t.first, (int)v);
+                } else {
+                    printf("var_%d: %f, ", (int)t.first, v);
+                }
+            }
+            printf("}, Constraints=%s\n",
+                   std::get<0>(ccv).toString(true).c_str());
+        }
+    }
+
+    if (queries.size() != 0) {
+        gymbo::ProbQuery query(executor);
+        printf("----\nQueries\n");
+        for (std::string &q : queries) {
+            query.dropped_mass = 0.0f;
+            printf("%s = %f\n", q.c_str(), query.query(q, var_counter));
+            if (query.dropped_mass > 0.0f) {
+                printf("  Dropped Probability Mass: %f\n",
+                       query.dropped_mass);
+            }
+        }
+    }
+}
+
 int main(int argc, char *argv[]) {
     parse_args(argc, argv);
 
@@ -105,13 +256,26 @@ int main(int argc, char *argv[]) {
     gymbo::GDOptimizer optimizer(num_itrs, step_size, eps, param_low,
                                  param_high, sign_grad, init_param_uniform_int,
                                  seed);
+    optimizer.use_jit = use_jit;
+    optimizer.init_type = init_type;
+    optimizer.reuse_models = reuse_models;
+    optimizer.init_within_intervals = init_within_intervals;
     gymbo::SymState init;
     std::unordered_set<int> target_pcs;
 
     printf("Compiling the input program...\n");
-    gymbo::Token *token = gymbo::tokenize(user_input, var_counter);
-    gymbo::generate_ast(token, user_input, code);
-    gymbo::compile_ast(code, prg);
+    std::unordered_map<int, gymbo::DiscreteDist> var2dist;
+    try {
+        gymbo::Token *token = gymbo::tokenize(user_input, var_counter);
+        gymbo::generate_ast(token, user_input, code);
+        gymbo::compile_ast(code, prg, var2dist, summarize_loops);
+    } catch (const gymbo::ParseError &e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    for (gymbo::Node *node : code) {
+        gymbo::gather_int_vars(node, optimizer.int_vars);
+    }
 
     if (verbose_level >= 3) {
         printf("...Compiled Stack Machine...\n");
@@ -121,8 +285,17 @@ int main(int argc, char *argv[]) {
         printf("----------------------------\n");
     }
 
+    if (var2dist.size() != 0) {
+        run_probabilistic(prg, var2dist, var_counter, optimizer, target_pcs,
+                          init);
+        return 0;
+    }
+
     gymbo::SExecutor executor(optimizer, maxSAT, maxUNSAT, max_num_trials,
                               ignore_memory, use_dpll, verbose_level);
+    executor.max_unroll = max_unroll;
+    executor.use_portfolio = use_portfolio;
+    executor.use_intervals = use_intervals;
 
     printf("Start Symbolic Execution...\n");
     executor.run(prg, target_pcs, init, max_depth);
@@ -0,0 +1,598 @@
+/**
+ * @file bitblast.h
+ * @brief Bit-precise solving of integer path constraints
+ * @author Hideaki Takahashi
+ */
+
+#pragma once
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <tuple>
+
+#include "sat.h"
+#include "type.h"
+
+namespace gymbo {
+
+/**
+ * @brief Struct translating path constraints over integer variables into
+ * clauses of the CDCL solver.
+ *
+ * Each integer variable is a bit-vector of `width` bits in two's complement,
+ * and each operation is encoded as a circuit whose gates are Tseitin-encoded
+ * and folded when their inputs are constant. Addition, subtraction, and
+ * multiplication wrap around, as do the bitwise operations evaluated by
+ * `bitwise`. Identical gates are shared. Since the VM does not wrap around,
+ * the answers are only used where no overflow can occur (see
+ * `bitblast_solver`).
+ */
+struct BitBlaster {
+    int width;                /**< The number of bits of an integer. */
+    gymbosat::CDCL solver;    /**< The solver receiving the clauses. */
+    int lit_true;             /**< The literal that is always true. */
+    std::unordered_map<int, std::vector<int>>
+        var_bits; /**< The bits of the variables, from the LSB. */
+
+    /**
+     * @brief Constructor for BitBlaster.
+     * @param width The number of bits of an integer, which is a power of two
+     * of at most 32.
+     * @param max_conflicts The number of conflicts before the solver gives up.
+     */
+    BitBlaster(int width = 32, int max_conflicts = 100000)
+        : width(width), solver(max_conflicts) {
+        lit_true = solver.new_var();
+        solver.add_clause({lit_true});
+    }
+
+    /**
+     * @brief Checks if a constraint can be bit-blasted, i.e., it is a boolean
+     * combination of comparisons of integer terms.
+     * @param sym The constraint.
+     * @param int_vars The indices of the integer variables.
+     * @return True if the constraint can be bit-blasted.
+     */
+    static bool is_formula(const Sym &sym,
+                           const std::unordered_set<int> &int_vars) {
+        switch (sym.symtype) {
+            case (SymType::SNot):
+                return is_formula(*sym.left, int_vars);
+            case (SymType::SAnd):
+            case (SymType::SOr):
+                return is_formula(*sym.left, int_vars) &&
+                       is_formula(*sym.right, int_vars);
+            case (SymType::SEq):
+            case (SymType::SLt):
+            case (SymType::SLe):
+                return is_term(*sym.left, int_vars) &&
+                       is_term(*sym.right, int_vars);
+            default:
+                return false;
+        }
+    }
+
+    /**
+     * @brief Checks if an expression is an integer term.
+     * @param sym The expression.
+     * @param int_vars The indices of the integer variables.
+     * @return True if the expression is an integer term.
+     */
+    static bool is_term(const Sym &sym,
+                        const std::unordered_set<int> &int_vars) {
+        switch (sym.symtype) {
+            case (SymType::SCon): {
+                float v = wordToFloat(sym.word);
+                return is_integer(v) &&
+                       v >= static_cast<float>(
+                                std::numeric_limits<int32_t>::min()) &&
+                       v < -static_cast<float>(
+                               std::numeric_limits<int32_t>::min());
+            }
+            case (SymType::SAny):
+                return int_vars.find(sym.var_idx) != int_vars.end();
+            case (SymType::SLin):
+                return is_term(*sym.expand(), int_vars);
+            case (SymType::SAdd):
+            case (SymType::SSub):
+            case (SymType::SMul):
+            case (SymType::SBitAnd):
+            case (SymType::SBitOr):
+            case (SymType::SBitXor):
+            case (SymType::SShl):
+            case (SymType::SShr):
+                return is_term(*sym.left, int_vars) &&
+                       is_term(*sym.right, int_vars);
+            default:
+                return false;
+        }
+    }
+
+    /**
+     * @brief Computes the range of an integer term over all 32-bit values of
+     * its variables and checks that its arithmetic is exact.
+     *
+     * `Sym::eval` adds and multiplies in float32 without wrapping around,
+     * so the bit-blasted circuit agrees with it only if every addition,
+     * subtraction, and multiplication stays within the integers that a
+     * float represents exactly, i.e., [-2^24, 2^24]. The bitwise operations
+     * wrap around in both.
+     *
+     * @param sym The term, which satisfies `is_term`.
+     * @param lo The lower bound of the term.
+     * @param hi The upper bound of the term.
+     * @return True if no arithmetic of the term can wrap around or round.
+     */
+    static bool exact_range(const Sym &sym, int64_t &lo, int64_t &hi) {
+        const int64_t int_min = std::numeric_limits<int32_t>::min();
+        const int64_t int_max = std::numeric_limits<int32_t>::max();
+        const int64_t exact = 1 << 24;
+        if (sym.symtype == SymType::SCon) {
+            lo = hi = static_cast<int64_t>(wordToFloat(sym.word));
+            return true;
+        } else if (sym.symtype == SymType::SAny) {
+            lo = int_min;
+            hi = int_max;
+            return true;
+        } else if (sym.symtype == SymType::SLin) {
+            return exact_range(*sym.expand(), lo, hi);
+        }
+
+        int64_t llo, lhi, rlo, rhi;
+        bool ok = exact_range(*sym.left, llo, lhi) &
+                  exact_range(*sym.right, rlo, rhi);
+        switch (sym.symtype) {
+            case (SymType::SAdd):
+            case (SymType::SSub):
+            case (SymType::SMul): {
+                if (sym.symtype == SymType::SAdd) {
+                    lo = llo + rlo;
+                    hi = lhi + rhi;
+                } else if (sym.symtype == SymType::SSub) {
+                    lo = llo - rhi;
+                    hi = lhi - rlo;
+                } else {
+                    // the operands are within 32 bits, so that the products
+                    // fit in 64 bits
+                    int64_t p[] = {llo * rlo, llo * rhi, lhi * rlo,
+                                   lhi * rhi};
+                    lo = *std::min_element(p, p + 4);
+                    hi = *std::max_element(p, p + 4);
+                }
+                ok = ok && -exact <= std::min(llo, rlo) &&
+                     std::max(lhi, rhi) <= exact && -exact <= lo &&
+                     hi <= exact;
+                lo = std::max(lo, int_min);
+                hi = std::min(hi, int_max);
+                return ok;
+            }
+            case (SymType::SBitAnd): {
+                if (llo >= 0 || rlo >= 0) {
+                    lo = 0;
+                    hi = std::min(llo >= 0 ? lhi : int_max,
+                                  rlo >= 0 ? rhi : int_max);
+                    return ok;
+                }
+                break;
+            }
+            case (SymType::SBitOr):
+            case (SymType::SBitXor): {
+                if (llo >= 0 && rlo >= 0) {
+                    int64_t mask = 1;
+                    while (mask <= std::max(lhi, rhi)) {
+                        mask <<= 1;
+                    }
+                    lo = 0;
+                    hi = mask - 1;
+                    return ok;
+                }
+                break;
+            }
+            case (SymType::SShr): {
+                if (rlo == rhi) {
+                    int k = static_cast<int>(rlo & 31);
+                    lo = llo >> k;
+                    hi = lhi >> k;
+                    return ok;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+        lo = int_min;
+        hi = int_max;
+        return ok;
+    }
+
+    /**
+     * @brief Checks that the arithmetic of a constraint is exact (see
+     * `exact_range`).
+     * @param sym The constraint, which satisfies `is_formula`.
+     * @return True if the constraint has the same models in 32-bit integers
+     * as under `Sym::eval`.
+     */
+    static bool is_exact(const Sym &sym) {
+        int64_t llo, lhi, rlo, rhi;
+        switch (sym.symtype) {
+            case (SymType::SNot):
+                return is_exact(*sym.left);
+            case (SymType::SAnd):
+            case (SymType::SOr):
+                return is_exact(*sym.left) && is_exact(*sym.right);
+            default:
+                return exact_range(*sym.left, llo, lhi) &
+                       exact_range(*sym.right, rlo, rhi);
+        }
+    }
+
+    /**
+     * @brief Encodes a constraint.
+     * @param sym The constraint, which satisfies `is_formula`.
+     * @return The literal that is true iff the constraint holds.
+     */
+    int formula(const Sym &sym) {
+        switch (sym.symtype) {
+            case (SymType::SNot):
+                return -formula(*sym.left);
+            case (SymType::SAnd):
+                return gate_and(formula(*sym.left), formula(*sym.right));
+            case (SymType::SOr):
+                return -gate_and(-formula(*sym.left), -formula(*sym.right));
+            case (SymType::SEq): {
+                std::vector<int> l = term(*sym.left), r = term(*sym.right);
+                int res = lit_true;
+                for (int i = 0; i < width; i++) {
+                    res = gate_and(res, -gate_xor(l[i], r[i]));
+                }
+                return res;
+            }
+            case (SymType::SLt):
+                return less(term(*sym.left), term(*sym.right));
+            default:
+                // l <= r iff !(r < l)
+                return -less(term(*sym.right), term(*sym.left));
+        }
+    }
+
+    /**
+     * @brief Encodes an integer term.
+     * @param sym The term, which satisfies `is_term`.
+     * @return The bits of the term, from the LSB.
+     */
+    std::vector<int> term(const Sym &sym) {
+        // structurally equal subexpressions, shared or not, are encoded once
+        auto memo = terms.find(&sym);
+        if (memo != terms.end()) {
+            return memo->second;
+        }
+        std::vector<int> bits = encode_term(sym);
+        terms.emplace(&sym, bits);
+        return bits;
+    }
+
+    /**
+     * @brief Decodes the value of a variable from the model of the solver.
+     * @param var_idx The index of the variable.
+     * @return The value of the variable.
+     */
+    float decode(int var_idx) const {
+        const std::vector<int> &bits = var_bits.at(var_idx);
+        uint32_t v = 0;
+        for (int i = 0; i < width; i++) {
+            if (solver.model(bits[i])) {
+                v |= (1u << i);
+            }
+        }
+        if (width < 32 && (v >> (width - 1)) & 1) {
+            v |= ~((1u << width) - 1);  // sign extension
+        }
+        return static_cast<float>(static_cast<int32_t>(v));
+    }
+
+   private:
+    std::map<std::tuple<int, int, int>, int>
+        gates; /**< Cache of the gates by their inputs. */
+    std::map<const Sym *, std::vector<int>, SymLess>
+        terms; /**< Cache of the encoded terms by their structures. */
+
+    std::vector<int> encode_term(const Sym &sym) {
+        switch (sym.symtype) {
+            case (SymType::SCon): {
+                uint32_t v = static_cast<uint32_t>(
+                    static_cast<int64_t>(wordToFloat(sym.word)));
+                std::vector<int> bits(width);
+                for (int i = 0; i < width; i++) {
+                    bits[i] = ((v >> i) & 1) ? lit_true : -lit_true;
+                }
+                return bits;
+            }
+            case (SymType::SAny): {
+                auto itr = var_bits.find(sym.var_idx);
+                if (itr == var_bits.end()) {
+                    std::vector<int> bits(width);
+                    for (int i = 0; i < width; i++) {
+                        bits[i] = solver.new_var();
+                    }
+                    itr = var_bits.emplace(sym.var_idx, bits).first;
+                }
+                return itr->second;
+            }
+            case (SymType::SLin):
+                return term(*sym.expand());
+            default:
+                break;
+        }
+
+        std::vector<int> l = term(*sym.left), r = term(*sym.right);
+        std::vector<int> res(width);
+        switch (sym.symtype) {
+            case (SymType::SAdd):
+                return add(l, r, -lit_true);
+            case (SymType::SSub):
+                // l - r = l + ~r + 1
+                for (int i = 0; i < width; i++) {
+                    r[i] = -r[i];
+                }
+                return add(l, r, lit_true);
+            case (SymType::SMul): {
+                // a negative constant has few zero bits, so that l * c is
+                // encoded as -(l * -c) with fewer partial products
+                if (is_constant(l)) {
+                    std::swap(l, r);
+                }
+                if (is_constant(r) && r[width - 1] == lit_true) {
+                    return neg(mul(l, neg(r)));
+                }
+                return mul(l, r);
+            }
+            case (SymType::SBitAnd):
+                for (int i = 0; i < width; i++) {
+                    res[i] = gate_and(l[i], r[i]);
+                }
+                return res;
+            case (SymType::SBitOr):
+                for (int i = 0; i < width; i++) {
+                    res[i] = -gate_and(-l[i], -r[i]);
+                }
+                return res;
+            case (SymType::SBitXor):
+                for (int i = 0; i < width; i++) {
+                    res[i] = gate_xor(l[i], r[i]);
+                }
+                return res;
+            default: {
+                // barrel shifter over the bits of the amount modulo the width
+                bool left = (sym.symtype == SymType::SShl);
+                for (int k = 0; (1 << k) < width; k++) {
+                    int amount = 1 << k;
+                    for (int i = 0; i < width; i++) {
+                        int src = left ? i - amount : i + amount;
+                        int shifted;
+                        if (src < 0) {
+                            shifted = -lit_true;
+                        } else if (src >= width) {
+                            shifted = l[width - 1];  // sign extension
+                        } else {
+                            shifted = l[src];
+                        }
+                        res[i] = gate_mux(r[k], shifted, l[i]);
+                    }
+                    l = res;
+                }
+                return l;
+            }
+        }
+    }
+
+    int gate_and(int a, int b) {
+        if (a == -lit_true || b == -lit_true || a == -b) {
+            return -lit_true;
+        }
+        if (a == lit_true || a == b) {
+            return b;
+        }
+        if (b == lit_true) {
+            return a;
+        }
+        if (a > b) {
+            std::swap(a, b);
+        }
+        auto key = std::make_tuple(0, a, b);
+        auto itr = gates.find(key);
+        if (itr != gates.end()) {
+            return itr->second;
+        }
+        int o = solver.new_var();
+        solver.add_clause({-o, a});
+        solver.add_clause({-o, b});
+        solver.add_clause({o, -a, -b});
+        gates.emplace(key, o);
+        return o;
+    }
+
+    int gate_xor(int a, int b) {
+        if (a == lit_true || a == -lit_true) {
+            return (a == lit_true) ? -b : b;
+        }
+        if (b == lit_true || b == -lit_true) {
+            return (b == lit_true) ? -a : a;
+        }
+        if (a == b || a == -b) {
+            return (a == b) ? -lit_true : lit_true;
+        }
+        // normalize the polarities, since a ^ b = !a ^ !b
+        bool negated = (a < 0) != (b < 0);
+        a = std::abs(a);
+        b = std::abs(b);
+        if (a > b) {
+            std::swap(a, b);
+        }
+        auto key = std::make_tuple(1, a, b);
+        auto itr = gates.find(key);
+        int o;
+        if (itr != gates.end()) {
+            o = itr->second;
+        } else {
+            o = solver.new_var();
+            solver.add_clause({-o, a, b});
+            solver.add_clause({-o, -a, -b});
+            solver.add_clause({o, -a, b});
+            solver.add_clause({o, a, -b});
+            gates.emplace(key, o);
+        }
+        return negated ? -o : o;
+    }
+
+    int gate_mux(int s, int t, int e) {
+        if (s == lit_true || t == e) {
+            return t;
+        }
+        if (s == -lit_true) {
+            return e;
+        }
+        return -gate_and(-gate_and(s, t), -gate_and(-s, e));
+    }
+
+    /**
+     * @brief Ripple-carry adder, which also returns the carry out.
+     */
+    std::vector<int> add(const std::vector<int> &a, const std::vector<int> &b,
+                         int carry, int *carry_out = nullptr) {
+        std::vector<int> sum(width);
+        for (int i = 0; i < width; i++) {
+            int p = gate_xor(a[i], b[i]);
+            sum[i] = gate_xor(p, carry);
+            carry = -gate_and(-gate_and(a[i], b[i]), -gate_and(p, carry));
+        }
+        if (carry_out != nullptr) {
+            *carry_out = carry;
+        }
+        return sum;
+    }
+
+    /**
+     * @brief Product `a * b`, which is the sum of the partial products
+     * `a << i` selected by the bits of b.
+     */
+    std::vector<int> mul(const std::vector<int> &a,
+                         const std::vector<int> &b) {
+        std::vector<int> res(width, -lit_true);
+        for (int i = 0; i < width; i++) {
+            if (b[i] == -lit_true) {
+                continue;
+            }
+            std::vector<int> partial(width, -lit_true);
+            for (int j = i; j < width; j++) {
+                partial[j] = gate_and(b[i], a[j - i]);
+            }
+            res = add(res, partial, -lit_true);
+        }
+        return res;
+    }
+
+    /** @brief Negation `-a = ~a + 1`. */
+    std::vector<int> neg(std::vector<int> a) {
+        for (int i = 0; i < width; i++) {
+            a[i] = -a[i];
+        }
+        return add(a, std::vector<int>(width, -lit_true), lit_true);
+    }
+
+    /** @brief Returns true if all the bits are constants. */
+    bool is_constant(const std::vector<int> &a) const {
+        for (int bit : a) {
+            if (bit != lit_true && bit != -lit_true) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Signed comparison `a < b`.
+     *
+     * Flipping the sign bits turns it into the unsigned comparison, which
+     * holds iff `a + ~b + 1` does not carry out.
+     */
+    int less(std::vector<int> a, std::vector<int> b) {
+        a[width - 1] = -a[width - 1];
+        for (int i = 0; i < width - 1; i++) {
+            b[i] = -b[i];
+        }
+        int carry;
+        add(a, b, lit_true, &carry);
+        return -carry;
+    }
+};
+
+/**
+ * @brief Decides path constraints over integer variables by bit-blasting.
+ *
+ * When every path constraint is a boolean combination of comparisons of
+ * integer terms, i.e., constants and variables of integer type combined by
+ * arithmetic and bitwise operations, the constraints are bit-blasted and
+ * decided by the CDCL solver under the semantics of 32-bit integers. Since
+ * `Sym::eval` and the VM compute in float32 without wrapping around, a model
+ * is returned only if it satisfies the constraints under `Sym::eval`, and
+ * UNSAT is final only if no arithmetic can wrap around or round (see
+ * `BitBlaster::is_exact`). Otherwise, including when the solver exceeds its
+ * budget, nothing is decided and the caller falls back to the gradient
+ * descent. Overflow is therefore not modelled: the constraints are only
+ * decided where they mean the same for wrapping integers and for the VM.
+ *
+ * @param is_sat Flag to store the result of satisfiability.
+ * @param path_constraints The path constraints.
+ * @param int_vars The indices of the integer variables.
+ * @param params The map from the variable IDs to the concrete values, which
+ * receives the model when the constraints are satisfiable.
+ * @param eps The smallest positive value used to check the model.
+ * @param max_conflicts The number of conflicts before the solver gives up.
+ * @return True if the constraints are decided.
+ */
+inline bool bitblast_solver(bool &is_sat,
+                            const std::vector<Sym> &path_constraints,
+                            const std::unordered_set<int> &int_vars,
+                            std::unordered_map<int, float> &params,
+                            float eps = 1.0f, int max_conflicts = 100000) {
+    for (const Sym &c : path_constraints) {
+        if (!BitBlaster::is_formula(c, int_vars)) {
+            return false;
+        }
+    }
+
+    BitBlaster blaster(32, max_conflicts);
+    for (const Sym &c : path_constraints) {
+        blaster.solver.add_clause({blaster.formula(c)});
+    }
+    gymbosat::SatResult result = blaster.solver.solve();
+    if (result == gymbosat::UNKNOWN) {
+        return false;
+    }
+    if (result == gymbosat::UNSAT) {
+        for (const Sym &c : path_constraints) {
+            if (!BitBlaster::is_exact(c)) {
+                return false;
+            }
+        }
+        is_sat = false;
+        return true;
+    }
+
+    // the model, e.g., of x * x < 0 by wrapping around, may not hold for
+    // the VM
+    std::unordered_map<int, float> model = params;
+    for (auto &vb : blaster.var_bits) {
+        model[vb.first] = blaster.decode(vb.first);
+    }
+    for (const Sym &c : path_constraints) {
+        if (!(c.eval(model, eps) <= 0.0f)) {
+            return false;
+        }
+    }
+    is_sat = true;
+    params = model;
+    return true;
+}
+
+}  // namespace gymbo
@@ -0,0 +1,295 @@
+/**
+ * @file block.h
+ * @brief Summaries of basic blocks as symbolic transfer functions
+ * @author Hideaki Takahashi
+ */
+
+#pragma once
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "type.h"
+
+namespace gymbo {
+
+/**
+ * @brief Kinds of the values a basic block reads from the state it is applied
+ * to.
+ */
+enum class BlockInputType {
+    Stack, /**< The k-th entry from the top of the stack at the entry. */
+    Mem,   /**< The value of a variable at the entry. */
+    Read,  /**< The k-th fresh variable read in the block. */
+    Store, /**< The value written by the k-th store of the block. */
+};
+
+/**
+ * @brief Effect of a basic block, i.e., a maximal sequence of straight-line
+ * instructions that neither jump nor fork.
+ *
+ * The values pushed and stored by the block are expressions over
+ * placeholders, which are the variables `0, 1, ...` standing for the inputs
+ * of the block. Applying the block is then a single substitution of its
+ * inputs instead of executing each of its instructions.
+ */
+struct BlockSummary {
+    bool valid = false; /**< False if the addresses depend on the inputs. */
+    int end_pc = 0;     /**< The pc after the block. */
+    int num_pops = 0;   /**< Entries of the stack consumed by the block. */
+    int num_reads = 0;  /**< Fresh variables read by the block. */
+    std::vector<std::pair<BlockInputType, int>>
+        inputs; /**< Kind and argument of each placeholder. */
+    std::vector<std::pair<int, Sym *>>
+        stores; /**< Addresses and values of the stores in order. */
+    std::vector<int> store_vars; /**< Placeholder of each store. */
+    std::vector<Sym *> pushes; /**< Values left on the stack, bottom first. */
+};
+
+/**
+ * @brief Checks whether an instruction is straight-line, i.e., it neither
+ * forks nor constrains the path, so that the state after it is unique.
+ *
+ * @param instr The instruction.
+ * @return True if the instruction is straight-line.
+ */
+inline bool is_straight_line(const Instr &instr) {
+    switch (instr.instr) {
+        case InstrType::Not:
+        case InstrType::Add:
+        case InstrType::Sub:
+        case InstrType::Mul:
+        case InstrType::BitAnd:
+        case InstrType::BitOr:
+        case InstrType::BitXor:
+        case InstrType::Shl:
+        case InstrType::Shr:
+        case InstrType::And:
+        case InstrType::Or:
+        case InstrType::Lt:
+        case InstrType::Le:
+        case InstrType::Eq:
+        case InstrType::Swap:
+        case InstrType::Store:
+        case InstrType::Load:
+        case InstrType::Read:
+        case InstrType::Push:
+        case InstrType::Dup:
+        case InstrType::Pop:
+        case InstrType::Jmp:
+        case InstrType::Nop:
+        case InstrType::Enter:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Checks whether an instruction can be part of a basic block.
+ *
+ * @param instr The instruction.
+ * @return True if the instruction is straight-line and its single successor
+ * is at the next pc.
+ */
+inline bool is_block_instr(const Instr &instr) {
+    return is_straight_line(instr) && instr.instr != InstrType::Jmp;
+}
+
+/**
+ * @brief Returns the type of the expression built by a binary instruction.
+ *
+ * @param instr_type The type of the instruction.
+ * @return The type of the expression.
+ */
+inline SymType block_binary_symtype(InstrType instr_type) {
+    switch (instr_type) {
+        case InstrType::Add:
+            return SymType::SAdd;
+        case InstrType::Sub:
+            return SymType::SSub;
+        case InstrType::Mul:
+            return SymType::SMul;
+        case InstrType::BitAnd:
+            return SymType::SBitAnd;
+        case InstrType::BitOr:
+            return SymType::SBitOr;
+        case InstrType::BitXor:
+            return SymType::SBitXor;
+        case InstrType::Shl:
+            return SymType::SShl;
+        case InstrType::Shr:
+            return SymType::SShr;
+        case InstrType::And:
+            return SymType::SAnd;
+        case InstrType::Or:
+            return SymType::SOr;
+        case InstrType::Lt:
+            return SymType::SLt;
+        case InstrType::Le:
+            return SymType::SLe;
+        default:
+            return SymType::SEq;
+    }
+}
+
+/**
+ * @brief Computes the summary of the basic block starting at a pc by
+ * executing it once over placeholders.
+ *
+ * The block is invalid if an address of a load or a store is not a constant
+ * of the block, since the variable it refers to is then unknown.
+ *
+ * @param prog The program.
+ * @param pc The first pc of the block.
+ * @return The summary.
+ */
+inline BlockSummary summarize_block(Prog &prog, int pc) {
+    BlockSummary summary;
+    std::vector<Sym *> stack;
+    std::unordered_map<int, Sym *> mem_inputs, written;
+
+    auto new_input = [&](BlockInputType type, int arg) {
+        Sym *p = new Sym(SymType::SAny, (Word32)summary.inputs.size());
+        summary.inputs.emplace_back(type, arg);
+        return p;
+    };
+    auto pop = [&]() {
+        if (stack.size() == 0) {
+            return new_input(BlockInputType::Stack, summary.num_pops++);
+        }
+        Sym *w = stack.back();
+        stack.pop_back();
+        return w;
+    };
+
+    summary.end_pc = pc;
+    while (summary.end_pc < (int)prog.size() &&
+           is_block_instr(prog[summary.end_pc])) {
+        Instr &instr = prog[summary.end_pc];
+        switch (instr.instr) {
+            case InstrType::Not: {
+                stack.emplace_back(new Sym(SymType::SNot, pop()));
+                break;
+            }
+            case InstrType::Swap: {
+                Sym *x = pop();
+                Sym *y = pop();
+                stack.emplace_back(x);
+                stack.emplace_back(y);
+                break;
+            }
+            case InstrType::Store: {
+                Sym *addr = pop();
+                if (addr->symtype != SymType::SCon) {
+                    return summary;
+                }
+                int a = wordToInt(addr->word);
+                summary.stores.emplace_back(a, pop());
+                summary.store_vars.emplace_back(summary.inputs.size());
+                written[a] = new_input(BlockInputType::Store,
+                                       summary.stores.size() - 1);
+                break;
+            }
+            case InstrType::Load: {
+                Sym *addr = pop();
+                if (addr->symtype != SymType::SCon) {
+                    return summary;
+                }
+                int a = wordToInt(addr->word);
+                if (written.find(a) != written.end()) {
+                    stack.emplace_back(written[a]);
+                } else {
+                    if (mem_inputs.find(a) == mem_inputs.end()) {
+                        mem_inputs[a] = new_input(BlockInputType::Mem, a);
+                    }
+                    stack.emplace_back(mem_inputs[a]);
+                }
+                break;
+            }
+            case InstrType::Read: {
+                stack.emplace_back(
+                    new_input(BlockInputType::Read, summary.num_reads++));
+                break;
+            }
+            case InstrType::Push: {
+                stack.emplace_back(new Sym(SymType::SCon, instr.word));
+                break;
+            }
+            case InstrType::Dup: {
+                Sym *w = pop();
+                stack.emplace_back(w);
+                stack.emplace_back(w);
+                break;
+            }
+            case InstrType::Pop: {
+                pop();
+                break;
+            }
+            case InstrType::Nop:
+            case InstrType::Enter: {
+                break;
+            }
+            default: {
+                Sym *r = pop();
+                Sym *l = pop();
+                stack.emplace_back(
+                    new Sym(block_binary_symtype(instr.instr), l, r));
+                break;
+            }
+        }
+        summary.end_pc++;
+    }
+
+    summary.pushes = stack;
+    summary.valid = true;
+    return summary;
+}
+
+/**
+ * @brief Applies the summary of a basic block to a state, which results in
+ * the same state as executing the instructions of the block.
+ *
+ * @param summary The valid summary of the block starting at the pc of the
+ * state.
+ * @param state The state, which is updated.
+ */
+inline void apply_block(const BlockSummary &summary, SymState &state) {
+    std::unordered_map<int, Sym *> values;
+    for (size_t i = 0; i < summary.inputs.size(); i++) {
+        int arg = summary.inputs[i].second;
+        switch (summary.inputs[i].first) {
+            case BlockInputType::Stack: {
+                // the popped entries stay alive in the ghost of the stack
+                values[i] = state.symbolic_stack.back();
+                state.symbolic_stack.pop();
+                break;
+            }
+            case BlockInputType::Mem: {
+                values[i] = new Sym(state.load(arg));
+                break;
+            }
+            case BlockInputType::Read: {
+                values[i] = new Sym(SymType::SAny, state.var_cnt + arg);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    // a store is read by the rest of the block as it is written
+    for (size_t k = 0; k < summary.stores.size(); k++) {
+        values[summary.store_vars[k]] =
+            state.store(summary.stores[k].first,
+                        summary.stores[k].second->substitute(values));
+    }
+
+    for (Sym *w : summary.pushes) {
+        state.symbolic_stack.push(*w->substitute(values));
+    }
+    state.var_cnt += summary.num_reads;
+    state.pc = summary.end_pc;
+}
+
+}  // namespace gymbo
@@ -10,6 +10,8 @@
 
 namespace gymbo {
 
+inline void gen(Node *node, Prog &prg, bool summarize_loops = false);
+
 /**
  * @brief Generates virtual instructions for a given AST node, representing the
  * left-hand side of a variable assignment expression.
@@ -19,6 +21,14 @@ namespace gymbo {
  * @param prg The virtual program to append the generated instructions to.
  */
 inline void gen_lval(Node *node, Prog &prg) {
+    if (node->kind == ND_INDEX) {
+        // the address of the element is resolved by `Index`, which forks
+        // the paths if the index is symbolic
+        prg.emplace_back(Instr(InstrType::Push, node->offset));
+        gen(node->lhs, prg);
+        prg.emplace_back(Instr(InstrType::Index, (Word32)node->val));
+        return;
+    }
     if (node->kind != ND_LVAR) {
         char em[] = "lvar is not a variable";
         error(em);
@@ -26,13 +36,191 @@ inline void gen_lval(Node *node, Prog &prg) {
     prg.emplace_back(Instr(InstrType::Push, node->offset));
 }
 
+/**
+ * @brief Checks whether the expression reads any of the variables.
+ *
+ * @param node The AST node of the expression.
+ * @param var_ids The indices of the variables.
+ * @return True if the expression reads one of the variables.
+ */
+inline bool reads_any(Node *node, const std::unordered_set<int> &var_ids) {
+    if (node == nullptr) {
+        return false;
+    }
+    if (node->kind == ND_LVAR) {
+        return var_ids.find(node->offset) != var_ids.end();
+    }
+    if (node->kind == ND_INDEX) {
+        for (int k = 0; k < (int)node->val; k++) {
+            if (var_ids.find(node->offset + k) != var_ids.end()) {
+                return true;
+            }
+        }
+    }
+    for (Node *arg : node->blocks) {
+        if (reads_any(arg, var_ids)) {
+            return true;
+        }
+    }
+    return reads_any(node->lhs, var_ids) || reads_any(node->rhs, var_ids);
+}
+
+/**
+ * @brief Checks whether the expression is of integer type, i.e., it consists
+ * of integer literals and variables declared with `int` combined by
+ * arithmetic operators.
+ *
+ * @param node The AST node of the expression.
+ * @return True if the expression is of integer type.
+ */
+inline bool is_int_expr(Node *node) {
+    switch (node->kind) {
+        case ND_NUM:
+        case ND_LVAR:
+        case ND_INDEX:
+            return node->is_int;
+        case ND_ADD:
+        case ND_SUB:
+        case ND_MUL:
+        case ND_DIV:
+        case ND_MOD:
+            return is_int_expr(node->lhs) && is_int_expr(node->rhs);
+        case ND_BITAND:
+        case ND_BITOR:
+        case ND_BITXOR:
+        case ND_SHL:
+        case ND_SHR:
+            // bitwise operations always yield 32-bit integers
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Summarizes a simple counting loop into closed-form assignments.
+ *
+ * The supported loop has the form `for (i = c0; i < c1; i = i + s) body` (or
+ * `i <= c1`) with constants `c0`, `c1` and `s > 0`, where each statement of the
+ * body is `v = v + e` or `v = v - e` for a distinct variable `v` other than
+ * `i`, and `e` reads none of the variables assigned in the loop and is of
+ * integer type if `v` is an integer. The constants must be integers, as the
+ * margin of the strict inequalities (at most 1) then does not change the
+ * number of iterations. Such a loop is compiled into
+ * `v = v + n * e` (or `v = v - n * e`) for each statement and
+ * `i = c0 + n * s`, where `n` is the number of iterations.
+ *
+ * @param node The AST node of the loop.
+ * @param prg The virtual program to append the generated instructions to.
+ * @return False if the loop is not supported, in which case nothing is
+ * generated.
+ */
+inline bool summarize_loop(Node *node, Prog &prg) {
+    Node *init = node->lhs;
+    Node *cond = node->cond;
+    Node *inc = node->rhs;
+    if (init == nullptr || cond == nullptr || inc == nullptr ||
+        init->kind != ND_ASSIGN || init->lhs->kind != ND_LVAR ||
+        init->rhs->kind != ND_NUM) {
+        return false;
+    }
+    Node *i = init->lhs;
+    if ((cond->kind != ND_LT && cond->kind != ND_LE) ||
+        cond->lhs->kind != ND_LVAR || cond->lhs->offset != i->offset ||
+        cond->rhs->kind != ND_NUM) {
+        return false;
+    }
+    if (inc->kind != ND_ASSIGN || inc->lhs->kind != ND_LVAR ||
+        inc->lhs->offset != i->offset || inc->rhs->kind != ND_ADD) {
+        return false;
+    }
+    Node *step = nullptr;
+    if (inc->rhs->lhs->kind == ND_LVAR && inc->rhs->lhs->offset == i->offset) {
+        step = inc->rhs->rhs;
+    } else if (inc->rhs->rhs->kind == ND_LVAR &&
+               inc->rhs->rhs->offset == i->offset) {
+        step = inc->rhs->lhs;
+    }
+    if (step == nullptr || step->kind != ND_NUM || step->val <= 0.0f) {
+        return false;
+    }
+
+    std::vector<Node *> stmts;
+    if (node->then->kind == ND_BLOCK) {
+        stmts = node->then->blocks;
+    } else {
+        stmts.emplace_back(node->then);
+    }
+
+    // each statement must be `v = v + e`, `v = e + v` or `v = v - e`
+    std::unordered_set<int> assigned = {i->offset};
+    std::vector<std::tuple<Node *, NodeKind, Node *>> updates;
+    for (Node *st : stmts) {
+        if (st->kind != ND_ASSIGN || st->lhs->kind != ND_LVAR ||
+            (st->rhs->kind != ND_ADD && st->rhs->kind != ND_SUB) ||
+            assigned.find(st->lhs->offset) != assigned.end()) {
+            return false;
+        }
+        Node *v = st->lhs;
+        Node *rhs = st->rhs;
+        if (rhs->lhs->kind == ND_LVAR && rhs->lhs->offset == v->offset) {
+            updates.emplace_back(v, rhs->kind, rhs->rhs);
+        } else if (rhs->kind == ND_ADD && rhs->rhs->kind == ND_LVAR &&
+                   rhs->rhs->offset == v->offset) {
+            updates.emplace_back(v, rhs->kind, rhs->lhs);
+        } else {
+            return false;
+        }
+        assigned.emplace(v->offset);
+    }
+    for (auto &u : updates) {
+        if (reads_any(std::get<2>(u), assigned)) {
+            return false;
+        }
+        // an integer truncates each partial sum, which `n * e` does not
+        if (std::get<0>(u)->is_int && !is_int_expr(std::get<2>(u))) {
+            return false;
+        }
+    }
+
+    float c0 = init->rhs->val;
+    float c1 = cond->rhs->val;
+    float s = step->val;
+    // the unrolled loop evaluates `i < c1` as `i + eps <= c1`, which agrees
+    // with the exact count below only when all the constants are integers
+    if (c0 != std::floor(c0) || c1 != std::floor(c1) || s != std::floor(s)) {
+        return false;
+    }
+    float n;
+    if (cond->kind == ND_LT) {
+        n = (c1 > c0) ? std::ceil((c1 - c0) / s) : 0.0f;
+    } else {
+        n = (c1 >= c0) ? std::floor((c1 - c0) / s) + 1.0f : 0.0f;
+    }
+
+    if (n > 0.0f) {
+        for (auto &u : updates) {
+            Node *v = std::get<0>(u);
+            gen(new_binary(ND_ASSIGN, v,
+                           new_binary(std::get<1>(u), v,
+                                      new_binary(ND_MUL, new_num(n),
+                                                 std::get<2>(u)))),
+                prg);
+        }
+    }
+    gen(new_binary(ND_ASSIGN, i, new_num(c0 + n * s)), prg);
+    return true;
+}
+
 /**
  * @brief Generates virtual instructions for a given AST node.
  *
  * @param node The AST node to generate LLVM instructions for.
  * @param prg The virtual program to append the generated instructions to.
+ * @param summarize_loops If true, simple counting loops are summarized into
+ * closed-form assignments (see `summarize_loop`).
  */
-inline void gen(Node *node, Prog &prg) {
+inline void gen(Node *node, Prog &prg, bool summarize_loops) {
     switch (node->kind) {
         case (ND_RETURN): {
             prg.emplace_back(Instr(InstrType::Done));
@@ -40,17 +228,48 @@ inline void gen(Node *node, Prog &prg) {
         }
         case (ND_BLOCK): {
             for (Node *b : node->blocks) {
-                gen(b, prg);
+                gen(b, prg, summarize_loops);
             }
             return;
         }
+        case (ND_RET): {
+            gen(node->lhs, prg, summarize_loops);
+            prg.emplace_back(Instr(InstrType::Ret));
+            return;
+        }
+        case (ND_FUNC): {
+            // the arguments are on the stack, the last one at the top
+            prg.emplace_back(Instr(InstrType::Enter, node->blocks.size()));
+            for (int i = node->blocks.size() - 1; i >= 0; i--) {
+                gen_lval(node->blocks[i], prg);
+                prg.emplace_back(Instr(InstrType::Store));
+            }
+            gen(node->then, prg, summarize_loops);
+            prg.emplace_back(Instr(InstrType::Push, FloatToWord(0)));
+            prg.emplace_back(Instr(InstrType::Ret));
+            return;
+        }
+        case (ND_CALL): {
+            for (Node *arg : node->blocks) {
+                gen(arg, prg, summarize_loops);
+            }
+            // the index of the function is replaced with its entry pc by
+            // `compile_ast`
+            prg.emplace_back(Instr(InstrType::Call, node->offset));
+            return;
+        }
+        case (ND_RANDVAR): {
+            // random variables are symbolic; their distributions are
+            // collected by `gather_random_vars`.
+            return;
+        }
         case ND_IF: {
-            gen(node->cond, prg);
+            gen(node->cond, prg, summarize_loops);
             Prog then_prg, els_prg;
-            gen(node->then, then_prg);
+            gen(node->then, then_prg, summarize_loops);
 
             if (node->els != nullptr) {
-                gen(node->els, els_prg);
+                gen(node->els, els_prg, summarize_loops);
             } else {
                 els_prg.emplace_back(Instr(InstrType::Nop));
             }
@@ -64,27 +283,68 @@ inline void gen(Node *node, Prog &prg) {
             prg.insert(prg.end(), then_prg.begin(), then_prg.end());
             return;
         }
+        case ND_FOR: {
+            if (summarize_loops && summarize_loop(node, prg)) {
+                return;
+            }
+            if (node->lhs != nullptr) {
+                gen(node->lhs, prg, summarize_loops);
+            }
+
+            Prog cond_prg, body_prg;
+            if (node->cond != nullptr) {
+                gen(node->cond, cond_prg, summarize_loops);
+            } else {
+                cond_prg.emplace_back(Instr(InstrType::Push, FloatToWord(1)));
+            }
+            gen(node->then, body_prg, summarize_loops);
+            if (node->rhs != nullptr) {
+                gen(node->rhs, body_prg, summarize_loops);
+            }
+
+            // cond; if true, jump to the body; otherwise, jump to the exit
+            prg.insert(prg.end(), cond_prg.begin(), cond_prg.end());
+            prg.emplace_back(Instr(InstrType::Push, 5));
+            prg.emplace_back(Instr(InstrType::Swap));
+            prg.emplace_back(Instr(InstrType::JmpIf, JMPIF_LOOP));
+            prg.emplace_back(Instr(InstrType::Push, 3 + body_prg.size()));
+            prg.emplace_back(Instr(InstrType::Jmp));
+            // body; jump back to the condition
+            prg.insert(prg.end(), body_prg.begin(), body_prg.end());
+            int back = -(int)(cond_prg.size() + body_prg.size() + 6);
+            prg.emplace_back(Instr(InstrType::Push, (Word32)back));
+            prg.emplace_back(Instr(InstrType::Jmp));
+            return;
+        }
         case ND_NUM: {
             prg.emplace_back(Instr(InstrType::Push, FloatToWord(node->val)));
             return;
         }
-        case ND_LVAR: {
+        case ND_LVAR:
+        case ND_INDEX: {
             gen_lval(node, prg);
             prg.emplace_back(Instr(InstrType::Load));
             return;
         }
         case ND_ASSIGN: {
             gen_lval(node->lhs, prg);
-            prg.emplace_back(Instr(InstrType::Load));
-            gen(node->rhs, prg);
+            gen(node->rhs, prg, summarize_loops);
+            if (node->lhs->is_int && !is_int_expr(node->rhs)) {
+                // the value assigned to an integer is truncated toward zero
+                prg.emplace_back(Instr(InstrType::Push, FloatToWord(1)));
+                prg.emplace_back(Instr(InstrType::Div, DIV_TRUNC));
+            }
             prg.emplace_back(Instr(InstrType::Swap));
             prg.emplace_back(Instr(InstrType::Store));
             return;
         }
+        default:
+            // binary operators are generated below
+            break;
     }
 
-    gen(node->lhs, prg);
-    gen(node->rhs, prg);
+    gen(node->lhs, prg, summarize_loops);
+    gen(node->rhs, prg, summarize_loops);
 
     switch (node->kind) {
         case ND_ADD:
@@ -96,6 +356,29 @@ inline void gen(Node *node, Prog &prg) {
         case ND_MUL:
             prg.emplace_back(Instr(InstrType::Mul));
             return;
+        case ND_DIV:
+            // the quotient of integers is truncated as in C
+            prg.emplace_back(
+                Instr(InstrType::Div, is_int_expr(node) ? DIV_TRUNC : 0));
+            return;
+        case ND_MOD:
+            prg.emplace_back(Instr(InstrType::Mod));
+            return;
+        case ND_BITAND:
+            prg.emplace_back(Instr(InstrType::BitAnd));
+            return;
+        case ND_BITOR:
+            prg.emplace_back(Instr(InstrType::BitOr));
+            return;
+        case ND_BITXOR:
+            prg.emplace_back(Instr(InstrType::BitXor));
+            return;
+        case ND_SHL:
+            prg.emplace_back(Instr(InstrType::Shl));
+            return;
+        case ND_SHR:
+            prg.emplace_back(Instr(InstrType::Shr));
+            return;
         case ND_EQ:
             prg.emplace_back(Instr(InstrType::Eq));
             return;
@@ -115,6 +398,8 @@ inline void gen(Node *node, Prog &prg) {
         case ND_OR:
             prg.emplace_back(Instr(InstrType::Or));
             return;
+        default:
+            break;
     }
 
     char em[] = "Unsupported Node";
@@ -125,18 +410,109 @@ inline void gen(Node *node, Prog &prg) {
  * @brief Compile the Abstract Syntax Tree (AST) into a sequence of instructions.
  *
  * This function traverses the provided AST and generates corresponding instructions
- * to be executed in the virtual stack machine.
+ * to be executed in the virtual stack machine. The functions are placed after the
+ * main program, and each of them starts with `Enter` and returns with `Ret`.
  *
  * @param code A vector containing pointers to AST nodes.
  * @param prg A reference to the program (sequence of instructions) being generated.
+ * @param summarize_loops If true, simple counting loops are summarized into
+ * closed-form assignments instead of being unrolled at execution.
  */
-inline void compile_ast(std::vector<Node *> code, Prog &prg) {
+inline void compile_ast(std::vector<Node *> code, Prog &prg,
+                        bool summarize_loops = false) {
+    std::vector<Node *> funcs;
     for (int i = 0; i < code.size(); i++) {
-        if (code[i] != nullptr) {
-            gen(code[i], prg);
-        } else {
+        if (code[i] == nullptr) {
             prg.emplace_back(Instr(InstrType::Done));
+        } else if (code[i]->kind == ND_FUNC) {
+            funcs.emplace_back(code[i]);
+        } else {
+            gen(code[i], prg, summarize_loops);
         }
     }
+
+    // functions are placed after the main program
+    std::vector<int> entries(funcs.size());
+    for (Node *f : funcs) {
+        entries[f->offset] = prg.size();
+        gen(f, prg, summarize_loops);
+    }
+    for (Instr &instr : prg) {
+        if (instr.instr == InstrType::Call) {
+            instr.word = entries[instr.word];
+        }
+    }
+}
+
+/**
+ * @brief Collects the distributions of the random variables declared in the
+ * AST (e.g., `x ~ bernoulli(0.3);`).
+ *
+ * @param node The AST node to traverse.
+ * @param var2dist Map of variable index to DiscreteDist to be updated.
+ */
+inline void gather_random_vars(
+    Node *node, std::unordered_map<int, DiscreteDist> &var2dist) {
+    if (node == nullptr) {
+        return;
+    }
+    if (node->kind == ND_RANDVAR) {
+        var2dist[node->offset] = *node->dist;
+    } else if (node->kind == ND_BLOCK) {
+        for (Node *b : node->blocks) {
+            gather_random_vars(b, var2dist);
+        }
+    } else if (node->kind == ND_IF || node->kind == ND_FOR) {
+        gather_random_vars(node->then, var2dist);
+        gather_random_vars(node->els, var2dist);
+    }
+}
+
+/**
+ * @brief Collects the variables of integer type, i.e., those declared with
+ * `int`, read or written in the AST.
+ *
+ * @param node The AST node to traverse.
+ * @param int_vars Set of the indices of integer variables to be updated.
+ */
+inline void gather_int_vars(Node *node, std::unordered_set<int> &int_vars) {
+    if (node == nullptr) {
+        return;
+    }
+    if ((node->kind == ND_LVAR || node->kind == ND_INDEX) && node->is_int) {
+        int n = (node->kind == ND_INDEX) ? (int)node->val : 1;
+        for (int k = 0; k < n; k++) {
+            int_vars.emplace(node->offset + k);
+        }
+    }
+    for (Node *b : node->blocks) {
+        gather_int_vars(b, int_vars);
+    }
+    gather_int_vars(node->lhs, int_vars);
+    gather_int_vars(node->rhs, int_vars);
+    gather_int_vars(node->cond, int_vars);
+    gather_int_vars(node->then, int_vars);
+    gather_int_vars(node->els, int_vars);
+}
+
+/**
+ * @brief Compile the Abstract Syntax Tree (AST) into a sequence of
+ * instructions, and collects the distributions of the declared random
+ * variables.
+ *
+ * @param code A vector containing pointers to AST nodes.
+ * @param prg A reference to the program (sequence of instructions) being
+ * generated.
+ * @param var2dist Map of variable index to DiscreteDist to be updated.
+ * @param summarize_loops If true, simple counting loops are summarized into
+ * closed-form assignments instead of being unrolled at execution.
+ */
+inline void compile_ast(std::vector<Node *> code, Prog &prg,
+                        std::unordered_map<int, DiscreteDist> &var2dist,
+                        bool summarize_loops = false) {
+    compile_ast(code, prg, summarize_loops);
+    for (Node *node : code) {
+        gather_random_vars(node, var2dist);
+    }
 }
 }  // namespace gymbo
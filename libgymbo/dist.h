@@ -0,0 +1,376 @@
+/**
+ * @file dist.h
+ * @brief Discrete probability distributions of random variables.
+ * @author Hideaki Takahashi
+ */
+
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace gymbo {
+
+/**
+ * @brief The largest number of values in the support of a distribution, which
+ * bounds the memory of its tables and the time of enumerating it.
+ */
+constexpr int MAX_SUPPORT_SIZE = 1 << 20;
+
+/**
+ * @brief Computes `x * log(y)`, which is zero when `x` is zero.
+ *
+ * @param x The multiplier.
+ * @param y The argument of the logarithm.
+ * @return `x * log(y)`.
+ */
+inline double xlogy(double x, double y) {
+    return (x == 0.0) ? 0.0 : x * std::log(y);
+}
+
+/**
+ * @struct DiscreteDist
+ * @brief Represents a discrete probability distribution.
+ *
+ * @details The probability mass table is stored in contiguous arrays, so that
+ * marginalization and sampling can weight many assignments at once. The
+ * derived distributions compute `log_probs` first, which keeps the tables
+ * accurate for large supports, and then fill `probs` and `cdf` with
+ * `finalize`.
+ */
+struct DiscreteDist {
+    std::vector<int> vals;    /**< Vector to store possible discrete values. */
+    std::vector<float> probs; /** Probability of each value */
+    std::vector<float> log_probs; /** Log probability of each value */
+    std::vector<float> cdf;       /** Cumulative sum of `probs` */
+
+    /**
+     * @brief Default constructor for DiscreteDist.
+     */
+    DiscreteDist() {}
+
+    /**
+     * @brief Constructor for DiscreteDist with an explicit table.
+     * @param vals Possible discrete values.
+     * @param probs Probability of each value.
+     */
+    DiscreteDist(std::vector<int> vals, std::vector<float> probs)
+        : vals(vals), probs(probs) {
+        finalize();
+    }
+
+    /**
+     * @brief Fills `log_probs` and `cdf` from `probs`. This must be called
+     * after modifying `probs` directly.
+     */
+    void finalize() {
+        log_probs.resize(probs.size());
+        cdf.resize(probs.size());
+        float c = 0.0f;
+        for (size_t k = 0; k < probs.size(); k++) {
+            log_probs[k] = std::log(probs[k]);
+            c += probs[k];
+            cdf[k] = c;
+        }
+    }
+
+    /**
+     * @brief Returns the total probability of the table.
+     * @return The total probability (one if the distribution is normalized).
+     */
+    float mass() const {
+        if (cdf.size() == probs.size() && cdf.size() != 0) {
+            return cdf.back();
+        }
+        float m = 0.0f;
+        for (float p : probs) {
+            m += p;
+        }
+        return m;
+    }
+
+   protected:
+    /**
+     * @brief Sets the table from unnormalized log probabilities, normalizes
+     * it with the log-sum-exp trick, and fills `probs` and `cdf`.
+     * @param lps Unnormalized log probability of each value in `vals`.
+     */
+    void set_log_probs(const std::vector<double> &lps) {
+        double max_lp = -std::numeric_limits<double>::infinity();
+        for (double lp : lps) {
+            max_lp = std::max(max_lp, lp);
+        }
+        double s = 0.0;
+        for (double lp : lps) {
+            s += std::exp(lp - max_lp);
+        }
+        double log_z = max_lp + std::log(s);
+
+        log_probs.resize(lps.size());
+        probs.resize(lps.size());
+        cdf.resize(lps.size());
+        float c = 0.0f;
+        for (size_t k = 0; k < lps.size(); k++) {
+            log_probs[k] = lps[k] - log_z;
+            probs[k] = std::exp(lps[k] - log_z);
+            c += probs[k];
+            cdf[k] = c;
+        }
+    }
+};
+
+/**
+ * @struct DiscreteUniformDist
+ * @brief Represents a discrete uniform distribution derived from
+ * DiscreteDist.
+ */
+struct DiscreteUniformDist : public DiscreteDist {
+    int low;  /**< The lower bound of the uniform distribution. */
+    int high; /**< The upper bound of the uniform distribution. */
+
+    /**
+     * @brief Constructor for DiscreteUniformDist.
+     * @param low The lower bound of the uniform distribution.
+     * @param high The upper bound of the uniform distribution.
+     * @details Initializes the distribution by populating vals with values from
+     * low to high (inclusive).
+     */
+    DiscreteUniformDist(int low, int high) : low(low), high(high) {
+        float p = 1.0f / (1.0f + (float)high - (float)low);
+        for (int i = low; i <= high; i++) {
+            vals.emplace_back(i);
+            probs.emplace_back(p);
+        }
+        finalize();
+    }
+};
+
+/**
+ * @struct BernoulliDist
+ * @brief Represents a bernoulli distribution derived from
+ * DiscreteDist.
+ */
+struct BernoulliDist : public DiscreteDist {
+    float p /** The probability of occurrance */;
+
+    BernoulliDist(float p) : p(p) {
+        vals = {0, 1};
+        probs = {1 - p, p};
+        finalize();
+    }
+};
+
+/**
+ * @struct BinomialDist
+ * @brief Represents a binomial distribution derived from
+ * DiscreteDist.
+ *
+ * @details The log PMF is computed with `lgamma` in O(n), which does not
+ * overflow for large n.
+ */
+struct BinomialDist : public DiscreteDist {
+    int n;   /** The number of trial */
+    float p; /** The probability of occurrance */
+
+    BinomialDist(int n, float p) : n(n), p(p) {
+        std::vector<double> lps(n + 1);
+        double log_n_fact = std::lgamma((double)n + 1.0);
+        for (int i = 0; i <= n; i++) {
+            vals.emplace_back(i);
+            lps[i] = log_n_fact - std::lgamma((double)i + 1.0) -
+                     std::lgamma((double)(n - i) + 1.0) + xlogy(i, p) +
+                     xlogy(n - i, 1.0 - (double)p);
+        }
+        set_log_probs(lps);
+    }
+};
+
+/**
+ * @struct GeometricDist
+ * @brief Represents a geometric distribution (the number of failures before
+ * the first success) truncated at `max_k`, derived from DiscreteDist.
+ */
+struct GeometricDist : public DiscreteDist {
+    float p;   /** The probability of success */
+    int max_k; /** The largest value of the support */
+
+    /**
+     * @brief Constructor for GeometricDist.
+     * @param p The probability of success.
+     * @param max_k The largest value of the support. If negative, it is chosen
+     * so that the truncated tail has a probability below `tail`. It is capped
+     * so that the support has at most `MAX_SUPPORT_SIZE` values.
+     * @param tail The probability of the truncated tail used when `max_k` is
+     * negative.
+     */
+    GeometricDist(float p, int max_k = -1, float tail = 1e-7)
+        : p(p), max_k(max_k) {
+        if (this->max_k < 0) {
+            this->max_k = (int)std::min(default_max_k(p, tail),
+                                        (double)(MAX_SUPPORT_SIZE - 1));
+        }
+        this->max_k = std::min(this->max_k, MAX_SUPPORT_SIZE - 1);
+        std::vector<double> lps(this->max_k + 1);
+        for (int i = 0; i <= this->max_k; i++) {
+            vals.emplace_back(i);
+            lps[i] = std::log((double)p) + xlogy(i, 1.0 - (double)p);
+        }
+        set_log_probs(lps);
+    }
+
+    /**
+     * @brief Returns the largest value of the support whose truncated tail
+     * has a probability below `tail`, which may exceed the range of `int`.
+     * @param p The probability of success.
+     * @param tail The probability of the truncated tail.
+     */
+    static double default_max_k(float p, float tail = 1e-7) {
+        return (p >= 1.0f) ? 0.0
+                           : std::ceil(std::log(tail) / std::log(1.0 - p));
+    }
+};
+
+/**
+ * @struct PoissonDist
+ * @brief Represents a poisson distribution truncated at `max_k`, derived from
+ * DiscreteDist.
+ */
+struct PoissonDist : public DiscreteDist {
+    float lambda; /** The expected number of occurrences */
+    int max_k;    /** The largest value of the support */
+
+    /**
+     * @brief Constructor for PoissonDist.
+     * @param lambda The expected number of occurrences.
+     * @param max_k The largest value of the support. If negative, it is set to
+     * `lambda + 10 * sqrt(lambda) + 10`, whose tail is negligible. It is
+     * capped so that the support has at most `MAX_SUPPORT_SIZE` values.
+     */
+    PoissonDist(float lambda, int max_k = -1) : lambda(lambda), max_k(max_k) {
+        if (this->max_k < 0) {
+            this->max_k = (int)std::min(default_max_k(lambda),
+                                        (double)(MAX_SUPPORT_SIZE - 1));
+        }
+        this->max_k = std::min(this->max_k, MAX_SUPPORT_SIZE - 1);
+        std::vector<double> lps(this->max_k + 1);
+        for (int i = 0; i <= this->max_k; i++) {
+            vals.emplace_back(i);
+            lps[i] = xlogy(i, lambda) - (double)lambda -
+                     std::lgamma((double)i + 1.0);
+        }
+        set_log_probs(lps);
+    }
+
+    /**
+     * @brief Returns `lambda + 10 * sqrt(lambda) + 10` rounded up, which may
+     * exceed the range of `int`.
+     * @param lambda The expected number of occurrences.
+     */
+    static double default_max_k(float lambda) {
+        return std::ceil((double)lambda + 10.0 * std::sqrt((double)lambda) +
+                         10.0);
+    }
+};
+
+/**
+ * @struct CategoricalDist
+ * @brief Represents a categorical distribution over arbitrary values derived
+ * from DiscreteDist.
+ */
+struct CategoricalDist : public DiscreteDist {
+    /**
+     * @brief Constructor for CategoricalDist.
+     * @param vals Possible discrete values.
+     * @param weights Non-negative weight of each value, which is normalized.
+     */
+    CategoricalDist(std::vector<int> vals, std::vector<float> weights) {
+        this->vals = vals;
+        std::vector<double> lps(weights.size());
+        for (size_t i = 0; i < weights.size(); i++) {
+            lps[i] = std::log((double)weights[i]);
+        }
+        set_log_probs(lps);
+    }
+};
+
+/**
+ * @brief Constructs a distribution from its name and arguments, as written in
+ * a declaration such as `x ~ bernoulli(0.3);`.
+ *
+ * The supported distributions are `uniform(low, high)`, `bernoulli(p)`,
+ * `binomial(n, p)`, `geometric(p[, max_k])`, `poisson(lambda[, max_k])`, and
+ * `categorical(v_0, w_0, v_1, w_1, ...)`.
+ *
+ * @param name The name of the distribution.
+ * @param args The arguments of the distribution.
+ * @param dist The constructed distribution.
+ * @return False if the name, the number of arguments, or their values are
+ * invalid, e.g., a probability outside [0, 1], `low > high`, or a support of
+ * more than `MAX_SUPPORT_SIZE` values.
+ */
+inline bool make_dist(const std::string &name, const std::vector<float> &args,
+                      DiscreteDist &dist) {
+    int n = args.size();
+    auto is_prob = [](float p) { return p >= 0.0f && p <= 1.0f; };
+    // the values are truncated to int, which must not overflow
+    auto is_int = [](float v) {
+        return std::fabs(v) < (float)std::numeric_limits<int>::max();
+    };
+    auto fits = [](double max_k) { return max_k < MAX_SUPPORT_SIZE; };
+    if (name == "uniform" && n == 2) {
+        if (!is_int(args[0]) || !is_int(args[1]) ||
+            (int)args[0] > (int)args[1] ||
+            !fits((double)(int)args[1] - (double)(int)args[0])) {
+            return false;
+        }
+        dist = DiscreteUniformDist((int)args[0], (int)args[1]);
+    } else if (name == "bernoulli" && n == 1) {
+        if (!is_prob(args[0])) {
+            return false;
+        }
+        dist = BernoulliDist(args[0]);
+    } else if (name == "binomial" && n == 2) {
+        if (!(args[0] >= 0.0f) || !fits(args[0]) || !is_prob(args[1])) {
+            return false;
+        }
+        dist = BinomialDist((int)args[0], args[1]);
+    } else if (name == "geometric" && (n == 1 || n == 2)) {
+        // the support is infinite without a success
+        if (!is_prob(args[0]) || args[0] == 0.0f ||
+            (n == 2 && !is_int(args[1])) ||
+            !fits((n == 2) ? args[1]
+                           : GeometricDist::default_max_k(args[0]))) {
+            return false;
+        }
+        dist = GeometricDist(args[0], (n == 2) ? (int)args[1] : -1);
+    } else if (name == "poisson" && (n == 1 || n == 2)) {
+        if (!(args[0] >= 0.0f) || (n == 2 && !is_int(args[1])) ||
+            !fits((n == 2) ? args[1] : PoissonDist::default_max_k(args[0]))) {
+            return false;
+        }
+        dist = PoissonDist(args[0], (n == 2) ? (int)args[1] : -1);
+    } else if (name == "categorical" && n > 0 && n % 2 == 0) {
+        std::vector<int> vals;
+        std::vector<float> weights;
+        float total = 0.0f;
+        for (int i = 0; i < n; i += 2) {
+            if (!is_int(args[i]) || !(args[i + 1] >= 0.0f)) {
+                return false;
+            }
+            vals.emplace_back((int)args[i]);
+            weights.emplace_back(args[i + 1]);
+            total += args[i + 1];
+        }
+        if (total <= 0.0f) {
+            return false;
+        }
+        dist = CategoricalDist(vals, weights);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+}  // namespace gymbo
@@ -5,12 +5,70 @@
  */
 
 #pragma once
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <numeric>
 #include <random>
 
+#include "jit.h"
 #include "type.h"
 
 namespace gymbo {
 
+/**
+ * @brief Initializers of the free variables of `GDOptimizer::solve`.
+ */
+enum class InitType {
+    Uniform, /**< Independent uniform draws from the generator of `seed`. */
+    Halton,  /**< The `seed`-th point of the Halton sequence. */
+    LatinHypercube, /**< Latin hypercube over blocks of `num_strata`
+                       consecutive seeds. */
+};
+
+/**
+ * @brief Returns the n-th prime number, starting from 2 for n = 0.
+ *
+ * @param n The index of the prime.
+ * @return The prime.
+ */
+inline unsigned int nth_prime(int n) {
+    unsigned int p = 1;
+    for (int k = 0; k <= n;) {
+        p++;
+        bool is_prime = true;
+        for (unsigned int d = 2; d * d <= p; d++) {
+            if (p % d == 0) {
+                is_prime = false;
+                break;
+            }
+        }
+        if (is_prime) {
+            k++;
+        }
+    }
+    return p;
+}
+
+/**
+ * @brief Computes the radical inverse of an integer, i.e., its digits in a
+ * base mirrored at the radix point, which is a coordinate of the Halton
+ * sequence.
+ *
+ * @param k The index of the point.
+ * @param base The base, which is a distinct prime for each dimension.
+ * @return The coordinate in [0, 1).
+ */
+inline float radical_inverse(unsigned int k, unsigned int base) {
+    double result = 0.0, scale = 1.0 / base;
+    while (k > 0) {
+        result += (k % base) * scale;
+        k /= base;
+        scale /= base;
+    }
+    return (float)result;
+}
+
 /**
  * @brief Gradient Descent Optimizer for Symbolic Path Constraints
  *
@@ -41,6 +99,47 @@ struct GDOptimizer {
                                    ///< use eval and grad.
     int seed;          ///< Random seed for initializing parameter values.
     int num_used_itr;  ///< Number of used iterations during optimization.
+    std::unordered_set<int>
+        int_vars;  ///< Variables of integer type, whose values are rounded.
+    bool use_jit = false;  ///< If true, compile the losses to native code
+                           ///< when they are still unsatisfied after
+                           ///< `jit_warmup_epochs` interpreted epochs.
+    int jit_warmup_epochs = 100;  ///< Number of epochs interpreted before
+                                  ///< compiling the losses.
+    float smooth_temperature =
+        0.0f;  ///< Initial temperature of the smooth surrogate losses, where
+               ///< 0 means the exact losses.
+    float smooth_decay = 0.9f;  ///< Decay of the temperature per epoch.
+    float smooth_min_temperature =
+        1e-3f;  ///< Temperature below which the exact losses are used.
+    std::unordered_map<int, std::pair<float, float>>
+        var_bounds;  ///< Per-variable bounds, which override `param_low` and
+                     ///< `param_high` for the initialization, and into which
+                     ///< the variable is projected after every update (see
+                     ///< `clamp`).
+    std::unordered_map<int, float>
+        var_lr;  ///< Per-variable learning rates, which override `lr`.
+    bool precondition = false;  ///< If true, infer the learning rates of the
+                                ///< variables without `var_lr` by diagonal
+                                ///< preconditioning (see `learning_rates`).
+    InitType init_type =
+        InitType::Uniform;  ///< Initializer of the free variables (see
+                            ///< `sample`).
+    int num_strata = 10;    ///< Number of strata per variable of the Latin
+                            ///< hypercube.
+    bool init_within_intervals =
+        false;  ///< If true, sample within `interval_bounds`.
+    std::unordered_map<int, std::pair<float, float>>
+        interval_bounds;  ///< Bounds inferred by interval propagation, which
+                          ///< are set by `call_smt_solver`.
+    bool reuse_models = false;  ///< If true, start from the last model found,
+                                ///< i.e., the next `warm_start`.
+    std::unordered_map<int, float>
+        warm_start;  ///< Initial values of the free variables for the next
+                     ///< call of `solve` only.
+    const std::atomic<bool> *cancel =
+        nullptr;  ///< Flag set by another thread to stop the optimization,
+                  ///< e.g., when another solver of a portfolio succeeds.
 
     /**
      * @brief Constructor for GDOptimizer.
@@ -91,13 +190,274 @@ struct GDOptimizer {
         return result;
     }
 
+    /**
+     * @brief Evaluates the path constraints at the parameters rounded by
+     * `project`, without copying the parameters when there are no integer
+     * variables to round.
+     *
+     * @param path_constraints Vector of symbolic path constraints.
+     * @param params Map of parameter values.
+     * @return `true` if all constraints are satisfied; otherwise, `false`.
+     */
+    bool eval_projected(std::vector<Sym> &path_constraints,
+                        const std::unordered_map<int, float> &params) {
+        if (int_vars.size() != 0) {
+            return eval(path_constraints, project(params));
+        }
+        for (Sym &c : path_constraints) {
+            if (!(c.eval(params, eps) <= 0.0f)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Checks whether the optimization is cancelled by `cancel`.
+     *
+     * @return `true` if the flag is set; otherwise, `false`.
+     */
+    bool is_cancelled() const {
+        return cancel != nullptr && cancel->load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Rounds the values of the integer variables to the nearest
+     * integers.
+     *
+     * @param params Map of parameter values.
+     * @return The parameter values after rounding.
+     */
+    std::unordered_map<int, float> project(
+        const std::unordered_map<int, float> &params) const {
+        std::unordered_map<int, float> result = params;
+        for (auto &p : result) {
+            if (int_vars.find(p.first) != int_vars.end()) {
+                p.second = std::round(p.second);
+            }
+        }
+        return result;
+    }
+
+    /**
+     * @brief Returns the range where a variable is initialized.
+     *
+     * The range is given by `var_bounds`, or `param_low` and `param_high`.
+     * With `init_within_intervals`, it is intersected with the interval
+     * inferred for the variable, and it is shifted to the nearest end of the
+     * interval if they are disjoint, e.g., to [100, 120] for `x > 100` and
+     * the default range [-10, 10].
+     *
+     * @param i The variable.
+     * @return The lower and upper bounds.
+     */
+    std::pair<float, float> init_range(int i) const {
+        auto bounds = var_bounds.find(i);
+        float lo = (bounds == var_bounds.end()) ? param_low
+                                                : bounds->second.first;
+        float hi = (bounds == var_bounds.end()) ? param_high
+                                                : bounds->second.second;
+        auto inferred = interval_bounds.find(i);
+        if (!init_within_intervals || inferred == interval_bounds.end()) {
+            return std::make_pair(lo, hi);
+        }
+
+        float ilo = inferred->second.first, ihi = inferred->second.second;
+        float width = hi - lo;
+        if (ihi < lo) {
+            return std::make_pair(std::max(ilo, ihi - width), ihi);
+        } else if (hi < ilo) {
+            return std::make_pair(ilo, std::min(ihi, ilo + width));
+        }
+        return std::make_pair(std::max(lo, ilo), std::min(hi, ihi));
+    }
+
+    /**
+     * @brief Maps a point of [0, 1) to a range.
+     *
+     * With `init_param_uniform_int`, the range is split into its integers,
+     * each of which receives an equal share of [0, 1). A range without any
+     * integer, or an empty range, gives its lower bound.
+     *
+     * @param range The lower and upper bounds.
+     * @param u The point.
+     * @return The value.
+     */
+    float scale(std::pair<float, float> range, float u) const {
+        float lo = range.first, hi = range.second;
+        if (init_param_uniform_int) {
+            lo = std::ceil(lo);
+            hi = std::floor(hi);
+            if (hi < lo) {
+                return lo;
+            }
+            return std::min(lo + std::floor(u * (hi - lo + 1.0f)), hi);
+        }
+        if (hi < lo) {
+            return lo;
+        }
+        return std::min(lo + u * (hi - lo), hi);
+    }
+
+    /**
+     * @brief Draws the initial value of a free variable.
+     *
+     * `Uniform` draws each variable independently, so that the points of
+     * successive seeds may cluster. `Halton` takes the `seed`-th point of
+     * the Halton sequence, whose coordinates are the radical inverses in
+     * distinct prime bases, and `LatinHypercube` splits the range of each
+     * variable into `num_strata` strata and visits each of them once in
+     * every block of `num_strata` consecutive seeds in an order shuffled per
+     * variable. Since the solvers increment the seed at each restart, the
+     * restarts of the latter two cover the space evenly. The drawn point of
+     * [0, 1) is mapped to `init_range` by `scale`.
+     *
+     * @param i The variable.
+     * @param dim The index of the variable among the free variables.
+     * @param gen The generator seeded by `seed`.
+     * @return The initial value.
+     */
+    float sample(int i, int dim, std::mt19937 &gen) const {
+        unsigned int k = (unsigned int)seed;
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        float u;
+        if (init_type == InitType::Uniform) {
+            u = unit(gen);
+        } else if (init_type == InitType::Halton) {
+            u = radical_inverse(k + 1, nth_prime(dim));
+        } else {
+            int n = std::max(num_strata, 1);
+            std::seed_seq seq{k / n, (unsigned int)dim};
+            std::mt19937 perm_gen(seq);
+            std::vector<int> perm(n);
+            std::iota(perm.begin(), perm.end(), 0);
+            std::shuffle(perm.begin(), perm.end(), perm_gen);
+            u = (perm[k % n] + unit(gen)) / n;
+        }
+        return scale(init_range(i), u);
+    }
+
+    /**
+     * @brief Returns the box into which a variable is projected.
+     *
+     * The box is given by `var_bounds`, and it is unbounded if the variable
+     * has none. The bounds of an integer variable are narrowed to the
+     * integers within them, so that the rounded value stays within them as
+     * well.
+     *
+     * @param i The variable.
+     * @return The lower and upper bounds.
+     */
+    std::pair<float, float> feasible_box(int i) const {
+        auto bounds = var_bounds.find(i);
+        if (bounds == var_bounds.end()) {
+            return std::make_pair(-std::numeric_limits<float>::infinity(),
+                                  std::numeric_limits<float>::infinity());
+        }
+        float lo = bounds->second.first, hi = bounds->second.second;
+        if (int_vars.find(i) != int_vars.end() &&
+            std::ceil(lo) <= std::floor(hi)) {
+            lo = std::ceil(lo);
+            hi = std::floor(hi);
+        }
+        return std::make_pair(lo, hi);
+    }
+
+    /**
+     * @brief Projects a value of a variable into its `feasible_box`.
+     *
+     * @param i The variable.
+     * @param v The value.
+     * @return The nearest value within the box.
+     */
+    float clamp(int i, float v) const {
+        std::pair<float, float> box = feasible_box(i);
+        return std::min(std::max(v, box.first), box.second);
+    }
+
+    /**
+     * @brief Computes the learning rate of each variable.
+     *
+     * A variable uses its `var_lr` if given, and `lr` otherwise. With
+     * `precondition`, the latter is divided by the sensitivity of the
+     * variable, i.e., the sum of the absolute partial derivatives of the
+     * losses at the initial values, and multiplied by the geometric mean of
+     * the sensitivities. Then each step changes the losses by a similar
+     * amount whatever the scale of the variable, e.g., of an input feature,
+     * and `lr` keeps its meaning for a single variable.
+     *
+     * @param path_constraints Vector of symbolic path constraints.
+     * @param params Map of the initial parameter values.
+     * @param var_ids The variables of the constraints.
+     * @return Map of the variables to their learning rates.
+     */
+    std::unordered_map<int, float> learning_rates(
+        std::vector<Sym> &path_constraints,
+        const std::unordered_map<int, float> &params,
+        const std::unordered_set<int> &var_ids) const {
+        std::unordered_map<int, float> sensitivity;
+        float log_mean = 0.0f;
+        if (precondition) {
+            for (size_t i = 0; i < path_constraints.size(); i++) {
+                for (auto &g : path_constraints[i].grad(params, eps).val) {
+                    sensitivity[g.first] += std::abs(g.second);
+                }
+            }
+            int cnt = 0;
+            for (auto &d : sensitivity) {
+                if (d.second > 0.0f && std::isfinite(d.second)) {
+                    log_mean += std::log(d.second);
+                    cnt++;
+                }
+            }
+            log_mean = (cnt > 0) ? log_mean / cnt : 0.0f;
+        }
+
+        std::unordered_map<int, float> result;
+        for (int i : var_ids) {
+            auto itr = var_lr.find(i);
+            auto d = sensitivity.find(i);
+            if (itr != var_lr.end()) {
+                result.emplace(i, itr->second);
+            } else if (d != sensitivity.end() && d->second > 0.0f &&
+                       std::isfinite(d->second)) {
+                result.emplace(i, lr * std::exp(log_mean) / d->second);
+            } else {
+                result.emplace(i, lr);
+            }
+        }
+        return result;
+    }
+
+    /**
+     * @brief Returns the temperature of the smooth surrogate losses at an
+     * epoch.
+     *
+     * The temperature decays geometrically from `smooth_temperature`, and
+     * it becomes 0, i.e., the losses become exact, once it falls below
+     * `smooth_min_temperature`.
+     *
+     * @param itr The epoch.
+     * @return The temperature.
+     */
+    float temperature(int itr) const {
+        float t = smooth_temperature * std::pow(smooth_decay, itr);
+        return (t < smooth_min_temperature) ? 0.0f : t;
+    }
+
     /**
      * @brief Solve path constraints using gradient descent optimization.
      *
      * This function attempts to find parameter values that satisfy the given
      * path constraints by using gradient descent optimization. It iteratively
      * updates the parameters until the constraints are satisfied or the maximum
-     * number of epochs is reached.
+     * number of epochs is reached. The integer variables are optimized as
+     * real values, and the constraints are checked after rounding them.
+     * If `smooth_temperature` is positive, the gradients are those of the
+     * smooth surrogate losses annealed by `temperature`, whereas the
+     * constraints are always checked with the exact losses.
+     * The variables missing in `params` start from `warm_start` if given,
+     * and from `sample` otherwise, and they are kept within `var_bounds`.
      *
      * @param path_constraints Vector of symbolic path constraints.
      * @param params Map of parameter values (will be modified during
@@ -115,8 +475,6 @@ struct GDOptimizer {
         }
 
         std::mt19937 gen(seed);
-        std::uniform_int_distribution<> idist(param_low, param_high);
-        std::uniform_real_distribution<float> rdist(param_low, param_high);
 
         std::unordered_map<int, bool> is_const;
         std::unordered_set<int> unique_var_ids;
@@ -125,28 +483,63 @@ struct GDOptimizer {
             path_constraints[i].gather_var_ids(unique_var_ids);
         }
 
+        // the dimensions of the low-discrepancy points follow the ids
+        std::vector<int> free_var_ids;
         for (int i : unique_var_ids) {
             if (params.find(i) == params.end()) {
-                if (init_param_uniform_int) {
-                    params.emplace(std::make_pair(i, idist(gen)));
-                } else {
-                    params.emplace(std::make_pair(i, rdist(gen)));
-                }
+                free_var_ids.emplace_back(i);
+            }
+        }
+        std::sort(free_var_ids.begin(), free_var_ids.end());
+        std::unordered_map<int, int> dims;
+        for (size_t d = 0; d < free_var_ids.size(); d++) {
+            dims.emplace(free_var_ids[d], d);
+        }
+
+        for (int i : unique_var_ids) {
+            if (params.find(i) == params.end()) {
+                auto w = warm_start.find(i);
+                params.emplace(std::make_pair(
+                    i, clamp(i, (w != warm_start.end())
+                                    ? w->second
+                                    : sample(i, dims.at(i), gen))));
                 is_const.emplace(std::make_pair(i, false));
             } else {
                 is_const.emplace(std::make_pair(i, is_init_params_const));
             }
         }
+        warm_start.clear();
+
+        std::unordered_map<int, float> rates =
+            learning_rates(path_constraints, params, unique_var_ids);
 
         int itr = 0;
-        bool is_sat = eval(path_constraints, params);
+        bool is_sat = eval_projected(path_constraints, params);
         bool is_converge = false;
 
-        while ((!is_sat) && (!is_converge) && (itr < num_epochs)) {
+        bool is_jit_tried = false;
+
+        while ((!is_sat) && (!is_converge) && (itr < num_epochs) &&
+               (!is_cancelled())) {
+            float t = temperature(itr);
+            // most constraints are solved within a few epochs, which are
+            // not worth the compilation
+            if (use_jit && !is_jit_tried && itr >= jit_warmup_epochs &&
+                t == 0.0f) {
+                is_jit_tried = true;
+                std::shared_ptr<JitLoss> jit = compile_loss(path_constraints);
+                if (jit != nullptr) {
+                    is_sat = solve_native(*jit, params, is_const, rates, itr);
+                    break;
+                }
+            }
             Grad grads = Grad({});
             for (int i = 0; i < path_constraints.size(); i++) {
+                // the unsatisfied constraints descend along the gradients of
+                // their smooth surrogates
                 if (path_constraints[i].eval(params, eps) > 0.0f) {
-                    grads = grads + path_constraints[i].grad(params, eps);
+                    grads = grads +
+                            path_constraints[i].grad(params, eps, nullptr, t);
                 }
             }
             is_converge = true;
@@ -156,7 +549,7 @@ struct GDOptimizer {
                         is_converge = false;
                     }
                     if (!sign_grad) {
-                        params.at(g.first) -= lr * g.second;
+                        params.at(g.first) -= rates.at(g.first) * g.second;
                     } else {
                         float sign = 0.0f;
                         if (g.second > 0.0f) {
@@ -164,14 +557,100 @@ struct GDOptimizer {
                         } else if (g.second < 0.0f) {
                             sign = -1.0f;
                         }
-                        params.at(g.first) -= lr * sign;
+                        params.at(g.first) -= rates.at(g.first) * sign;
+                    }
+                    params.at(g.first) = clamp(g.first, params.at(g.first));
+                }
+            }
+            is_sat = eval_projected(path_constraints, params);
+            itr++;
+            num_used_itr++;
+        }
+        if (int_vars.size() != 0) {
+            params = project(params);
+        }
+        if (reuse_models && is_sat) {
+            warm_start = params;
+        }
+        return is_sat;
+    }
+
+    /**
+     * @brief Runs the gradient descent of `solve` with compiled losses.
+     *
+     * The parameters are stored in a dense array in the order of the
+     * variables of the compiled loss, and they are updated in the same way
+     * as `solve`, up to the rounding of the sums of the gradients.
+     *
+     * @param jit The compiled loss of the path constraints.
+     * @param params Map of parameter values, which has all the variables of
+     * the constraints (will be modified during optimization).
+     * @param is_const Whether each variable is kept constant.
+     * @param rates The learning rate of each variable.
+     * @param itr The number of the epochs already run.
+     * @return `true` if the constraints are satisfied after optimization;
+     * otherwise, `false`.
+     */
+    bool solve_native(const JitLoss &jit,
+                      std::unordered_map<int, float> &params,
+                      const std::unordered_map<int, bool> &is_const,
+                      const std::unordered_map<int, float> &rates, int itr) {
+        int n = jit.vars.size();
+        std::vector<float> x(n), rounded(n), grads(n), step(n);
+        std::vector<std::pair<float, float>> box(n);
+        std::vector<bool> is_int(n), is_free(n);
+        for (int i = 0; i < n; i++) {
+            x[i] = params.at(jit.vars[i]);
+            box[i] = feasible_box(jit.vars[i]);
+            is_int[i] = int_vars.find(jit.vars[i]) != int_vars.end();
+            is_free[i] = !is_const.at(jit.vars[i]);
+            step[i] = rates.at(jit.vars[i]);
+        }
+        auto satisfied = [&]() {
+            for (int i = 0; i < n; i++) {
+                rounded[i] = is_int[i] ? std::round(x[i]) : x[i];
+            }
+            return jit.run(rounded.data(), eps, nullptr) == 0;
+        };
+
+        bool is_sat = satisfied();
+        bool is_converge = false;
+
+        while ((!is_sat) && (!is_converge) && (itr < num_epochs) &&
+               (!is_cancelled())) {
+            jit.run(x.data(), eps, grads.data());
+            is_converge = true;
+            for (int i = 0; i < n; i++) {
+                if (!is_free[i]) {
+                    continue;
+                }
+                if (grads[i] != 0.0f) {
+                    is_converge = false;
+                }
+                if (!sign_grad) {
+                    x[i] -= step[i] * grads[i];
+                } else {
+                    float sign = 0.0f;
+                    if (grads[i] > 0.0f) {
+                        sign = 1.0;
+                    } else if (grads[i] < 0.0f) {
+                        sign = -1.0f;
                     }
+                    x[i] -= step[i] * sign;
                 }
+                x[i] = std::min(std::max(x[i], box[i].first), box[i].second);
             }
-            is_sat = eval(path_constraints, params);
+            is_sat = satisfied();
             itr++;
             num_used_itr++;
         }
+
+        for (int i = 0; i < n; i++) {
+            params.at(jit.vars[i]) = x[i];
+        }
+        if (int_vars.size() != 0) {
+            params = project(params);
+        }
         return is_sat;
     }
 };
@@ -0,0 +1,304 @@
+/**
+ * @file interval.h
+ * @brief Interval reasoning over threshold comparisons
+ * @author Hideaki Takahashi
+ */
+
+#pragma once
+#include <cmath>
+#include <limits>
+
+#include "type.h"
+
+namespace gymbo {
+
+/**
+ * @brief Struct representing an affine expression `coef * x + offset` in at
+ * most one variable.
+ */
+struct Affine {
+    int var_idx = -1;    /**< The variable (-1 for a constant). */
+    float coef = 0.0f;   /**< The coefficient of the variable. */
+    float offset = 0.0f; /**< The constant term. */
+};
+
+/**
+ * @brief Converts a symbolic expression into an affine expression in at most
+ * one variable.
+ *
+ * @param sym The symbolic expression.
+ * @param result The resulting affine expression.
+ * @return False if the expression is not affine or has several variables.
+ */
+inline bool to_affine(const Sym &sym, Affine &result) {
+    Affine l, r;
+    switch (sym.symtype) {
+        case (SymType::SCon): {
+            result = {-1, 0.0f, wordToFloat(sym.word)};
+            return true;
+        }
+        case (SymType::SAny): {
+            result = {sym.var_idx, 1.0f, 0.0f};
+            return true;
+        }
+        case (SymType::SAdd):
+        case (SymType::SSub): {
+            if (!to_affine(*sym.left, l) || !to_affine(*sym.right, r) ||
+                (l.var_idx != -1 && r.var_idx != -1 &&
+                 l.var_idx != r.var_idx)) {
+                return false;
+            }
+            float sign = (sym.symtype == SymType::SAdd) ? 1.0f : -1.0f;
+            result.var_idx = (l.var_idx != -1) ? l.var_idx : r.var_idx;
+            result.coef = l.coef + sign * r.coef;
+            result.offset = l.offset + sign * r.offset;
+            return true;
+        }
+        case (SymType::SMul): {
+            if (!to_affine(*sym.left, l) || !to_affine(*sym.right, r) ||
+                (l.var_idx != -1 && r.var_idx != -1)) {
+                return false;
+            }
+            if (l.var_idx == -1) {
+                std::swap(l, r);
+            }
+            // r is constant
+            result.var_idx = l.var_idx;
+            result.coef = l.coef * r.offset;
+            result.offset = l.offset * r.offset;
+            return true;
+        }
+        case (SymType::SDiv): {
+            if (sym.word == DIV_TRUNC || !to_affine(*sym.left, l) ||
+                !to_affine(*sym.right, r) || r.var_idx != -1 ||
+                r.offset == 0.0f) {
+                return false;
+            }
+            result.var_idx = l.var_idx;
+            result.coef = l.coef / r.offset;
+            result.offset = l.offset / r.offset;
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Struct representing a closed interval of a variable.
+ */
+struct Interval {
+    float lo = -std::numeric_limits<float>::infinity(); /**< Lower bound. */
+    float hi = std::numeric_limits<float>::infinity();  /**< Upper bound. */
+
+    /**
+     * @brief Checks whether the interval contains no value, up to the rounding
+     * error of the bounds.
+     * @return True if the interval is empty.
+     */
+    bool is_empty() const {
+        float tol =
+            1e-6f * std::max(1.0f, std::max(std::abs(lo), std::abs(hi)));
+        return lo > hi + tol;
+    }
+
+    /**
+     * @brief Picks a value in the interval, preferring integers.
+     * @return The picked value.
+     */
+    float pick() const {
+        bool has_lo = std::isfinite(lo), has_hi = std::isfinite(hi);
+        if (has_lo && std::ceil(lo) <= hi) {
+            return std::ceil(lo);
+        } else if (has_lo && has_hi) {
+            return (lo + hi) / 2.0f;
+        } else if (has_hi) {
+            return std::min(0.0f, std::floor(hi));
+        } else {
+            return 0.0f;
+        }
+    }
+};
+
+/**
+ * @brief Struct representing the box of the variables implied by path
+ * constraints.
+ *
+ * Comparisons between an affine expression of one variable and a constant,
+ * such as the threshold comparisons of decision trees, are turned into bounds
+ * of the variable. A strict comparison is tightened by `eps`, which matches
+ * the loss of `SLt` used by the gradient descent. The other constraints are
+ * ignored, so that an empty box refutes the path constraints, while a
+ * non-empty box only satisfies them when all of them are box constraints.
+ */
+struct IntervalDomain {
+    float eps;     /**< The smallest positive value. */
+    bool is_box;   /**< True if all added constraints are box constraints. */
+    bool is_empty; /**< True if the added constraints are infeasible. */
+    std::unordered_map<int, Interval> bounds; /**< Bounds of the variables. */
+
+    /**
+     * @brief Constructor for IntervalDomain.
+     * @param eps The smallest positive value of the target type.
+     */
+    IntervalDomain(float eps) : eps(eps), is_box(true), is_empty(false) {}
+
+    /**
+     * @brief Adds all path constraints to the domain.
+     * @param path_constraints The path constraints.
+     */
+    void add(const std::vector<Sym> &path_constraints) {
+        for (const Sym &c : path_constraints) {
+            add(c, false);
+            if (is_empty) {
+                return;
+            }
+        }
+    }
+
+    /**
+     * @brief Adds a constraint to the domain.
+     * @param c The constraint.
+     * @param negated If set to true, the negation of the constraint is added.
+     */
+    void add(const Sym &c, bool negated) {
+        switch (c.symtype) {
+            case (SymType::SNot): {
+                add(*c.left, !negated);
+                return;
+            }
+            case (SymType::SAnd): {
+                if (negated) {
+                    is_box = false;
+                } else {
+                    add(*c.left, false);
+                    add(*c.right, false);
+                }
+                return;
+            }
+            case (SymType::SOr): {
+                if (negated) {
+                    add(*c.left, true);
+                    add(*c.right, true);
+                } else {
+                    is_box = false;
+                }
+                return;
+            }
+            case (SymType::SLt): {
+                // l < r holds iff l - r <= -eps, and its negation iff
+                // l - r >= 0
+                if (negated) {
+                    add_diff(c, 0.0f, true);
+                } else {
+                    add_diff(c, -eps, false);
+                }
+                return;
+            }
+            case (SymType::SLe): {
+                if (negated) {
+                    add_diff(c, eps, true);
+                } else {
+                    add_diff(c, 0.0f, false);
+                }
+                return;
+            }
+            case (SymType::SEq): {
+                if (negated) {
+                    add_diseq(c);
+                } else {
+                    add_diff(c, 0.0f, false);
+                    add_diff(c, 0.0f, true);
+                }
+                return;
+            }
+            default:
+                is_box = false;
+                return;
+        }
+    }
+
+    /**
+     * @brief Shrinks the bounds of the integer variables to integers.
+     * @param int_vars The indices of the integer variables.
+     */
+    void round(const std::unordered_set<int> &int_vars) {
+        for (auto &b : bounds) {
+            if (int_vars.find(b.first) != int_vars.end()) {
+                // the bounds are relaxed by their rounding error
+                float lo = b.second.lo, hi = b.second.hi;
+                b.second.lo =
+                    std::ceil(lo - 1e-6f * std::max(1.0f, std::abs(lo)));
+                b.second.hi =
+                    std::floor(hi + 1e-6f * std::max(1.0f, std::abs(hi)));
+                if (b.second.lo > b.second.hi) {
+                    is_empty = true;
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Fills the parameters with a point of the box.
+     * @param params The map from the variable IDs to the concrete values.
+     */
+    void witness(std::unordered_map<int, float> &params) const {
+        for (auto &b : bounds) {
+            params[b.first] = b.second.pick();
+        }
+    }
+
+   private:
+    /**
+     * @brief Adds `left != right`, which is a box constraint only when both
+     * sides are constant.
+     */
+    void add_diseq(const Sym &c) {
+        Affine l, r;
+        if (!to_affine(*c.left, l) || !to_affine(*c.right, r) ||
+            l.var_idx != -1 || r.var_idx != -1) {
+            is_box = false;
+        } else if (std::abs(l.offset - r.offset) < eps) {
+            is_empty = true;
+        }
+    }
+
+    /**
+     * @brief Adds `left - right <= bound` (or `>= bound` if `lower` is set)
+     * for a comparison `c`.
+     */
+    void add_diff(const Sym &c, float bound, bool lower) {
+        Affine l, r;
+        if (!to_affine(*c.left, l) || !to_affine(*c.right, r) ||
+            (l.var_idx != -1 && r.var_idx != -1 && l.var_idx != r.var_idx)) {
+            is_box = false;
+            return;
+        }
+        float coef = l.coef - r.coef;
+        float rhs = bound - (l.offset - r.offset);
+        int var_idx = (l.var_idx != -1) ? l.var_idx : r.var_idx;
+
+        if (var_idx == -1 || coef == 0.0f) {
+            if (var_idx != -1) {
+                bounds[var_idx];
+            }
+            if (lower ? (0.0f < rhs) : (0.0f > rhs)) {
+                is_empty = true;
+            }
+            return;
+        }
+
+        // coef * x <= rhs (or >= rhs), whose direction flips when coef < 0
+        Interval &itv = bounds[var_idx];
+        if (lower != (coef < 0.0f)) {
+            itv.lo = std::max(itv.lo, rhs / coef);
+        } else {
+            itv.hi = std::min(itv.hi, rhs / coef);
+        }
+        if (itv.is_empty()) {
+            is_empty = true;
+        }
+    }
+};
+
+}  // namespace gymbo
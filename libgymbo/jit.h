@@ -0,0 +1,576 @@
+/**
+ * @file jit.h
+ * @brief Compilation of the losses of path constraints to native code
+ * @author Hideaki Takahashi
+ */
+
+#pragma once
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "type.h"
+
+extern char **environ;
+
+namespace gymbo {
+
+/**
+ * @brief Signature of a compiled loss.
+ *
+ * The function takes the values `x` of the variables and `eps`, and returns
+ * the number of the constraints whose losses are not non-positive. If `grad`
+ * is not null, it is overwritten with the sum of the gradients of the
+ * constraints whose losses are positive, as `GDOptimizer` accumulates them.
+ */
+using JitLossFn = int (*)(const float *x, float eps, float *grad);
+
+/**
+ * @brief Loss and gradient of a set of path constraints compiled to native
+ * code.
+ */
+struct JitLoss {
+    std::vector<int> vars; /**< The variable of each entry of `x`. */
+    JitLossFn fn;          /**< The compiled function. */
+
+    /**
+     * @brief Evaluates the constraints.
+     * @param x The values of `vars`.
+     * @param eps The smallest positive value.
+     * @param grad The gradient to be written, or null to skip it.
+     * @return The number of the unsatisfied constraints.
+     */
+    int run(const float *x, float eps, float *grad) const {
+        return fn(x, eps, grad);
+    }
+};
+
+/**
+ * @brief Emits the C source of the loss of path constraints.
+ *
+ * Each node of the expressions, which share their subexpressions, is
+ * evaluated once into a local variable with the same float operations as
+ * `Sym::eval`, and the gradient is accumulated by the reverse mode, i.e., by
+ * propagating the adjoints of the nodes in the reverse order. The branches of
+ * `SEq`, `SAnd`, and `SOr` follow those of `Sym::grad`.
+ */
+class JitEmitter {
+   public:
+    std::vector<int> vars; /**< The variable of each entry of `x`. */
+
+    /**
+     * @brief Generates the source of the loss.
+     * @param path_constraints The constraints.
+     * @param source The generated source.
+     * @return False if a constraint has an expression that is not supported,
+     * e.g., `SCnt`.
+     */
+    bool generate(const std::vector<Sym> &path_constraints,
+                  std::string &source) {
+        std::vector<int> roots;
+        for (const Sym &c : path_constraints) {
+            int id = emit(&c);
+            if (id < 0) {
+                return false;
+            }
+            roots.emplace_back(id);
+        }
+
+        std::ostringstream out;
+        out << prelude();
+        out << "int gymbo_loss(const float *x, float eps, float *grad) {\n";
+        out << fwd.str();
+        out << "    int n = 0;\n";
+        for (int r : roots) {
+            out << "    n += !(v" << r << " <= 0.0f);\n";
+        }
+        out << "    if (grad == 0) {\n        return n;\n    }\n";
+        out << "    for (int i = 0; i < " << vars.size() << "; i++) {\n"
+            << "        grad[i] = 0.0f;\n    }\n";
+        for (size_t i = 0; i < nodes.size(); i++) {
+            out << "    float a" << i << " = 0.0f;\n";
+        }
+        for (int r : roots) {
+            out << "    if (v" << r << " > 0.0f) {\n        a" << r
+                << " += 1.0f;\n    }\n";
+        }
+        for (int i = nodes.size() - 1; i >= 0; i--) {
+            std::string body = backward(i);
+            if (!body.empty()) {
+                out << "    if (a" << i << " != 0.0f) {\n"
+                    << body << "    }\n";
+            }
+        }
+        out << "    return n;\n}\n";
+        source = out.str();
+        return true;
+    }
+
+   private:
+    std::unordered_map<const Sym *, int> ids; /**< Node of each expression. */
+    std::unordered_map<int, int> var_pos;     /**< Entry of each variable. */
+    std::vector<const Sym *> nodes; /**< The nodes in the evaluation order. */
+    std::ostringstream fwd;         /**< The statements of the evaluation. */
+
+    static const char *prelude() {
+        return "#include <math.h>\n"
+               "#include <stdint.h>\n"
+               "#include <string.h>\n"
+               "static float w2f(uint32_t w) {\n"
+               "    float f;\n"
+               "    memcpy(&f, &w, sizeof(f));\n"
+               "    return f;\n"
+               "}\n"
+               "static int32_t to_int32(float x) {\n"
+               "    if (!isfinite(x)) {\n"
+               "        return 0;\n"
+               "    }\n"
+               "    return (int32_t)(uint32_t)(int64_t)fmodf(truncf(x), "
+               "4294967296.0f);\n"
+               "}\n";
+    }
+
+    static std::string con(float v) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "w2f(0x%08xu)", FloatToWord(v));
+        return buf;
+    }
+
+    int pos(int var_idx) {
+        auto itr = var_pos.find(var_idx);
+        if (itr == var_pos.end()) {
+            itr = var_pos.emplace(var_idx, vars.size()).first;
+            vars.emplace_back(var_idx);
+        }
+        return itr->second;
+    }
+
+    /**
+     * @brief Emits the evaluation of an expression.
+     * @param sym The expression.
+     * @return The node of the expression, or -1 if it is not supported.
+     */
+    int emit(const Sym *sym) {
+        auto memo = ids.find(sym);
+        if (memo != ids.end()) {
+            return memo->second;
+        }
+
+        std::string v;
+        switch (sym->symtype) {
+            case (SymType::SCon): {
+                v = con(wordToFloat(sym->word));
+                break;
+            }
+            case (SymType::SAny): {
+                v = "x[" + std::to_string(pos(sym->var_idx)) + "]";
+                break;
+            }
+            case (SymType::SLin): {
+                // accumulated term by term as `Sym::eval` does
+                std::string acc = "l" + std::to_string(nodes.size());
+                const LinearForm *lin = sym->lin;
+                fwd << "    float " << acc << " = " << con(lin->coefs[0])
+                    << " * x[" << pos(lin->vars[0]) << "];\n";
+                for (size_t i = 1; i < lin->vars.size(); i++) {
+                    fwd << "    " << acc << " += " << con(lin->coefs[i])
+                        << " * x[" << pos(lin->vars[i]) << "];\n";
+                }
+                v = acc + " + " + con(lin->offset);
+                break;
+            }
+            case (SymType::SCnt): {
+                return -1;
+            }
+            case (SymType::SNot): {
+                int l = emit(sym->left);
+                if (l < 0) {
+                    return -1;
+                }
+                v = "v" + std::to_string(l) + " * -1.0f + eps";
+                break;
+            }
+            default: {
+                int l = emit(sym->left);
+                int r = emit(sym->right);
+                if (l < 0 || r < 0) {
+                    return -1;
+                }
+                std::string a = "v" + std::to_string(l);
+                std::string b = "v" + std::to_string(r);
+                switch (sym->symtype) {
+                    case (SymType::SAdd):
+                        v = a + " + " + b;
+                        break;
+                    case (SymType::SSub):
+                        v = a + " - " + b;
+                        break;
+                    case (SymType::SMul):
+                        v = a + " * " + b;
+                        break;
+                    case (SymType::SDiv):
+                        v = (sym->word == DIV_TRUNC)
+                                ? "truncf(" + a + " / " + b + ")"
+                                : a + " / " + b;
+                        break;
+                    case (SymType::SMod):
+                        v = "fmodf(" + a + ", " + b + ")";
+                        break;
+                    case (SymType::SBitAnd):
+                        v = "(float)(to_int32(" + a + ") & to_int32(" + b +
+                            "))";
+                        break;
+                    case (SymType::SBitOr):
+                        v = "(float)(to_int32(" + a + ") | to_int32(" + b +
+                            "))";
+                        break;
+                    case (SymType::SBitXor):
+                        v = "(float)(to_int32(" + a + ") ^ to_int32(" + b +
+                            "))";
+                        break;
+                    case (SymType::SShl):
+                        v = "(float)(int32_t)((uint32_t)to_int32(" + a +
+                            ") << (to_int32(" + b + ") & 31))";
+                        break;
+                    case (SymType::SShr):
+                        v = "(float)(to_int32(" + a + ") >> (to_int32(" + b +
+                            ") & 31))";
+                        break;
+                    case (SymType::SEq):
+                        v = "fabsf(" + a + " - " + b + ")";
+                        break;
+                    case (SymType::SAnd):
+                        // std::max and std::min
+                        v = "(" + a + " < " + b + ") ? " + b + " : " + a;
+                        break;
+                    case (SymType::SOr):
+                        v = "(" + b + " < " + a + ") ? " + b + " : " + a;
+                        break;
+                    case (SymType::SLt):
+                        v = a + " - " + b + " + eps";
+                        break;
+                    case (SymType::SLe):
+                        v = a + " - " + b;
+                        break;
+                    default:
+                        return -1;
+                }
+            }
+        }
+
+        int id = nodes.size();
+        fwd << "    float v" << id << " = " << v << ";\n";
+        nodes.emplace_back(sym);
+        ids.emplace(sym, id);
+        return id;
+    }
+
+    /**
+     * @brief Emits the propagation of the adjoint of a node to its operands.
+     * @param id The node.
+     * @return The statements, which are empty if nothing is propagated.
+     */
+    std::string backward(int id) {
+        const Sym *sym = nodes[id];
+        std::string g = "a" + std::to_string(id);
+        std::ostringstream out;
+        switch (sym->symtype) {
+            case (SymType::SCon):
+            case (SymType::SBitAnd):
+            case (SymType::SBitOr):
+            case (SymType::SBitXor): {
+                return "";
+            }
+            case (SymType::SAny): {
+                out << "        grad[" << var_pos.at(sym->var_idx)
+                    << "] += " << g << ";\n";
+                return out.str();
+            }
+            case (SymType::SLin): {
+                const LinearForm *lin = sym->lin;
+                for (size_t i = 0; i < lin->vars.size(); i++) {
+                    out << "        grad[" << var_pos.at(lin->vars[i])
+                        << "] += " << g << " * " << con(lin->coefs[i])
+                        << ";\n";
+                }
+                return out.str();
+            }
+            case (SymType::SNot): {
+                out << "        a" << ids.at(sym->left) << " -= " << g
+                    << ";\n";
+                return out.str();
+            }
+            default:
+                break;
+        }
+
+        int l = ids.at(sym->left), r = ids.at(sym->right);
+        std::string al = "a" + std::to_string(l), ar = "a" + std::to_string(r);
+        std::string vl = "v" + std::to_string(l), vr = "v" + std::to_string(r);
+        switch (sym->symtype) {
+            case (SymType::SAdd): {
+                out << "        " << al << " += " << g << ";\n";
+                out << "        " << ar << " += " << g << ";\n";
+                break;
+            }
+            case (SymType::SMul): {
+                out << "        " << al << " += " << g << " * " << vr << ";\n";
+                out << "        " << ar << " += " << g << " * " << vl << ";\n";
+                break;
+            }
+            case (SymType::SDiv): {
+                out << "        float s = 1.0f / (" << vr << " * " << vr
+                    << ");\n";
+                out << "        " << al << " += " << g << " * " << vr
+                    << " * s;\n";
+                out << "        " << ar << " -= " << g << " * " << vl
+                    << " * s;\n";
+                break;
+            }
+            case (SymType::SMod): {
+                out << "        " << al << " += " << g << ";\n";
+                out << "        " << ar << " -= " << g << " * truncf(" << vl
+                    << " / " << vr << ");\n";
+                break;
+            }
+            case (SymType::SShl):
+            case (SymType::SShr): {
+                out << "        float s = ldexpf(1.0f, to_int32(" << vr
+                    << ") & 31);\n";
+                out << "        " << al << " += " << g << " * "
+                    << (sym->symtype == SymType::SShl ? "s" : "(1.0f / s)")
+                    << ";\n";
+                break;
+            }
+            case (SymType::SEq): {
+                out << "        if (" << vl << " > " << vr << ") {\n";
+                out << "            " << al << " += " << g << ";\n";
+                out << "            " << ar << " -= " << g << ";\n";
+                out << "        } else if (!(" << vl << " == " << vr
+                    << ")) {\n";
+                out << "            " << al << " -= " << g << ";\n";
+                out << "            " << ar << " += " << g << ";\n";
+                out << "        }\n";
+                break;
+            }
+            case (SymType::SAnd):
+            case (SymType::SOr): {
+                const char *op =
+                    (sym->symtype == SymType::SAnd) ? " < " : " > ";
+                out << "        if (" << vl << op << vr << ") {\n";
+                out << "            " << ar << " += " << g << ";\n";
+                out << "        } else {\n";
+                out << "            " << al << " += " << g << ";\n";
+                out << "        }\n";
+                break;
+            }
+            default: {
+                // SSub, SLt, and SLe
+                out << "        " << al << " += " << g << ";\n";
+                out << "        " << ar << " -= " << g << ";\n";
+                break;
+            }
+        }
+        return out.str();
+    }
+};
+
+/**
+ * @brief Returns the directory of the compiled losses, which is
+ * `$GYMBO_JIT_DIR` if set and `$TMPDIR/gymbo_jit_<uid>` otherwise.
+ * @return The directory.
+ */
+inline std::string jit_cache_dir() {
+    const char *dir = std::getenv("GYMBO_JIT_DIR");
+    if (dir != nullptr) {
+        return dir;
+    }
+    const char *tmp = std::getenv("TMPDIR");
+    return std::string(tmp != nullptr ? tmp : "/tmp") + "/gymbo_jit_" +
+           std::to_string(getuid());
+}
+
+/**
+ * @brief Creates the cache directory if missing and checks that it is
+ * private.
+ *
+ * Since the shared objects in the directory are loaded into the process,
+ * the directory must be owned by the current user and writable by nobody
+ * else. A directory planted by another user, e.g., in a shared `/tmp`, is
+ * rejected.
+ *
+ * @param dir The directory.
+ * @return True if the directory can be trusted.
+ */
+inline bool prepare_jit_cache_dir(const std::string &dir) {
+    mkdir(dir.c_str(), 0700);
+    struct stat st;
+    return lstat(dir.c_str(), &st) == 0 && S_ISDIR(st.st_mode) &&
+           st.st_uid == getuid() && (st.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+}
+
+/**
+ * @brief Runs the C compiler on a source without a shell.
+ *
+ * `$CC` (or `cc`) is split at whitespace, e.g., `ccache gcc`, and its words
+ * are passed as they are, so that no character of it is interpreted by a
+ * shell.
+ *
+ * @param src The path of the source.
+ * @param lib The path of the shared object.
+ * @return True if the compilation succeeds.
+ */
+inline bool run_jit_compiler(const std::string &src, const std::string &lib) {
+    const char *cc = std::getenv("CC");
+    std::istringstream words(cc != nullptr ? cc : "cc");
+    std::vector<std::string> args;
+    std::string word;
+    while (words >> word) {
+        args.emplace_back(word);
+    }
+    if (args.size() == 0) {
+        return false;
+    }
+    for (const char *flag : {"-O2", "-ffp-contract=off", "-shared", "-fPIC",
+                             "-o"}) {
+        args.emplace_back(flag);
+    }
+    args.emplace_back(lib);
+    args.emplace_back(src);
+    args.emplace_back("-lm");
+    std::vector<char *> argv;
+    for (std::string &a : args) {
+        argv.emplace_back(const_cast<char *>(a.c_str()));
+    }
+    argv.emplace_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null",
+                                     O_WRONLY, 0);
+    pid_t pid;
+    int err = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(),
+                           environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (err != 0) {
+        return false;
+    }
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/**
+ * @brief Loads the shared object of a source, compiling it with `$CC` (or
+ * `cc`) unless the cache directory already has it.
+ *
+ * The source is stored next to its shared object, which is reused only if
+ * the stored source is identical and the object is owned by the current
+ * user. Nothing is loaded from a directory rejected by
+ * `prepare_jit_cache_dir`. The contraction into fused multiply-adds is
+ * disabled, so that the native code rounds as `Sym::eval` does.
+ *
+ * @param source The source.
+ * @return The compiled function, or null if the compilation fails.
+ */
+inline JitLossFn load_jit_source(const std::string &source) {
+    std::string dir = jit_cache_dir();
+    if (!prepare_jit_cache_dir(dir)) {
+        return nullptr;
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "%016zx", std::hash<std::string>()(source));
+    std::string base = dir + "/gymbo_" + name;
+    std::string lib = base + ".so";
+
+    std::ifstream cached(base + ".c");
+    std::stringstream content;
+    content << cached.rdbuf();
+    struct stat st;
+    if (!cached || content.str() != source ||
+        lstat(lib.c_str(), &st) != 0 || !S_ISREG(st.st_mode) ||
+        st.st_uid != getuid()) {
+        std::string src = base + "." + std::to_string(getpid()) + ".c";
+        std::string tmp = base + "." + std::to_string(getpid()) + ".so";
+        std::ofstream(src) << source;
+        // renamed after the compilation, so that concurrent processes never
+        // load a partial shared object
+        if (!run_jit_compiler(src, tmp) ||
+            std::rename(tmp.c_str(), lib.c_str()) != 0 ||
+            std::rename(src.c_str(), (base + ".c").c_str()) != 0) {
+            std::remove(src.c_str());
+            std::remove(tmp.c_str());
+            return nullptr;
+        }
+    }
+
+    // the handle stays open for the lifetime of the process
+    void *handle = dlopen(lib.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle == nullptr) {
+        return nullptr;
+    }
+    return reinterpret_cast<JitLossFn>(dlsym(handle, "gymbo_loss"));
+}
+
+/**
+ * @brief Compiles the loss and the gradient of path constraints to native
+ * code.
+ *
+ * The compiled functions are cached by their sources within the process and
+ * in `jit_cache_dir()` across processes, so that the same constraints are
+ * compiled once. The sources refer to the variables by position, so that
+ * the constraints of the same shape over different variables share the
+ * function but not the variables of the returned loss. The cache is shared by the threads of a portfolio, which
+ * compile one at a time.
+ *
+ * @param path_constraints The constraints.
+ * @return The compiled loss, or null if an expression is not supported or
+ * the compilation fails, in which case the constraints are to be
+ * interpreted.
+ */
+inline std::shared_ptr<JitLoss> compile_loss(
+    const std::vector<Sym> &path_constraints) {
+    // the source refers to the variables by position, so that only the
+    // function is shared between constraints over different variables
+    static std::unordered_map<std::string, JitLossFn> cache;
+    static std::mutex cache_mutex;
+
+    JitEmitter emitter;
+    std::string source;
+    if (!emitter.generate(path_constraints, source)) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    auto itr = cache.find(source);
+    if (itr == cache.end()) {
+        itr = cache.emplace(source, load_jit_source(source)).first;
+    }
+    if (itr->second == nullptr) {
+        return nullptr;
+    }
+
+    std::shared_ptr<JitLoss> result = std::make_shared<JitLoss>();
+    result->vars = emitter.vars;
+    result->fn = itr->second;
+    return result;
+}
+
+}  // namespace gymbo
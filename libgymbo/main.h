@@ -56,16 +56,23 @@
  *          | "return" expr ";"
  * expr       = assign
  * assign     = logical ("=" assign)?
- * logical    = equality ("&&" equality | "||" equality)*
+ * logical    = bit_or ("&&" bit_or | "||" bit_or)*
+ * bit_or     = bit_xor ("|" bit_xor)*
+ * bit_xor    = bit_and ("^" bit_and)*
+ * bit_and    = equality ("&" equality)*
  * equality   = relational ("==" relational | "!=" relational)*
- * relational = add ("<" add | "<=" add | ">" add | ">=" add)*
+ * relational = shift ("<" shift | "<=" shift | ">" shift | ">=" shift)*
+ * shift      = add ("<<" add | ">>" add)*
  * add        = mul ("+" mul | "-" mul)*
- * mul        = unary ("*" unary | "/" unary)*
+ * mul        = unary ("*" unary | "/" unary | "%" unary)*
  * unary      = ("+" | "-")? primary
  * primary    = num | ident | "(" expr ")"
  * ```
  *
- * > Please note that Gymbo currently ignores `/` when solving path constraints.
+ * A variable declared with `int` is an integer, whose division truncates the
+ * quotient toward zero as in C. The bitwise operators treat their operands as
+ * 32-bit integers, and path constraints over integers built from `+`, `-`,
+ * `*`, and bitwise operators are decided by bit-blasting to a SAT solver.
  *
  * @section algorithm_sec Internal Algorithm
  *
@@ -168,9 +175,10 @@
  * import pylibgymbo as plg
  *
  * inp = "a = 1; if (a == 1) return 2;"
- * var_counter, prg = plg.gcompile(inp)
+ * var_counter, prg, int_vars = plg.gcompile(inp)
  *
  * optimizer = plg.GDOptimizer(num_itrs, step_size, ...)
+ * optimizer.int_vars = int_vars  # variables declared with `int`
  * executor = plg.SExecutor(optimizer, maxSAT, maxUNSAT, max_num_trials,
  *                          ignore_memory, use_dpll, verbose_level)
  * executor.run(prg, target_pcs, init, max_depth)
@@ -206,7 +214,8 @@
  *   )
  *
  * optimizer = plg.GDOptimizer(num_itrs, step_size, ...)
- * var_counter, prg = plg.gcompile(mlp_code)
+ * var_counter, prg, int_vars = plg.gcompile(mlp_code)
+ * optimizer.int_vars = int_vars
  *
  * executor = plg.SExecutor(optimizer, maxSAT, maxUNSAT, max_num_trials,
  *                          ignore_memory, use_dpll, verbose_level)
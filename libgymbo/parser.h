@@ -5,8 +5,11 @@
  */
 
 #pragma once
+#include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "dist.h"
 #include "tokenizer.h"
 
 /**
@@ -59,6 +62,11 @@ char LETTER_MUL[] = "*";
  */
 char LETTER_DIV[] = "/";
 
+/**
+ * @brief Array representing the modulo operator "%"
+ */
+char LETTER_MOD[] = "%";
+
 /**
  * @brief Array representing the logical AND operator "&&"
  */
@@ -69,6 +77,31 @@ char LETTER_AND[] = "&&";
  */
 char LETTER_OR[] = "||";
 
+/**
+ * @brief Array representing the bitwise AND operator "&"
+ */
+char LETTER_BITAND[] = "&";
+
+/**
+ * @brief Array representing the bitwise OR operator "|"
+ */
+char LETTER_BITOR[] = "|";
+
+/**
+ * @brief Array representing the bitwise XOR operator "^"
+ */
+char LETTER_BITXOR[] = "^";
+
+/**
+ * @brief Array representing the left shift operator "<<"
+ */
+char LETTER_SHL[] = "<<";
+
+/**
+ * @brief Array representing the right shift operator ">>"
+ */
+char LETTER_SHR[] = ">>";
+
 /**
  * @brief Array representing the logical NOT operator "!"
  */
@@ -104,6 +137,26 @@ char LETTER_LB[] = "{";
  */
 char LETTER_RB[] = "}";
 
+/**
+ * @brief Array representing the tilde "~"
+ */
+char LETTER_TILDE[] = "~";
+
+/**
+ * @brief Array representing the comma ","
+ */
+char LETTER_COMMA[] = ",";
+
+/**
+ * @brief Array representing the left square bracket "["
+ */
+char LETTER_LSB[] = "[";
+
+/**
+ * @brief Array representing the right square bracket "]"
+ */
+char LETTER_RSB[] = "]";
+
 namespace gymbo {
 
 /**
@@ -115,6 +168,12 @@ typedef enum {
     ND_SUB,  // -
     ND_MUL,  // *
     ND_DIV,  // /
+    ND_MOD,  // %
+    ND_BITAND,  // &
+    ND_BITOR,   // |
+    ND_BITXOR,  // ^
+    ND_SHL,     // <<
+    ND_SHR,     // >>
     ND_AND,  // &&
     ND_OR,   // ||
     ND_NOT,  // !
@@ -127,8 +186,13 @@ typedef enum {
     ND_NUM,  // Integer
     ND_RETURN,
     ND_IF,
-    ND_FOR,
+    ND_FOR,  // for, while
     ND_BLOCK,
+    ND_RANDVAR,  // x ~ dist(...)
+    ND_FUNC,     // def f(...) {...}
+    ND_CALL,     // f(...)
+    ND_RET,      // return from a function
+    ND_INDEX,    // a[i]
 } NodeKind;
 
 /**
@@ -136,14 +200,20 @@ typedef enum {
  */
 struct Node {
     NodeKind kind;               ///< Node kind
-    Node *lhs;                   ///< Left-hand side
-    Node *rhs;                   ///< Right-hand side
+    Node *lhs;                   ///< Left-hand side (initialization of 'for')
+    Node *rhs;                   ///< Right-hand side (increment of 'for')
     Node *cond;                  ///< Condition
-    Node *then;                  ///< 'Then' branch
+    Node *then;                  ///< 'Then' branch (body of 'for')
     Node *els;                   ///< 'Else' branch
-    std::vector<Node *> blocks;  ///< Vector of child blocks
-    float val;                   ///< Used if kind is ND_NUM
-    int offset;                  ///< Offset
+    std::vector<Node *> blocks;  ///< Vector of child blocks (parameters of
+                                 ///< 'def', arguments of a call)
+    float val;  ///< Used if kind is ND_NUM (number of elements if ND_INDEX)
+    int offset;  ///< Offset (index of the function if kind is ND_FUNC or
+                 ///< ND_CALL)
+    DiscreteDist *dist;  ///< Used if kind is ND_RANDVAR
+    std::string name;    ///< Used if kind is ND_FUNC or ND_CALL
+    bool is_int;  ///< If kind is ND_NUM, ND_LVAR, or ND_INDEX, whether it is
+                  ///< an integer literal or a variable declared with `int`
 };
 
 Node *assign(Token *&token, char *user_input);
@@ -151,6 +221,10 @@ Node *expr(Token *&token, char *user_input);
 Node *equality(Token *&token, char *user_input);
 Node *relational(Token *&token, char *user_input);
 Node *logical(Token *&token, char *user_input);
+Node *bit_or(Token *&token, char *user_input);
+Node *bit_xor(Token *&token, char *user_input);
+Node *bit_and(Token *&token, char *user_input);
+Node *shift(Token *&token, char *user_input);
 Node *add(Token *&token, char *user_input);
 Node *mul(Token *&token, char *user_input);
 Node *unary(Token *&token, char *user_input);
@@ -231,20 +305,80 @@ Node *assign(Token *&token, char *user_input) {
 /**
  * @brief Parses a logical expression from a C-like language program.
  *
- * logical = equality ("&&" equality | "||" equality)*
+ * logical = bit_or ("&&" bit_or | "||" bit_or)*
  *
  * @param token The first token in the logical expression.
  * @param user_input The source code of the program.
  * @return An AST node representing the logical expression.
  */
 Node *logical(Token *&token, char *user_input) {
-    Node *node = equality(token, user_input);
+    Node *node = bit_or(token, user_input);
 
     for (;;) {
         if (consume(token, LETTER_AND))
-            node = new_binary(ND_AND, node, equality(token, user_input));
+            node = new_binary(ND_AND, node, bit_or(token, user_input));
         else if (consume(token, LETTER_OR))
-            node = new_binary(ND_OR, node, equality(token, user_input));
+            node = new_binary(ND_OR, node, bit_or(token, user_input));
+        else
+            return node;
+    }
+}
+
+/**
+ * @brief Parses a bitwise OR expression from a C-like language program.
+ *
+ * bit_or = bit_xor ("|" bit_xor)*
+ *
+ * @param token The first token in the bitwise OR expression.
+ * @param user_input The source code of the program.
+ * @return An AST node representing the bitwise OR expression.
+ */
+Node *bit_or(Token *&token, char *user_input) {
+    Node *node = bit_xor(token, user_input);
+
+    for (;;) {
+        if (consume(token, LETTER_BITOR))
+            node = new_binary(ND_BITOR, node, bit_xor(token, user_input));
+        else
+            return node;
+    }
+}
+
+/**
+ * @brief Parses a bitwise XOR expression from a C-like language program.
+ *
+ * bit_xor = bit_and ("^" bit_and)*
+ *
+ * @param token The first token in the bitwise XOR expression.
+ * @param user_input The source code of the program.
+ * @return An AST node representing the bitwise XOR expression.
+ */
+Node *bit_xor(Token *&token, char *user_input) {
+    Node *node = bit_and(token, user_input);
+
+    for (;;) {
+        if (consume(token, LETTER_BITXOR))
+            node = new_binary(ND_BITXOR, node, bit_and(token, user_input));
+        else
+            return node;
+    }
+}
+
+/**
+ * @brief Parses a bitwise AND expression from a C-like language program.
+ *
+ * bit_and = equality ("&" equality)*
+ *
+ * @param token The first token in the bitwise AND expression.
+ * @param user_input The source code of the program.
+ * @return An AST node representing the bitwise AND expression.
+ */
+Node *bit_and(Token *&token, char *user_input) {
+    Node *node = equality(token, user_input);
+
+    for (;;) {
+        if (consume(token, LETTER_BITAND))
+            node = new_binary(ND_BITAND, node, equality(token, user_input));
         else
             return node;
     }
@@ -275,24 +409,46 @@ Node *equality(Token *&token, char *user_input) {
 /**
  * @brief Parses a relational expression from a C-like language program.
  *
- * relational = add ("<" add | "<=" add | ">" add | ">=" add)*
+ * relational = shift ("<" shift | "<=" shift | ">" shift | ">=" shift)*
  *
  * @param token The first token in the relational expression.
  * @param user_input The source code of the program.
  * @return An AST node representing the relational expression.
  */
 Node *relational(Token *&token, char *user_input) {
-    Node *node = add(token, user_input);
+    Node *node = shift(token, user_input);
 
     for (;;) {
         if (consume(token, LETTER_LQ))
-            node = new_binary(ND_LT, node, add(token, user_input));
+            node = new_binary(ND_LT, node, shift(token, user_input));
         else if (consume(token, LETTER_LEQ))
-            node = new_binary(ND_LE, node, add(token, user_input));
+            node = new_binary(ND_LE, node, shift(token, user_input));
         else if (consume(token, LETTER_GQ))
-            node = new_binary(ND_LT, add(token, user_input), node);
+            node = new_binary(ND_LT, shift(token, user_input), node);
         else if (consume(token, LETTER_GEQ))
-            node = new_binary(ND_LE, add(token, user_input), node);
+            node = new_binary(ND_LE, shift(token, user_input), node);
+        else
+            return node;
+    }
+}
+
+/**
+ * @brief Parses a shift expression from a C-like language program.
+ *
+ * shift = add ("<<" add | ">>" add)*
+ *
+ * @param token The first token in the shift expression.
+ * @param user_input The source code of the program.
+ * @return An AST node representing the shift expression.
+ */
+Node *shift(Token *&token, char *user_input) {
+    Node *node = add(token, user_input);
+
+    for (;;) {
+        if (consume(token, LETTER_SHL))
+            node = new_binary(ND_SHL, node, add(token, user_input));
+        else if (consume(token, LETTER_SHR))
+            node = new_binary(ND_SHR, node, add(token, user_input));
         else
             return node;
     }
@@ -321,10 +477,10 @@ inline Node *add(Token *&token, char *user_input) {
 }
 
 /**
- * @brief Parse and construct an AST node representing multiplication or
- * division.
+ * @brief Parse and construct an AST node representing multiplication,
+ * division, or modulo.
  *
- * mul = unary ("*" unary | "/" unary)*
+ * mul = unary ("*" unary | "/" unary | "%" unary)*
  *
  * @param token A reference to the current token.
  * @param user_input The user input string.
@@ -338,6 +494,8 @@ inline Node *mul(Token *&token, char *user_input) {
             node = new_binary(ND_MUL, node, unary(token, user_input));
         else if (consume(token, LETTER_DIV))
             node = new_binary(ND_DIV, node, unary(token, user_input));
+        else if (consume(token, LETTER_MOD))
+            node = new_binary(ND_MOD, node, unary(token, user_input));
         else
             return node;
     }
@@ -355,15 +513,20 @@ inline Node *mul(Token *&token, char *user_input) {
  */
 inline Node *unary(Token *&token, char *user_input) {
     if (consume(token, LETTER_PLUS)) return unary(token, user_input);
-    if (consume(token, LETTER_MINUS))
-        return new_binary(ND_SUB, new_num(0), unary(token, user_input));
+    if (consume(token, LETTER_MINUS)) {
+        // -e is 0 - e, which has the type of e
+        Node *zero = new_num(0);
+        zero->is_int = true;
+        return new_binary(ND_SUB, zero, unary(token, user_input));
+    }
     return primary(token, user_input);
 }
 
 /**
  * @brief Parse and construct an AST node representing primary expressions.
  *
- * primary = "(" expr ")" | num | ident
+ * primary = "(" expr ")" | num | ident ("(" (expr ("," expr)*)? ")")?
+ *         | ident "[" expr "]"
  *
  * @param token A reference to the current token.
  * @param user_input The user input string.
@@ -378,13 +541,154 @@ inline Node *primary(Token *&token, char *user_input) {
 
     Token *tok = consume_ident(token);
     if (tok) {
-        Node *node = (Node *)std::calloc(1, sizeof(Node));
-        node->kind = ND_LVAR;
+        if (consume(token, LETTER_LP)) {
+            Node *node = new_node(ND_CALL);
+            node->name = std::string(tok->str, tok->len);
+            if (!consume(token, LETTER_RP)) {
+                do {
+                    node->blocks.emplace_back(expr(token, user_input));
+                } while (consume(token, LETTER_COMMA));
+                expect(token, user_input, LETTER_RP);
+            }
+            return node;
+        }
+        if (consume(token, LETTER_LSB)) {
+            if (tok->num_elems == 0) {
+                char em[] = "not an array";
+                error_at(user_input, tok->str, em);
+            }
+            Node *node = new_node(ND_INDEX);
+            node->offset = tok->var_id;
+            node->val = tok->num_elems;
+            node->is_int = tok->is_int;
+            node->lhs = expr(token, user_input);
+            expect(token, user_input, LETTER_RSB);
+            return node;
+        }
+        Node *node = new_node(ND_LVAR);
         node->offset = tok->var_id;
+        node->is_int = tok->is_int;
         return node;
     }
 
-    return new_num(expect_number(token, user_input));
+    bool is_int = token->is_int;
+    Node *node = new_num(expect_number(token, user_input));
+    node->is_int = is_int;
+    return node;
+}
+
+/**
+ * @brief Parse and construct an AST node representing the declaration of a
+ * random variable, such as `x ~ bernoulli(0.3);`.
+ *
+ * @param token A reference to the current token.
+ * @param user_input The user input string.
+ * @return A pointer to the constructed AST node.
+ */
+inline Node *randvar(Token *&token, char *user_input) {
+    Token *tok = consume_ident(token);
+    expect(token, user_input, LETTER_TILDE);
+
+    Token *dist_tok = token;
+    if (consume_ident(token) == NULL) {
+        char em[] = "expected a distribution";
+        error_at(user_input, dist_tok->str, em);
+    }
+    std::string dist_name(dist_tok->str, dist_tok->len);
+
+    std::vector<float> args;
+    expect(token, user_input, LETTER_LP);
+    if (!consume(token, LETTER_RP)) {
+        do {
+            float sign = consume(token, LETTER_MINUS) ? -1.0f : 1.0f;
+            args.emplace_back(sign * expect_number(token, user_input));
+        } while (consume(token, LETTER_COMMA));
+        expect(token, user_input, LETTER_RP);
+    }
+    expect(token, user_input, LETTER_SC);
+
+    Node *node = new Node();
+    node->kind = ND_RANDVAR;
+    node->offset = tok->var_id;
+    node->dist = new DiscreteDist();
+    if (!make_dist(dist_name, args, *node->dist)) {
+        char em[] = "unknown distribution or invalid arguments";
+        error_at(user_input, dist_tok->str, em);
+    }
+    return node;
+}
+
+/**
+ * @brief Parse and construct an AST node representing the declaration of an
+ * array, such as `int a[3] = {1, 2, 3};`. The `int` keyword must be consumed
+ * beforehand. The elements without initializers are symbolic.
+ *
+ * @param token A reference to the current token.
+ * @param user_input The user input string.
+ * @return A pointer to the block assigning the initializers to the elements.
+ */
+inline Node *arraydecl(Token *&token, char *user_input) {
+    Token *tok = consume_ident(token);
+    if (tok == NULL || tok->num_elems == 0) {
+        char em[] = "expected an array declaration";
+        error_at(user_input, token->str, em);
+    }
+    expect(token, user_input, LETTER_LSB);
+    expect_number(token, user_input);
+    expect(token, user_input, LETTER_RSB);
+
+    char LETTER_ASS[] = "=";
+    Node *node = new_node(ND_BLOCK);
+    if (consume(token, LETTER_ASS)) {
+        expect(token, user_input, LETTER_LB);
+        int k = 0;
+        do {
+            if (k >= tok->num_elems) {
+                char em[] = "too many initializers";
+                error_at(user_input, token->str, em);
+            }
+            Node *elem = new_node(ND_INDEX);
+            elem->offset = tok->var_id;
+            elem->val = tok->num_elems;
+            elem->is_int = true;
+            elem->lhs = new_num(k++);
+            node->blocks.emplace_back(
+                new_binary(ND_ASSIGN, elem, expr(token, user_input)));
+        } while (consume(token, LETTER_COMMA));
+        expect(token, user_input, LETTER_RB);
+    }
+    expect(token, user_input, LETTER_SC);
+    return node;
+}
+
+/**
+ * @brief Parse and construct an AST node representing the declaration of an
+ * integer variable, such as `int x;` or `int x = 3;`. The `int` keyword must
+ * be consumed beforehand, and arrays are declared by `arraydecl`. A variable
+ * without an initializer is symbolic.
+ *
+ * @param token A reference to the current token.
+ * @param user_input The user input string.
+ * @return A pointer to the block assigning the initializer to the variable.
+ */
+inline Node *intdecl(Token *&token, char *user_input) {
+    Token *tok = consume_ident(token);
+    if (tok == NULL) {
+        char em[] = "expected a declaration";
+        error_at(user_input, token->str, em);
+    }
+
+    char LETTER_ASS[] = "=";
+    Node *node = new_node(ND_BLOCK);
+    if (consume(token, LETTER_ASS)) {
+        Node *var = new_node(ND_LVAR);
+        var->offset = tok->var_id;
+        var->is_int = true;
+        node->blocks.emplace_back(
+            new_binary(ND_ASSIGN, var, expr(token, user_input)));
+    }
+    expect(token, user_input, LETTER_SC);
+    return node;
 }
 
 /**
@@ -421,6 +725,39 @@ inline Node *stmt(Token *&token, char *user_input) {
         if (consume_tok(token, TOKEN_ELSE)) {
             node->els = stmt(token, user_input);
         }
+    } else if (consume_tok(token, TOKEN_FOR)) {
+        node = new Node();
+        node->kind = ND_FOR;
+        expect(token, user_input, LETTER_LP);
+        if (!consume(token, LETTER_SC)) {
+            node->lhs = expr(token, user_input);
+            expect(token, user_input, LETTER_SC);
+        }
+        if (!consume(token, LETTER_SC)) {
+            node->cond = expr(token, user_input);
+            expect(token, user_input, LETTER_SC);
+        }
+        if (!consume(token, LETTER_RP)) {
+            node->rhs = expr(token, user_input);
+            expect(token, user_input, LETTER_RP);
+        }
+        node->then = stmt(token, user_input);
+    } else if (consume_tok(token, TOKEN_WHILE)) {
+        node = new Node();
+        node->kind = ND_FOR;
+        expect(token, user_input, LETTER_LP);
+        node->cond = expr(token, user_input);
+        expect(token, user_input, LETTER_RP);
+        node->then = stmt(token, user_input);
+    } else if (consume_tok(token, TOKEN_INT)) {
+        if (token->kind == TOKEN_IDENT && token->num_elems == 0) {
+            node = intdecl(token, user_input);
+        } else {
+            node = arraydecl(token, user_input);
+        }
+    } else if (token->kind == TOKEN_IDENT && token->next->kind != TOKEN_EOF &&
+               token->next->len == 1 && *token->next->str == '~') {
+        node = randvar(token, user_input);
     } else {
         node = expr(token, user_input);
         expect(token, user_input, LETTER_SC);
@@ -429,6 +766,137 @@ inline Node *stmt(Token *&token, char *user_input) {
     return node;
 }
 
+/**
+ * @brief Replaces `return` statements in the body of a function with returns
+ * from the function.
+ *
+ * @param node The AST node of the body.
+ */
+inline void mark_returns(Node *node) {
+    if (node == nullptr) {
+        return;
+    }
+    if (node->kind == ND_RETURN) {
+        node->kind = ND_RET;
+    } else if (node->kind == ND_BLOCK) {
+        for (Node *b : node->blocks) {
+            mark_returns(b);
+        }
+    } else if (node->kind == ND_IF || node->kind == ND_FOR) {
+        mark_returns(node->then);
+        mark_returns(node->els);
+    }
+}
+
+/**
+ * @brief Checks whether a statement declares a random variable.
+ *
+ * @param node The AST node of the statement.
+ * @return True if the statement or one of its sub-statements is a
+ * declaration such as `x ~ bernoulli(0.3);`.
+ */
+inline bool declares_random_var(Node *node) {
+    if (node == nullptr) {
+        return false;
+    }
+    if (node->kind == ND_RANDVAR) {
+        return true;
+    } else if (node->kind == ND_BLOCK) {
+        for (Node *b : node->blocks) {
+            if (declares_random_var(b)) {
+                return true;
+            }
+        }
+    } else if (node->kind == ND_IF || node->kind == ND_FOR) {
+        return declares_random_var(node->then) ||
+               declares_random_var(node->els);
+    }
+    return false;
+}
+
+/**
+ * @brief Parse and construct an AST node representing the definition of a
+ * function, such as `def f(a, b) { return a * b; }`. The `def` keyword must be
+ * consumed beforehand. Random variables must be declared outside of
+ * functions.
+ *
+ * @param token A reference to the current token.
+ * @param user_input The user input string.
+ * @return A pointer to the constructed AST node.
+ * @throws ParseError if the body declares a random variable.
+ */
+inline Node *funcdef(Token *&token, char *user_input) {
+    Token *tok = consume_ident(token);
+    if (tok == NULL) {
+        char em[] = "expected a function name";
+        error_at(user_input, token->str, em);
+    }
+    Node *node = new_node(ND_FUNC);
+    node->name = std::string(tok->str, tok->len);
+
+    expect(token, user_input, LETTER_LP);
+    if (!consume(token, LETTER_RP)) {
+        do {
+            Token *param = consume_ident(token);
+            if (param == NULL) {
+                char em[] = "expected a parameter";
+                error_at(user_input, token->str, em);
+            }
+            Node *p = new_node(ND_LVAR);
+            p->offset = param->var_id;
+            node->blocks.emplace_back(p);
+        } while (consume(token, LETTER_COMMA));
+        expect(token, user_input, LETTER_RP);
+    }
+
+    if (token->kind != TOKEN_RESERVED || *token->str != '{') {
+        char em[] = "expected \"{\"";
+        error_at(user_input, token->str, em);
+    }
+    node->then = stmt(token, user_input);
+    if (declares_random_var(node->then)) {
+        // a random variable is drawn once per program, not once per call
+        char em[] = "random variables cannot be declared in a function";
+        error_at(user_input, tok->str, em);
+    }
+    mark_returns(node->then);
+    return node;
+}
+
+/**
+ * @brief Resolves the function called by each call in the AST, and checks
+ * the number of its arguments.
+ *
+ * @param node The AST node to traverse.
+ * @param funcs Map of function name to its definition.
+ */
+inline void resolve_calls(Node *node,
+                          std::unordered_map<std::string, Node *> &funcs) {
+    if (node == nullptr) {
+        return;
+    }
+    if (node->kind == ND_CALL) {
+        auto itr = funcs.find(node->name);
+        if (itr == funcs.end()) {
+            char em[] = "undefined function %s";
+            error(em, node->name.c_str());
+        }
+        if (itr->second->blocks.size() != node->blocks.size()) {
+            char em[] = "wrong number of arguments to %s";
+            error(em, node->name.c_str());
+        }
+        node->offset = itr->second->offset;
+    }
+    resolve_calls(node->lhs, funcs);
+    resolve_calls(node->rhs, funcs);
+    resolve_calls(node->cond, funcs);
+    resolve_calls(node->then, funcs);
+    resolve_calls(node->els, funcs);
+    for (Node *b : node->blocks) {
+        resolve_calls(b, funcs);
+    }
+}
+
 /**
  * @brief Parses a C-like language program into an AST.
  *
@@ -438,7 +906,24 @@ inline Node *stmt(Token *&token, char *user_input) {
  */
 inline void generate_ast(Token *&token, char *user_input,
                          std::vector<Node *> &code) {
-    while (!at_eof(token)) code.emplace_back(stmt(token, user_input));
+    std::unordered_map<std::string, Node *> funcs;
+    while (!at_eof(token)) {
+        if (consume_tok(token, TOKEN_DEF)) {
+            Node *node = funcdef(token, user_input);
+            if (funcs.find(node->name) != funcs.end()) {
+                char em[] = "redefinition of function %s";
+                error(em, node->name.c_str());
+            }
+            node->offset = funcs.size();
+            funcs.emplace(node->name, node);
+            code.emplace_back(node);
+        } else {
+            code.emplace_back(stmt(token, user_input));
+        }
+    }
     code.emplace_back(nullptr);
+    for (Node *node : code) {
+        resolve_calls(node, funcs);
+    }
 }
 }  // namespace gymbo
@@ -5,42 +5,89 @@
  */
 
 #pragma once
+#include <tuple>
+#include <unordered_set>
+
 #include "compiler.h"
 
 namespace gymbo {
 
 /**
- * @brief Compiles user input into a program, returning variable counts and the
- * compiled program.
+ * @brief Compiles user input into a program, returning variable counts, the
+ * compiled program, and the integer variables.
  *
  * This function takes a user-provided input in the form of a character array
  * and performs the following steps:
  * 1. Tokenizes the input, counting occurrences of variables using var_counter.
  * 2. Generates an Abstract Syntax Tree (AST) from the tokenized input.
  * 3. Compiles the AST into a program using gymbo::Node objects.
+ * 4. Gathers the variables declared with `int`.
  *
  * @param user_input A character array representing the user-provided input.
  *
- * @return A std::pair containing:
+ * @return A std::tuple containing:
  *   - First element: An std::unordered_map<std::string, int> representing
  * variable counts.
  *   - Second element: A Prog object representing the compiled program.
+ *   - Third element: The indices of the integer variables, to be set to
+ * `GDOptimizer::int_vars`.
+ *
+ * @throws ParseError if the input is malformed.
  *
  * @see tokenize() Function used for tokenization.
  * @see generate_ast() Function used for AST generation.
  * @see compile_ast() Function used for compiling the AST into a program.
+ * @see gather_int_vars() Function used for gathering the integer variables.
  */
-inline std::pair<std::unordered_map<std::string, int>, Prog> gcompile(
-    char *user_input) {
+inline std::tuple<std::unordered_map<std::string, int>, Prog,
+                  std::unordered_set<int>>
+gcompile(char *user_input) {
     std::unordered_map<std::string, int> var_counter;
     std::vector<gymbo::Node *> code;
     Prog prg;
+    std::unordered_set<int> int_vars;
 
     Token *token = tokenize(user_input, var_counter);
     generate_ast(token, user_input, code);
     compile_ast(code, prg);
+    for (Node *node : code) {
+        gather_int_vars(node, int_vars);
+    }
+
+    return std::make_tuple(var_counter, prg, int_vars);
+}
+
+/**
+ * @brief Compiles a probabilistic program into a program, returning variable
+ * counts, the compiled program, the distributions of the declared random
+ * variables, and the integer variables.
+ *
+ * @param user_input A character array representing the user-provided input.
+ *
+ * @return A std::tuple containing the variable counts, the compiled program,
+ * the map of variable index to DiscreteDist, and the indices of the integer
+ * variables.
+ *
+ * @see gcompile() Function compiling a deterministic program.
+ */
+inline std::tuple<std::unordered_map<std::string, int>, Prog,
+                  std::unordered_map<int, DiscreteDist>,
+                  std::unordered_set<int>>
+gpcompile(char *user_input) {
+    std::unordered_map<std::string, int> var_counter;
+    std::vector<gymbo::Node *> code;
+    Prog prg;
+    std::unordered_map<int, DiscreteDist> var2dist;
+    std::unordered_set<int> int_vars;
+
+    Token *token = tokenize(user_input, var_counter);
+    generate_ast(token, user_input, code);
+    compile_ast(code, prg, var2dist);
+    for (Node *node : code) {
+        gather_int_vars(node, int_vars);
+    }
 
-    return std::make_pair(var_counter, prg);
+    return std::make_tuple(var_counter, prg, var2dist, int_vars);
 }
 
 }  // namespace gymbo
@@ -5,6 +5,9 @@
  */
 
 #pragma once
+#include <queue>
+#include <tuple>
+
 #include "symbolic.h"
 
 namespace gymbo {
@@ -100,8 +103,9 @@ inline void verbose_pconstraints(int verbose_level,
 /**
  * @brief Updates the table of probabilistic path constraints.
  *
- * This function stores the path constraints and the corresponding probability
- * of reaching the current state in a table for future reference.
+ * This function stores the path constraints, the memory, and the
+ * corresponding probability of reaching the current state in a table for
+ * future reference.
  *
  * @param pc The program counter.
  * @param state The symbolic state.
@@ -115,12 +119,12 @@ inline void update_prob_constraints_table(
         cc = Sym(SymType::SAnd, cc.copy(), &state.path_constraints[i]);
     }
     if (prob_constraints_table.find(pc) == prob_constraints_table.end()) {
-        std::vector<std::tuple<Sym, Mem, SymProb>> tmp = {
-            std::make_tuple(cc, state.mem, *state.p)};
+        std::vector<std::tuple<Sym, Mem, SymProb, SMem>> tmp = {
+            std::make_tuple(cc, state.mem, *state.p, state.smem)};
         prob_constraints_table.emplace(pc, tmp);
     } else {
         prob_constraints_table[pc].emplace_back(
-            std::make_tuple(cc, state.mem, *state.p));
+            std::make_tuple(cc, state.mem, *state.p, state.smem));
     }
 }
 
@@ -131,16 +135,75 @@ inline void update_prob_constraints_table(
  */
 struct PSExecutor : public BaseExecutor {
     std::unordered_set<int> random_vars;  ///< Set of random variables'IDs.
+    std::unordered_map<int, DiscreteDist>
+        var2dist;  ///< Map of random variable index to its distribution.
+    size_t var2dist_signature = 0;  ///< Signature of `var2dist`.
+    SymProbCache prob_cache;  ///< Cache of the probabilities of conditions,
+                              ///< which estimates them by sampling if its
+                              ///< `use_sampling` is set.
     PathConstraintsTable
         constraints_cache;  ///< Cache for storing and reusing path constraints.
     ProbPathConstraintsTable
         prob_constraints_table;  ///< Table for storing probabilistic path
                                  ///< constraints.
+    float prob_threshold = 0.0f;  ///< States whose reach probability is below
+                                  ///< this value are pruned.
+    float mass_tolerance = 0.0f;  ///< `run_best_first` stops when the total
+                                  ///< reach probability of the frontier is at
+                                  ///< most this value.
+    float pruned_mass = 0.0f;  ///< Total reach probability of pruned states
+                               ///< (including those cut by `max_unroll` or
+                               ///< by the exploration budget).
+    float frontier_mass = 0.0f;  ///< Total reach probability of the states
+                                 ///< left unexplored by `run_best_first`.
 
     using BaseExecutor::BaseExecutor;
 
     void register_random_var(int var_id) { random_vars.emplace(var_id); }
 
+    /**
+     * @brief Registers a random variable with its distribution.
+     *
+     * @param var_id The index of the random variable.
+     * @param dist The distribution of the random variable.
+     */
+    void register_random_var(int var_id, const DiscreteDist &dist) {
+        random_vars.emplace(var_id);
+        var2dist[var_id] = dist;
+        var2dist_signature = dist_signature(var2dist);
+    }
+
+    /**
+     * @brief Registers random variables with their distributions, such as the
+     * ones declared in the program and collected by `compile_ast`.
+     *
+     * @param dists Map of variable index to DiscreteDist.
+     */
+    void register_random_vars(
+        const std::unordered_map<int, DiscreteDist> &dists) {
+        for (auto &vd : dists) {
+            random_vars.emplace(vd.first);
+            var2dist[vd.first] = vd.second;
+        }
+        var2dist_signature = dist_signature(var2dist);
+    }
+
+    /**
+     * @brief Evaluates the probability with the registered distributions while
+     * reusing the probabilities of the conditions computed so far.
+     *
+     * @param p The symbolic probability to evaluate.
+     * @param params Map of variable index to parameter values.
+     * @return The evaluated probability.
+     */
+    float eval_prob(SymProb &p, const std::unordered_map<int, float> &params) {
+        float v_n = prob_cache.prob(p.numerator, params, optimizer.eps,
+                                    var2dist, var2dist_signature);
+        float v_d = prob_cache.prob(p.denominator, params, optimizer.eps,
+                                    var2dist, var2dist_signature);
+        return (v_d == 0.0f) ? 0.0f : v_n / v_d;
+    }
+
     /**
      * @brief Solves path constraints and updates the symbolic state.
      *
@@ -184,11 +247,16 @@ struct PSExecutor : public BaseExecutor {
             if (is_contain_prob_var) {
                 // call probabilistic branch algorithm
                 pbranch(state);
+                if (var2dist.size() != 0 &&
+                    var2dist.size() == random_vars.size()) {
+                    state.reach_prob = eval_prob(*state.p, params);
+                }
                 is_sat = true;
             } else {
                 // solve deterministic path constraints
                 call_smt_solver(is_sat, state, params, optimizer,
-                                max_num_trials, ignore_memory, use_dpll);
+                                max_num_trials, ignore_memory, use_dpll,
+                                use_intervals, use_bitblast, use_portfolio);
                 if (is_sat) {
                     maxSAT--;
                 } else {
@@ -217,23 +285,22 @@ struct PSExecutor : public BaseExecutor {
     }
 
     /**
-     * @brief Run probabilistic symbolic execution on a program.
+     * @brief Solves the path constraints of the state at its current pc and
+     * records it if it is final.
      *
-     * This function performs probabilistic symbolic execution on a given
-     * program, considering variable distributions, symbolic states, and path
-     * constraints. It explores different execution paths and updates the
-     * constraints and probabilities accordingly.
+     * The reach probability of a state never increases along a path, so a
+     * state whose reach probability is below `prob_threshold` is pruned
+     * together with all of its descendants, and its probability is added to
+     * `pruned_mass`.
      *
      * @param prog The program to symbolically execute.
      * @param target_pcs Set of pc where gymbo executes path-constraints
-     * solving. If this set is empty or contains -1, gymbo solves all
-     * path-constraints.
-     * @param state The initial symbolic state for execution.
-     * @param maxDepth Maximum exploration depth during symbolic execution.
-     * @return The symbolic execution trace containing states and child traces.
+     * solving.
+     * @param state The symbolic state.
+     * @return True if the state should be explored further.
      */
-    Trace run(Prog &prog, std::unordered_set<int> &target_pcs, SymState &state,
-              int maxDepth = 256) {
+    bool visit(Prog &prog, std::unordered_set<int> &target_pcs,
+               SymState &state) {
         int pc = state.pc;
         bool is_target = is_target_pc(target_pcs, pc);
         bool is_sat = true;
@@ -250,13 +317,52 @@ struct PSExecutor : public BaseExecutor {
         }
 
         if ((prog[pc].instr == InstrType::Done) || (!is_sat)) {
+            return false;
+        }
+        if (state.reach_prob < prob_threshold) {
+            pruned_mass += state.reach_prob;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Run probabilistic symbolic execution on a program.
+     *
+     * This function performs probabilistic symbolic execution on a given
+     * program, considering variable distributions, symbolic states, and path
+     * constraints. It explores different execution paths and updates the
+     * constraints and probabilities accordingly.
+     *
+     * @param prog The program to symbolically execute.
+     * @param target_pcs Set of pc where gymbo executes path-constraints
+     * solving. If this set is empty or contains -1, gymbo solves all
+     * path-constraints.
+     * @param state The initial symbolic state for execution.
+     * @param maxDepth Maximum exploration depth during symbolic execution.
+     * @return The symbolic execution trace containing states and child traces.
+     */
+    Trace run(Prog &prog, std::unordered_set<int> &target_pcs, SymState &state,
+              int maxDepth = 256) {
+        RunGuard guard(*this);
+        if (!return_trace &&
+            !run_straight_line(prog, target_pcs, state, maxDepth)) {
+            pruned_mass += state.reach_prob;
+            return Trace(state, {});
+        }
+        if (!visit(prog, target_pcs, state)) {
             return Trace(state, {});
         } else if (explore_further(maxDepth, maxSAT, maxUNSAT)) {
-            Instr instr = prog[pc];
+            Instr instr = prog[state.pc];
             std::vector<SymState *> newStates;
-            symStep(&state, instr, newStates);
+            int pc = state.pc;
+            symStep(&state, instr, newStates, optimizer.eps);
             std::vector<Trace> children;
             for (SymState *newState : newStates) {
+                if (!within_unroll_bound(pc, prog, *newState)) {
+                    pruned_mass += newState->reach_prob;
+                    continue;
+                }
                 Trace child = run(prog, target_pcs, *newState, maxDepth - 1);
                 if (return_trace) {
                     children.push_back(child);
@@ -264,9 +370,94 @@ struct PSExecutor : public BaseExecutor {
             }
             return Trace(state, children);
         } else {
+            // the state is dropped unexplored by the exploration budget
+            pruned_mass += state.reach_prob;
             return Trace(state, {});
         }
     }
+
+    /**
+     * @brief Run probabilistic symbolic execution on a program, exploring the
+     * most probable states first.
+     *
+     * The frontier is a priority queue of the states created at branches,
+     * ordered by their reach probabilities. Since the paths are disjoint, the
+     * probabilities of the final states found so far, `pruned_mass`, and
+     * `frontier_mass` sum up to the total probability, which gives an anytime
+     * bound on the error of queries such as expectations. The search stops
+     * when `frontier_mass` is at most `mass_tolerance` (or the frontier is
+     * empty).
+     *
+     * @param prog The program to symbolically execute.
+     * @param target_pcs Set of pc where gymbo executes path-constraints
+     * solving. If this set is empty or contains -1, gymbo solves all
+     * path-constraints.
+     * @param state The initial symbolic state for execution.
+     * @param maxDepth Maximum exploration depth during symbolic execution.
+     */
+    void run_best_first(Prog &prog, std::unordered_set<int> &target_pcs,
+                        SymState &state, int maxDepth = 256) {
+        RunGuard guard(*this);
+        // (reach probability, -insertion order, state, remaining depth)
+        std::priority_queue<std::tuple<float, int, SymState *, int>> frontier;
+        int order = 0;
+        frontier_mass = 0.0f;
+
+        if (!visit(prog, target_pcs, state)) {
+            return;
+        }
+        frontier.emplace(state.reach_prob, order--, &state, maxDepth);
+        frontier_mass += state.reach_prob;
+
+        while (!frontier.empty() &&
+               (mass_tolerance <= 0.0f || frontier_mass > mass_tolerance)) {
+            SymState *s = std::get<2>(frontier.top());
+            int depth = std::get<3>(frontier.top());
+            frontier_mass -= s->reach_prob;
+            frontier.pop();
+
+            // follow the path until it forks
+            while (true) {
+                if (!explore_further(depth, maxSAT, maxUNSAT)) {
+                    // the state is dropped unexplored by the exploration
+                    // budget
+                    pruned_mass += s->reach_prob;
+                    break;
+                }
+                std::vector<SymState *> newStates;
+                int pc = s->pc;
+                symStep(s, prog[pc], newStates, optimizer.eps);
+                depth--;
+                if (newStates.size() == 1) {
+                    s = newStates[0];
+                    if (!within_unroll_bound(pc, prog, *s)) {
+                        pruned_mass += s->reach_prob;
+                        break;
+                    }
+                    if (!visit(prog, target_pcs, *s)) {
+                        break;
+                    }
+                    continue;
+                }
+                for (SymState *newState : newStates) {
+                    if (!within_unroll_bound(pc, prog, *newState)) {
+                        pruned_mass += newState->reach_prob;
+                        continue;
+                    }
+                    if (visit(prog, target_pcs, *newState)) {
+                        frontier.emplace(newState->reach_prob, order--,
+                                         newState, depth);
+                        frontier_mass += newState->reach_prob;
+                    }
+                }
+                break;
+            }
+        }
+
+        if (frontier.empty()) {
+            frontier_mass = 0.0f;
+        }
+    }
 };
 }  // namespace gymbo
 
@@ -0,0 +1,522 @@
+/**
+ * @file query.h
+ * @brief Queries on the final states of probabilistic symbolic execution.
+ * @author Hideaki Takahashi
+ */
+
+#pragma once
+#include <cstdlib>
+#include <limits>
+#include <string>
+
+#include "compiler.h"
+#include "psymbolic.h"
+
+namespace gymbo {
+
+/**
+ * @brief Converts an AST node of an expression into a symbolic expression.
+ *
+ * @param node The AST node.
+ * @return The corresponding symbolic expression, or nullptr if the node is
+ * not supported.
+ */
+inline Sym *node2sym(Node *node) {
+    if (node == nullptr) {
+        return nullptr;
+    }
+    switch (node->kind) {
+        case ND_NUM:
+            return new Sym(SymType::SCon, FloatToWord(node->val));
+        case ND_LVAR:
+            return new Sym(SymType::SAny, node->offset);
+        case ND_NOT:
+            return new Sym(SymType::SNot, node2sym(node->lhs));
+        default:
+            break;
+    }
+
+    Sym *lhs = node2sym(node->lhs);
+    Sym *rhs = node2sym(node->rhs);
+    if (lhs == nullptr || rhs == nullptr) {
+        return nullptr;
+    }
+    switch (node->kind) {
+        case ND_ADD:
+            return new Sym(SymType::SAdd, lhs, rhs);
+        case ND_SUB:
+            return new Sym(SymType::SSub, lhs, rhs);
+        case ND_MUL:
+            return new Sym(SymType::SMul, lhs, rhs);
+        case ND_DIV:
+            return new Sym(SymType::SDiv, lhs, rhs,
+                           is_int_expr(node) ? DIV_TRUNC : 0, 0);
+        case ND_MOD:
+            return new Sym(SymType::SMod, lhs, rhs);
+        case ND_BITAND:
+            return new Sym(SymType::SBitAnd, lhs, rhs);
+        case ND_BITOR:
+            return new Sym(SymType::SBitOr, lhs, rhs);
+        case ND_BITXOR:
+            return new Sym(SymType::SBitXor, lhs, rhs);
+        case ND_SHL:
+            return new Sym(SymType::SShl, lhs, rhs);
+        case ND_SHR:
+            return new Sym(SymType::SShr, lhs, rhs);
+        case ND_AND:
+            return new Sym(SymType::SAnd, lhs, rhs);
+        case ND_OR:
+            return new Sym(SymType::SOr, lhs, rhs);
+        case ND_EQ:
+            return new Sym(SymType::SEq, lhs, rhs);
+        case ND_NE:
+            return new Sym(SymType::SNot, new Sym(SymType::SEq, lhs, rhs));
+        case ND_LT:
+            return new Sym(SymType::SLt, lhs, rhs);
+        case ND_LE:
+            return new Sym(SymType::SLe, lhs, rhs);
+        default:
+            return nullptr;
+    }
+}
+
+/**
+ * @struct ProbQuery
+ * @brief Query engine over the final states collected by `PSExecutor`.
+ *
+ * @details The probabilities of all the final states are evaluated once at
+ * construction, and every query shares the cache of the probabilities of the
+ * conditions with the executor. A query can be restricted to the final states
+ * at a specific `Done` pc, in which case it is conditioned on terminating at
+ * that pc. The value of a variable at a final state is its concrete value if
+ * it is in the concrete memory, the expression over the symbolic inputs if it
+ * is in the symbolic memory, and otherwise, its symbolic input. The random
+ * variables in the value are marginalized over their distributions. If the
+ * executor estimates the probabilities by sampling, so do the queries.
+ */
+struct ProbQuery {
+    /**
+     * @brief Final state with its evaluated probability.
+     */
+    struct Entry {
+        int pc;                 ///< The pc of the final state.
+        Sym *numerator;         ///< Numerator of the probability.
+        Sym *denominator;       ///< Denominator of the probability.
+        float denominator_val;  ///< Probability of the denominator.
+        float prob;             ///< Probability of the final state.
+        Mem mem;                ///< Concrete memory of the final state.
+        SMem smem;              ///< Symbolic memory of the final state.
+    };
+
+    PSExecutor &executor;  ///< The executor that collected the final states.
+    std::unordered_map<int, float> params;  ///< Values of the parameters.
+    std::vector<Entry> entries;             ///< Final states.
+    float dropped_mass = 0.0f;  ///< Probability mass of the final states
+                                ///< left out of the last moment, as their
+                                ///< values depend on a symbolic input that
+                                ///< is neither random nor a parameter.
+
+    /**
+     * @brief Constructor for ProbQuery.
+     *
+     * @param executor The executor that collected the final states.
+     * @param params Values of the non-random symbolic variables.
+     */
+    ProbQuery(PSExecutor &executor,
+              const std::unordered_map<int, float> &params = {})
+        : executor(executor), params(params) {
+        for (auto &cc : executor.prob_constraints_table) {
+            for (auto &ccv : cc.second) {
+                SymProb &p = std::get<2>(ccv);
+                float v_d = executor.prob_cache.prob(
+                    p.denominator, params, executor.optimizer.eps,
+                    executor.var2dist, executor.var2dist_signature);
+                float v_n = executor.prob_cache.prob(
+                    p.numerator, params, executor.optimizer.eps,
+                    executor.var2dist, executor.var2dist_signature);
+                float prob = (v_d == 0.0f) ? 0.0f : v_n / v_d;
+                entries.push_back(Entry{cc.first, p.numerator, p.denominator,
+                                        v_d, prob, std::get<1>(ccv),
+                                        std::get<3>(ccv)});
+            }
+        }
+    }
+
+    /**
+     * @brief Replaces the program variables in the expression with their
+     * values at the final state.
+     *
+     * @param sym The expression on program variables.
+     * @param e The final state.
+     * @return The expression on the symbolic inputs.
+     */
+    static Sym *at_final_state(Sym *sym, Entry &e) {
+        std::unordered_map<int, Sym *> var2sym;
+        for (auto &t : e.mem) {
+            var2sym.emplace((int)t.first, new Sym(SymType::SCon, t.second));
+        }
+        for (auto &t : e.smem) {
+            var2sym.emplace((int)t.first, &t.second);
+        }
+        return sym->substitute(var2sym)->psimplify({});
+    }
+
+    /**
+     * @brief Computes the joint probability of the final state and a
+     * condition on the symbolic inputs.
+     *
+     * When the probabilities are estimated by sampling (see
+     * `SymProbCache::use_sampling`), the probability of the condition given
+     * the path is estimated from samples drawn within the path, i.e., the
+     * samples are stratified by the path conditions, and it is weighted by
+     * the probability of the final state.
+     *
+     * @param e The final state.
+     * @param cond The condition on the symbolic inputs.
+     * @return The joint probability.
+     */
+    float joint_prob_at(Entry &e, Sym *cond) {
+        SymProbCache &cache = executor.prob_cache;
+        Sym *numerator = new Sym(SymType::SAnd, e.numerator, cond);
+        if (cache.use_sampling) {
+            return e.prob * sampled_prob(numerator, e.numerator, params,
+                                         executor.optimizer.eps,
+                                         executor.var2dist,
+                                         cache.sampling_precision, 1.96f,
+                                         cache.max_samples, 1024,
+                                         cache.sampling_seed,
+                                         cache.importance_sampling)
+                                .prob;
+        }
+        return cache.prob(numerator, params, executor.optimizer.eps,
+                          executor.var2dist, executor.var2dist_signature) /
+               e.denominator_val;
+    }
+
+    /**
+     * @brief Computes the total probability of the final states at the pc.
+     *
+     * @param pc The pc of the final states (-1 for all of them).
+     * @return The total probability.
+     */
+    float mass(int pc = -1) {
+        float m = 0.0f;
+        for (Entry &e : entries) {
+            if (pc == -1 || e.pc == pc) {
+                m += e.prob;
+            }
+        }
+        return m;
+    }
+
+    /**
+     * @brief Computes the joint probability of terminating at the pc and the
+     * event.
+     *
+     * @param event The event on program variables.
+     * @param pc The pc of the final states (-1 for all of them).
+     * @return The joint probability.
+     */
+    float joint_prob(Sym *event, int pc = -1) {
+        float p = 0.0f;
+        for (Entry &e : entries) {
+            if ((pc != -1 && e.pc != pc) || e.prob == 0.0f) {
+                continue;
+            }
+            Sym *cond = at_final_state(event, e);
+            std::unordered_set<int> unique_var_ids;
+            cond->gather_var_ids(unique_var_ids);
+            if (unique_var_ids.size() == 0) {
+                if (cond->eval(params, executor.optimizer.eps) <= 0.0f) {
+                    p += e.prob;
+                }
+                continue;
+            }
+            p += joint_prob_at(e, cond);
+        }
+        return p;
+    }
+
+    /**
+     * @brief Computes the probability of the event given terminating at the
+     * pc.
+     *
+     * @param event The event on program variables.
+     * @param pc The pc of the final states (-1 for all of them).
+     * @return The probability of the event.
+     */
+    float prob(Sym *event, int pc = -1) {
+        float m = mass(pc);
+        return (m == 0.0f) ? 0.0f : joint_prob(event, pc) / m;
+    }
+
+    /**
+     * @brief Computes the conditional probability of the event given another
+     * event and terminating at the pc.
+     *
+     * @param event The event on program variables.
+     * @param given The conditioning event on program variables.
+     * @param pc The pc of the final states (-1 for all of them).
+     * @return The conditional probability.
+     */
+    float conditional_prob(Sym *event, Sym *given, int pc = -1) {
+        float p_given = joint_prob(given, pc);
+        if (p_given == 0.0f) {
+            return 0.0f;
+        }
+        return joint_prob(new Sym(SymType::SAnd, event, given), pc) / p_given;
+    }
+
+    /**
+     * @brief Computes the cumulative distribution function of the variable
+     * given terminating at the pc.
+     *
+     * @param var_id The index of the variable.
+     * @param x The point where the CDF is evaluated.
+     * @param pc The pc of the final states (-1 for all of them).
+     * @return The probability that the variable is at most `x`.
+     */
+    float cdf(int var_id, float x, int pc = -1) {
+        return prob(new Sym(SymType::SLe, new Sym(SymType::SAny, var_id),
+                            new Sym(SymType::SCon, FloatToWord(x))),
+                    pc);
+    }
+
+    /**
+     * @brief Computes the k-th raw moment of the variable given terminating
+     * at the pc.
+     *
+     * @param var_id The index of the variable.
+     * @param k The order of the moment.
+     * @param pc The pc of the final states (-1 for all of them).
+     * @return The k-th raw moment over the final states where the value of
+     * the variable is determined by the random variables and the parameters.
+     * The mass of the other final states is stored in `dropped_mass`.
+     */
+    float moment(int var_id, int k, int pc = -1) {
+        float m = 0.0f, total = 0.0f;
+        dropped_mass = 0.0f;
+        for (Entry &e : entries) {
+            if ((pc != -1 && e.pc != pc) || e.prob == 0.0f) {
+                continue;
+            }
+            Sym *value = at_final_state(new Sym(SymType::SAny, var_id), e);
+            std::unordered_set<int> unique_var_ids;
+            value->gather_var_ids(unique_var_ids);
+            std::vector<int> rvs;
+            bool is_random = true;
+            for (int i : unique_var_ids) {
+                if (executor.var2dist.find(i) != executor.var2dist.end()) {
+                    rvs.emplace_back(i);
+                } else if (params.find(i) == params.end()) {
+                    is_random = false;
+                }
+            }
+            if (!is_random) {
+                // the value is neither concrete nor random
+                dropped_mass += e.prob;
+                continue;
+            }
+            if (rvs.size() == 0) {
+                float v = value->eval(params, executor.optimizer.eps);
+                m += e.prob * std::pow(v, (float)k);
+                total += e.prob;
+                continue;
+            }
+
+            // marginalizes the random variables in the value
+            std::vector<size_t> idxs(rvs.size(), 0);
+            while (idxs[0] < executor.var2dist[rvs[0]].vals.size()) {
+                std::unordered_map<int, float> rvals;
+                Sym *event = nullptr;
+                for (size_t j = 0; j < rvs.size(); j++) {
+                    float v = executor.var2dist[rvs[j]].vals[idxs[j]];
+                    rvals.emplace(rvs[j], v);
+                    Sym *eq = new Sym(SymType::SEq,
+                                      new Sym(SymType::SAny, rvs[j]),
+                                      new Sym(SymType::SCon, FloatToWord(v)));
+                    event = (event == nullptr)
+                                ? eq
+                                : new Sym(SymType::SAnd, event, eq);
+                }
+                m += std::pow(value->eval(rvals, executor.optimizer.eps,
+                                          &params),
+                              (float)k) *
+                     joint_prob_at(e, event);
+                // advances to the next combination of the values
+                size_t j = rvs.size() - 1;
+                idxs[j]++;
+                while (j > 0 &&
+                       idxs[j] == executor.var2dist[rvs[j]].vals.size()) {
+                    idxs[j] = 0;
+                    idxs[--j]++;
+                }
+            }
+            total += e.prob;
+        }
+        return (total == 0.0f) ? 0.0f : m / total;
+    }
+
+    /**
+     * @brief Computes the expectation of the variable given terminating at the
+     * pc.
+     *
+     * @param var_id The index of the variable.
+     * @param pc The pc of the final states (-1 for all of them).
+     * @return The expectation.
+     */
+    float expectation(int var_id, int pc = -1) {
+        return moment(var_id, 1, pc);
+    }
+
+    /**
+     * @brief Computes the variance of the variable given terminating at the
+     * pc.
+     *
+     * @param var_id The index of the variable.
+     * @param pc The pc of the final states (-1 for all of them).
+     * @return The variance.
+     */
+    float variance(int var_id, int pc = -1) {
+        float m1 = moment(var_id, 1, pc);
+        return moment(var_id, 2, pc) - m1 * m1;
+    }
+
+    /**
+     * @brief Parses an expression on program variables into a symbolic
+     * expression.
+     *
+     * @param str The expression (e.g., `result == 1 && x < 2`).
+     * @param var_counter The mapping from variable name to variable id, which
+     * is not modified.
+     * @return The symbolic expression, or nullptr if it is malformed,
+     * mentions a variable that is not in the program or is not supported.
+     */
+    static Sym *parse_event(
+        const std::string &str,
+        const std::unordered_map<std::string, int> &var_counter) {
+        char *user_input = strdup(str.c_str());
+        // the tokenizer registers unknown names, which would be new symbolic
+        // inputs unrelated to the explored program
+        std::unordered_map<std::string, int> names = var_counter;
+        Token *token;
+        Node *node;
+        try {
+            token = tokenize(user_input, names);
+            if (names.size() != var_counter.size()) {
+                fprintf(stderr, "unknown variable in query: %s\n",
+                        str.c_str());
+                free(user_input);
+                return nullptr;
+            }
+            node = expr(token, user_input);
+        } catch (const ParseError &e) {
+            fprintf(stderr, "%s\n", e.what());
+            free(user_input);
+            return nullptr;
+        }
+        Sym *sym = node2sym(node);
+        if (sym == nullptr || !at_eof(token)) {
+            fprintf(stderr, "unsupported query expression: %s\n",
+                    str.c_str());
+            sym = nullptr;
+        }
+        free(user_input);
+        return sym;
+    }
+
+    /**
+     * @brief Answers a query written as a string.
+     *
+     * The supported queries are `E[x]`, `Var[x]`, `P[event]` and
+     * `P[event | given]`, where `x` is the name of a variable and `event` and
+     * `given` are expressions such as `x <= 1`. A bitwise OR in an event must
+     * be parenthesized (e.g., `P[(x | 1) == 3]`), as a single `|` outside the
+     * parentheses separates `event` and `given`. A query can be restricted to
+     * the final states at a pc by appending `@pc` (e.g., `E[x]@30`).
+     *
+     * @param str The query.
+     * @param var_counter The mapping from variable name to variable id.
+     * @return The answer, or NaN if the query is malformed, unknown, or not
+     * supported.
+     */
+    float query(const std::string &str,
+                const std::unordered_map<std::string, int> &var_counter) {
+        const float invalid = std::numeric_limits<float>::quiet_NaN();
+        size_t lb = str.find('[');
+        size_t rb = str.rfind(']');
+        if (lb == std::string::npos || rb == std::string::npos || rb < lb) {
+            fprintf(stderr, "invalid query: %s\n", str.c_str());
+            return invalid;
+        }
+
+        std::string kind = str.substr(0, lb);
+        kind.erase(0, kind.find_first_not_of(" \t"));
+        std::string body = str.substr(lb + 1, rb - lb - 1);
+        int pc = -1;
+        std::string suffix = str.substr(rb + 1);
+        suffix.erase(suffix.find_last_not_of(" \t") + 1);
+        if (suffix.size() != 0) {
+            // only `@pc` may follow the brackets
+            char *end = nullptr;
+            long v = (suffix[0] == '@')
+                         ? std::strtol(suffix.c_str() + 1, &end, 10)
+                         : -1;
+            if (suffix[0] != '@' || suffix.size() == 1 ||
+                end != suffix.c_str() + suffix.size() || v < 0 ||
+                v > std::numeric_limits<int>::max()) {
+                fprintf(stderr, "invalid pc in query: %s\n", str.c_str());
+                return invalid;
+            }
+            pc = (int)v;
+        }
+
+        if (kind == "E" || kind == "Var") {
+            Sym *sym = parse_event(body, var_counter);
+            if (sym == nullptr) {
+                return invalid;
+            }
+            if (sym->symtype != SymType::SAny) {
+                fprintf(stderr, "%s[] expects a variable: %s\n", kind.c_str(),
+                        body.c_str());
+                return invalid;
+            }
+            return (kind == "E") ? expectation(sym->var_idx, pc)
+                                 : variance(sym->var_idx, pc);
+        } else if (kind == "P") {
+            // split at a single `|` outside the parentheses, which is neither
+            // a part of `||` nor a bitwise OR
+            size_t bar = std::string::npos;
+            int depth = 0;
+            for (size_t i = 0; i < body.size(); i++) {
+                if (body[i] == '(') {
+                    depth++;
+                } else if (body[i] == ')') {
+                    depth--;
+                } else if (body[i] == '|' && depth == 0) {
+                    if (i + 1 < body.size() && body[i + 1] == '|') {
+                        i++;
+                    } else {
+                        bar = i;
+                        break;
+                    }
+                }
+            }
+            if (bar == std::string::npos) {
+                Sym *event = parse_event(body, var_counter);
+                return (event == nullptr) ? invalid : prob(event, pc);
+            }
+            Sym *event = parse_event(body.substr(0, bar), var_counter);
+            Sym *given = parse_event(body.substr(bar + 1), var_counter);
+            if (event == nullptr || given == nullptr) {
+                return invalid;
+            }
+            return conditional_prob(event, given, pc);
+        }
+
+        fprintf(stderr, "unknown query: %s\n", str.c_str());
+        return invalid;
+    }
+};
+
+}  // namespace gymbo
@@ -5,6 +5,7 @@
  */
 
 #pragma once
+#include <algorithm>
 #include <memory>
 
 #include "type.h"
@@ -725,6 +726,312 @@ inline bool satisfiableDPLL(
     }
 }
 
+/**
+ * @brief Enum representing the result of a SAT solver.
+ */
+typedef enum { SAT, UNSAT, UNKNOWN } SatResult;
+
+/**
+ * @class CDCL
+ * @brief Conflict-driven clause-learning solver over clauses of literals.
+ *
+ * Unlike `satisfiableDPLL`, which rewrites expression trees, this solver works
+ * on flat clauses and scales to the thousands of clauses produced by
+ * bit-blasting. A literal is a non-zero integer as in DIMACS, i.e., `v` for a
+ * variable `v >= 1` and `-v` for its negation. The solver watches two literals
+ * per clause, learns the first-UIP clause of each conflict, backjumps
+ * non-chronologically, and branches on the most active variable with its
+ * saved phase.
+ */
+class CDCL {
+   public:
+    int num_vars;      /**< Number of variables. */
+    int max_conflicts; /**< Conflicts before giving up (-1 for no limit). */
+
+    /**
+     * @brief Constructor for CDCL.
+     * @param max_conflicts The number of conflicts before giving up.
+     */
+    CDCL(int max_conflicts = 100000)
+        : num_vars(0),
+          max_conflicts(max_conflicts),
+          is_unsat(false),
+          qhead(0),
+          var_inc(1.0),
+          vals(1, 0),
+          levels(1, 0),
+          reasons(1, -1),
+          activity(1, 0.0),
+          polarity(1, false),
+          seen(1, false),
+          watches(2) {}
+
+    /**
+     * @brief Creates a new variable.
+     * @return The positive literal of the variable.
+     */
+    int new_var() {
+        num_vars++;
+        vals.emplace_back(0);
+        levels.emplace_back(0);
+        reasons.emplace_back(-1);
+        activity.emplace_back(0.0);
+        polarity.emplace_back(false);
+        seen.emplace_back(false);
+        watches.resize(2 * (num_vars + 1));
+        return num_vars;
+    }
+
+    /**
+     * @brief Adds a clause, i.e., a disjunction of literals. Clauses must be
+     * added before `solve` is called.
+     * @param clause The literals of the clause.
+     */
+    void add_clause(std::vector<int> clause) {
+        std::sort(clause.begin(), clause.end());
+        clause.erase(std::unique(clause.begin(), clause.end()), clause.end());
+        for (size_t i = 0; i + 1 < clause.size(); i++) {
+            if (std::binary_search(clause.begin() + i + 1, clause.end(),
+                                   -clause[i])) {
+                return;  // tautology
+            }
+        }
+        if (clause.size() == 0) {
+            is_unsat = true;
+        } else if (clause.size() == 1) {
+            units.emplace_back(clause[0]);
+        } else {
+            attach(clause);
+        }
+    }
+
+    /**
+     * @brief Decides the satisfiability of the added clauses.
+     * @return `SAT`, `UNSAT`, or `UNKNOWN` if `max_conflicts` is exceeded.
+     */
+    SatResult solve() {
+        if (is_unsat) {
+            return UNSAT;
+        }
+        for (int u : units) {
+            if (value(u) < 0) {
+                return UNSAT;
+            } else if (value(u) == 0) {
+                enqueue(u, -1);
+            }
+        }
+
+        int num_conflicts = 0, restart_conflicts = 0, restart_limit = 100;
+        std::vector<int> learnt;
+        for (;;) {
+            int confl = propagate();
+            if (confl != -1) {
+                num_conflicts++;
+                restart_conflicts++;
+                if (trail_lim.size() == 0) {
+                    return UNSAT;
+                }
+                if (max_conflicts >= 0 && num_conflicts > max_conflicts) {
+                    cancel_until(0);
+                    return UNKNOWN;
+                }
+                int backtrack_level = analyze(confl, learnt);
+                cancel_until(backtrack_level);
+                if (learnt.size() == 1) {
+                    enqueue(learnt[0], -1);
+                } else {
+                    enqueue(learnt[0], attach(learnt));
+                }
+                var_inc /= 0.95;
+            } else if (restart_conflicts >= restart_limit) {
+                cancel_until(0);
+                restart_conflicts = 0;
+                restart_limit += restart_limit / 2;
+            } else {
+                int v = pick_branch_var();
+                if (v == 0) {
+                    return SAT;
+                }
+                trail_lim.emplace_back(trail.size());
+                enqueue(polarity[v] ? v : -v, -1);
+            }
+        }
+    }
+
+    /**
+     * @brief Returns the value of a variable in the model found by `solve`.
+     * @param v The variable.
+     * @return True if the variable is assigned to true.
+     */
+    bool model(int v) const { return vals[v] > 0; }
+
+   private:
+    bool is_unsat; /**< True if an empty clause was added. */
+    int qhead;     /**< Head of the propagation queue in the trail. */
+    double var_inc;              /**< Increment of the activities. */
+    std::vector<int> vals;       /**< 1 (true), -1 (false), or 0. */
+    std::vector<int> levels;     /**< Decision levels of the variables. */
+    std::vector<int> reasons;    /**< Clauses implying the variables. */
+    std::vector<double> activity; /**< Activities of the variables. */
+    std::vector<bool> polarity;   /**< Saved phases of the variables. */
+    std::vector<bool> seen;       /**< Work flags of the conflict analysis. */
+    std::vector<int> units;       /**< Unit clauses. */
+    std::vector<std::vector<int>> clauses; /**< Non-unit clauses. */
+    std::vector<std::vector<int>> watches; /**< Clauses watching a literal. */
+    std::vector<int> trail;      /**< Assigned literals in order. */
+    std::vector<int> trail_lim;  /**< Trail sizes at the decisions. */
+
+    int index(int lit) const { return 2 * std::abs(lit) + (lit < 0); }
+
+    int value(int lit) const {
+        return (lit > 0) ? vals[lit] : -vals[-lit];
+    }
+
+    int attach(const std::vector<int> &clause) {
+        clauses.emplace_back(clause);
+        int ci = clauses.size() - 1;
+        watches[index(clause[0])].emplace_back(ci);
+        watches[index(clause[1])].emplace_back(ci);
+        return ci;
+    }
+
+    void enqueue(int lit, int reason) {
+        vals[std::abs(lit)] = (lit > 0) ? 1 : -1;
+        levels[std::abs(lit)] = trail_lim.size();
+        reasons[std::abs(lit)] = reason;
+        trail.emplace_back(lit);
+    }
+
+    /**
+     * @brief Propagates the assigned literals through the watched clauses.
+     * @return The index of a conflicting clause, or -1 if there is none.
+     */
+    int propagate() {
+        while (qhead < (int)trail.size()) {
+            int false_lit = -trail[qhead++];
+            std::vector<int> &ws = watches[index(false_lit)];
+            size_t i = 0, j = 0;
+            while (i < ws.size()) {
+                int ci = ws[i++];
+                std::vector<int> &c = clauses[ci];
+                // the implied literal is kept at the front of the clause
+                if (c[0] == false_lit) {
+                    std::swap(c[0], c[1]);
+                }
+                if (value(c[0]) > 0) {
+                    ws[j++] = ci;
+                    continue;
+                }
+                bool moved = false;
+                for (size_t k = 2; k < c.size(); k++) {
+                    if (value(c[k]) >= 0) {
+                        std::swap(c[1], c[k]);
+                        watches[index(c[1])].emplace_back(ci);
+                        moved = true;
+                        break;
+                    }
+                }
+                if (moved) {
+                    continue;
+                }
+                ws[j++] = ci;
+                if (value(c[0]) < 0) {
+                    while (i < ws.size()) {
+                        ws[j++] = ws[i++];
+                    }
+                    ws.resize(j);
+                    qhead = trail.size();
+                    return ci;
+                }
+                enqueue(c[0], ci);
+            }
+            ws.resize(j);
+        }
+        return -1;
+    }
+
+    /**
+     * @brief Derives the first-UIP clause of a conflict.
+     * @param confl The index of the conflicting clause.
+     * @param learnt The learnt clause, whose first literal is the UIP.
+     * @return The decision level to backjump to.
+     */
+    int analyze(int confl, std::vector<int> &learnt) {
+        int current_level = trail_lim.size();
+        learnt.assign(1, 0);
+        int num_paths = 0, lit = 0, idx = trail.size() - 1;
+        do {
+            const std::vector<int> &c = clauses[confl];
+            for (size_t k = (lit == 0) ? 0 : 1; k < c.size(); k++) {
+                int v = std::abs(c[k]);
+                if (!seen[v] && levels[v] > 0) {
+                    bump(v);
+                    seen[v] = true;
+                    if (levels[v] >= current_level) {
+                        num_paths++;
+                    } else {
+                        learnt.emplace_back(c[k]);
+                    }
+                }
+            }
+            while (!seen[std::abs(trail[idx])]) {
+                idx--;
+            }
+            lit = trail[idx--];
+            confl = reasons[std::abs(lit)];
+            seen[std::abs(lit)] = false;
+            num_paths--;
+        } while (num_paths > 0);
+        learnt[0] = -lit;
+
+        int backtrack_level = 0;
+        for (size_t k = 1; k < learnt.size(); k++) {
+            seen[std::abs(learnt[k])] = false;
+            if (levels[std::abs(learnt[k])] > backtrack_level) {
+                backtrack_level = levels[std::abs(learnt[k])];
+                // the second watch is the literal of the highest level
+                std::swap(learnt[1], learnt[k]);
+            }
+        }
+        return backtrack_level;
+    }
+
+    void bump(int v) {
+        activity[v] += var_inc;
+        if (activity[v] > 1e100) {
+            for (double &a : activity) {
+                a *= 1e-100;
+            }
+            var_inc *= 1e-100;
+        }
+    }
+
+    void cancel_until(int level) {
+        if ((int)trail_lim.size() <= level) {
+            return;
+        }
+        for (int i = trail.size() - 1; i >= trail_lim[level]; i--) {
+            int v = std::abs(trail[i]);
+            polarity[v] = vals[v] > 0;
+            vals[v] = 0;
+            reasons[v] = -1;
+        }
+        trail.resize(trail_lim[level]);
+        trail_lim.resize(level);
+        qhead = trail.size();
+    }
+
+    int pick_branch_var() const {
+        int best = 0;
+        for (int v = 1; v <= num_vars; v++) {
+            if (vals[v] == 0 && (best == 0 || activity[v] > activity[best])) {
+                best = v;
+            }
+        }
+        return best;
+    }
+};
+
 /**
  * @brief Convert a symbolic expression to a logical expression.
  * @param sym Pointer to the symbolic expression.
@@ -5,7 +5,12 @@
  */
 
 #pragma once
+#include <atomic>
+#include <thread>
+
+#include "bitblast.h"
 #include "gd.h"
+#include "interval.h"
 #include "sat.h"
 namespace gymbo {
 
@@ -24,8 +29,17 @@ inline void initialize_params(std::unordered_map<int, float> &params,
                               SymState &state, bool ignore_memory) {
     params = {};
     if (!ignore_memory) {
+        // a variable in the path constraints refers to its symbolic input
+        // (see SymState::load), which is not fixed to its current value when
+        // it is overwritten after being read.
+        std::unordered_set<int> unique_var_ids;
+        for (Sym &c : state.path_constraints) {
+            c.gather_var_ids(unique_var_ids);
+        }
         for (auto &p : state.mem) {
-            params.emplace(std::make_pair(p.first, wordToFloat(p.second)));
+            if (unique_var_ids.find(p.first) == unique_var_ids.end()) {
+                params.emplace(std::make_pair(p.first, wordToFloat(p.second)));
+            }
         }
     }
 }
@@ -45,11 +59,12 @@ inline void smt_union_solver(bool &is_sat, SymState &state,
                              std::unordered_map<int, float> &params,
                              GDOptimizer &optimizer, int max_num_trials,
                              bool ignore_memory) {
-    for (int j = 0; j < max_num_trials; j++) {
+    for (int j = 0; j < max_num_trials && !optimizer.is_cancelled(); j++) {
         is_sat = optimizer.solve(state.path_constraints, params);
         if (is_sat) {
             break;
         }
+        // the next restart takes the next point of the initializer
         optimizer.seed += 1;
         int total_num_params = params.size();
         initialize_params(params, state, ignore_memory);
@@ -81,7 +96,8 @@ inline void smt_dpll_solver(bool &is_sat, SymState &state,
         gymbosat::pathconstraints2expr(state.path_constraints,
                                        unique_terms_map);
 
-    while (satisfiableDPLL(path_constraints_expr, assignments_map)) {
+    while (!optimizer.is_cancelled() &&
+           satisfiableDPLL(path_constraints_expr, assignments_map)) {
         std::vector<Sym> new_constraints;
         for (auto &ass : assignments_map) {
             if (ass.second) {
@@ -92,11 +108,13 @@ inline void smt_dpll_solver(bool &is_sat, SymState &state,
             }
         }
 
-        for (int j = 0; j < max_num_trials; j++) {
+        for (int j = 0; j < max_num_trials && !optimizer.is_cancelled();
+             j++) {
             is_sat = optimizer.solve(new_constraints, params);
             if (is_sat) {
                 break;
             }
+            // the next restart takes the next point of the initializer
             optimizer.seed += 1;
             initialize_params(params, state, ignore_memory);
         }
@@ -126,4 +144,115 @@ inline void smt_dpll_solver(bool &is_sat, SymState &state,
     }
 }
 
+/**
+ * @brief Configuration of a solver in a portfolio.
+ */
+struct PortfolioConfig {
+    GDOptimizer optimizer; /**< The optimizer with its own options and seed. */
+    bool use_dpll; /**< If set to true, use `smt_dpll_solver`. Otherwise, use
+                      `smt_union_solver`. */
+};
+
+/**
+ * @brief Returns the default portfolio derived from an optimizer.
+ *
+ * The portfolio has the union and the DPLL solvers with the optimizer as it
+ * is, and the union solver with Halton restarts, with annealed smooth losses
+ * and Latin hypercube restarts, and with the other kind of gradient descent,
+ * each of which starts from a different seed.
+ *
+ * @param optimizer The optimizer.
+ * @param use_dpll The solver of the first configuration.
+ * @return The configurations.
+ */
+inline std::vector<PortfolioConfig> default_portfolio(
+    const GDOptimizer &optimizer, bool use_dpll) {
+    std::vector<PortfolioConfig> configs = {{optimizer, use_dpll},
+                                            {optimizer, !use_dpll}};
+
+    GDOptimizer halton = optimizer;
+    halton.init_type = InitType::Halton;
+    halton.seed += 1000;
+    configs.push_back({halton, false});
+
+    GDOptimizer smooth = optimizer;
+    smooth.init_type = InitType::LatinHypercube;
+    smooth.smooth_temperature = std::max(optimizer.smooth_temperature, 1.0f);
+    smooth.seed += 2000;
+    configs.push_back({smooth, false});
+
+    GDOptimizer plain = optimizer;
+    plain.sign_grad = !optimizer.sign_grad;
+    plain.seed += 3000;
+    configs.push_back({plain, false});
+    return configs;
+}
+
+/**
+ * @brief SMT Solver racing several solvers on separate threads.
+ *
+ * Each configuration solves the path constraints on its own thread with its
+ * own copy of the parameters. The first configuration finding a model sets
+ * the shared cancellation flag, which stops the others at their next epoch,
+ * and its model is taken. The path constraints are UNSAT if none of them
+ * finds a model. Since every configuration has its own optimizer, the
+ * memory is only read by the threads, and the compiled losses are shared
+ * under a lock, the solvers do not interfere.
+ *
+ * @param is_sat Flag to store the result of satisfiability.
+ * @param state The current symbolic state.
+ * @param params The map from the variable IDs to the concrete values.
+ * @param optimizer The gradient descent optimizer, which accumulates the
+ * iterations of all configurations and takes the seed of the first one.
+ * @param max_num_trials The maximum number of trials for each gradient descent.
+ * @param ignore_memory If set to true, constraints derived from memory will be
+ * ignored.
+ * @param configs The configurations of the solvers.
+ */
+inline void smt_portfolio_solver(bool &is_sat, SymState &state,
+                                 std::unordered_map<int, float> &params,
+                                 GDOptimizer &optimizer, int max_num_trials,
+                                 bool ignore_memory,
+                                 std::vector<PortfolioConfig> configs) {
+    std::atomic<bool> cancel(false);
+    int winner = -1;
+    std::vector<std::unordered_map<int, float>> models(configs.size(),
+                                                       params);
+    std::vector<std::thread> threads;
+    for (size_t k = 0; k < configs.size(); k++) {
+        configs[k].optimizer.cancel = &cancel;
+        configs[k].optimizer.num_used_itr = 0;
+        threads.emplace_back([&, k]() {
+            bool found = false;
+            if (configs[k].use_dpll) {
+                smt_dpll_solver(found, state, models[k], configs[k].optimizer,
+                                max_num_trials, ignore_memory);
+            } else {
+                smt_union_solver(found, state, models[k],
+                                 configs[k].optimizer, max_num_trials,
+                                 ignore_memory);
+            }
+            // only the first model is taken
+            if (found && !cancel.exchange(true)) {
+                winner = k;
+            }
+        });
+    }
+    for (std::thread &t : threads) {
+        t.join();
+    }
+
+    for (PortfolioConfig &c : configs) {
+        optimizer.num_used_itr += c.optimizer.num_used_itr;
+    }
+    optimizer.seed = configs[0].optimizer.seed;
+    is_sat = winner >= 0;
+    if (is_sat) {
+        params = models[winner];
+        optimizer.warm_start = configs[winner].optimizer.warm_start;
+    } else {
+        params = models[0];
+    }
+}
+
 }  // namespace gymbo
@@ -5,6 +5,7 @@
  */
 
 #pragma once
+#include "block.h"
 #include "smt.h"
 
 namespace gymbo {
@@ -54,12 +55,57 @@ inline bool explore_further(int maxDepth, int maxSAT, int maxUNSAT) {
  * @param max_num_trials Maximum number of solver trials.
  * @param ignore_memory Flag indicating whether to ignore memory.
  * @param use_dpll Flag indicating whether to use the DPLL solver.
+ * @param use_intervals Flag indicating whether to decide the path constraints
+ * with interval reasoning before calling the solver.
+ * @param use_bitblast Flag indicating whether to decide the path constraints
+ * over integer variables by bit-blasting before calling the solver.
+ * @param use_portfolio Flag indicating whether to race the configurations of
+ * `default_portfolio` instead of calling a single solver.
  */
 inline void call_smt_solver(bool &is_sat, SymState &state,
                             std::unordered_map<int, float> &params,
                             GDOptimizer &optimizer, int max_num_trials,
-                            bool ignore_memory, bool use_dpll) {
-    if (use_dpll) {
+                            bool ignore_memory, bool use_dpll,
+                            bool use_intervals = false,
+                            bool use_bitblast = true,
+                            bool use_portfolio = false) {
+    optimizer.interval_bounds.clear();
+    if (use_intervals) {
+        IntervalDomain domain(optimizer.eps);
+        domain.add(state.path_constraints);
+        domain.round(optimizer.int_vars);
+        if (domain.is_empty) {
+            is_sat = false;
+            return;
+        }
+        if (optimizer.init_within_intervals) {
+            for (auto &b : domain.bounds) {
+                optimizer.interval_bounds.emplace(
+                    b.first, std::make_pair(b.second.lo, b.second.hi));
+            }
+        }
+        if (domain.is_box) {
+            std::unordered_map<int, float> witness = params;
+            domain.witness(witness);
+            if (optimizer.eval(state.path_constraints, witness)) {
+                params = witness;
+                is_sat = true;
+                return;
+            }
+        }
+    }
+
+    if (use_bitblast && optimizer.int_vars.size() != 0 &&
+        bitblast_solver(is_sat, state.path_constraints, optimizer.int_vars,
+                        params, optimizer.eps)) {
+        return;
+    }
+
+    if (use_portfolio) {
+        smt_portfolio_solver(is_sat, state, params, optimizer, max_num_trials,
+                             ignore_memory,
+                             default_portfolio(optimizer, use_dpll));
+    } else if (use_dpll) {
         smt_dpll_solver(is_sat, state, params, optimizer, max_num_trials,
                         ignore_memory);
     } else {
@@ -150,28 +196,18 @@ inline void verbose_post(int verbose_level) {
 }
 
 /**
- * @brief Symbolically Execute a Single Instruction of a Program.
- *
- * This function symbolically executes a single instruction of a program and
- * generates new symbolic states, representing possible outcomes of the
- * instruction's execution.
+ * @brief Symbolically executes a straight-line instruction in place.
  *
- * @param state The state of the program before the instruction is executed.
- * @param instr The instruction to be executed.
- * @param result A list of new symbolic states, each representing a possible
- * outcome.
+ * @param state The state of the program, which is updated.
+ * @param instr The instruction, which satisfies `is_straight_line`.
  */
-inline void symStep(SymState *state, Instr &instr,
-                    std::vector<SymState *> &result) {
-    // SymState state = state;
-
+inline void symStepStraight(SymState *state, const Instr &instr) {
     switch (instr.instr) {
         case InstrType::Not: {
             Sym *w = state->symbolic_stack.back();
             state->symbolic_stack.pop();
             state->pc++;
             state->symbolic_stack.push(Sym(SymType::SNot, w));
-            result.emplace_back(state);
             break;
         }
         case InstrType::Add: {
@@ -181,7 +217,6 @@ inline void symStep(SymState *state, Instr &instr,
             state->symbolic_stack.pop();
             state->pc++;
             state->symbolic_stack.push(Sym(SymType::SAdd, l, r));
-            result.emplace_back(state);
             break;
         }
         case InstrType::Sub: {
@@ -191,7 +226,6 @@ inline void symStep(SymState *state, Instr &instr,
             state->symbolic_stack.pop();
             state->pc++;
             state->symbolic_stack.push(Sym(SymType::SSub, l, r));
-            result.emplace_back(state);
             break;
         }
         case InstrType::Mul: {
@@ -201,7 +235,37 @@ inline void symStep(SymState *state, Instr &instr,
             state->symbolic_stack.pop();
             state->pc++;
             state->symbolic_stack.push(Sym(SymType::SMul, l, r));
-            result.emplace_back(state);
+            break;
+        }
+        case InstrType::BitAnd:
+        case InstrType::BitOr:
+        case InstrType::BitXor:
+        case InstrType::Shl:
+        case InstrType::Shr: {
+            Sym *r = state->symbolic_stack.back();
+            state->symbolic_stack.pop();
+            Sym *l = state->symbolic_stack.back();
+            state->symbolic_stack.pop();
+            state->pc++;
+            SymType symtype;
+            switch (instr.instr) {
+                case InstrType::BitAnd:
+                    symtype = SymType::SBitAnd;
+                    break;
+                case InstrType::BitOr:
+                    symtype = SymType::SBitOr;
+                    break;
+                case InstrType::BitXor:
+                    symtype = SymType::SBitXor;
+                    break;
+                case InstrType::Shl:
+                    symtype = SymType::SShl;
+                    break;
+                default:
+                    symtype = SymType::SShr;
+                    break;
+            }
+            state->symbolic_stack.push(Sym(symtype, l, r));
             break;
         }
         case InstrType::And: {
@@ -211,7 +275,6 @@ inline void symStep(SymState *state, Instr &instr,
             state->symbolic_stack.pop();
             state->pc++;
             state->symbolic_stack.push(Sym(SymType::SAnd, l, r));
-            result.emplace_back(state);
             break;
         }
         case InstrType::Or: {
@@ -221,7 +284,6 @@ inline void symStep(SymState *state, Instr &instr,
             state->symbolic_stack.pop();
             state->pc++;
             state->symbolic_stack.push(Sym(SymType::SOr, l, r));
-            result.emplace_back(state);
             break;
         }
         case InstrType::Lt: {
@@ -231,7 +293,6 @@ inline void symStep(SymState *state, Instr &instr,
             state->symbolic_stack.pop();
             state->pc++;
             state->symbolic_stack.push(Sym(SymType::SLt, l, r));
-            result.emplace_back(state);
             break;
         }
         case InstrType::Le: {
@@ -241,7 +302,6 @@ inline void symStep(SymState *state, Instr &instr,
             state->symbolic_stack.pop();
             state->pc++;
             state->symbolic_stack.push(Sym(SymType::SLe, l, r));
-            result.emplace_back(state);
             break;
         }
         case InstrType::Eq: {
@@ -251,7 +311,6 @@ inline void symStep(SymState *state, Instr &instr,
             state->symbolic_stack.pop();
             state->pc++;
             state->symbolic_stack.push(Sym(SymType::SEq, l, r));
-            result.emplace_back(state);
             break;
         }
         case InstrType::Swap: {
@@ -262,79 +321,34 @@ inline void symStep(SymState *state, Instr &instr,
             state->pc++;
             state->symbolic_stack.push(*x);
             state->symbolic_stack.push(*y);
-            result.emplace_back(state);
             break;
         }
         case InstrType::Store: {
             Sym *addr = state->symbolic_stack.back();
             state->symbolic_stack.pop();
-            Sym *w = state->symbolic_stack.back();
+            int a = (addr->symtype == SymType::SCon) ? wordToInt(addr->word)
+                                                     : addr->var_idx;
+            state->store(a, state->symbolic_stack.back());
             state->symbolic_stack.pop();
-            if (w->symtype == SymType::SCon) {
-                if (state->mem.find(wordToInt(addr->var_idx)) ==
-                    state->mem.end()) {
-                    state->mem.emplace(wordToInt(addr->var_idx), w->word);
-                } else {
-                    state->mem.at(wordToInt(addr->var_idx)) = w->word;
-                }
-            } else if ((w->symtype == SymType::SAny) &&
-                       (state->mem.find(wordToInt(w->var_idx)) !=
-                        state->mem.end())) {
-                if (state->mem.find(wordToInt(addr->var_idx)) ==
-                    state->mem.end()) {
-                    state->mem.emplace(wordToInt(addr->var_idx),
-                                       state->mem[wordToInt(w->var_idx)]);
-                } else {
-                    state->mem.at(wordToInt(addr->var_idx)) =
-                        state->mem[wordToInt(w->var_idx)];
-                }
-            } else {
-                if (state->smem.find(wordToInt(addr->var_idx)) ==
-                    state->smem.end()) {
-                    if (state->smem.find(wordToInt(w->var_idx)) ==
-                        state->smem.end()) {
-                        state->smem.emplace(wordToInt(addr->var_idx), *w);
-                    } else {
-                        state->smem.emplace(wordToInt(addr->var_idx),
-                                            state->smem[wordToInt(w->var_idx)]);
-                    }
-                } else {
-                    if (state->smem.find(wordToInt(w->var_idx)) ==
-                        state->smem.end()) {
-                        state->smem.at(wordToInt(addr->var_idx)) = *w;
-                    } else {
-                        state->smem.at(wordToInt(addr->var_idx)) =
-                            state->smem[wordToInt(w->var_idx)];
-                    }
-                }
-            }
             state->pc++;
-            result.emplace_back(state);
             break;
         }
         case InstrType::Load: {
             Sym *addr = state->symbolic_stack.back();
             state->symbolic_stack.pop();
-            if (state->smem.find(wordToInt(addr->word)) != state->smem.end()) {
-                state->symbolic_stack.push(state->smem[wordToInt(addr->word)]);
-            } else {
-                state->symbolic_stack.push(Sym(SymType::SAny, addr->word));
-            }
+            state->symbolic_stack.push(state->load(wordToInt(addr->word)));
             state->pc++;
-            result.emplace_back(state);
             break;
         }
         case InstrType::Read: {
             state->symbolic_stack.push(Sym(SymType::SAny, state->var_cnt));
             state->pc++;
             state->var_cnt++;
-            result.emplace_back(state);
             break;
         }
         case InstrType::Push: {
             state->symbolic_stack.push(Sym(SymType::SCon, instr.word));
             state->pc++;
-            result.emplace_back(state);
             break;
         }
         case InstrType::Dup: {
@@ -343,42 +357,183 @@ inline void symStep(SymState *state, Instr &instr,
             state->pc++;
             state->symbolic_stack.push(*w);
             state->symbolic_stack.push(*w);
-            result.emplace_back(state);
             break;
         }
         case InstrType::Pop: {
             state->symbolic_stack.pop();
             state->pc++;
+            break;
+        }
+        case InstrType::Jmp: {
+            Sym *addr = state->symbolic_stack.back();
+            state->symbolic_stack.pop();
+            int offset = wordToInt(addr->word);
+            if (offset < 0) {
+                // a backward jump closes an iteration of a loop. The counts of
+                // the loops nested inside it are reset.
+                state->loop_counts.erase(
+                    state->loop_counts.lower_bound(state->pc + offset),
+                    state->loop_counts.lower_bound(state->pc));
+                state->loop_counts[state->pc]++;
+            }
+            state->pc += offset;
+            break;
+        }
+        case InstrType::Nop: {
+            state->pc++;
+            break;
+        }
+        case InstrType::Enter: {
+            state->pc++;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Symbolically Execute a Single Instruction of a Program.
+ *
+ * This function symbolically executes a single instruction of a program and
+ * generates new symbolic states, representing possible outcomes of the
+ * instruction's execution.
+ *
+ * @param state The state of the program before the instruction is executed.
+ * @param instr The instruction to be executed.
+ * @param result A list of new symbolic states, each representing a possible
+ * outcome.
+ * @param eps The margin of the strict inequalities, with which a concrete loop
+ * condition is evaluated consistently with the solver.
+ */
+inline void symStep(SymState *state, Instr &instr,
+                    std::vector<SymState *> &result, float eps) {
+    // SymState state = state;
+
+    if (is_straight_line(instr)) {
+        symStepStraight(state, instr);
+        result.emplace_back(state);
+        return;
+    }
+
+    switch (instr.instr) {
+        case InstrType::Div:
+        case InstrType::Mod: {
+            // a concrete zero divisor makes the path infeasible, and a
+            // symbolic divisor is guarded to be non-zero.
+            Sym *r = state->symbolic_stack.back()->psimplify({});
+            state->symbolic_stack.pop();
+            Sym *l = state->symbolic_stack.back();
+            state->symbolic_stack.pop();
+            if (r->symtype == SymType::SCon) {
+                if (wordToFloat(r->word) == 0.0f) {
+                    break;
+                }
+            } else {
+                state->path_constraints.emplace_back(
+                    *Sym(SymType::SNot,
+                         new Sym(SymType::SEq, r,
+                                 new Sym(SymType::SCon, FloatToWord(0))))
+                         .normalize());
+            }
+            state->pc++;
+            SymType symtype = (instr.instr == InstrType::Div) ? SymType::SDiv
+                                                               : SymType::SMod;
+            state->symbolic_stack.push(Sym(symtype, l, r, instr.word, 0));
             result.emplace_back(state);
             break;
         }
         case InstrType::JmpIf: {
-            Sym *cond = state->symbolic_stack.back()->psimplify(state->mem);
+            // the path constraints are kept in the normal form; the memory is
+            // not substituted, as the loads are already eager (see
+            // SymState::load)
+            Sym *cond =
+                state->symbolic_stack.back()->psimplify({})->normalize();
             state->symbolic_stack.pop();
             Sym *addr = state->symbolic_stack.back();
             state->symbolic_stack.pop();
             if (addr->symtype == SymType::SCon) {
+                std::unordered_set<int> unique_var_ids;
+                if (instr.word == JMPIF_LOOP) {
+                    cond->gather_var_ids(unique_var_ids);
+                }
+                if (instr.word == JMPIF_LOOP && unique_var_ids.size() == 0) {
+                    // the condition of a loop is concrete, so that only the
+                    // feasible branch is taken without a path constraint.
+                    if (cond->eval({}, eps) <= 0.0f) {
+                        state->pc += wordToInt(addr->word - 2);
+                    } else {
+                        state->pc++;
+                    }
+                    result.emplace_back(state);
+                    break;
+                }
                 SymState *true_state = state->copy();
                 SymState *false_state = state->copy();
                 true_state->pc += wordToInt(addr->word - 2);
                 true_state->path_constraints.emplace_back(*cond);
                 false_state->pc++;
-                false_state->path_constraints.emplace_back(
-                    Sym(SymType::SNot, cond));
+                false_state->path_constraints.emplace_back(*cond->negate());
                 result.emplace_back(true_state);
                 result.emplace_back(false_state);
             }
             break;
         }
-        case InstrType::Jmp: {
-            Sym *addr = state->symbolic_stack.back();
+        case InstrType::Index: {
+            // the address of the element is pushed; a symbolic index is split
+            // into the cases of the elements, and out-of-bounds indices are
+            // infeasible.
+            Sym *idx = state->symbolic_stack.back()->psimplify({});
+            state->symbolic_stack.pop();
+            Sym *base = state->symbolic_stack.back();
             state->symbolic_stack.pop();
-            state->pc += wordToInt(addr->word);
+            int n = wordToInt(instr.word);
+            if (idx->symtype == SymType::SCon) {
+                float k = wordToFloat(idx->word);
+                if (is_integer(k) && 0 <= k && k < n) {
+                    state->symbolic_stack.push(
+                        Sym(SymType::SCon, base->word + (int)k));
+                    state->pc++;
+                    result.emplace_back(state);
+                }
+                break;
+            }
+            for (int k = 0; k < n; k++) {
+                SymState *elem_state = state->copy();
+                elem_state->path_constraints.emplace_back(
+                    *Sym(SymType::SEq, idx,
+                         new Sym(SymType::SCon, FloatToWord(k)))
+                         .normalize());
+                elem_state->symbolic_stack.push(
+                    Sym(SymType::SCon, base->word + k));
+                elem_state->pc++;
+                result.emplace_back(elem_state);
+            }
+            break;
+        }
+        case InstrType::Call: {
+            // the callee starts with an empty memory, since the variables of
+            // a function are local to it.
+            state->call_stack.push_back(
+                Frame{state->pc + 1, state->mem, state->smem});
+            state->mem.clear();
+            state->smem.clear();
+            state->pc = wordToInt(instr.word);
             result.emplace_back(state);
             break;
         }
-        case InstrType::Nop: {
-            state->pc++;
+        case InstrType::Ret: {
+            if (state->call_stack.size() == 0) {
+                break;
+            }
+            Sym *w = state->symbolic_stack.back()->psimplify({});
+            state->symbolic_stack.pop();
+            Frame &frame = state->call_stack.back();
+            state->pc = frame.ret_pc;
+            state->mem = frame.mem;
+            state->smem = frame.smem;
+            state->call_stack.pop_back();
+            state->symbolic_stack.push(*w);
             result.emplace_back(state);
             break;
         }
@@ -408,6 +563,40 @@ struct BaseExecutor {
                          ///< assignment for each term.
     bool return_trace;   ///< If set to true, save the trace at each pc and
                          ///< return them.
+    int max_unroll = 64;  ///< The maximum number of iterations of each loop
+                          ///< to explore (negative for no limit).
+    std::unordered_map<int, int>
+        unroll_bounds;  ///< The maximum number of iterations of specific
+                        ///< loops, keyed by the pc of their backward jump.
+    bool use_intervals = false;  ///< If set to true, decide path constraints
+                                 ///< with interval reasoning when possible.
+    bool use_bitblast = true;  ///< If set to true, decide path constraints
+                               ///< over integer variables by bit-blasting.
+    bool use_portfolio = false;  ///< If set to true, race several solver
+                                 ///< configurations on separate threads.
+    bool use_block_summaries = true;  ///< If set to true, apply the cached
+                                      ///< summary of each basic block
+                                      ///< instead of executing it.
+    std::unordered_map<int, BlockSummary>
+        block_summaries;  ///< Summaries of the basic blocks, keyed by their
+                          ///< first pc.
+    int run_depth = 0;  ///< Number of nested calls of `run` in progress.
+
+    /**
+     * @brief Guard of a call of `run`, which clears the caches keyed by pc
+     * when the top-level call starts, since the executor may be reused on
+     * another program.
+     */
+    struct RunGuard {
+        BaseExecutor &executor;  ///< The executor.
+
+        RunGuard(BaseExecutor &executor) : executor(executor) {
+            if (executor.run_depth++ == 0) {
+                executor.clear_program_caches();
+            }
+        }
+        ~RunGuard() { executor.run_depth--; }
+    };
 
     /**
      * @brief Constructor for BaseExecutor.
@@ -439,11 +628,138 @@ struct BaseExecutor {
           verbose_level(verbose_level),
           return_trace(return_trace){};
 
+    /**
+     * @brief Checks whether a state stays within the unrolling bound of the
+     * loop closed by the backward jump at the pc.
+     *
+     * @param pc The pc of the executed instruction.
+     * @param prog The program.
+     * @param state The state after executing the instruction.
+     * @return False if the instruction is a backward jump and the loop has
+     * been iterated more than its bound.
+     */
+    bool within_unroll_bound(int pc, Prog &prog, SymState &state) {
+        if (prog[pc].instr != InstrType::Jmp || state.pc > pc) {
+            return true;
+        }
+        auto itr = unroll_bounds.find(pc);
+        int bound = (itr == unroll_bounds.end()) ? max_unroll : itr->second;
+        return bound < 0 || state.loop_counts[pc] <= bound;
+    }
+
+    /**
+     * @brief Applies the summary of the basic block starting at the pc of a
+     * state, which is computed and cached on the first visit.
+     *
+     * The block is executed instruction by instruction instead if the
+     * summary is invalid, if the block is longer than the remaining depth,
+     * if its path constraints have to be solved in the middle of the block,
+     * or if the verbose output shows the intermediate states.
+     *
+     * @param prog The program.
+     * @param target_pcs The set of pc where path constraints are solved.
+     * @param state The state, which is updated.
+     * @param maxDepth The remaining depth, which is decreased by the length of
+     * the block.
+     * @return True if the summary is applied.
+     */
+    bool apply_block_summary(Prog &prog, std::unordered_set<int> &target_pcs,
+                             SymState &state, int &maxDepth) {
+        int pc = state.pc;
+        if (verbose_level >= 2) {
+            return false;
+        }
+        auto itr = block_summaries.find(pc);
+        if (itr == block_summaries.end()) {
+            itr = block_summaries.emplace(pc, summarize_block(prog, pc)).first;
+        }
+        const BlockSummary &summary = itr->second;
+        int len = summary.end_pc - pc;
+        if (!summary.valid || len < 2 || len > maxDepth) {
+            return false;
+        }
+        if (state.path_constraints.size() != 0) {
+            for (int q = pc + 1; q < summary.end_pc; q++) {
+                if (is_target_pc(target_pcs, q)) {
+                    return false;
+                }
+            }
+        }
+        for (int q = pc; q < summary.end_pc; q++) {
+            verbose_pre(verbose_level, q, prog, state);
+        }
+        apply_block(summary, state);
+        maxDepth -= len;
+        return true;
+    }
+
+    /**
+     * @brief Executes straight-line instructions in place until the state
+     * reaches a fork, a target pc where its path constraints are solved, or
+     * the end of the budget, so that `run` regains control only there
+     * instead of recursing for each instruction.
+     *
+     * @param prog The program.
+     * @param target_pcs The set of pc where path constraints are solved.
+     * @param state The state, which is updated.
+     * @param maxDepth The remaining depth, which is decreased by the number
+     * of executed instructions.
+     * @return False if the path exceeds the unrolling bound of a loop.
+     */
+    bool run_straight_line(Prog &prog, std::unordered_set<int> &target_pcs,
+                           SymState &state, int &maxDepth) {
+        while (explore_further(maxDepth, maxSAT, maxUNSAT)) {
+            int pc = state.pc;
+            if (!is_straight_line(prog[pc]) ||
+                (state.path_constraints.size() != 0 &&
+                 is_target_pc(target_pcs, pc))) {
+                break;
+            }
+            if (use_block_summaries &&
+                apply_block_summary(prog, target_pcs, state, maxDepth)) {
+                continue;
+            }
+            verbose_pre(verbose_level, pc, prog, state);
+            verbose_post(verbose_level);
+            symStepStraight(&state, prog[pc]);
+            maxDepth--;
+            if (!within_unroll_bound(pc, prog, state)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Clears the caches that are only valid for the program being
+     * explored.
+     */
+    virtual void clear_program_caches() { block_summaries.clear(); }
+
     virtual bool solve(bool is_target, int pc, SymState &state) = 0;
     virtual Trace run(Prog &prog, std::unordered_set<int> &target_pcs,
                       SymState &state, int maxDepth) = 0;
 };
 
+/**
+ * @brief Path of a function summarized as its path constraints and its
+ * return value, both of which are expressed in terms of the arguments.
+ */
+struct SummaryPath {
+    std::vector<Sym> path_constraints; /**< Path constraints of the path. */
+    Sym ret;                           /**< Return value of the path. */
+};
+
+/**
+ * @brief Returns the variable standing for the k-th argument of a function in
+ * its summary. The index is negative so as not to collide with the variables
+ * of the program.
+ *
+ * @param k The position of the argument.
+ * @return The index of the variable.
+ */
+inline int arg_var_idx(int k) { return -1 - k; }
+
 /**
  * @struct SExecutor
  * @brief Represents a derived class for symbolic execution engine for
@@ -452,9 +768,165 @@ struct BaseExecutor {
 struct SExecutor : public BaseExecutor {
     PathConstraintsTable
         constraints_cache;  ///< Cache for storing and reusing path constraints.
+    bool use_summaries = true;  ///< If set to true, each function is explored
+                                ///< once, and its summary is reused at calls.
+    std::unordered_map<int, std::vector<SummaryPath>>
+        summaries;  ///< Summaries of the functions, keyed by their entry pc.
+    std::unordered_set<int>
+        unsummarizable;  ///< Entry pcs of the (mutually) recursive functions
+                         ///< and of those exceeding the limits below, which
+                         ///< are executed inline.
+    size_t max_summary_paths = 1024;  ///< The maximum number of paths of a
+                                      ///< summary, including the pending ones.
+    int max_summary_steps = 65536;  ///< The maximum number of instructions
+                                    ///< executed to summarize a function.
+    std::vector<int> summarizing;  ///< Entry pcs of the functions whose
+                                   ///< summaries are being computed.
 
     using BaseExecutor::BaseExecutor;
 
+    /**
+     * @brief Clears the summaries of the blocks and of the functions, which
+     * are keyed by pc.
+     */
+    void clear_program_caches() {
+        BaseExecutor::clear_program_caches();
+        summaries.clear();
+        unsummarizable.clear();
+        summarizing.clear();
+    }
+
+    /**
+     * @brief Computes the summary of a function by exploring all of its paths
+     * from symbolic arguments, or returns the cached one.
+     *
+     * The paths are enumerated without solving their path constraints, except
+     * that the paths with a constant false constraint are dropped. The
+     * infeasible paths left are pruned at each call site, where the path
+     * constraints are solved together with those of the caller. The loops in
+     * the function are bounded by `max_unroll`. A function with more paths
+     * than `max_summary_paths`, or that takes more than `max_summary_steps`
+     * instructions to explore, is executed inline instead.
+     *
+     * @param prog The program.
+     * @param entry The entry pc of the function.
+     * @return The summary, or nullptr if the function is recursive or too
+     * large to summarize.
+     */
+    std::vector<SummaryPath> *summarize(Prog &prog, int entry) {
+        auto itr = summaries.find(entry);
+        if (itr != summaries.end()) {
+            return &itr->second;
+        }
+        if (unsummarizable.find(entry) != unsummarizable.end()) {
+            return nullptr;
+        }
+        if (std::find(summarizing.begin(), summarizing.end(), entry) !=
+            summarizing.end()) {
+            // recursion; all the functions on the cycle are executed inline
+            for (auto it = std::find(summarizing.begin(), summarizing.end(),
+                                     entry);
+                 it != summarizing.end(); it++) {
+                unsummarizable.emplace(*it);
+            }
+            return nullptr;
+        }
+        summarizing.emplace_back(entry);
+
+        SymState *init = new SymState();
+        init->pc = entry;
+        for (int k = 0; k < wordToInt(prog[entry].word); k++) {
+            init->symbolic_stack.push(Sym(SymType::SAny, arg_var_idx(k)));
+        }
+
+        std::vector<SummaryPath> paths;
+        std::vector<SymState *> stack = {init};
+        int num_steps = 0;
+        while (stack.size() != 0 &&
+               unsummarizable.find(entry) == unsummarizable.end()) {
+            if (paths.size() + stack.size() > max_summary_paths ||
+                num_steps++ >= max_summary_steps) {
+                unsummarizable.emplace(entry);
+                break;
+            }
+            SymState *state = stack.back();
+            stack.pop_back();
+            int pc = state->pc;
+            if (prog[pc].instr == InstrType::Ret &&
+                state->call_stack.size() == 0) {
+                paths.push_back(SummaryPath{
+                    state->path_constraints,
+                    *state->symbolic_stack.back()->psimplify({})});
+                continue;
+            }
+
+            size_t num_constraints = state->path_constraints.size();
+            std::vector<SymState *> newStates;
+            step(prog, state, newStates);
+            for (SymState *newState : newStates) {
+                if (!within_unroll_bound(pc, prog, *newState)) {
+                    continue;
+                }
+                if (newState->path_constraints.size() > num_constraints) {
+                    Sym &c = newState->path_constraints.back();
+                    std::unordered_set<int> unique_var_ids;
+                    c.gather_var_ids(unique_var_ids);
+                    if (unique_var_ids.size() == 0 &&
+                        c.eval({}, optimizer.eps) > 0.0f) {
+                        continue;
+                    }
+                }
+                stack.emplace_back(newState);
+            }
+        }
+
+        summarizing.pop_back();
+        if (unsummarizable.find(entry) != unsummarizable.end()) {
+            return nullptr;
+        }
+        summaries.emplace(entry, paths);
+        return &summaries[entry];
+    }
+
+    /**
+     * @brief Symbolically executes a single instruction like `symStep`, except
+     * that a call is replaced with the paths of the summary of the callee.
+     *
+     * @param prog The program.
+     * @param state The state of the program before the instruction is
+     * executed.
+     * @param result A list of new symbolic states.
+     */
+    void step(Prog &prog, SymState *state, std::vector<SymState *> &result) {
+        Instr &instr = prog[state->pc];
+        std::vector<SummaryPath> *paths = nullptr;
+        if (instr.instr == InstrType::Call && use_summaries) {
+            paths = summarize(prog, wordToInt(instr.word));
+        }
+        if (paths == nullptr) {
+            symStep(state, instr, result, optimizer.eps);
+            return;
+        }
+
+        int num_args = wordToInt(prog[wordToInt(instr.word)].word);
+        std::unordered_map<int, Sym *> args;
+        for (int k = num_args - 1; k >= 0; k--) {
+            args.emplace(arg_var_idx(k),
+                         state->symbolic_stack.back()->psimplify({}));
+            state->symbolic_stack.pop();
+        }
+        for (SummaryPath &path : *paths) {
+            SymState *newState = state->copy();
+            for (Sym &c : path.path_constraints) {
+                newState->path_constraints.emplace_back(
+                    *c.substitute(args)->psimplify({})->normalize());
+            }
+            newState->symbolic_stack.push(*path.ret.substitute(args));
+            newState->pc++;
+            result.emplace_back(newState);
+        }
+    }
+
     /**
      * @brief Solves path constraints and updates the cache.
      *
@@ -482,7 +954,8 @@ struct SExecutor : public BaseExecutor {
             is_unknown_path_constraint = false;
         } else {
             call_smt_solver(is_sat, state, params, optimizer, max_num_trials,
-                            ignore_memory, use_dpll);
+                            ignore_memory, use_dpll, use_intervals,
+                            use_bitblast, use_portfolio);
             if (is_sat) {
                 maxSAT--;
             } else {
@@ -518,6 +991,14 @@ struct SExecutor : public BaseExecutor {
      */
     Trace run(Prog &prog, std::unordered_set<int> &target_pcs, SymState &state,
               int maxDepth = 256) {
+        RunGuard guard(*this);
+        // the trace records a node per instruction, which the straight-line
+        // loop skips
+        if (!return_trace &&
+            !run_straight_line(prog, target_pcs, state, maxDepth)) {
+            return Trace(state, {});
+        }
+
         int pc = state.pc;
         bool is_target = is_target_pc(target_pcs, pc);
         bool is_sat = true;
@@ -532,11 +1013,13 @@ struct SExecutor : public BaseExecutor {
         if ((prog[pc].instr == InstrType::Done) || (!is_sat)) {
             return Trace(state, {});
         } else if (explore_further(maxDepth, maxSAT, maxUNSAT)) {
-            Instr instr = prog[pc];
             std::vector<SymState *> newStates;
-            symStep(&state, instr, newStates);
+            step(prog, &state, newStates);
             std::vector<Trace> children;
             for (SymState *newState : newStates) {
+                if (!within_unroll_bound(pc, prog, *newState)) {
+                    continue;
+                }
                 Trace child = run(prog, target_pcs, *newState, maxDepth - 1);
                 if (return_trace) {
                     children.push_back(child);
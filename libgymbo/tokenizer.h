@@ -14,8 +14,10 @@
 
 #include <cstdlib>
 #include <cstring>
+#include <stdexcept>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 
 namespace gymbo {
 
@@ -37,36 +39,48 @@ inline bool is_alpha(char c) {
 inline bool is_alnum(char c) { return is_alpha(c) || ('0' <= c && c <= '9'); }
 
 /**
- * @brief Reports an error and exits the program.
+ * @brief Exception raised when the input cannot be tokenized, parsed or
+ * compiled.
+ */
+struct ParseError : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+/**
+ * @brief Reports an error by throwing ParseError.
  * @param fmt The format string for the error message.
  * @param ... Additional arguments for the format string.
+ * @throws ParseError with the formatted message.
  */
 inline void error(char *fmt, ...) {
+    char buf[1024];
     va_list ap;
     va_start(ap, fmt);
-    vfprintf(stderr, fmt, ap);
-    fprintf(stderr, "\n");
-    exit(1);
+    vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    throw ParseError(buf);
 }
 
 /**
- * @brief Reports an error location and exits the program.
+ * @brief Reports an error location by throwing ParseError.
  * @param user_input The input string.
  * @param loc The location of the error.
  * @param fmt The format string for the error message.
  * @param ... Additional arguments for the format string.
+ * @throws ParseError with the input, a caret under the location and the
+ * formatted message.
  */
 inline void error_at(char *user_input, char *loc, char *fmt, ...) {
+    char buf[1024];
     va_list ap;
     va_start(ap, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
 
     int pos = loc - user_input;
-    fprintf(stderr, "%s\n", user_input);
-    fprintf(stderr, "%*s", pos, "");  // print pos spaces.
-    fprintf(stderr, "^ ");
-    vfprintf(stderr, fmt, ap);
-    fprintf(stderr, "\n");
-    exit(1);
+    std::string msg(user_input);
+    msg += "\n" + std::string(pos, ' ') + "^ " + buf;
+    throw ParseError(msg);
 }
 
 /**
@@ -78,6 +92,9 @@ typedef enum {
     TOKEN_IF,        ///< Token representing the 'if' keyword
     TOKEN_ELSE,      ///< Token representing the 'else' keyword
     TOKEN_FOR,       ///< Token representing the 'for' keyword
+    TOKEN_WHILE,     ///< Token representing the 'while' keyword
+    TOKEN_DEF,       ///< Token representing the 'def' keyword
+    TOKEN_INT,       ///< Token representing the 'int' keyword
     TOKEN_IDENT,     ///< Token representing an identifier
     TOKEN_NUM,       ///< Token representing integer literals
     TOKEN_EOF,       ///< Token representing end-of-file markers
@@ -93,6 +110,9 @@ struct Token {
     char *str;       ///< Token string
     int len;         ///< Token length
     int var_id;      ///< Variable ID
+    int num_elems;   ///< If the identifier is an array, its number of elements
+    bool is_int;     ///< If the token is an integer literal or a variable
+                     ///< declared with `int`
 };
 
 /**
@@ -222,16 +242,28 @@ inline bool startswith(char *p, char *q) {
 inline Token *tokenize(char *user_input,
                        std::unordered_map<std::string, int> &var_counter) {
     char *p = user_input;
-    Token head;
+    Token head = {};
     head.next = NULL;
     Token *cur = &head;
 
+    // The variables in a function `def f(a) {...}` are local to the function
+    // and named `f::a`.
+    std::string scope = "";
+    int depth = 0;
+    // The elements of an array `int a[n]` have consecutive variable IDs
+    // starting from that of `a`.
+    std::unordered_map<std::string, int> arrays;
+    // The variables declared with `int` (scalars or arrays) are integers.
+    std::unordered_set<std::string> ints;
+
     char LETTER_EQ[] = "==";
     char LETTER_NEQ[] = "!=";
     char LETTER_LEQ[] = "<=";
     char LETTER_GEQ[] = ">=";
     char LETTER_AND[] = "&&";
     char LETTER_OR[] = "||";
+    char LETTER_SHL[] = "<<";
+    char LETTER_SHR[] = ">>";
 
     while (*p) {
         // Skip whitespace characters.
@@ -243,7 +275,8 @@ inline Token *tokenize(char *user_input,
         // Multi-letter punctuator
         if (startswith(p, LETTER_EQ) || startswith(p, LETTER_NEQ) ||
             startswith(p, LETTER_LEQ) || startswith(p, LETTER_GEQ) ||
-            startswith(p, LETTER_AND) || startswith(p, LETTER_OR)) {
+            startswith(p, LETTER_AND) || startswith(p, LETTER_OR) ||
+            startswith(p, LETTER_SHL) || startswith(p, LETTER_SHR)) {
             cur = new_token(TOKEN_RESERVED, cur, p, 2);
             p += 2;
             continue;
@@ -261,6 +294,30 @@ inline Token *tokenize(char *user_input,
             continue;
         }
 
+        if (strncmp(p, "for", 3) == 0 && !is_alnum(p[3])) {
+            cur = new_token(TOKEN_FOR, cur, p, 3);
+            p += 3;
+            continue;
+        }
+
+        if (strncmp(p, "while", 5) == 0 && !is_alnum(p[5])) {
+            cur = new_token(TOKEN_WHILE, cur, p, 5);
+            p += 5;
+            continue;
+        }
+
+        if (strncmp(p, "def", 3) == 0 && !is_alnum(p[3])) {
+            cur = new_token(TOKEN_DEF, cur, p, 3);
+            p += 3;
+            continue;
+        }
+
+        if (strncmp(p, "int", 3) == 0 && !is_alnum(p[3])) {
+            cur = new_token(TOKEN_INT, cur, p, 3);
+            p += 3;
+            continue;
+        }
+
         if (strncmp(p, "return", 6) == 0 && !is_alnum(p[6])) {
             cur = new_token(TOKEN_RETURN, cur, p, 6);
             p += 6;
@@ -268,7 +325,12 @@ inline Token *tokenize(char *user_input,
         }
 
         // Single-letter punctuator
-        if (strchr("+-*/()<>=;{}", *p)) {
+        if (strchr("+-*/%()<>=;{}~,[]&|^", *p)) {
+            if (*p == '{') {
+                depth++;
+            } else if (*p == '}' && --depth == 0) {
+                scope = "";
+            }
             cur = new_token(TOKEN_RESERVED, cur, p++, 1);
             continue;
         }
@@ -279,6 +341,12 @@ inline Token *tokenize(char *user_input,
             char *q = p;
             cur->val = strtof(p, &p);
             cur->len = p - q;
+            cur->is_int = true;
+            for (char *c = q; c < p; c++) {
+                if (*c == '.' || *c == 'e' || *c == 'E') {
+                    cur->is_int = false;
+                }
+            }
             continue;
         }
 
@@ -287,17 +355,56 @@ inline Token *tokenize(char *user_input,
             char *q = p;
             while (is_alnum(*p)) p++;
 
+            // The name of a function or a distribution (e.g., `f(x)` or
+            // `x ~ bernoulli(0.3)`) is not a variable.
+            char *r = p;
+            while (isspace(*r)) r++;
+            bool is_func_name = *r == '(';
+
             char var_name[(p - q) + 1];
             strncpy(var_name, q, (p - q));
             var_name[p - q] = '\0';
-            std::string var_name_s(var_name);
+            std::string var_name_s = scope + std::string(var_name);
 
-            if (var_counter.find(var_name_s) == var_counter.end()) {
+            if (cur->kind == TOKEN_DEF && depth == 0) {
+                scope = std::string(var_name) + "::";
+            }
+
+            bool is_new_var =
+                var_counter.find(var_name_s) == var_counter.end();
+            if (!is_func_name && is_new_var) {
                 var_counter.emplace(var_name_s, (int)var_counter.size());
             }
 
+            if (cur->kind == TOKEN_INT) {
+                if (!is_new_var) {
+                    char em[] = "variable must be declared before its use";
+                    error_at(user_input, q, em);
+                }
+                ints.emplace(var_name_s);
+            }
+
+            // Declaration of an array `int a[n]` reserves the IDs of its
+            // elements, which are named `a[1]`, ..., `a[n - 1]`.
+            if (cur->kind == TOKEN_INT && *r == '[') {
+                int n = strtol(r + 1, NULL, 10);
+                if (n <= 0) {
+                    char em[] = "invalid array size";
+                    error_at(user_input, r, em);
+                }
+                arrays[var_name_s] = n;
+                for (int k = 1; k < n; k++) {
+                    var_counter.emplace(
+                        var_name_s + "[" + std::to_string(k) + "]",
+                        (int)var_counter.size());
+                }
+            }
+
             cur = new_token(TOKEN_IDENT, cur, q, p - q);
-            cur->var_id = var_counter[var_name_s];
+            cur->var_id = is_func_name ? -1 : var_counter[var_name_s];
+            auto itr = arrays.find(var_name_s);
+            cur->num_elems = (itr == arrays.end()) ? 0 : itr->second;
+            cur->is_int = ints.find(var_name_s) != ints.end();
 
             continue;
         }
@@ -5,10 +5,15 @@
  */
 
 #pragma once
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <random>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
 
+#include "dist.h"
 #include "utils.h"
 
 namespace gymbo {
@@ -45,8 +50,31 @@ enum class InstrType {
     RotL,
     Done,
     Nop,
+    Call,
+    Enter,
+    Ret,
+    Index,
+    Div,
+    Mod,
+    BitAnd,
+    BitOr,
+    BitXor,
+    Shl,
+    Shr,
 };
 
+/**
+ * @brief Word of a `JmpIf` instruction marking the condition of a loop, whose
+ * branch is taken directly when the condition is concrete.
+ */
+const Word32 JMPIF_LOOP = 1;
+
+/**
+ * @brief Word of a `Div` instruction (and of its `SDiv` expression) marking
+ * the division of integers, whose quotient is truncated toward zero.
+ */
+const Word32 DIV_TRUNC = 1;
+
 /**
  * @brief Class representing an instruction.
  */
@@ -59,7 +87,7 @@ class Instr {
      * @brief Constructor for an instruction without additional data.
      * @param instr The type of the instruction.
      */
-    Instr(InstrType instr) : instr(instr) {}
+    Instr(InstrType instr) : instr(instr), word(0) {}
 
     /**
      * @brief Constructor for an instruction with additional data.
@@ -130,6 +158,39 @@ class Instr {
             case (InstrType::Push): {
                 return "push " + std::to_string(word);
             }
+            case (InstrType::Call): {
+                return "call " + std::to_string(word);
+            }
+            case (InstrType::Enter): {
+                return "enter " + std::to_string(word);
+            }
+            case (InstrType::Ret): {
+                return "return";
+            }
+            case (InstrType::Index): {
+                return "index " + std::to_string(word);
+            }
+            case (InstrType::Div): {
+                return (word == DIV_TRUNC) ? "idiv" : "div";
+            }
+            case (InstrType::Mod): {
+                return "mod";
+            }
+            case (InstrType::BitAnd): {
+                return "band";
+            }
+            case (InstrType::BitOr): {
+                return "bor";
+            }
+            case (InstrType::BitXor): {
+                return "bxor";
+            }
+            case (InstrType::Shl): {
+                return "shl";
+            }
+            case (InstrType::Shr): {
+                return "shr";
+            }
             default: {
                 return "unknown";
             }
@@ -256,20 +317,165 @@ enum class SymType {
     SAnd,
     SLt,
     SLe,
-    SAny
+    SAny,
+    SDiv,
+    SMod,
+    SBitAnd,
+    SBitOr,
+    SBitXor,
+    SShl,
+    SShr,
+    SLin
+};
+
+/**
+ * @brief Applies a bitwise operation to 32-bit two's complement integers.
+ *
+ * The operands are converted with `to_int32`, and the amount of a shift is
+ * taken modulo 32. The right shift is arithmetic.
+ *
+ * @param symtype The type of the operation (`SBitAnd`, `SBitOr`, `SBitXor`,
+ * `SShl`, or `SShr`).
+ * @param l The left operand.
+ * @param r The right operand.
+ * @return The result of the operation.
+ */
+inline float bitwise(SymType symtype, float l, float r) {
+    int32_t a = to_int32(l), b = to_int32(r);
+    switch (symtype) {
+        case (SymType::SBitAnd):
+            return static_cast<float>(a & b);
+        case (SymType::SBitOr):
+            return static_cast<float>(a | b);
+        case (SymType::SBitXor):
+            return static_cast<float>(a ^ b);
+        case (SymType::SShl):
+            return static_cast<float>(static_cast<int32_t>(
+                static_cast<uint32_t>(a) << (b & 31)));
+        case (SymType::SShr):
+            return static_cast<float>(a >> (b & 31));
+        default:
+            return 0.0f;
+    }
+}
+
+/**
+ * @brief Checks if the symbolic expression type is a bitwise operation.
+ * @param symtype The type of the symbolic expression.
+ * @return True if the type is `SBitAnd`, `SBitOr`, `SBitXor`, `SShl`, or
+ * `SShr`.
+ */
+inline bool is_bitwise(SymType symtype) {
+    return symtype == SymType::SBitAnd || symtype == SymType::SBitOr ||
+           symtype == SymType::SBitXor || symtype == SymType::SShl ||
+           symtype == SymType::SShr;
+}
+
+/**
+ * @brief Computes the smooth maximum `t * log(exp(l / t) + exp(r / t))`
+ * (log-sum-exp), which is at most `t * log(2)` above `max(l, r)`.
+ *
+ * @param l The left operand.
+ * @param r The right operand.
+ * @param t The positive temperature.
+ * @param wl Set to the derivative with respect to `l`, i.e., the softmax
+ * weight of `l`, whereas that of `r` is `1 - wl`.
+ * @return The smooth maximum.
+ */
+inline float smooth_max(float l, float r, float t, float &wl) {
+    float m = std::max(l, r);
+    float el = std::exp((l - m) / t), er = std::exp((r - m) / t);
+    wl = el / (el + er);
+    return m + t * std::log(el + er);
+}
+
+/**
+ * @brief Computes the smooth minimum `-smooth_max(-l, -r, t)`.
+ *
+ * @param l The left operand.
+ * @param r The right operand.
+ * @param t The positive temperature.
+ * @param wl Set to the derivative with respect to `l`.
+ * @return The smooth minimum.
+ */
+inline float smooth_min(float l, float r, float t, float &wl) {
+    return -smooth_max(-l, -r, t, wl);
+}
+
+/**
+ * @brief Computes the Huber loss of `d`, which is `|d|` outside `[-t, t]`
+ * and the parabola `d^2 / (2t) + t / 2` inside, so that the gradient does
+ * not jump at 0.
+ *
+ * @param d The difference.
+ * @param t The positive temperature.
+ * @param slope Set to the derivative with respect to `d`.
+ * @return The loss.
+ */
+inline float huber(float d, float t, float &slope) {
+    if (std::abs(d) >= t) {
+        slope = (d > 0.0f) ? 1.0f : -1.0f;
+        return std::abs(d);
+    }
+    slope = d / t;
+    return d * d / (2.0f * t) + t / 2.0f;
+}
+
+/**
+ * @brief Dense affine form `sum_i coefs[i] * var_{vars[i]} + offset` in at
+ * least two variables, which is the payload of an `SLin` expression.
+ */
+struct LinearForm {
+    std::vector<int> vars;     /**< The variables in the order of the terms. */
+    std::vector<float> coefs;  /**< The coefficient of each variable. */
+    float offset = 0.0f;       /**< The constant. */
+    Grad grad = Grad({});      /**< The gradient, which is constant. */
+
+    /**
+     * @brief Constructor for LinearForm.
+     * @param vars The variables in the order of the terms.
+     * @param coefs The coefficient of each variable.
+     * @param offset The constant.
+     */
+    LinearForm(const std::vector<int> &vars, const std::vector<float> &coefs,
+               float offset)
+        : vars(vars), coefs(coefs), offset(offset) {
+        for (size_t i = 0; i < vars.size(); i++) {
+            grad.val[vars[i]] += coefs[i];
+        }
+    }
+};
+
+struct Sym;
+
+/**
+ * @brief Strict weak ordering of expressions by their structure (see
+ * `Sym::compare`).
+ */
+struct SymLess {
+    bool operator()(const Sym *a, const Sym *b) const;
 };
 
+/**
+ * @brief Atoms of a linear form and their coefficients, in the structural
+ * order of the atoms.
+ */
+using LinearTerms = std::map<const Sym *, std::pair<Sym *, float>, SymLess>;
+
 /**
  * @brief Struct representing a symbolic expression.
  */
 struct Sym {
-    SymType symtype; /**< The type of the symbolic expression. */
-    Sym *left;       /**< Pointer to the left child of the expression. */
-    Sym *right;      /**< Pointer to the right child of the expression. */
-    Word32 word;     /**< Additional data associated with the expression. */
-    int var_idx; /**< Index of the variable associated with the expression. */
+    SymType symtype;      /**< The type of the symbolic expression. */
+    Sym *left = nullptr;  /**< Pointer to the left child of the expression. */
+    Sym *right = nullptr; /**< Pointer to the right child of the expression. */
+    Word32 word = 0;      /**< Additional data of the expression. */
+    int var_idx =
+        0; /**< Index of the variable associated with the expression. */
     std::unordered_map<int, float>
         assign; /** Map from var IDs to their assigned values */
+    const LinearForm *lin =
+        nullptr; /**< Coefficients of the expression of type `SLin`. */
 
     /**
      * @brief Default constructor for Sym.
@@ -316,7 +522,17 @@ struct Sym {
           word(word),
           var_idx(var_idx) {}
 
-    Sym *copy() { return new Sym(symtype, left, right, word, var_idx); }
+    /**
+     * @brief Constructor for an affine expression of type `SLin`.
+     * @param lin The coefficients of the expression.
+     */
+    Sym(const LinearForm *lin) : symtype(SymType::SLin), lin(lin) {}
+
+    Sym *copy() {
+        Sym *result = new Sym(symtype, left, right, word, var_idx);
+        result->lin = lin;
+        return result;
+    }
 
     /**
      * @brief Gathers variable indices from the symbolic expression.
@@ -334,7 +550,14 @@ struct Sym {
                 right->gather_var_ids(result);
                 return;
             }
-            case (SymType::SMul): {
+            case (SymType::SMul):
+            case (SymType::SDiv):
+            case (SymType::SMod):
+            case (SymType::SBitAnd):
+            case (SymType::SBitOr):
+            case (SymType::SBitXor):
+            case (SymType::SShl):
+            case (SymType::SShr): {
                 left->gather_var_ids(result);
                 right->gather_var_ids(result);
                 return;
@@ -343,6 +566,10 @@ struct Sym {
                 result.emplace(var_idx);
                 return;
             }
+            case (SymType::SLin): {
+                result.insert(lin->vars.begin(), lin->vars.end());
+                return;
+            }
             case (SymType::SEq): {
                 left->gather_var_ids(result);
                 right->gather_var_ids(result);
@@ -384,6 +611,123 @@ struct Sym {
         }
     }
 
+    /**
+     * @brief Computes the structural hash of the symbolic expression.
+     *
+     * Structurally identical expressions have the same hash regardless of
+     * where they are allocated.
+     *
+     * @return The structural hash.
+     */
+    size_t hash() const {
+        size_t h = std::hash<int>()(static_cast<int>(symtype));
+        switch (symtype) {
+            case (SymType::SCon): {
+                return hash_combine(h, word);
+            }
+            case (SymType::SAny): {
+                return hash_combine(h, var_idx);
+            }
+            case (SymType::SLin): {
+                for (size_t i = 0; i < lin->vars.size(); i++) {
+                    h = hash_combine(hash_combine(h, lin->vars[i]),
+                                     FloatToWord(lin->coefs[i]));
+                }
+                return hash_combine(h, FloatToWord(lin->offset));
+            }
+            case (SymType::SNot): {
+                return hash_combine(h, left->hash());
+            }
+            case (SymType::SDiv): {
+                h = hash_combine(hash_combine(h, word), left->hash());
+                return hash_combine(h, right->hash());
+            }
+            case (SymType::SCnt): {
+                // combine the assignments commutatively, since they are
+                // unordered
+                size_t ha = 0;
+                for (const auto &a : assign) {
+                    ha += hash_combine(a.first, FloatToWord(a.second));
+                }
+                return hash_combine(hash_combine(h, left->hash()), ha);
+            }
+            default: {
+                h = hash_combine(h, left->hash());
+                return hash_combine(h, right->hash());
+            }
+        }
+    }
+
+    /**
+     * @brief Compares two expressions by their structure.
+     *
+     * The order is total on structures: types first, then constants by
+     * their bit patterns, variables by their ids, and children from left to
+     * right. Two expressions compare equal exactly when they are
+     * structurally identical, so that distinct constants never collide as
+     * their printed forms may, e.g., `0.1234561` and `0.1234564`.
+     *
+     * @param a The first expression.
+     * @param b The second expression.
+     * @return A negative value, zero, or a positive value if `a` is
+     * smaller than, identical to, or larger than `b`.
+     */
+    static int compare(const Sym *a, const Sym *b) {
+        auto cmp = [](auto x, auto y) { return (x < y) ? -1 : (y < x); };
+        if (a == b) {
+            return 0;
+        }
+        if (a->symtype != b->symtype) {
+            return cmp(a->symtype, b->symtype);
+        }
+        switch (a->symtype) {
+            case (SymType::SCon): {
+                return cmp(a->word, b->word);
+            }
+            case (SymType::SAny): {
+                return cmp(a->var_idx, b->var_idx);
+            }
+            case (SymType::SLin): {
+                int c = cmp(a->lin->vars, b->lin->vars);
+                for (size_t i = 0; c == 0 && i < a->lin->coefs.size(); i++) {
+                    c = cmp(FloatToWord(a->lin->coefs[i]),
+                            FloatToWord(b->lin->coefs[i]));
+                }
+                return (c != 0) ? c
+                                : cmp(FloatToWord(a->lin->offset),
+                                      FloatToWord(b->lin->offset));
+            }
+            case (SymType::SNot): {
+                return compare(a->left, b->left);
+            }
+            case (SymType::SCnt): {
+                int c = compare(a->left, b->left);
+                if (c != 0) {
+                    return c;
+                }
+                std::map<int, Word32> x, y;
+                for (const auto &v : a->assign) {
+                    x.emplace(v.first, FloatToWord(v.second));
+                }
+                for (const auto &v : b->assign) {
+                    y.emplace(v.first, FloatToWord(v.second));
+                }
+                return cmp(x, y);
+            }
+            case (SymType::SDiv): {
+                int c = cmp(a->word, b->word);
+                if (c == 0) {
+                    c = compare(a->left, b->left);
+                }
+                return (c != 0) ? c : compare(a->right, b->right);
+            }
+            default: {
+                int c = compare(a->left, b->left);
+                return (c != 0) ? c : compare(a->right, b->right);
+            }
+        }
+    }
+
     /**
      * @brief Simplifies the symbolic expression by evaluating constant
      * subexpressions.
@@ -401,6 +745,26 @@ struct Sym {
                     return this;
                 }
             }
+            case (SymType::SLin): {
+                bool is_folded = false;
+                std::vector<int> vars;
+                std::vector<float> coefs;
+                float offset = 0.0f;
+                for (size_t i = 0; i < lin->vars.size(); i++) {
+                    auto itr = cvals.find(lin->vars[i]);
+                    if (itr == cvals.end()) {
+                        vars.emplace_back(lin->vars[i]);
+                        coefs.emplace_back(lin->coefs[i]);
+                    } else {
+                        offset += lin->coefs[i] * wordToFloat(itr->second);
+                        is_folded = true;
+                    }
+                }
+                if (!is_folded) {
+                    return this;
+                }
+                return make_linear(vars, coefs, offset + lin->offset);
+            }
             case (SymType::SAdd): {
                 if (left->symtype == SymType::SCon &&
                     right->symtype == SymType::SCon) {
@@ -458,6 +822,39 @@ struct Sym {
                     return new Sym(SymType::SMul, tmp_left, tmp_right);
                 }
             }
+            case (SymType::SDiv):
+            case (SymType::SMod): {
+                // a division by zero is left to the guard of the division
+                tmp_left = left->psimplify(cvals);
+                tmp_right = right->psimplify(cvals);
+                if (tmp_left->symtype == SymType::SCon &&
+                    tmp_right->symtype == SymType::SCon &&
+                    wordToFloat(tmp_right->word) != 0.0f) {
+                    float l = wordToFloat(tmp_left->word);
+                    float r = wordToFloat(tmp_right->word);
+                    return new Sym(SymType::SCon,
+                                   FloatToWord(symtype == SymType::SDiv
+                                                   ? divide(l, r, word)
+                                                   : std::fmod(l, r)));
+                }
+                return new Sym(symtype, tmp_left, tmp_right, word, 0);
+            }
+            case (SymType::SBitAnd):
+            case (SymType::SBitOr):
+            case (SymType::SBitXor):
+            case (SymType::SShl):
+            case (SymType::SShr): {
+                tmp_left = left->psimplify(cvals);
+                tmp_right = right->psimplify(cvals);
+                if (tmp_left->symtype == SymType::SCon &&
+                    tmp_right->symtype == SymType::SCon) {
+                    return new Sym(SymType::SCon,
+                                   FloatToWord(bitwise(
+                                       symtype, wordToFloat(tmp_left->word),
+                                       wordToFloat(tmp_right->word))));
+                }
+                return new Sym(symtype, tmp_left, tmp_right);
+            }
             case (SymType::SEq): {
                 return new Sym(SymType::SEq, left->psimplify(cvals),
                                right->psimplify(cvals));
@@ -491,214 +888,730 @@ struct Sym {
     }
 
     /**
-     * @brief Evaluates the symbolic expression given concrete variable values.
-     * @param cvals Map of variable indices to concrete values.
-     * @param eps The smallest positive value of the target type.
-     * @return Result of the symbolic expression evaluation.
+     * @brief Rewrites the symbolic expression into its normal form.
+     *
+     * Each arithmetic expression becomes a canonical linear form, i.e., the
+     * sum of `coef * atom` in the order of the atoms plus a constant, where an
+     * atom is a variable or a normalized non-linear term. Like terms are
+     * collected, so that `x - x` is 0 and `(a + 1) + 2` is `a + 3`. An
+     * equality becomes `linear form == constant` whose first coefficient is
+     * positive, and a negation is pushed into comparisons (`!(a < b)` is
+     * `b <= a`) and conjunctions by De Morgan's laws. The rewrites are
+     * equivalent over the reals. The sides of an inequality are not moved
+     * across it, since the bit-blaster compares them as `width`-bit integers
+     * in two's complement, where `a < b` and `a - b < 0` differ on overflow.
+     *
+     * @return The normalized expression.
      */
-    float eval(const std::unordered_map<int, float> &cvals,
-               const float eps) const {
+    Sym *normalize() {
         switch (symtype) {
-            case (SymType::SAdd): {
-                return left->eval(cvals, eps) + right->eval(cvals, eps);
-            }
-            case (SymType::SSub): {
-                return left->eval(cvals, eps) - right->eval(cvals, eps);
+            case (SymType::SCon):
+            case (SymType::SAny):
+            case (SymType::SLin): {
+                return this;
             }
+            case (SymType::SAdd):
+            case (SymType::SSub):
             case (SymType::SMul): {
-                return left->eval(cvals, eps) * right->eval(cvals, eps);
-            }
-            case (SymType::SCon): {
-                return wordToFloat(word);
+                LinearTerms terms;
+                float constant = 0.0f;
+                collect_linear(1.0f, terms, constant);
+                return build_linear(terms, constant);
             }
-            case (SymType::SCnt): {
-                switch (left->symtype) {
-                    case (SymType::SAdd): {
-                        return 1;
-                    }
-                    case (SymType::SSub): {
-                        return 1;
-                    }
-                    case (SymType::SMul): {
-                        return 1;
-                    }
-                    case (SymType::SCon): {
-                        return 1;
-                    }
-                    case (SymType::SCnt): {
-                        return 1;
-                    }
-                    case (SymType::SAny): {
-                        return 1;
+            case (SymType::SEq): {
+                LinearTerms terms;
+                float constant = 0.0f;
+                left->collect_linear(1.0f, terms, constant);
+                right->collect_linear(-1.0f, terms, constant);
+                for (auto itr = terms.begin(); itr != terms.end(); itr++) {
+                    if (itr->second.second == 0.0f) {
+                        continue;
                     }
-                    default: {
-                        std::unordered_map<int, float> nvals(cvals);
-                        for (const auto &a : assign) {
-                            nvals.emplace(a.first, a.second);
-                        }
-                        if (left->eval(nvals, eps) <= 0.0f) {
-                            return 1.0f;
-                        } else {
-                            return 0.0;
+                    if (itr->second.second < 0.0f) {
+                        // |-e| = |e|
+                        for (auto &t : terms) {
+                            t.second.second = -t.second.second;
                         }
+                        constant = -constant;
                     }
+                    break;
                 }
-            }
-            case (SymType::SAny): {
-                if (cvals.find(var_idx) != cvals.end()) {
-                    return cvals.at(var_idx);
-                } else {
-                    fprintf(stderr,
-                            "\x1b[33m Warning!! var_%d should be specified to "
-                            "correctly evaluate this "
-                            "symbolic expression\x1b[39m\n",
-                            var_idx);
-                    return 0;
-                }
-            }
-            case (SymType::SEq): {
-                return std::abs(left->eval(cvals, eps) -
-                                right->eval(cvals, eps));
+                return new Sym(SymType::SEq, build_linear(terms, 0.0f),
+                               new Sym(SymType::SCon,
+                                       FloatToWord(0.0f - constant)));
             }
             case (SymType::SNot): {
-                return left->eval(cvals, eps) * (-1.0f) + eps;
-            }
-            case (SymType::SAnd): {
-                return std::max(left->eval(cvals, eps),
-                                right->eval(cvals, eps));
-            }
-            case (SymType::SOr): {
-                return std::min(left->eval(cvals, eps),
-                                right->eval(cvals, eps));
-            }
-            case (SymType::SLt): {
-                return left->eval(cvals, eps) - right->eval(cvals, eps) + eps;
+                return left->normalize()->negate();
             }
+            case (SymType::SAnd):
+            case (SymType::SOr):
+            case (SymType::SLt):
             case (SymType::SLe): {
-                return left->eval(cvals, eps) - right->eval(cvals, eps);
+                return new Sym(symtype, left->normalize(), right->normalize());
+            }
+            case (SymType::SCnt): {
+                return new Sym(SymType::SCnt, left->normalize(), assign);
             }
             default: {
-                return 0.0f;
+                // the other operations are folded when their operands are
+                // constants
+                Sym *tmp = new Sym(symtype, left->normalize(),
+                                   right->normalize(), word, 0);
+                return tmp->psimplify({});
             }
         }
     }
 
     /**
-     * @brief Computes the gradient of the symbolic expression given concrete
-     * variable values.
-     * @param cvals Map of variable indices to concrete values.
-     * @param eps Small value to handle numerical instability.
-     * @return Gradient of the symbolic expression.
+     * @brief Returns the normalized negation of a normalized expression.
+     *
+     * Since `eval` of `!e` is `-eval(e) + eps`, the negation of `a < b` is
+     * exactly `b <= a`, and that of `a <= b` is `b < a`.
+     *
+     * @return The negated expression.
      */
-    Grad grad(const std::unordered_map<int, float> &cvals,
-              const float eps) const {
+    Sym *negate() {
         switch (symtype) {
-            case (SymType::SAdd): {
-                return left->grad(cvals, eps) + right->grad(cvals, eps);
-            }
-            case (SymType::SSub): {
-                return left->grad(cvals, eps) - right->grad(cvals, eps);
-            }
-            case (SymType::SMul): {
-                return left->grad(cvals, eps) * right->eval(cvals, eps) +
-                       right->grad(cvals, eps) * left->eval(cvals, eps);
-            }
-            case (SymType::SCon): {
-                return Grad({});
-            }
-            case (SymType::SCnt): {
-                switch (left->symtype) {
-                    case (SymType::SAdd): {
-                        return Grad({});
-                    }
-                    case (SymType::SSub): {
-                        return Grad({});
-                    }
-                    case (SymType::SMul): {
-                        return Grad({});
-                    }
-                    case (SymType::SCon): {
-                        return Grad({});
-                    }
-                    case (SymType::SCnt): {
-                        return Grad({});
-                    }
-                    case (SymType::SAny): {
-                        return Grad({});
-                    }
-                    default: {
-                        std::unordered_map<int, float> nvals(cvals);
-                        for (const auto &a : assign) {
-                            nvals.emplace(a.first, a.second);
-                        }
-                        if (left->eval(nvals, eps) <= 0.0f) {
-                            return left->grad(nvals, eps);
-                        } else {
-                            return left->grad(nvals, eps) * -1;
-                        }
-                    }
-                }
-            }
-            case (SymType::SAny): {
-                std::unordered_map<int, float> tmp = {{var_idx, 1.0f}};
-                return Grad(tmp);
+            case (SymType::SNot): {
+                return left;
             }
-            case (SymType::SEq): {
-                float lv = left->eval(cvals, eps);
-                float rv = right->eval(cvals, eps);
-                Grad lg = left->grad(cvals, eps);
-                Grad rg = right->grad(cvals, eps);
-                if (lv == rv) {
-                    return Grad({});
-                } else if (lv > rv) {
-                    return lg - rg;
-                } else {
-                    return rg - lg;
-                }
+            case (SymType::SLt): {
+                return new Sym(SymType::SLe, right, left);
             }
-            case (SymType::SNot): {
-                return left->grad(cvals, eps) * (-1.0f);
+            case (SymType::SLe): {
+                return new Sym(SymType::SLt, right, left);
             }
             case (SymType::SAnd): {
-                if (left->eval(cvals, eps) < right->eval(cvals, eps)) {
-                    return right->grad(cvals, eps);
-                } else {
-                    return left->grad(cvals, eps);
-                }
+                return new Sym(SymType::SOr, left->negate(), right->negate());
             }
             case (SymType::SOr): {
-                if (left->eval(cvals, eps) > right->eval(cvals, eps)) {
-                    return right->grad(cvals, eps);
-                } else {
-                    return left->grad(cvals, eps);
-                }
-            }
-            case (SymType::SLt): {
-                return left->grad(cvals, eps) - right->grad(cvals, eps);
-            }
-            case (SymType::SLe): {
-                return left->grad(cvals, eps) - right->grad(cvals, eps);
+                return new Sym(SymType::SAnd, left->negate(), right->negate());
             }
             default: {
-                return Grad({});
+                return new Sym(SymType::SNot, this);
             }
         }
     }
 
     /**
-     * @brief Converts the symbolic expression to a string representation.
-     * @param convert_to_num Whether to convert constants to numeric
-     * representations.
-     * @return String representation of the symbolic expression.
+     * @brief Adds `coef` times the symbolic expression to a linear form.
+     *
+     * A product is distributed only when one of its factors is constant, and
+     * the other terms are kept as normalized atoms.
+     *
+     * @param coef The coefficient of the expression.
+     * @param terms The atoms of the linear form and their coefficients, keyed
+     * by their structures.
+     * @param constant The constant of the linear form.
      */
-    std::string toString(bool convert_to_num) const {
-        std::string result = "";
-        float tmp_word;
-
+    void collect_linear(float coef,
+                        LinearTerms &terms,
+                        float &constant) {
         switch (symtype) {
-            case (SymType::SAdd): {
-                result = "(" + left->toString(convert_to_num) + "+" +
-                         right->toString(convert_to_num) + ")";
+            case (SymType::SCon): {
+                constant += coef * wordToFloat(word);
+                return;
+            }
+            case (SymType::SLin): {
+                for (size_t i = 0; i < lin->vars.size(); i++) {
+                    add_linear_atom(new Sym(SymType::SAny, lin->vars[i]),
+                                    coef * lin->coefs[i], terms);
+                }
+                constant += coef * lin->offset;
+                return;
+            }
+            case (SymType::SAdd): {
+                left->collect_linear(coef, terms, constant);
+                right->collect_linear(coef, terms, constant);
+                return;
+            }
+            case (SymType::SSub): {
+                left->collect_linear(coef, terms, constant);
+                right->collect_linear(-coef, terms, constant);
+                return;
+            }
+            case (SymType::SMul): {
+                Sym *l = left->normalize();
+                Sym *r = right->normalize();
+                if (l->symtype == SymType::SCon) {
+                    r->collect_linear(coef * wordToFloat(l->word), terms,
+                                      constant);
+                    return;
+                }
+                if (r->symtype == SymType::SCon) {
+                    l->collect_linear(coef * wordToFloat(r->word), terms,
+                                      constant);
+                    return;
+                }
+                // the factors of a product commute
+                if (compare(r, l) < 0) {
+                    std::swap(l, r);
+                }
+                add_linear_atom(new Sym(SymType::SMul, l, r), coef, terms);
+                return;
+            }
+            default: {
+                add_linear_atom(normalize(), coef, terms);
+                return;
+            }
+        }
+    }
+
+    /**
+     * @brief Builds the expression of an affine form in variables.
+     *
+     * @param vars The variables in the order of the terms.
+     * @param coefs The coefficient of each variable.
+     * @param offset The constant.
+     * @return An `SLin` expression if there are at least two variables, and
+     * the equivalent tree otherwise.
+     */
+    static Sym *make_linear(const std::vector<int> &vars,
+                            const std::vector<float> &coefs, float offset) {
+        if (vars.size() >= 2) {
+            return new Sym(new LinearForm(vars, coefs, offset));
+        }
+        LinearTerms terms;
+        if (vars.size() == 1) {
+            add_linear_atom(new Sym(SymType::SAny, vars[0]), coefs[0], terms);
+        }
+        return build_linear(terms, offset);
+    }
+
+    /**
+     * @brief Returns the tree of additions and multiplications equivalent to
+     * an `SLin` expression, which has the same string representation.
+     *
+     * @return The equivalent tree.
+     */
+    Sym *expand() const {
+        Sym *result = nullptr;
+        for (size_t i = 0; i < lin->vars.size(); i++) {
+            Sym *atom = new Sym(SymType::SAny, lin->vars[i]);
+            float c = lin->coefs[i];
+            float a = (result == nullptr) ? c : std::abs(c);
+            Sym *term = (a == 1.0f)
+                            ? atom
+                            : new Sym(SymType::SMul,
+                                      new Sym(SymType::SCon, FloatToWord(a)),
+                                      atom);
+            if (result == nullptr) {
+                result = term;
+            } else {
+                result = new Sym((c > 0.0f) ? SymType::SAdd : SymType::SSub,
+                                 result, term);
+            }
+        }
+        if (lin->offset > 0.0f) {
+            result = new Sym(SymType::SAdd, result,
+                             new Sym(SymType::SCon, FloatToWord(lin->offset)));
+        } else if (lin->offset < 0.0f) {
+            result =
+                new Sym(SymType::SSub, result,
+                        new Sym(SymType::SCon, FloatToWord(-lin->offset)));
+        }
+        return result;
+    }
+
+    /**
+     * @brief Adds `coef` times an atom to a linear form.
+     *
+     * @param atom The normalized atom.
+     * @param coef The coefficient of the atom.
+     * @param terms The atoms of the linear form and their coefficients.
+     */
+    static void add_linear_atom(
+        Sym *atom, float coef,
+        LinearTerms &terms) {
+        auto itr = terms.emplace(atom, std::make_pair(atom, 0.0f)).first;
+        itr->second.second += coef;
+    }
+
+    /**
+     * @brief Builds the expression of a linear form.
+     *
+     * @param terms The atoms of the linear form and their coefficients.
+     * @param constant The constant of the linear form.
+     * @return The sum of the terms in the order of the atoms followed by the
+     * constant.
+     */
+    static Sym *build_linear(
+        const LinearTerms &terms,
+        float constant) {
+        std::vector<int> vars;
+        std::vector<float> coefs;
+        for (auto &t : terms) {
+            if (t.second.second == 0.0f) {
+                continue;
+            }
+            if (t.second.first->symtype != SymType::SAny) {
+                vars.clear();
+                break;
+            }
+            vars.emplace_back(t.second.first->var_idx);
+            coefs.emplace_back(t.second.second);
+        }
+        if (vars.size() >= 2) {
+            return new Sym(new LinearForm(vars, coefs, constant));
+        }
+
+        Sym *result = nullptr;
+        for (auto &t : terms) {
+            Sym *atom = t.second.first;
+            float c = t.second.second;
+            if (c == 0.0f) {
+                continue;
+            }
+            if (result == nullptr) {
+                result = (c == 1.0f) ? atom
+                                     : new Sym(SymType::SMul,
+                                               new Sym(SymType::SCon,
+                                                       FloatToWord(c)),
+                                               atom);
+                continue;
+            }
+            float a = std::abs(c);
+            Sym *term = (a == 1.0f) ? atom
+                                    : new Sym(SymType::SMul,
+                                              new Sym(SymType::SCon,
+                                                      FloatToWord(a)),
+                                              atom);
+            result = new Sym((c > 0.0f) ? SymType::SAdd : SymType::SSub,
+                             result, term);
+        }
+        if (result == nullptr) {
+            return new Sym(SymType::SCon, FloatToWord(constant));
+        }
+        if (constant > 0.0f) {
+            result = new Sym(SymType::SAdd, result,
+                             new Sym(SymType::SCon, FloatToWord(constant)));
+        } else if (constant < 0.0f) {
+            result = new Sym(SymType::SSub, result,
+                             new Sym(SymType::SCon, FloatToWord(-constant)));
+        }
+        return result;
+    }
+
+    /**
+     * @brief Replaces variables with symbolic expressions.
+     * @param var2sym Map of variable indices to the expressions replacing
+     * them.
+     * @return The symbolic expression after the replacement.
+     */
+    Sym *substitute(const std::unordered_map<int, Sym *> &var2sym) {
+        switch (symtype) {
+            case (SymType::SCon): {
+                return this;
+            }
+            case (SymType::SAny): {
+                auto itr = var2sym.find(var_idx);
+                return (itr == var2sym.end()) ? this : itr->second;
+            }
+            case (SymType::SLin): {
+                for (int v : lin->vars) {
+                    if (var2sym.find(v) != var2sym.end()) {
+                        return expand()->substitute(var2sym);
+                    }
+                }
+                return this;
+            }
+            case (SymType::SNot): {
+                return new Sym(SymType::SNot, left->substitute(var2sym));
+            }
+            case (SymType::SCnt): {
+                return new Sym(SymType::SCnt, left->substitute(var2sym),
+                               assign);
+            }
+            case (SymType::SDiv): {
+                return new Sym(SymType::SDiv, left->substitute(var2sym),
+                               right->substitute(var2sym), word, 0);
+            }
+            default: {
+                return new Sym(symtype, left->substitute(var2sym),
+                               right->substitute(var2sym));
+            }
+        }
+    }
+
+    /**
+     * @brief Evaluates the symbolic expression given concrete variable values.
+     * @param cvals Map of variable indices to concrete values.
+     * @param eps The smallest positive value of the target type.
+     * @param overlay Optional map of additional variable values, which is
+     * looked up when a variable is not found in `cvals`.
+     * @param temperature If positive, `&&`, `||`, and `==` are evaluated with
+     * their smooth surrogates `smooth_max`, `smooth_min`, and `huber`, which
+     * tend to the exact losses as the temperature tends to 0.
+     * @return Result of the symbolic expression evaluation.
+     */
+    float eval(const std::unordered_map<int, float> &cvals, const float eps,
+               const std::unordered_map<int, float> *overlay = nullptr,
+               float temperature = 0.0f) const {
+        switch (symtype) {
+            case (SymType::SAdd): {
+                return left->eval(cvals, eps, overlay, temperature) +
+                       right->eval(cvals, eps, overlay, temperature);
+            }
+            case (SymType::SSub): {
+                return left->eval(cvals, eps, overlay, temperature) -
+                       right->eval(cvals, eps, overlay, temperature);
+            }
+            case (SymType::SMul): {
+                return left->eval(cvals, eps, overlay, temperature) *
+                       right->eval(cvals, eps, overlay, temperature);
+            }
+            case (SymType::SDiv): {
+                return divide(left->eval(cvals, eps, overlay, temperature),
+                              right->eval(cvals, eps, overlay, temperature),
+                              word);
+            }
+            case (SymType::SMod): {
+                return std::fmod(left->eval(cvals, eps, overlay, temperature),
+                                 right->eval(cvals, eps, overlay, temperature));
+            }
+            case (SymType::SBitAnd):
+            case (SymType::SBitOr):
+            case (SymType::SBitXor):
+            case (SymType::SShl):
+            case (SymType::SShr): {
+                return bitwise(symtype,
+                               left->eval(cvals, eps, overlay, temperature),
+                               right->eval(cvals, eps, overlay, temperature));
+            }
+            case (SymType::SCon): {
+                return wordToFloat(word);
+            }
+            case (SymType::SCnt): {
+                switch (left->symtype) {
+                    case (SymType::SDiv):
+                    case (SymType::SMod):
+                    case (SymType::SBitAnd):
+                    case (SymType::SBitOr):
+                    case (SymType::SBitXor):
+                    case (SymType::SShl):
+                    case (SymType::SShr):
+                    case (SymType::SAdd): {
+                        return 1;
+                    }
+                    case (SymType::SSub): {
+                        return 1;
+                    }
+                    case (SymType::SMul): {
+                        return 1;
+                    }
+                    case (SymType::SCon): {
+                        return 1;
+                    }
+                    case (SymType::SCnt): {
+                        return 1;
+                    }
+                    case (SymType::SAny):
+                    case (SymType::SLin): {
+                        return 1;
+                    }
+                    default: {
+                        float v;
+                        if (overlay == nullptr) {
+                            v = left->eval(cvals, eps, &assign);
+                        } else {
+                            std::unordered_map<int, float> nvals(*overlay);
+                            for (const auto &a : assign) {
+                                nvals.emplace(a.first, a.second);
+                            }
+                            v = left->eval(cvals, eps, &nvals);
+                        }
+                        if (v <= 0.0f) {
+                            return 1.0f;
+                        } else {
+                            return 0.0;
+                        }
+                    }
+                }
+            }
+            case (SymType::SAny): {
+                return lookup_var(var_idx, cvals, overlay);
+            }
+            case (SymType::SLin): {
+                // the terms are accumulated in the order of the equivalent
+                // tree, so that the result is the same
+                float result = lin->coefs[0] * lookup_var(lin->vars[0], cvals,
+                                                          overlay);
+                for (size_t i = 1; i < lin->vars.size(); i++) {
+                    result += lin->coefs[i] *
+                              lookup_var(lin->vars[i], cvals, overlay);
+                }
+                return result + lin->offset;
+            }
+            case (SymType::SEq): {
+                float d = left->eval(cvals, eps, overlay, temperature) -
+                          right->eval(cvals, eps, overlay, temperature);
+                if (temperature > 0.0f) {
+                    float slope;
+                    return huber(d, temperature, slope);
+                }
+                return std::abs(d);
+            }
+            case (SymType::SNot): {
+                return left->eval(cvals, eps, overlay, temperature) * (-1.0f) +
+                       eps;
+            }
+            case (SymType::SAnd): {
+                float l = left->eval(cvals, eps, overlay, temperature);
+                float r = right->eval(cvals, eps, overlay, temperature);
+                if (temperature > 0.0f) {
+                    float wl;
+                    return smooth_max(l, r, temperature, wl);
+                }
+                return std::max(l, r);
+            }
+            case (SymType::SOr): {
+                float l = left->eval(cvals, eps, overlay, temperature);
+                float r = right->eval(cvals, eps, overlay, temperature);
+                if (temperature > 0.0f) {
+                    float wl;
+                    return smooth_min(l, r, temperature, wl);
+                }
+                return std::min(l, r);
+            }
+            case (SymType::SLt): {
+                return left->eval(cvals, eps, overlay, temperature) -
+                       right->eval(cvals, eps, overlay, temperature) + eps;
+            }
+            case (SymType::SLe): {
+                return left->eval(cvals, eps, overlay, temperature) -
+                       right->eval(cvals, eps, overlay, temperature);
+            }
+            default: {
+                return 0.0f;
+            }
+        }
+    }
+
+    /**
+     * @brief Looks up the value of a variable.
+     * @param var_idx The index of the variable.
+     * @param cvals Map of variable indices to concrete values.
+     * @param overlay Optional map looked up when the variable is not found in
+     * `cvals`.
+     * @return The value of the variable, or 0 with a warning if it is unknown.
+     */
+    static float lookup_var(int var_idx,
+                            const std::unordered_map<int, float> &cvals,
+                            const std::unordered_map<int, float> *overlay) {
+        auto itr = cvals.find(var_idx);
+        if (itr != cvals.end()) {
+            return itr->second;
+        } else if (overlay != nullptr &&
+                   (itr = overlay->find(var_idx)) != overlay->end()) {
+            return itr->second;
+        } else {
+            fprintf(stderr,
+                    "\x1b[33m Warning!! var_%d should be specified to "
+                    "correctly evaluate this "
+                    "symbolic expression\x1b[39m\n",
+                    var_idx);
+            return 0;
+        }
+    }
+
+    /**
+     * @brief Computes the gradient of the symbolic expression given concrete
+     * variable values.
+     * @param cvals Map of variable indices to concrete values.
+     * @param eps Small value to handle numerical instability.
+     * @param overlay Optional map of additional variable values, which is
+     * looked up when a variable is not found in `cvals`.
+     * @param temperature If positive, the gradient of the smooth surrogate
+     * evaluated by `eval` with the same temperature, which propagates the
+     * gradients of both sides of `&&` and `||` weighted by their softmax.
+     * @return Gradient of the symbolic expression.
+     */
+    Grad grad(const std::unordered_map<int, float> &cvals, const float eps,
+              const std::unordered_map<int, float> *overlay = nullptr,
+              float temperature = 0.0f) const {
+        switch (symtype) {
+            case (SymType::SAdd): {
+                return left->grad(cvals, eps, overlay, temperature) +
+                       right->grad(cvals, eps, overlay, temperature);
+            }
+            case (SymType::SSub): {
+                return left->grad(cvals, eps, overlay, temperature) -
+                       right->grad(cvals, eps, overlay, temperature);
+            }
+            case (SymType::SMul): {
+                return left->grad(cvals, eps, overlay, temperature) *
+                           right->eval(cvals, eps, overlay, temperature) +
+                       right->grad(cvals, eps, overlay, temperature) *
+                           left->eval(cvals, eps, overlay, temperature);
+            }
+            case (SymType::SDiv): {
+                // the truncation is ignored, since its gradient is zero
+                // almost everywhere
+                float l = left->eval(cvals, eps, overlay, temperature);
+                float r = right->eval(cvals, eps, overlay, temperature);
+                return (left->grad(cvals, eps, overlay, temperature) * r -
+                        right->grad(cvals, eps, overlay, temperature) * l) *
+                       (1.0f / (r * r));
+            }
+            case (SymType::SMod): {
+                // l % r = l - r * trunc(l / r), whose quotient is piecewise
+                // constant
+                float q =
+                    std::trunc(left->eval(cvals, eps, overlay, temperature) /
+                               right->eval(cvals, eps, overlay, temperature));
+                return left->grad(cvals, eps, overlay, temperature) -
+                       right->grad(cvals, eps, overlay, temperature) * q;
+            }
+            case (SymType::SShl):
+            case (SymType::SShr): {
+                // a shift by a constant amount scales its operand, ignoring
+                // the wraparound and the rounding of the right shift
+                float scale = std::ldexp(
+                    1.0f,
+                    to_int32(right->eval(cvals, eps, overlay, temperature)) &
+                        31);
+                return left->grad(cvals, eps, overlay, temperature) *
+                       (symtype == SymType::SShl ? scale : 1.0f / scale);
+            }
+            case (SymType::SCon): {
+                return Grad({});
+            }
+            case (SymType::SCnt): {
+                switch (left->symtype) {
+                    case (SymType::SDiv):
+                    case (SymType::SMod):
+                    case (SymType::SBitAnd):
+                    case (SymType::SBitOr):
+                    case (SymType::SBitXor):
+                    case (SymType::SShl):
+                    case (SymType::SShr):
+                    case (SymType::SAdd): {
+                        return Grad({});
+                    }
+                    case (SymType::SSub): {
+                        return Grad({});
+                    }
+                    case (SymType::SMul): {
+                        return Grad({});
+                    }
+                    case (SymType::SCon): {
+                        return Grad({});
+                    }
+                    case (SymType::SCnt): {
+                        return Grad({});
+                    }
+                    case (SymType::SAny):
+                    case (SymType::SLin): {
+                        return Grad({});
+                    }
+                    default: {
+                        std::unordered_map<int, float> nvals;
+                        const std::unordered_map<int, float> *nov = &assign;
+                        if (overlay != nullptr) {
+                            nvals = *overlay;
+                            for (const auto &a : assign) {
+                                nvals.emplace(a.first, a.second);
+                            }
+                            nov = &nvals;
+                        }
+                        if (left->eval(cvals, eps, nov) <= 0.0f) {
+                            return left->grad(cvals, eps, nov);
+                        } else {
+                            return left->grad(cvals, eps, nov) * -1;
+                        }
+                    }
+                }
+            }
+            case (SymType::SAny): {
+                std::unordered_map<int, float> tmp = {{var_idx, 1.0f}};
+                return Grad(tmp);
+            }
+            case (SymType::SLin): {
+                return lin->grad;
+            }
+            case (SymType::SEq): {
+                float lv = left->eval(cvals, eps, overlay, temperature);
+                float rv = right->eval(cvals, eps, overlay, temperature);
+                Grad lg = left->grad(cvals, eps, overlay, temperature);
+                Grad rg = right->grad(cvals, eps, overlay, temperature);
+                if (temperature > 0.0f) {
+                    float slope;
+                    huber(lv - rv, temperature, slope);
+                    return (lg - rg) * slope;
+                }
+                if (lv == rv) {
+                    return Grad({});
+                } else if (lv > rv) {
+                    return lg - rg;
+                } else {
+                    return rg - lg;
+                }
+            }
+            case (SymType::SNot): {
+                return left->grad(cvals, eps, overlay, temperature) * (-1.0f);
+            }
+            case (SymType::SAnd): {
+                if (temperature > 0.0f) {
+                    float wl;
+                    smooth_max(left->eval(cvals, eps, overlay, temperature),
+                               right->eval(cvals, eps, overlay, temperature),
+                               temperature, wl);
+                    return left->grad(cvals, eps, overlay, temperature) * wl +
+                           right->grad(cvals, eps, overlay, temperature) *
+                               (1.0f - wl);
+                }
+                if (left->eval(cvals, eps, overlay, temperature) <
+                    right->eval(cvals, eps, overlay, temperature)) {
+                    return right->grad(cvals, eps, overlay, temperature);
+                } else {
+                    return left->grad(cvals, eps, overlay, temperature);
+                }
+            }
+            case (SymType::SOr): {
+                if (temperature > 0.0f) {
+                    float wl;
+                    smooth_min(left->eval(cvals, eps, overlay, temperature),
+                               right->eval(cvals, eps, overlay, temperature),
+                               temperature, wl);
+                    return left->grad(cvals, eps, overlay, temperature) * wl +
+                           right->grad(cvals, eps, overlay, temperature) *
+                               (1.0f - wl);
+                }
+                if (left->eval(cvals, eps, overlay, temperature) >
+                    right->eval(cvals, eps, overlay, temperature)) {
+                    return right->grad(cvals, eps, overlay, temperature);
+                } else {
+                    return left->grad(cvals, eps, overlay, temperature);
+                }
+            }
+            case (SymType::SLt): {
+                return left->grad(cvals, eps, overlay, temperature) -
+                       right->grad(cvals, eps, overlay, temperature);
+            }
+            case (SymType::SLe): {
+                return left->grad(cvals, eps, overlay, temperature) -
+                       right->grad(cvals, eps, overlay, temperature);
+            }
+            default: {
+                return Grad({});
+            }
+        }
+    }
+
+    /**
+     * @brief Converts the symbolic expression to a string representation.
+     * @param convert_to_num Whether to convert constants to numeric
+     * representations.
+     * @return String representation of the symbolic expression.
+     */
+    std::string toString(bool convert_to_num) const {
+        std::string result = "";
+        float tmp_word;
+
+        switch (symtype) {
+            case (SymType::SAdd): {
+                result = "(" + left->toString(convert_to_num) + "+" +
+                         right->toString(convert_to_num) + ")";
                 break;
             }
             case (SymType::SSub): {
@@ -711,6 +1624,43 @@ struct Sym {
                          right->toString(convert_to_num) + ")";
                 break;
             }
+            case (SymType::SDiv): {
+                // `//` denotes the integer division truncating the quotient
+                result = "(" + left->toString(convert_to_num) +
+                         (word == DIV_TRUNC ? "//" : "/") +
+                         right->toString(convert_to_num) + ")";
+                break;
+            }
+            case (SymType::SMod): {
+                result = "(" + left->toString(convert_to_num) + "%" +
+                         right->toString(convert_to_num) + ")";
+                break;
+            }
+            case (SymType::SBitAnd): {
+                result = "(" + left->toString(convert_to_num) + "&" +
+                         right->toString(convert_to_num) + ")";
+                break;
+            }
+            case (SymType::SBitOr): {
+                result = "(" + left->toString(convert_to_num) + "|" +
+                         right->toString(convert_to_num) + ")";
+                break;
+            }
+            case (SymType::SBitXor): {
+                result = "(" + left->toString(convert_to_num) + "^" +
+                         right->toString(convert_to_num) + ")";
+                break;
+            }
+            case (SymType::SShl): {
+                result = "(" + left->toString(convert_to_num) + "<<" +
+                         right->toString(convert_to_num) + ")";
+                break;
+            }
+            case (SymType::SShr): {
+                result = "(" + left->toString(convert_to_num) + ">>" +
+                         right->toString(convert_to_num) + ")";
+                break;
+            }
             case (SymType::SCon): {
                 if (convert_to_num) {
                     tmp_word = wordToFloat(word);
@@ -746,6 +1696,10 @@ struct Sym {
                 result += "var_" + std::to_string(var_idx);
                 break;
             }
+            case (SymType::SLin): {
+                result += expand()->toString(convert_to_num);
+                break;
+            }
             case (SymType::SEq): {
                 result += "(" + left->toString(convert_to_num) +
                           "==" + right->toString(convert_to_num) + ")";
@@ -780,94 +1734,728 @@ struct Sym {
     }
 };
 
+inline bool SymLess::operator()(const Sym *a, const Sym *b) const {
+    return Sym::compare(a, b) < 0;
+}
+
 /**
- * @struct DiscreteDist
- * @brief Represents a discrete probability distribution.
+ * @brief Alias for symbolic memory, represented as an unordered map of symbolic
+ * expressions.
  */
-struct DiscreteDist {
-    std::vector<int> vals;    /**< Vector to store possible discrete values. */
-    std::vector<float> probs; /** Probability of each value */
+using SMem = std::unordered_map<Word32, Sym>;
 
-    /**
-     * @brief Default constructor for DiscreteDist.
-     */
-    DiscreteDist() {}
-};
+/**
+ * @brief Splits a symbolic condition into its top-level conjuncts.
+ *
+ * @param cond Pointer to the symbolic condition.
+ * @param conjuncts Vector to store the conjuncts.
+ */
+inline void split_conjuncts(Sym *cond, std::vector<Sym *> &conjuncts) {
+    if (cond->symtype == SymType::SAnd) {
+        split_conjuncts(cond->left, conjuncts);
+        split_conjuncts(cond->right, conjuncts);
+    } else {
+        conjuncts.emplace_back(cond);
+    }
+}
+
+/**
+ * @brief Checks if the indicator of the symbolic expression is always one.
+ *
+ * Following the semantics of `SCnt`, arithmetic expressions are not treated
+ * as conditions, and their indicator is always one.
+ *
+ * @param sym Pointer to the symbolic expression.
+ * @return True if the indicator of the expression is constantly one.
+ */
+inline bool is_trivial_indicator(const Sym *sym) {
+    switch (sym->symtype) {
+        case (SymType::SAdd):
+        case (SymType::SSub):
+        case (SymType::SMul):
+        case (SymType::SDiv):
+        case (SymType::SMod):
+        case (SymType::SBitAnd):
+        case (SymType::SBitOr):
+        case (SymType::SBitXor):
+        case (SymType::SShl):
+        case (SymType::SShr):
+        case (SymType::SCon):
+        case (SymType::SCnt):
+        case (SymType::SAny):
+        case (SymType::SLin): {
+            return true;
+        }
+        default: {
+            return false;
+        }
+    }
+}
 
 /**
- * @struct DiscreteUniformDist
- * @brief Represents a discrete uniform distribution derived from
- * DiscreteDist.
+ * @brief Weighted Model Counter over Finite Discrete Random Variables
+ *
+ * The `WeightedModelCounter` computes the probability that a symbolic
+ * condition holds, that is, the total weight of the assignments of the random
+ * variables satisfying it. It follows the component-caching approach of
+ * modern #SAT solvers:
+ *
+ * - Random variables not mentioned in the condition are summed out.
+ * - Conjuncts are split into independent components sharing no unassigned
+ *   random variable, and the weights of the components are multiplied.
+ * - A small component is enumerated directly. Otherwise, the counter branches
+ *   on the variable appearing in the most conjuncts, drops the conjuncts that
+ *   become true, prunes the branch as soon as a conjunct becomes false, and
+ *   decomposes the rest again.
+ * - The weight of each component is cached, keyed by the set of its
+ *   conjuncts and the values of the assigned variables they mention.
  */
-struct DiscreteUniformDist : public DiscreteDist {
-    int low;  /**< The lower bound of the uniform distribution. */
-    int high; /**< The upper bound of the uniform distribution. */
+struct WeightedModelCounter {
+    float eps;  ///< Epsilon value for numerical stability.
+    std::unordered_map<int, DiscreteDist>
+        &var2dist;  ///< Map of variable index to DiscreteDist.
+    std::unordered_map<int, float>
+        nvals;  ///< Parameters and the current partial assignment.
+    std::unordered_set<int> assigned;  ///< IDs of assigned random variables.
+    std::unordered_map<int, float>
+        var2mass;  ///< Total probability of each random variable.
+    std::unordered_map<Sym *, std::vector<int>>
+        conj2vars;  ///< Random variables (not fixed) of each conjunct.
+    std::map<std::pair<std::vector<Sym *>, std::vector<std::pair<int, Word32>>>,
+             float>
+        cache;  ///< Weights of components keyed by their sorted conjuncts and
+                ///< the sorted values of their assigned variables.
+    int max_enum_size;  ///< Components with at most this many assignments
+                        ///< are enumerated without branching.
+
+    /**
+     * @brief Constructor for WeightedModelCounter.
+     *
+     * @param params Map of variable index to parameter values. Random
+     * variables contained in this map are treated as fixed.
+     * @param eps Epsilon value for numerical stability.
+     * @param var2dist Map of variable index to DiscreteDist.
+     * @param max_enum_size Components with at most this many assignments are
+     * enumerated without branching (default 256).
+     */
+    WeightedModelCounter(const std::unordered_map<int, float> &params,
+                         float eps,
+                         std::unordered_map<int, DiscreteDist> &var2dist,
+                         int max_enum_size = 256)
+        : eps(eps),
+          var2dist(var2dist),
+          nvals(params),
+          max_enum_size(max_enum_size) {
+        for (auto &vd : var2dist) {
+            var2mass.emplace(vd.first, vd.second.mass());
+        }
+    }
+
+    /**
+     * @brief Computes the probability that the symbolic condition holds.
+     *
+     * @param cond Pointer to the symbolic condition.
+     * @return The probability that the condition holds (unnormalized if the
+     * probabilities of some distribution do not sum up to one).
+     */
+    float count(Sym *cond) {
+        float mass = 1.0f;
+        if (is_trivial_indicator(cond)) {
+            for (auto &vm : var2mass) {
+                mass *= vm.second;
+            }
+            return mass;
+        }
+
+        std::vector<Sym *> conjuncts, random_conjuncts;
+        split_conjuncts(cond, conjuncts);
+
+        std::unordered_set<int> mentioned;
+        for (Sym *c : conjuncts) {
+            std::unordered_set<int> unique_var_ids;
+            c->gather_var_ids(unique_var_ids);
+            std::vector<int> vars;
+            for (int v : unique_var_ids) {
+                if (var2dist.find(v) != var2dist.end() &&
+                    nvals.find(v) == nvals.end()) {
+                    vars.emplace_back(v);
+                    mentioned.emplace(v);
+                }
+            }
+
+            if (vars.size() == 0) {
+                // the conjunct does not depend on any random variable
+                if (c->eval(nvals, eps) > 0.0f) {
+                    return 0.0f;
+                }
+                continue;
+            }
+            conj2vars[c] = vars;
+            random_conjuncts.emplace_back(c);
+        }
+
+        // sum out the random variables that do not appear in the condition
+        for (auto &vm : var2mass) {
+            if (mentioned.find(vm.first) == mentioned.end()) {
+                mass *= vm.second;
+            }
+        }
+
+        return mass * count_conjuncts(random_conjuncts);
+    }
+
+    /**
+     * @brief Computes the total weight of the assignments of the unassigned
+     * variables mentioned in the conjuncts that satisfy all of them.
+     *
+     * @param conjuncts Conjuncts, each of which has unassigned variables.
+     * @return The total weight.
+     */
+    float count_conjuncts(std::vector<Sym *> &conjuncts) {
+        // union-find over the unassigned variables of the same conjunct
+        std::unordered_map<int, int> parent;
+        auto find = [&](int v) {
+            while (parent[v] != v) {
+                parent[v] = parent[parent[v]];
+                v = parent[v];
+            }
+            return v;
+        };
+
+        for (Sym *c : conjuncts) {
+            int root = -1;
+            for (int v : conj2vars[c]) {
+                if (assigned.find(v) != assigned.end()) {
+                    continue;
+                }
+                if (parent.find(v) == parent.end()) {
+                    parent.emplace(v, v);
+                }
+                if (root == -1) {
+                    root = find(v);
+                } else {
+                    int b = find(v);
+                    if (root != b) {
+                        parent[b] = root;
+                    }
+                }
+            }
+        }
+
+        std::unordered_map<int, std::vector<int>> comp2vars;
+        std::unordered_map<int, std::vector<Sym *>> comp2conjuncts;
+        for (auto &pv : parent) {
+            comp2vars[find(pv.first)].emplace_back(pv.first);
+        }
+        for (Sym *c : conjuncts) {
+            for (int v : conj2vars[c]) {
+                if (assigned.find(v) == assigned.end()) {
+                    comp2conjuncts[find(v)].emplace_back(c);
+                    break;
+                }
+            }
+        }
+
+        float weight = 1.0f;
+        for (auto &cv : comp2vars) {
+            weight *= count_component(comp2conjuncts[cv.first], cv.second);
+            if (weight == 0.0f) {
+                return 0.0f;
+            }
+        }
+        return weight;
+    }
+
+    /**
+     * @brief Computes the total weight of a connected component.
+     *
+     * @param conjuncts Conjuncts of the component.
+     * @param vars Unassigned variables of the component.
+     * @return The total weight of the satisfying assignments of `vars`.
+     */
+    float count_component(std::vector<Sym *> &conjuncts,
+                          std::vector<int> &vars) {
+        // the conjuncts are compared by their identities, which are unique
+        // within the condition being counted
+        std::pair<std::vector<Sym *>, std::vector<std::pair<int, Word32>>> key;
+        key.first = conjuncts;
+        std::sort(key.first.begin(), key.first.end());
+        for (Sym *c : conjuncts) {
+            for (int v : conj2vars[c]) {
+                if (assigned.find(v) != assigned.end()) {
+                    key.second.emplace_back(v, FloatToWord(nvals[v]));
+                }
+            }
+        }
+        std::sort(key.second.begin(), key.second.end());
+        key.second.erase(std::unique(key.second.begin(), key.second.end()),
+                         key.second.end());
+        auto itr = cache.find(key);
+        if (itr != cache.end()) {
+            return itr->second;
+        }
+
+        long long enum_size = 1;
+        for (int v : vars) {
+            enum_size *= var2dist[v].vals.size();
+            if (enum_size > max_enum_size) {
+                break;
+            }
+        }
+
+        float weight;
+        if (enum_size <= max_enum_size) {
+            weight = enumerate(conjuncts, vars);
+        } else {
+            weight = branch(conjuncts, vars);
+        }
+        cache.emplace(key, weight);
+        return weight;
+    }
 
     /**
-     * @brief Constructor for DiscreteUniformDist.
-     * @param low The lower bound of the uniform distribution.
-     * @param high The upper bound of the uniform distribution.
-     * @details Initializes the distribution by populating vals with values from
-     * low to high (inclusive).
+     * @brief Enumerates all the assignments of the variables with an odometer,
+     * while only updating the digits that changed at each step.
+     *
+     * @param conjuncts Conjuncts of the component.
+     * @param vars Unassigned variables of the component.
+     * @return The total weight of the satisfying assignments of `vars`.
      */
-    DiscreteUniformDist(int low, int high) : low(low), high(high) {
-        float p = 1.0f / (1.0f + (float)high - (float)low);
-        for (int i = low; i <= high; i++) {
-            vals.emplace_back(i);
-            probs.emplace_back(p);
+    float enumerate(std::vector<Sym *> &conjuncts, std::vector<int> &vars) {
+        int n = vars.size();
+        std::vector<DiscreteDist *> dists(n);
+        std::vector<int> radices(n);
+        for (int j = 0; j < n; j++) {
+            dists[j] = &var2dist[vars[j]];
+            radices[j] = dists[j]->vals.size();
+        }
+        MixedRadixCounter counter(radices);
+        if (!counter.valid()) {
+            return 0.0f;
+        }
+
+        // suffix[j] is the product of the probabilities of digits j..n-1
+        std::vector<float> suffix(n + 1, 1.0f);
+        int num_changed = n;
+        float weight = 0.0f;
+        do {
+            for (int j = num_changed - 1; j >= 0; j--) {
+                nvals[vars[j]] = dists[j]->vals[counter.digits[j]];
+                suffix[j] = suffix[j + 1] * dists[j]->probs[counter.digits[j]];
+            }
+            bool is_sat = true;
+            for (Sym *c : conjuncts) {
+                if (c->eval(nvals, eps) > 0.0f) {
+                    is_sat = false;
+                    break;
+                }
+            }
+            if (is_sat) {
+                weight += suffix[0];
+            }
+            num_changed = counter.next();
+        } while (num_changed != 0);
+
+        for (int v : vars) {
+            nvals.erase(v);
         }
+        return weight;
+    }
+
+    /**
+     * @brief Branches on the variable appearing in the most conjuncts.
+     *
+     * @param conjuncts Conjuncts of the component.
+     * @param vars Unassigned variables of the component.
+     * @return The total weight of the satisfying assignments of `vars`.
+     */
+    float branch(std::vector<Sym *> &conjuncts, std::vector<int> &vars) {
+        std::unordered_map<int, int> occurrences;
+        int x = vars[0];
+        for (Sym *c : conjuncts) {
+            for (int v : conj2vars[c]) {
+                if (assigned.find(v) == assigned.end() &&
+                    ++occurrences[v] > occurrences[x]) {
+                    x = v;
+                }
+            }
+        }
+
+        DiscreteDist &dist = var2dist[x];
+        assigned.emplace(x);
+        float weight = 0.0f;
+        for (size_t k = 0; k < dist.vals.size(); k++) {
+            if (dist.probs[k] == 0.0f) {
+                continue;
+            }
+            nvals[x] = dist.vals[k];
+
+            bool is_pruned = false;
+            std::vector<Sym *> rest;
+            for (Sym *c : conjuncts) {
+                bool is_closed = true;
+                for (int v : conj2vars[c]) {
+                    if (assigned.find(v) == assigned.end()) {
+                        is_closed = false;
+                        break;
+                    }
+                }
+                if (!is_closed) {
+                    rest.emplace_back(c);
+                } else if (c->eval(nvals, eps) > 0.0f) {
+                    is_pruned = true;
+                    break;
+                }
+            }
+            if (is_pruned) {
+                continue;
+            }
+
+            // every other variable of the component still appears in a
+            // conjunct of `rest`, and is summed out by `count_conjuncts`
+            float w = dist.probs[k];
+            if (rest.size() != 0) {
+                w *= count_conjuncts(rest);
+            }
+            weight += w;
+        }
+        assigned.erase(x);
+        nvals.erase(x);
+        return weight;
     }
 };
 
 /**
- * @struct BernoulliDist
- * @brief Represents a bernoulli distribution derived from
- * DiscreteDist.
+ * @brief Computes the probability that the symbolic condition holds.
+ *
+ * Instead of enumerating the Cartesian product of all random variables, this
+ * function exploits the dependency structure of the condition with
+ * `WeightedModelCounter`.
+ *
+ * @param cond Pointer to the symbolic condition.
+ * @param params Map of variable index to parameter values. Random variables
+ * contained in this map are treated as fixed.
+ * @param eps Epsilon value for numerical stability.
+ * @param var2dist Map of variable index to DiscreteDist.
+ * @return The probability that the condition holds (unnormalized if the
+ * probabilities of some distribution do not sum up to one).
  */
-struct BernoulliDist : public DiscreteDist {
-    float p /** The probability of occurrance */;
+inline float factorized_prob(Sym *cond,
+                             const std::unordered_map<int, float> &params,
+                             float eps,
+                             std::unordered_map<int, DiscreteDist> &var2dist) {
+    WeightedModelCounter counter(params, eps, var2dist);
+    return counter.count(cond);
+}
 
-    BernoulliDist(float p) : p(p) {
-        vals = {0, 1};
-        probs = {1 - p, p};
+/**
+ * @brief Computes the signature of the distributions of random variables.
+ *
+ * @param var2dist Map of variable index to DiscreteDist.
+ * @return The hash value representing the distributions.
+ */
+inline size_t dist_signature(
+    const std::unordered_map<int, DiscreteDist> &var2dist) {
+    size_t sig = 0;
+    for (const auto &vd : var2dist) {
+        size_t h = std::hash<int>()(vd.first);
+        for (size_t k = 0; k < vd.second.vals.size(); k++) {
+            h = hash_combine(h, vd.second.vals[k]);
+            h = hash_combine(h, FloatToWord(vd.second.probs[k]));
+        }
+        // the iteration order of unordered_map is unspecified
+        sig += h;
     }
+    return sig;
+}
+
+/**
+ * @brief Struct representing a probability estimated by sampling.
+ */
+struct ProbEstimate {
+    float prob;       /**< Point estimate of the probability. */
+    float lower;      /**< Lower bound of the confidence interval. */
+    float upper;      /**< Upper bound of the confidence interval. */
+    int num_samples;  /**< Number of drawn samples. */
+
+    /**
+     * @brief Constructor for ProbEstimate.
+     * @param prob Point estimate of the probability.
+     * @param lower Lower bound of the confidence interval.
+     * @param upper Upper bound of the confidence interval.
+     * @param num_samples Number of drawn samples.
+     */
+    ProbEstimate(float prob, float lower, float upper, int num_samples)
+        : prob(prob), lower(lower), upper(upper), num_samples(num_samples) {}
 };
 
 /**
- * @struct BinomialDist
- * @brief Represents a binomial distribution derived from
- * DiscreteDist.
+ * @brief Estimates the conditional probability of `numerator` given
+ * `denominator` by (importance) sampling.
+ *
+ * Samples of the random variables are drawn column by column in batches, and
+ * the self-normalized ratio `sum(w * [n]) / sum(w * [d])` is computed, where
+ * `w` is the importance weight (one for plain Monte Carlo). The sampling stops
+ * as soon as the half width of the confidence interval falls below
+ * `precision` or `max_samples` samples have been drawn. The numerator is
+ * assumed to imply the denominator, which holds for the probabilities built by
+ * `pbranch`.
+ *
+ * @param numerator Pointer to the symbolic condition of the numerator.
+ * @param denominator Pointer to the symbolic condition of the denominator.
+ * @param params Map of variable index to parameter values.
+ * @param eps Epsilon value for numerical stability.
+ * @param var2dist Map of variable index to DiscreteDist.
+ * @param precision Target half width of the confidence interval.
+ * @param z Quantile of the standard normal distribution for the confidence
+ * level (1.96 for 95%).
+ * @param max_samples Maximum number of samples.
+ * @param batch_size Number of samples drawn at once.
+ * @param seed Random seed.
+ * @param importance_sampling If true, draw each random variable uniformly from
+ * its support and reweight the samples, which helps when the condition
+ * depends on values with small probabilities.
+ * @return The estimated probability with its confidence interval.
  */
-struct BinomialDist : public DiscreteDist {
-    int n;   /** The number of trial */
-    float p; /** The probability of occurrance */
+inline ProbEstimate sampled_prob(
+    Sym *numerator, Sym *denominator,
+    const std::unordered_map<int, float> &params, float eps,
+    std::unordered_map<int, DiscreteDist> &var2dist, float precision = 0.01f,
+    float z = 1.96f, int max_samples = 1 << 20, int batch_size = 1024,
+    int seed = 42, bool importance_sampling = false) {
+    std::unordered_set<int> unique_var_ids;
+    numerator->gather_var_ids(unique_var_ids);
+    denominator->gather_var_ids(unique_var_ids);
+
+    std::vector<int> vars;
+    std::vector<DiscreteDist *> dists;
+    std::vector<std::vector<float>> cdfs;
+    for (int v : unique_var_ids) {
+        if (var2dist.find(v) != var2dist.end() &&
+            params.find(v) == params.end()) {
+            DiscreteDist *dist = &var2dist[v];
+            if (importance_sampling) {
+                std::vector<float> cdf(dist->probs.size());
+                for (size_t k = 0; k < cdf.size(); k++) {
+                    cdf[k] = (float)(k + 1);
+                }
+                cdfs.emplace_back(cdf);
+            } else {
+                if (dist->cdf.size() != dist->probs.size()) {
+                    dist->finalize();
+                }
+                cdfs.emplace_back(dist->cdf);
+            }
+            vars.emplace_back(v);
+            dists.emplace_back(dist);
+        }
+    }
 
-    BinomialDist(int n, float p) : n(n), p(p) {
-        std::vector<std::vector<long long>> v(n + 1,
-                                              std::vector<long long>(n + 1, 0));
-        for (int i = 0; i < v.size(); i++) {
-            v[i][0] = 1;
-            v[i][i] = 1;
+    bool trivial_n = is_trivial_indicator(numerator);
+    bool trivial_d = is_trivial_indicator(denominator);
+
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> udist(0.0f, 1.0f);
+    std::vector<std::vector<int>> columns(vars.size(),
+                                          std::vector<int>(batch_size));
+    std::unordered_map<int, float> nvals(params);
+
+    double sum_wd = 0.0, sum_wn = 0.0, sum_wd2 = 0.0, sum_wn2 = 0.0;
+    int num_samples = 0;
+    float prob = 0.0f, half_width = 1.0f;
+
+    while (num_samples < max_samples) {
+        int b = std::min(batch_size, max_samples - num_samples);
+        for (size_t j = 0; j < vars.size(); j++) {
+            float total = cdfs[j].back();
+            for (int i = 0; i < b; i++) {
+                float u = udist(gen) * total;
+                int k = std::upper_bound(cdfs[j].begin(), cdfs[j].end(), u) -
+                        cdfs[j].begin();
+                columns[j][i] = std::min(k, (int)cdfs[j].size() - 1);
+            }
         }
-        for (int j = 1; j < v.size(); j++) {
-            for (int k = 1; k < j; k++) {
-                v[j][k] = (v[j - 1][k - 1] + v[j - 1][k]);
+
+        for (int i = 0; i < b; i++) {
+            double w = 1.0;
+            for (size_t j = 0; j < vars.size(); j++) {
+                int k = columns[j][i];
+                nvals[vars[j]] = dists[j]->vals[k];
+                if (importance_sampling) {
+                    w *= dists[j]->probs[k] * dists[j]->probs.size();
+                }
             }
+            bool is_d =
+                trivial_d || (denominator->eval(nvals, eps) <= 0.0f);
+            bool is_n =
+                is_d && (trivial_n || (numerator->eval(nvals, eps) <= 0.0f));
+            if (is_d) {
+                sum_wd += w;
+                sum_wd2 += w * w;
+            }
+            if (is_n) {
+                sum_wn += w;
+                sum_wn2 += w * w;
+            }
+        }
+        num_samples += b;
+
+        if (sum_wd == 0.0) {
+            continue;
         }
 
-        for (int i = 0; i <= n; i++) {
-            vals.emplace_back(i);
-            probs.emplace_back((float)v[n][i] * std::pow(p, (float)i) *
-                               std::pow(1.0f - p, (float)n - (float)i));
+        // delta method for the self-normalized ratio estimator
+        // sum((w_n - prob * w_d)^2) expanded, since w_n is either w_d or 0
+        prob = sum_wn / sum_wd;
+        double var = sum_wn2 * (1.0 - 2.0 * prob) + prob * prob * sum_wd2;
+        var = std::max(var, 0.0) / (sum_wd * sum_wd);
+        double n_eff = sum_wd * sum_wd / sum_wd2;
+        // never trust a narrower interval than Wilson's one at the boundary
+        half_width = std::max(z * std::sqrt(var), z * z / (n_eff + z * z));
+        if (half_width <= precision) {
+            break;
         }
     }
-};
+
+    return ProbEstimate(prob, std::max(0.0f, prob - half_width),
+                        std::min(1.0f, prob + half_width), num_samples);
+}
 
 /**
- * @brief Alias for symbolic memory, represented as an unordered map of symbolic
- * expressions.
+ * @brief Cache of the probabilities of symbolic conditions.
+ *
+ * The hash of a query combines the structural hash of the condition, the
+ * signature of the distributions, the values of the fixed variables the
+ * condition depends on, and eps. Since the hash may collide, each entry keeps
+ * the query itself, which is compared on lookup. Since the denominators of
+ * many states are shared, a cache kept across queries turns most of the
+ * evaluations into lookups. If `use_sampling` is true, the probabilities are
+ * estimated by `sampled_prob` instead of being computed exactly, which bounds
+ * the time spent on large random domains.
  */
-using SMem = std::unordered_map<Word32, Sym>;
+struct SymProbCache {
+    /**
+     * @brief A cached query and its probability.
+     */
+    struct Entry {
+        Sym *cond;  ///< The condition.
+        std::vector<std::pair<int, Word32>>
+            fixed;  ///< Sorted values of the fixed variables of `cond`.
+        std::vector<std::pair<int, DiscreteDist>>
+            dists;  ///< Sorted distributions of the random variables of
+                    ///< `cond`.
+        Word32 eps;    ///< eps, compared bitwise.
+        bool sampled;  ///< True if `prob` is estimated by sampling.
+        float prob;    ///< The probability that `cond` holds.
+    };
+
+    std::unordered_map<size_t, std::vector<Entry>>
+        table;       ///< Map from the hash of a query to its entries.
+    int num_hits;    ///< Number of queries answered by the cache.
+    int num_misses;  ///< Number of queries computed from scratch.
+    bool use_sampling = false;  ///< If set to true, estimate the
+                                ///< probabilities by sampling.
+    float sampling_precision = 0.01f;  ///< Target half width of the
+                                       ///< confidence interval of each
+                                       ///< estimate.
+    int max_samples = 1 << 20;  ///< Maximum number of samples per estimate.
+    int sampling_seed = 42;     ///< Random seed of the sampling.
+    bool importance_sampling = false;  ///< If set to true, draw the samples
+                                       ///< from the uniform proposal over the
+                                       ///< supports and reweight them.
+
+    /**
+     * @brief Default constructor for SymProbCache.
+     */
+    SymProbCache() : num_hits(0), num_misses(0) {}
+
+    /**
+     * @brief Returns the probability that the condition holds, computing it
+     * with `factorized_prob` (or estimating it with `sampled_prob`) only when
+     * it is not cached yet.
+     *
+     * @param cond Pointer to the symbolic condition.
+     * @param params Map of variable index to parameter values.
+     * @param eps Epsilon value for numerical stability.
+     * @param var2dist Map of variable index to DiscreteDist.
+     * @param signature Signature of `var2dist` computed by `dist_signature`.
+     * @return The probability that the condition holds.
+     */
+    float prob(Sym *cond, const std::unordered_map<int, float> &params,
+               float eps, std::unordered_map<int, DiscreteDist> &var2dist,
+               size_t signature) {
+        std::unordered_set<int> unique_var_ids;
+        cond->gather_var_ids(unique_var_ids);
+        Entry query{cond, {}, {}, FloatToWord(eps), use_sampling, 0.0f};
+        for (int v : unique_var_ids) {
+            auto itr = params.find(v);
+            if (itr != params.end()) {
+                query.fixed.emplace_back(v, FloatToWord(itr->second));
+            } else {
+                auto ditr = var2dist.find(v);
+                if (ditr != var2dist.end()) {
+                    query.dists.emplace_back(v, ditr->second);
+                }
+            }
+        }
+        std::sort(query.fixed.begin(), query.fixed.end());
+        std::sort(query.dists.begin(), query.dists.end(),
+                  [](const std::pair<int, DiscreteDist> &a,
+                     const std::pair<int, DiscreteDist> &b) {
+                      return a.first < b.first;
+                  });
+
+        size_t key = hash_combine(cond->hash(), signature);
+        key = hash_combine(key, query.eps);
+        for (const auto &f : query.fixed) {
+            key = hash_combine(key, hash_combine(f.first, f.second));
+        }
+
+        std::vector<Entry> &bucket = table[key];
+        for (const Entry &e : bucket) {
+            if (matches(e, query)) {
+                num_hits++;
+                return e.prob;
+            }
+        }
+        num_misses++;
+        if (use_sampling) {
+            Sym always(SymType::SCon, FloatToWord(0.0f));
+            query.prob = sampled_prob(cond, &always, params, eps, var2dist,
+                                      sampling_precision, 1.96f, max_samples,
+                                      1024, sampling_seed,
+                                      importance_sampling)
+                             .prob;
+        } else {
+            query.prob = factorized_prob(cond, params, eps, var2dist);
+        }
+        bucket.push_back(query);
+        return query.prob;
+    }
+
+   private:
+    /**
+     * @brief Returns true if the cached entry answers the query, i.e., if
+     * both have the same condition, fixed values, eps, and distributions.
+     */
+    static bool matches(const Entry &e, const Entry &query) {
+        if (e.eps != query.eps || e.sampled != query.sampled ||
+            e.fixed != query.fixed ||
+            e.dists.size() != query.dists.size() ||
+            Sym::compare(e.cond, query.cond) != 0) {
+            return false;
+        }
+        for (size_t k = 0; k < e.dists.size(); k++) {
+            const DiscreteDist &a = e.dists[k].second;
+            const DiscreteDist &b = query.dists[k].second;
+            if (e.dists[k].first != query.dists[k].first ||
+                a.vals != b.vals || a.probs != b.probs) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
 
 /**
  * @brief Represents a symbolic probability with a numerator and denominator.
@@ -912,6 +2500,18 @@ struct SymProb {
                denominator->toString(true) + ")";
     }
 
+    /**
+     * @brief Checks whether two expressions have the same normal form, so
+     * that a term cancels out regardless of how it is written.
+     *
+     * @param a The first expression.
+     * @param b The second expression.
+     * @return True if the normal forms are identical.
+     */
+    static bool equivalent(Sym *a, Sym *b) {
+        return a == b || Sym::compare(a->normalize(), b->normalize()) == 0;
+    }
+
     /**
      * @brief Multiplies two SymProb instances.
      *
@@ -919,10 +2519,9 @@ struct SymProb {
      * @return Result of the multiplication operation as a new SymProb instance.
      */
     SymProb operator*(SymProb other) {
-        if (denominator->toString(true) == other.numerator->toString(true)) {
+        if (equivalent(denominator, other.numerator)) {
             return SymProb(numerator, other.denominator);
-        } else if (numerator->toString(true) ==
-                   other.denominator->toString(true)) {
+        } else if (equivalent(numerator, other.denominator)) {
             return SymProb(other.numerator, denominator);
         } else {
             return SymProb(
@@ -938,10 +2537,9 @@ struct SymProb {
      * @return Result of the multiplication operation as a new SymProb instance.
      */
     SymProb *pmul(SymProb *other) {
-        if (denominator->toString(true) == other->numerator->toString(true)) {
+        if (equivalent(denominator, other->numerator)) {
             return new SymProb(numerator, other->denominator);
-        } else if (numerator->toString(true) ==
-                   other->denominator->toString(true)) {
+        } else if (equivalent(numerator, other->denominator)) {
             return new SymProb(other->numerator, denominator);
         } else {
             return new SymProb(
@@ -971,7 +2569,10 @@ struct SymProb {
             std::unordered_map<int, float> tmp_assign;
             for (auto &vd : var2dist) {
                 tmp_assign.emplace(vd.first, D[i][j]);
-                tmp_p *= vd.second.probs[j];
+                int k = std::find(vd.second.vals.begin(), vd.second.vals.end(),
+                                  D[i][j]) -
+                        vd.second.vals.begin();
+                tmp_p *= vd.second.probs[k];
                 j++;
             }
             Sym *weight = new Sym(SymType::SCon, FloatToWord(tmp_p));
@@ -992,21 +2593,40 @@ struct SymProb {
      * @brief Evaluates the SymProb for given parameters, epsilon, variable
      * assignments, and distributions.
      *
+     * The numerator and the denominator are evaluated with `factorized_prob`,
+     * which only enumerates the random variables each condition depends on.
+     *
      * @param params Map of variable index to parameter values.
      * @param eps Epsilon value for numerical stability.
      * @param var2dist Map of variable index to DiscreteDist.
-     * @param D Vector of variable assignments.
+     * @param D Vector of variable assignments (kept for compatibility; the
+     * supports are taken from `var2dist`).
      * @return The evaluated probability as a float.
      */
     float eval(std::unordered_map<int, float> &params, float eps,
                std::unordered_map<int, DiscreteDist> &var2dist,
                std::vector<std::vector<int>> &D) {
-        std::pair<Sym *, Sym *> mq = marginalize(var2dist, D);
-        Sym *q_n = mq.first;
-        Sym *q_d = mq.second;
+        (void)D;
+        return eval(params, eps, var2dist);
+    }
 
-        float v_n = q_n->eval(params, eps);
-        float v_d = q_d->eval(params, eps);
+    /**
+     * @brief Evaluates the SymProb for given parameters, epsilon, and
+     * distributions.
+     *
+     * The assignments of the random variables are enumerated lazily, so that
+     * neither the Cartesian product of their supports nor any intermediate
+     * symbolic expression is materialized.
+     *
+     * @param params Map of variable index to parameter values.
+     * @param eps Epsilon value for numerical stability.
+     * @param var2dist Map of variable index to DiscreteDist.
+     * @return The evaluated probability as a float.
+     */
+    float eval(std::unordered_map<int, float> &params, float eps,
+               std::unordered_map<int, DiscreteDist> &var2dist) {
+        float v_n = factorized_prob(numerator, params, eps, var2dist);
+        float v_d = factorized_prob(denominator, params, eps, var2dist);
 
         if (v_d == 0.0f) {
             return 0.0f;
@@ -1015,6 +2635,56 @@ struct SymProb {
         }
     }
 
+    /**
+     * @brief Evaluates the SymProb while reusing the probabilities of the
+     * conditions stored in the cache.
+     *
+     * @param params Map of variable index to parameter values.
+     * @param eps Epsilon value for numerical stability.
+     * @param var2dist Map of variable index to DiscreteDist.
+     * @param cache The cache shared across queries.
+     * @return The evaluated probability as a float.
+     */
+    float eval(std::unordered_map<int, float> &params, float eps,
+               std::unordered_map<int, DiscreteDist> &var2dist,
+               SymProbCache &cache) {
+        size_t signature = dist_signature(var2dist);
+        float v_n = cache.prob(numerator, params, eps, var2dist, signature);
+        float v_d = cache.prob(denominator, params, eps, var2dist, signature);
+
+        if (v_d == 0.0f) {
+            return 0.0f;
+        } else {
+            return v_n / v_d;
+        }
+    }
+
+    /**
+     * @brief Estimates the SymProb by sampling instead of exact enumeration.
+     *
+     * @param params Map of variable index to parameter values.
+     * @param eps Epsilon value for numerical stability.
+     * @param var2dist Map of variable index to DiscreteDist.
+     * @param precision Target half width of the confidence interval.
+     * @param z Quantile of the standard normal distribution for the confidence
+     * level (1.96 for 95%).
+     * @param max_samples Maximum number of samples.
+     * @param seed Random seed.
+     * @param importance_sampling If true, use the uniform proposal over the
+     * supports and reweight the samples.
+     * @return The estimated probability with its confidence interval.
+     * @see sampled_prob
+     */
+    ProbEstimate estimate(std::unordered_map<int, float> &params, float eps,
+                          std::unordered_map<int, DiscreteDist> &var2dist,
+                          float precision = 0.01f, float z = 1.96f,
+                          int max_samples = 1 << 20, int seed = 42,
+                          bool importance_sampling = false) {
+        return sampled_prob(numerator, denominator, params, eps, var2dist,
+                            precision, z, max_samples, 1024, seed,
+                            importance_sampling);
+    }
+
     /**
      * @brief Queries the SymProb with a given symbolic type, another symbolic
      * expression, and variable assignments.
@@ -1036,6 +2706,15 @@ struct SymProb {
     }
 };
 
+/**
+ * @brief Struct representing a call frame of a function.
+ */
+struct Frame {
+    int ret_pc; /**< The pc to return to. */
+    Mem mem;    /**< Concrete memory of the caller. */
+    SMem smem;  /**< Symbolic memory of the caller. */
+};
+
 /**
  * @brief Struct representing the symbolic state of the symbolic execution.
  */
@@ -1053,6 +2732,13 @@ struct SymState {
     bool has_observed_p_cond /**< Flag indicating whether path_constraints
                                 contains probabilistic path conditions. */
         ;
+    float reach_prob = 1.0f; /**< Evaluated probability of the state being
+                                reached. */
+    std::map<int, int> loop_counts; /**< Number of iterations taken by each
+                                       loop, keyed by the pc of its backward
+                                       jump. */
+    std::vector<Frame> call_stack; /**< Frames of the functions being
+                                      called. */
 
     /**
      * @brief Default constructor for symbolic state.
@@ -1096,8 +2782,67 @@ struct SymState {
      * @brief Create a copy object.
      */
     SymState *copy() {
-        return new SymState(pc, var_cnt, mem, smem, symbolic_stack,
-                            path_constraints, p, cond_p, has_observed_p_cond);
+        // the stack is cloned since the forked states push and pop on it
+        // independently
+        Linkedlist<Sym> stack = symbolic_stack.clone();
+        SymState *state =
+            new SymState(pc, var_cnt, mem, smem, stack, path_constraints, p,
+                         cond_p, has_observed_p_cond);
+        state->reach_prob = reach_prob;
+        state->loop_counts = loop_counts;
+        state->call_stack = call_stack;
+        return state;
+    }
+
+    /**
+     * @brief Reads the current value of a variable.
+     *
+     * The memory model of the executors is as follows. A variable lives in
+     * exactly one of the concrete memory `mem` and the symbolic memory
+     * `smem`, or in neither while it holds its symbolic input `var_<a>`.
+     * A read returns the current value eagerly, i.e., a constant, the
+     * expression stored in the symbolic memory, or the input, so that a
+     * variable inside an expression always refers to its symbolic input.
+     * Hence, `s = x; x = 0;` leaves `s` equal to the input `x`, and the
+     * expressions are never substituted with the memory afterward, which
+     * would replace the input with the overwritten value.
+     *
+     * @param a The address of the variable.
+     * @return The value of the variable.
+     */
+    Sym load(int a) const {
+        auto c = mem.find(a);
+        if (c != mem.end()) {
+            return Sym(SymType::SCon, c->second);
+        }
+        auto w = smem.find(a);
+        if (w != smem.end()) {
+            return w->second;
+        }
+        return Sym(SymType::SAny, (Word32)a);
+    }
+
+    /**
+     * @brief Writes a value to a variable (see `load` for the memory model).
+     *
+     * The constant subexpressions of the value are folded without reading
+     * the memory, and the variable is moved to the concrete memory if the
+     * value is constant and to the symbolic memory otherwise.
+     *
+     * @param a The address of the variable.
+     * @param w The value.
+     * @return The stored value.
+     */
+    Sym *store(int a, Sym *w) {
+        w = w->psimplify({});
+        if (w->symtype == SymType::SCon) {
+            mem[a] = w->word;
+            smem.erase(a);
+        } else {
+            smem[a] = *w;
+            mem.erase(a);
+        }
+        return w;
     }
 
     /**
@@ -1192,17 +2937,18 @@ using PathConstraintsTable =
  * @brief Alias for a table of probabilistic path constraints.
  *
  * This table uses the program counter as the key, and the corresponding values
- * are vectors of tuples. Each tuple contains three elements:
+ * are vectors of tuples. Each tuple contains four elements:
  *  - The first element is the path constraint.
  *  - The second element is the concrete memory.
  *  - The third element is the probability of reachability under satisfying
  * universal variables.
+ *  - The fourth element is the symbolic memory.
  *
  * The overall structure of the table is as follows:
- *   {pc: {(constraints, memory, probability)}}
+ *   {pc: {(constraints, memory, probability, symbolic memory)}}
  */
 using ProbPathConstraintsTable =
-    std::unordered_map<int, std::vector<std::tuple<Sym, Mem, SymProb>>>;
+    std::unordered_map<int, std::vector<std::tuple<Sym, Mem, SymProb, SMem>>>;
 
 /**
  * @brief Struct representing a trace in symbolic execution.
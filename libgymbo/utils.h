@@ -5,6 +5,7 @@
  */
 
 #pragma once
+#include <algorithm>
 #include <bitset>
 #include <cmath>
 #include <cstdint>
@@ -24,6 +25,36 @@ namespace gymbo {
  */
 inline bool is_integer(float x) { return std::floor(x) == x; }
 
+/**
+ * @brief Divides two floats.
+ *
+ * @param l The dividend.
+ * @param r The divisor.
+ * @param truncate If true, the quotient is truncated toward zero as in the
+ * integer division of C.
+ * @return The quotient.
+ */
+inline float divide(float l, float r, bool truncate) {
+    return truncate ? std::trunc(l / r) : l / r;
+}
+
+/**
+ * @brief Converts a float to a 32-bit two's complement integer.
+ *
+ * The value is truncated toward zero and wraps around modulo 2^32 as an
+ * unsigned integer of C does.
+ *
+ * @param x The float value to convert.
+ * @return The 32-bit integer.
+ */
+inline int32_t to_int32(float x) {
+    if (!std::isfinite(x)) {
+        return 0;
+    }
+    return static_cast<int32_t>(static_cast<uint32_t>(
+        static_cast<int64_t>(std::fmod(std::trunc(x), 4294967296.0f))));
+}
+
 /**
  * @brief Converts a float value to a 32-bit word representation.
  *
@@ -111,6 +142,17 @@ inline uint32_t twosComplement(uint32_t i) { return 1 + ~i; }
  */
 inline bool isNegative(uint32_t word) { return (word & 0x80000000) != 0; }
 
+/**
+ * @brief Mixes a hash value into another one.
+ *
+ * @param seed The accumulated hash value.
+ * @param v The hash value to mix into `seed`.
+ * @return The combined hash value.
+ */
+inline size_t hash_combine(size_t seed, size_t v) {
+    return seed ^ (v + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
 /**
  * @brief Generates a name for a variable based on its index.
  *
@@ -213,6 +255,24 @@ class Linkedlist {
         return &(tail->data);
     }
 
+    /**
+     * @brief Creates a copy of the linked list that shares no node with it, so
+     * that pushes and pops on one of them do not affect the other.
+     *
+     * @return The copy of the linked list.
+     */
+    Linkedlist<T> clone() const {
+        std::vector<T> items;
+        for (LLNode<T> *tmp = tail; tmp != NULL; tmp = tmp->prev) {
+            items.emplace_back(tmp->data);
+        }
+        Linkedlist<T> result;
+        for (auto itr = items.rbegin(); itr != items.rend(); itr++) {
+            result.push(*itr);
+        }
+        return result;
+    }
+
     /**
      * @brief Pops the element at the back of the linked list.
      */
@@ -242,12 +302,65 @@ class Linkedlist {
     }
 };
 
+/**
+ * @brief Mixed-Radix Counter for Lazy Enumeration of Combinations
+ *
+ * The `MixedRadixCounter` class enumerates all the combinations of indices
+ * `(d_0, d_1, ..., d_{n-1})` with `0 <= d_i < radices[i]` like an odometer,
+ * without materializing them. The first digit changes fastest.
+ */
+class MixedRadixCounter {
+   public:
+    std::vector<int> radices;  ///< The number of candidates of each digit.
+    std::vector<int> digits;   ///< The current combination of indices.
+
+    /**
+     * @brief Constructor for MixedRadixCounter.
+     *
+     * @param radices The number of candidates of each digit.
+     */
+    MixedRadixCounter(const std::vector<int> &radices)
+        : radices(radices), digits(radices.size(), 0) {}
+
+    /**
+     * @brief Checks if the counter has at least one combination.
+     *
+     * @return True if no radix is zero, false otherwise.
+     */
+    bool valid() const {
+        for (int r : radices) {
+            if (r == 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Advances the counter to the next combination.
+     *
+     * @return The number of leading digits that were updated, or zero if all
+     * the combinations have been enumerated.
+     */
+    int next() {
+        for (size_t i = 0; i < digits.size(); i++) {
+            digits[i]++;
+            if (digits[i] < radices[i]) {
+                return i + 1;
+            }
+            digits[i] = 0;
+        }
+        return 0;
+    }
+};
+
 /**
  * @brief Compute the Cartesian product of a vector of vectors of integers.
  *
  * This function takes a vector of vectors of integers and computes their
  * Cartesian product. The result is a vector of vectors, where each inner vector
- * represents a combination of elements from the input vectors.
+ * represents a combination of elements from the input vectors. Prefer
+ * `MixedRadixCounter` when the combinations can be processed one by one.
  *
  * @param vectors A vector of vectors of integers for which the Cartesian
  * product is computed.
@@ -261,23 +374,30 @@ inline std::vector<std::vector<int>> cartesianProduct(
         return result;
     }
 
-    for (int v : vectors[0]) {
-        std::vector<int> tmp = {v};
-        result.emplace_back(tmp);
+    size_t total_size = 1;
+    std::vector<int> radices;
+    for (const auto &v : vectors) {
+        radices.emplace_back(v.size());
+        total_size *= v.size();
     }
+    result.reserve(total_size);
 
-    for (int i = 1; i < vectors.size(); ++i) {
-        std::vector<std::vector<int>> tempResult;
-        for (const auto &element1 : result) {
-            for (const auto &element2 : vectors[i]) {
-                std::vector<int> tempElement = element1;
-                tempElement.push_back(element2);
-                tempResult.push_back(tempElement);
-            }
-        }
-        result = tempResult;
+    // the last vector changes fastest, as in the nested-loop order
+    std::reverse(radices.begin(), radices.end());
+    MixedRadixCounter counter(radices);
+    if (!counter.valid()) {
+        return result;
     }
 
+    int n = vectors.size();
+    do {
+        std::vector<int> element(n);
+        for (int i = 0; i < n; i++) {
+            element[i] = vectors[i][counter.digits[n - 1 - i]];
+        }
+        result.emplace_back(element);
+    } while (counter.next() != 0);
+
     return result;
 }
 };  // namespace gymbo
@@ -9,6 +9,7 @@ ext_modules = [
         ["src/main.cpp"],
         # Example: passing in the version to the compiled code
         define_macros=[("VERSION_INFO", __version__)],
+        libraries=["dl", "pthread"],
     ),
 ]
 
@@ -7,6 +7,8 @@
 
 #include "../libgymbo/compiler.h"
 #include "../libgymbo/pipeline.h"
+#include "../libgymbo/psymbolic.h"
+#include "../libgymbo/query.h"
 #include "../libgymbo/symbolic.h"
 
 #define STRINGIFY(x) #x
@@ -37,17 +39,97 @@ PYBIND11_MODULE(pylibgymbo, m) {
         .def("set_concrete_val", &gymbo::SymState::set_concrete_val);
 
     m.def("gcompile", &gymbo::gcompile, R"pbdoc(gcompile)pbdoc");
+    m.def("gpcompile", &gymbo::gpcompile, R"pbdoc(gpcompile)pbdoc");
+
+    py::class_<gymbo::DiscreteDist>(m, "DiscreteDist")
+        .def_readonly("vals", &gymbo::DiscreteDist::vals)
+        .def_readonly("probs", &gymbo::DiscreteDist::probs);
+
+    py::enum_<gymbo::InitType>(m, "InitType")
+        .value("Uniform", gymbo::InitType::Uniform)
+        .value("Halton", gymbo::InitType::Halton)
+        .value("LatinHypercube", gymbo::InitType::LatinHypercube);
 
     py::class_<gymbo::GDOptimizer>(m, "GDOptimizer")
-        .def(py::init<int, float, float, float, float, bool, bool, int>());
+        .def(py::init<int, float, float, float, float, bool, bool, int>())
+        .def_readwrite("int_vars", &gymbo::GDOptimizer::int_vars)
+        .def_readwrite("use_jit", &gymbo::GDOptimizer::use_jit)
+        .def_readwrite("jit_warmup_epochs",
+                       &gymbo::GDOptimizer::jit_warmup_epochs)
+        .def_readwrite("smooth_temperature",
+                       &gymbo::GDOptimizer::smooth_temperature)
+        .def_readwrite("smooth_decay", &gymbo::GDOptimizer::smooth_decay)
+        .def_readwrite("smooth_min_temperature",
+                       &gymbo::GDOptimizer::smooth_min_temperature)
+        .def_readwrite("var_bounds", &gymbo::GDOptimizer::var_bounds)
+        .def_readwrite("var_lr", &gymbo::GDOptimizer::var_lr)
+        .def_readwrite("precondition", &gymbo::GDOptimizer::precondition)
+        .def_readwrite("init_type", &gymbo::GDOptimizer::init_type)
+        .def_readwrite("num_strata", &gymbo::GDOptimizer::num_strata)
+        .def_readwrite("init_within_intervals",
+                       &gymbo::GDOptimizer::init_within_intervals)
+        .def_readwrite("interval_bounds",
+                       &gymbo::GDOptimizer::interval_bounds)
+        .def_readwrite("reuse_models", &gymbo::GDOptimizer::reuse_models)
+        .def_readwrite("warm_start", &gymbo::GDOptimizer::warm_start);
 
     py::class_<gymbo::SExecutor>(m, "SExecutor")
         .def(py::init<gymbo::GDOptimizer, int, int, int, bool, bool, int,
                       bool>())
         .def_readwrite("constraints_cache",
                        &gymbo::SExecutor::constraints_cache)
+        .def_readwrite("max_unroll", &gymbo::SExecutor::max_unroll)
+        .def_readwrite("use_summaries", &gymbo::SExecutor::use_summaries)
+        .def_readwrite("max_summary_paths",
+                       &gymbo::SExecutor::max_summary_paths)
+        .def_readwrite("max_summary_steps",
+                       &gymbo::SExecutor::max_summary_steps)
+        .def_readwrite("use_intervals", &gymbo::SExecutor::use_intervals)
+        .def_readwrite("use_bitblast", &gymbo::SExecutor::use_bitblast)
+        .def_readwrite("use_portfolio", &gymbo::SExecutor::use_portfolio)
+        .def_readwrite("use_block_summaries",
+                       &gymbo::SExecutor::use_block_summaries)
         .def("run", &gymbo::SExecutor::run);
 
+    py::class_<gymbo::SymProbCache>(m, "SymProbCache")
+        .def_readwrite("use_sampling", &gymbo::SymProbCache::use_sampling)
+        .def_readwrite("sampling_precision",
+                       &gymbo::SymProbCache::sampling_precision)
+        .def_readwrite("max_samples", &gymbo::SymProbCache::max_samples)
+        .def_readwrite("sampling_seed", &gymbo::SymProbCache::sampling_seed)
+        .def_readwrite("importance_sampling",
+                       &gymbo::SymProbCache::importance_sampling);
+
+    py::class_<gymbo::PSExecutor>(m, "PSExecutor")
+        .def(py::init<gymbo::GDOptimizer, int, int, int, bool, bool, int,
+                      bool>())
+        .def_readwrite("prob_threshold", &gymbo::PSExecutor::prob_threshold)
+        .def_readwrite("max_unroll", &gymbo::PSExecutor::max_unroll)
+        .def_readwrite("use_intervals", &gymbo::PSExecutor::use_intervals)
+        .def_readwrite("use_bitblast", &gymbo::PSExecutor::use_bitblast)
+        .def_readwrite("use_portfolio", &gymbo::PSExecutor::use_portfolio)
+        .def_readwrite("use_block_summaries",
+                       &gymbo::PSExecutor::use_block_summaries)
+        .def_readwrite("mass_tolerance", &gymbo::PSExecutor::mass_tolerance)
+        .def_readonly("pruned_mass", &gymbo::PSExecutor::pruned_mass)
+        .def_readonly("frontier_mass", &gymbo::PSExecutor::frontier_mass)
+        .def_readwrite("prob_cache", &gymbo::PSExecutor::prob_cache)
+        .def("register_random_vars",
+             &gymbo::PSExecutor::register_random_vars)
+        .def("run", &gymbo::PSExecutor::run)
+        .def("run_best_first", &gymbo::PSExecutor::run_best_first);
+
+    py::class_<gymbo::ProbQuery>(m, "ProbQuery")
+        .def(py::init<gymbo::PSExecutor &,
+                      const std::unordered_map<int, float> &>(),
+             py::keep_alive<1, 2>())
+        .def_readonly("dropped_mass", &gymbo::ProbQuery::dropped_mass)
+        .def("expectation", &gymbo::ProbQuery::expectation)
+        .def("variance", &gymbo::ProbQuery::variance)
+        .def("cdf", &gymbo::ProbQuery::cdf)
+        .def("mass", &gymbo::ProbQuery::mass)
+        .def("query", &gymbo::ProbQuery::query);
+
 #ifdef VERSION_INFO
     m.attr("__version__") = MACRO_STRINGIFY(VERSION_INFO);
 #else
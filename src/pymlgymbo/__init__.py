@@ -1,2 +1,14 @@
+from .converter_quant import (  # noqa: F401
+    QuantizedLinear,
+    dump_quantized_MLP,
+    quantize_input,
+    quantize_sklearn_MLP,
+    quantized_forward,
+)
 from .converter_sklearn import dump_sklearn_MLP  # noqa: F401
+from .converter_tree import (  # noqa: F401
+    dump_sklearn_forest,
+    dump_sklearn_gbdt,
+    dump_sklearn_tree,
+)
 from .converter_torch import TorchMLP, dump_pytorch_MLP  # noqa: F401
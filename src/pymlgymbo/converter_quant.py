@@ -0,0 +1,260 @@
+import numpy as np
+
+INT8_MIN = -128
+INT8_MAX = 127
+
+
+class QuantizedLinear:
+    """
+    Fully connected layer with int8 weights and activations.
+
+    A real value `r` of an activation is represented by an int8 `q` with
+    `r = scale * (q - zero_point)`, and the weights are symmetric, i.e., their
+    zero point is 0. The layer computes, with 32-bit integers that wrap
+    around on overflow,
+
+        acc_j = bias_j + sum_c weight[j, c] * (x_c - input_zero_point)
+        y_j = output_zero_point + ((acc_j * multiplier + 2^(shift - 1)) >> shift)
+
+    and saturates `y_j` to [-128, 127] (to [output_zero_point, 127] when the
+    layer is followed by ReLU). The fixed-point `multiplier / 2^shift`
+    approximates `input_scale * weight_scale / output_scale`.
+
+    Args:
+        weight (array): int8 weights of shape (num_outputs, num_inputs).
+        bias (array): int32 biases in the scale of the accumulator.
+        input_zero_point (int): Zero point of the inputs.
+        multiplier (int): Fixed-point multiplier of the requantization.
+        shift (int): Right shift of the requantization (at least 1).
+        output_zero_point (int): Zero point of the outputs.
+        relu (bool): Whether the layer is followed by ReLU.
+    """
+
+    def __init__(
+        self,
+        weight,
+        bias,
+        input_zero_point,
+        multiplier,
+        shift,
+        output_zero_point,
+        relu,
+    ):
+        self.weight = np.asarray(weight, dtype=np.int8)
+        self.bias = np.asarray(bias, dtype=np.int32)
+        self.input_zero_point = int(input_zero_point)
+        self.multiplier = int(multiplier)
+        self.shift = int(shift)
+        self.output_zero_point = int(output_zero_point)
+        self.relu = relu
+
+    def lower_bound(self):
+        """Returns the smallest output of the layer."""
+        return max(INT8_MIN, self.output_zero_point) if self.relu else INT8_MIN
+
+    def forward(self, x):
+        """
+        Computes the outputs of the layer with int8 kernels.
+
+        Args:
+            x (array): int8 inputs of shape (num_inputs,) or (batch, num_inputs).
+
+        Returns:
+        array: The int8 outputs, stored as int32.
+        """
+        x = np.asarray(x, dtype=np.int32) - np.int32(self.input_zero_point)
+        with np.errstate(over="ignore"):
+            acc = x @ self.weight.T.astype(np.int32) + self.bias
+            y = acc * np.int32(self.multiplier) + np.int32(1 << (self.shift - 1))
+            y = y >> np.int32(self.shift)
+            y = y + np.int32(self.output_zero_point)
+        return np.clip(y, self.lower_bound(), INT8_MAX).astype(np.int32)
+
+
+def quantized_forward(layers, x):
+    """
+    Computes the outputs of a quantized MLP.
+
+    Args:
+        layers (list): List of `QuantizedLinear`.
+        x (array): int8 inputs of shape (num_inputs,) or (batch, num_inputs).
+
+    Returns:
+    array: The int8 outputs of the last layer, stored as int32.
+    """
+    for layer in layers:
+        x = layer.forward(x)
+    return x
+
+
+def _affine_params(lo, hi):
+    """Returns the scale and the zero point of int8 values covering [lo, hi]."""
+    lo, hi = min(float(lo), 0.0), max(float(hi), 0.0)
+    scale = (hi - lo) / (INT8_MAX - INT8_MIN)
+    if scale == 0.0:
+        scale = 1.0
+    zero_point = int(np.clip(round(INT8_MIN - lo / scale), INT8_MIN, INT8_MAX))
+    return scale, zero_point
+
+
+def _fixed_point(m, multiplier_bits):
+    """Returns (multiplier, shift) with multiplier / 2^shift close to m > 0."""
+    shift = multiplier_bits - 1 - int(np.floor(np.log2(m)))
+    shift = max(shift, 1)
+    return int(round(m * (1 << shift))), shift
+
+
+def quantize_input(x, scale, zero_point):
+    """
+    Quantizes real inputs to int8.
+
+    Args:
+        x (array): Real inputs.
+        scale (float): Scale of the inputs.
+        zero_point (int): Zero point of the inputs.
+
+    Returns:
+    array: The int8 inputs, stored as int32.
+    """
+    q = np.round(np.asarray(x, dtype=float) / scale) + zero_point
+    return np.clip(q, INT8_MIN, INT8_MAX).astype(np.int32)
+
+
+def quantize_sklearn_MLP(clf, X, multiplier_bits=8):
+    """
+    Quantizes a trained scikit-learn MLP to int8 (post-training quantization).
+
+    The scales and the zero points of the activations are calibrated on the
+    ranges observed for `X`, and the weights of each layer are quantized
+    symmetrically. The multiplier of each requantization has
+    `multiplier_bits` bits, so that the product with the accumulator stays
+    within 32 bits for accumulators below 2^(31 - multiplier_bits).
+
+    Args:
+        clf (MLPClassifier|MLPRegressor): The trained scikit-learn MLP, whose
+            activation is "relu" or "identity".
+        X (array): Calibration inputs.
+        multiplier_bits (int, optional): Bits of the fixed-point multipliers. Defaults to 8.
+
+    Returns:
+    tuple: (layers, input_scale, input_zero_point), where layers is a list of
+    `QuantizedLinear`.
+
+    Example:
+    ```python
+    layers, s, z = quantize_sklearn_MLP(clf, X_train)
+    y_q = quantized_forward(layers, quantize_input(X_test, s, z))
+    ```
+    """
+
+    if clf.activation not in ("relu", "identity"):
+        raise ValueError(f"unsupported activation: {clf.activation}")
+
+    a = np.asarray(X, dtype=float)
+    input_scale, input_zero_point = _affine_params(a.min(), a.max())
+    scale, zero_point = input_scale, input_zero_point
+
+    layers = []
+    num_layers = len(clf.coefs_)
+    for layer_id in range(num_layers):
+        W, b = clf.coefs_[layer_id], clf.intercepts_[layer_id]
+        relu = layer_id < num_layers - 1 and clf.activation == "relu"
+        a = a @ W + b
+        if relu:
+            a = np.maximum(a, 0.0)
+        out_scale, out_zero_point = _affine_params(a.min(), a.max())
+
+        w_scale = np.abs(W).max() / INT8_MAX
+        if w_scale == 0.0:
+            w_scale = 1.0
+        weight = np.clip(np.round(W.T / w_scale), INT8_MIN, INT8_MAX)
+        bias = np.round(b / (scale * w_scale))
+        multiplier, shift = _fixed_point(
+            scale * w_scale / out_scale, multiplier_bits
+        )
+        layers.append(
+            QuantizedLinear(
+                weight, bias, zero_point, multiplier, shift, out_zero_point, relu
+            )
+        )
+        scale, zero_point = out_scale, out_zero_point
+
+    return layers, input_scale, input_zero_point
+
+
+def dump_quantized_MLP(layers, feature_vars, indent_char="", endl="\n"):
+    """
+    Generate code representation of a quantized MLP.
+
+    The features and the activations are declared as `int`, and the program
+    returns 0 unless every feature is within the int8 range [-128, 127]. Each
+    layer is emitted with the integer semantics of `QuantizedLinear.forward`,
+    i.e., the multiply-accumulate, the fixed-point requantization with a
+    rounding right shift, and the saturation to int8 as two comparisons.
+    Each output `y_j` is the int8 output of the last layer.
+
+    Since the program only uses integer arithmetic and shifts, its path
+    constraints are bit-blasted. The VM, however, computes in float32, which
+    represents integers exactly only up to 2^24 in magnitude, e.g., not
+    every `acc * multiplier` of a wide layer. A model from bit-blasting is
+    therefore kept only if it also holds in float32, and a refutation is
+    final only if no product can exceed 2^24; otherwise the path
+    constraints fall back to gradient descent.
+
+    Args:
+        layers (list): List of `QuantizedLinear`.
+        feature_vars (list): List of feature variable names, whose values are int8 inputs.
+        indent_char (str, optional): Character used for indentation. Defaults to an empty string.
+        endl (str, optional): String representing the end of a line. Defaults to "\n".
+
+    Returns:
+    str: The formatted code representation of the quantized MLP.
+
+    Example:
+    ```python
+    layers, s, z = quantize_sklearn_MLP(clf, X_train)
+    code_representation = dump_quantized_MLP(layers, feature_vars)
+    print(code_representation)
+    ```
+    """
+
+    code = ""
+    for n in feature_vars:
+        code += f"{indent_char}int {n};{endl}"
+    out_of_range = " || ".join(
+        f"({n} < {INT8_MIN}) || ({n} > {INT8_MAX})" for n in feature_vars
+    )
+    code += f"{indent_char}if ({out_of_range}){endl}"
+    code += f"{indent_char}    return 0;{endl}"
+
+    prev = list(feature_vars)
+    for layer_id, layer in enumerate(layers):
+        code += endl
+        zp = layer.input_zero_point
+        names = []
+        for j in range(layer.weight.shape[0]):
+            h = f"h_{layer_id + 1}_{j}"
+            code += f"{indent_char}int {h} = {int(layer.bias[j])}"
+            for c in range(layer.weight.shape[1]):
+                w = int(layer.weight[j, c])
+                if w == 0:
+                    continue
+                x = prev[c] if zp == 0 else f"({prev[c]} - {zp})"
+                code += f" + ({w} * {x})"
+            code += f";{endl}"
+            code += (
+                f"{indent_char}{h} = (({h} * {layer.multiplier} + "
+                f"{1 << (layer.shift - 1)}) >> {layer.shift}) + "
+                f"{layer.output_zero_point};{endl}"
+            )
+            code += f"{indent_char}if ({h} < {layer.lower_bound()}){endl}"
+            code += f"{indent_char}    {h} = {layer.lower_bound()};{endl}"
+            code += f"{indent_char}if ({h} > {INT8_MAX}){endl}"
+            code += f"{indent_char}    {h} = {INT8_MAX};{endl}"
+            names.append(h)
+        prev = names
+
+    code += endl
+    for j, h in enumerate(prev):
+        code += f"{indent_char}y_{j} = {h};{endl}"
+    return code
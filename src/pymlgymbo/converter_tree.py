@@ -0,0 +1,263 @@
+import numpy as np
+
+
+class _SubtreeTable:
+    """
+    Table of the distinct subtrees of tree ensembles, where each subtree that
+    is shared by several trees (or outputs) is emitted once as a function.
+    """
+
+    def __init__(self, feature_vars, indent_char, endl, format_str, prefix):
+        self.feature_vars = feature_vars
+        self.indent_char = indent_char
+        self.endl = endl
+        self.format_str = format_str
+        self.prefix = prefix
+        self.keys = {}
+        self.counts = {}
+        self.funcs = {}
+        self.code = ""
+
+    def args(self):
+        return ", ".join(self.feature_vars)
+
+    def key(self, tree, node, values):
+        """Returns the structural key of the subtree rooted at `node`."""
+        memo_key = (id(tree), id(values), node)
+        if memo_key in self.keys:
+            return self.keys[memo_key]
+        if tree.children_left[node] == -1:
+            k = ("leaf", self.format_str.format(values[node]))
+        else:
+            k = (
+                "node",
+                tree.feature[node],
+                self.format_str.format(tree.threshold[node]),
+                self.key(tree, tree.children_left[node], values),
+                self.key(tree, tree.children_right[node], values),
+            )
+        self.keys[memo_key] = k
+        return k
+
+    def count(self, tree, node, values):
+        """Counts the occurrences of the subtrees rooted under `node`."""
+        k = self.key(tree, node, values)
+        self.counts[k] = self.counts.get(k, 0) + 1
+        if self.counts[k] == 1 and k[0] == "node":
+            self.count(tree, tree.children_left[node], values)
+            self.count(tree, tree.children_right[node], values)
+
+    def body(self, tree, node, values, depth):
+        """Returns the statements returning the value of the subtree."""
+        indent = self.indent_char + " " * depth
+        k = self.key(tree, node, values)
+        if k[0] == "leaf":
+            return f"{indent}return {k[1]};{self.endl}"
+        if depth > 1 and self.counts[k] > 1:
+            return f"{indent}return {self.func(tree, node, values)}({self.args()});{self.endl}"
+
+        code = f"{indent}if ({self.feature_vars[k[1]]} <= {k[2]}) {{{self.endl}"
+        code += self.body(tree, tree.children_left[node], values, depth + 1)
+        code += f"{indent}}} else {{{self.endl}"
+        code += self.body(tree, tree.children_right[node], values, depth + 1)
+        code += f"{indent}}}{self.endl}"
+        return code
+
+    def func(self, tree, node, values):
+        """Returns the name of the function of the subtree, defining it if needed."""
+        k = self.key(tree, node, values)
+        if k not in self.funcs:
+            name = f"{self.prefix}{len(self.funcs)}"
+            self.funcs[k] = name
+            body = self.body(tree, node, values, 1)
+            self.code += f"{self.indent_char}def {name}({self.args()}) {{{self.endl}"
+            self.code += body
+            self.code += f"{self.indent_char}}}{self.endl}"
+        return self.funcs[k]
+
+
+def _dump_trees(
+    trees, feature_vars, init, scale, indent_char, endl, precision, prefix
+):
+    format_str = "{:." + str(precision) + "f}"
+    table = _SubtreeTable(feature_vars, indent_char, endl, format_str, prefix)
+
+    for output_trees in trees:
+        for tree, values in output_trees:
+            table.count(tree, 0, values)
+
+    main = ""
+    for j, output_trees in enumerate(trees):
+        main += f"{indent_char}y_{j} = {format_str.format(init[j])};{endl}"
+        for tree, values in output_trees:
+            name = table.func(tree, 0, values)
+            main += f"{indent_char}y_{j} = y_{j} + ({format_str.format(scale)} * {name}({table.args()}));{endl}"
+    return table.code + endl + main
+
+
+def _tree_outputs(estimator):
+    """Returns the leaf values of a fitted tree for each output."""
+    tree = estimator.tree_
+    if hasattr(estimator, "classes_"):
+        probs = tree.value[:, 0, :]
+        probs = probs / probs.sum(axis=1, keepdims=True)
+        return [(tree, np.ascontiguousarray(probs[:, j])) for j in range(probs.shape[1])]
+    return [(tree, np.ascontiguousarray(tree.value[:, 0, 0]))]
+
+
+def dump_sklearn_tree(
+    clf, feature_vars, indent_char="", endl="\n", precision=8, prefix="tree_"
+):
+    """
+    Generate code representation of a trained scikit-learn decision tree.
+
+    The tree is emitted as a function of the features that returns the value of
+    the reached leaf, so that the symbolic executor summarizes it once, and
+    each output is assigned to `y_j`. For a classifier, `y_j` is the
+    probability of the j-th class.
+
+    Args:
+        clf (DecisionTreeClassifier|DecisionTreeRegressor): The trained scikit-learn tree.
+        feature_vars (list): List of feature variable names.
+        indent_char (str, optional): Character used for indentation. Defaults to an empty string.
+        endl (str, optional): String representing the end of a line. Defaults to "\n".
+        precision (int, optional): Number of decimal places for formatting. Defaults to 8.
+        prefix (str, optional): Prefix of the names of the emitted functions. Defaults to "tree_".
+
+    Returns:
+    str: The formatted code representation of the tree.
+
+    Example:
+    ```python
+    from sklearn.tree import DecisionTreeClassifier
+
+    # Assuming clf and feature_vars are defined
+    code_representation = dump_sklearn_tree(clf, feature_vars)
+    print(code_representation)
+    ```
+    """
+
+    outputs = _tree_outputs(clf)
+    return _dump_trees(
+        [[o] for o in outputs],
+        feature_vars,
+        [0.0] * len(outputs),
+        1.0,
+        indent_char,
+        endl,
+        precision,
+        prefix,
+    )
+
+
+def dump_sklearn_forest(
+    clf, feature_vars, indent_char="", endl="\n", precision=8, prefix="tree_"
+):
+    """
+    Generate code representation of a trained scikit-learn random forest.
+
+    Each output `y_j` is the average of the values returned by the trees. A
+    subtree that appears in several trees (or outputs) is emitted once as a
+    function and called from each of them, which keeps the program linear in
+    the number of distinct subtrees and lets the symbolic executor reuse its
+    summary. When interval reasoning is enabled (`use_intervals`, or `-k`/`-x`
+    on the command line), the threshold comparisons along a path are decided
+    by it, so that the infeasible combinations of leaves are pruned without
+    gradient descent.
+
+    Args:
+        clf (RandomForestClassifier|RandomForestRegressor|ExtraTreesClassifier|ExtraTreesRegressor):
+            The trained scikit-learn forest.
+        feature_vars (list): List of feature variable names.
+        indent_char (str, optional): Character used for indentation. Defaults to an empty string.
+        endl (str, optional): String representing the end of a line. Defaults to "\n".
+        precision (int, optional): Number of decimal places for formatting. Defaults to 8.
+        prefix (str, optional): Prefix of the names of the emitted functions. Defaults to "tree_".
+
+    Returns:
+    str: The formatted code representation of the forest.
+
+    Example:
+    ```python
+    from sklearn.ensemble import RandomForestClassifier
+
+    # Assuming clf and feature_vars are defined
+    code_representation = dump_sklearn_forest(clf, feature_vars)
+    print(code_representation)
+    ```
+    """
+
+    per_tree = [_tree_outputs(e) for e in clf.estimators_]
+    trees = [list(o) for o in zip(*per_tree)]
+    return _dump_trees(
+        trees,
+        feature_vars,
+        [0.0] * len(trees),
+        1.0 / len(clf.estimators_),
+        indent_char,
+        endl,
+        precision,
+        prefix,
+    )
+
+
+def dump_sklearn_gbdt(
+    clf, feature_vars, indent_char="", endl="\n", precision=8, prefix="tree_"
+):
+    """
+    Generate code representation of a trained scikit-learn gradient boosting model.
+
+    Each output `y_j` is the raw score of the model, i.e., the initial
+    prediction plus the learning rate times the values of the trees, which
+    equals `decision_function` for a classifier and `predict` for a regressor.
+    The trees are shared and summarized as in `dump_sklearn_forest`.
+
+    Args:
+        clf (GradientBoostingClassifier|GradientBoostingRegressor): The trained scikit-learn model.
+        feature_vars (list): List of feature variable names.
+        indent_char (str, optional): Character used for indentation. Defaults to an empty string.
+        endl (str, optional): String representing the end of a line. Defaults to "\n".
+        precision (int, optional): Number of decimal places for formatting. Defaults to 8.
+        prefix (str, optional): Prefix of the names of the emitted functions. Defaults to "tree_".
+
+    Returns:
+    str: The formatted code representation of the model.
+
+    Example:
+    ```python
+    from sklearn.ensemble import GradientBoostingClassifier
+
+    # Assuming clf and feature_vars are defined
+    code_representation = dump_sklearn_gbdt(clf, feature_vars)
+    print(code_representation)
+    ```
+    """
+
+    num_outputs = clf.estimators_.shape[1]
+    trees = [
+        [_tree_outputs(e)[0] for e in clf.estimators_[:, j]]
+        for j in range(num_outputs)
+    ]
+
+    # the initial prediction is the raw score minus the contribution of the
+    # trees at any point
+    x = np.zeros((1, clf.n_features_in_))
+    if hasattr(clf, "decision_function"):
+        raw = np.asarray(clf.decision_function(x), dtype=float).reshape(-1)
+    else:
+        raw = np.asarray(clf.predict(x), dtype=float).reshape(-1)
+    init = [
+        raw[j]
+        - clf.learning_rate * sum(e.predict(x)[0] for e in clf.estimators_[:, j])
+        for j in range(num_outputs)
+    ]
+    return _dump_trees(
+        trees,
+        feature_vars,
+        init,
+        clf.learning_rate,
+        indent_char,
+        endl,
+        precision,
+        prefix,
+    )
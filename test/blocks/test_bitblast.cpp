@@ -0,0 +1,152 @@
+#include "../../libgymbo/bitblast.h"
+#include "gtest/gtest.h"
+
+TEST(GymboBitBlastTest, CDCL) {
+    // pigeonhole principle with 4 pigeons and 3 holes, where p(i, j) means
+    // that the pigeon i is in the hole j
+    gymbosat::CDCL solver;
+    int p[4][3];
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 3; j++) {
+            p[i][j] = solver.new_var();
+        }
+        solver.add_clause({p[i][0], p[i][1], p[i][2]});
+    }
+    for (int j = 0; j < 3; j++) {
+        for (int i = 0; i < 4; i++) {
+            for (int k = i + 1; k < 4; k++) {
+                solver.add_clause({-p[i][j], -p[k][j]});
+            }
+        }
+    }
+    ASSERT_EQ(solver.solve(), gymbosat::UNSAT);
+
+    // x1 xor x2, x2 -> x3, !x3
+    gymbosat::CDCL solver2;
+    int x1 = solver2.new_var(), x2 = solver2.new_var(),
+        x3 = solver2.new_var();
+    solver2.add_clause({x1, x2});
+    solver2.add_clause({-x1, -x2});
+    solver2.add_clause({-x2, x3});
+    solver2.add_clause({-x3});
+    ASSERT_EQ(solver2.solve(), gymbosat::SAT);
+    ASSERT_TRUE(solver2.model(x1));
+    ASSERT_FALSE(solver2.model(x2));
+}
+
+TEST(GymboBitBlastTest, Solver) {
+    gymbo::Word32 var_id_0 = 0, var_id_1 = 1;
+    gymbo::Sym *x = new gymbo::Sym(gymbo::SymType::SAny, var_id_0);
+    gymbo::Sym *y = new gymbo::Sym(gymbo::SymType::SAny, var_id_1);
+    gymbo::Sym *one =
+        new gymbo::Sym(gymbo::SymType::SCon, gymbo::FloatToWord(1.0f));
+    gymbo::Sym *four =
+        new gymbo::Sym(gymbo::SymType::SCon, gymbo::FloatToWord(4.0f));
+    gymbo::Sym *zero =
+        new gymbo::Sym(gymbo::SymType::SCon, gymbo::FloatToWord(0.0f));
+    gymbo::Sym *mask =
+        new gymbo::Sym(gymbo::SymType::SCon, gymbo::FloatToWord(255.0f));
+    gymbo::Sym *target =
+        new gymbo::Sym(gymbo::SymType::SCon, gymbo::FloatToWord(0xa5));
+    std::unordered_set<int> int_vars = {0, 1};
+
+    // ((x ^ y) & 255) == 0xa5 && (y << 4) == 160 && y < 16 && 0 <= x &&
+    // x < y + 200
+    std::vector<gymbo::Sym> path_constraints = {
+        gymbo::Sym(gymbo::SymType::SEq,
+                   new gymbo::Sym(gymbo::SymType::SBitAnd,
+                                  new gymbo::Sym(gymbo::SymType::SBitXor, x, y),
+                                  mask),
+                   target),
+        gymbo::Sym(gymbo::SymType::SEq,
+                   new gymbo::Sym(gymbo::SymType::SShl, y, four),
+                   new gymbo::Sym(gymbo::SymType::SCon,
+                                  gymbo::FloatToWord(160.0f))),
+        gymbo::Sym(gymbo::SymType::SLt, y,
+                   new gymbo::Sym(gymbo::SymType::SCon,
+                                  gymbo::FloatToWord(16.0f))),
+        gymbo::Sym(gymbo::SymType::SLe, zero, x),
+        gymbo::Sym(gymbo::SymType::SLt, x,
+                   new gymbo::Sym(gymbo::SymType::SAdd, y,
+                                  new gymbo::Sym(gymbo::SymType::SCon,
+                                                 gymbo::FloatToWord(200.0f))))};
+
+    bool is_sat = false;
+    std::unordered_map<int, float> params;
+    ASSERT_TRUE(gymbo::bitblast_solver(is_sat, path_constraints, int_vars,
+                                       params));
+    ASSERT_TRUE(is_sat);
+    ASSERT_FLOAT_EQ(params[0], 175.0f);
+    ASSERT_FLOAT_EQ(params[1], 10.0f);
+    for (const gymbo::Sym &c : path_constraints) {
+        ASSERT_LE(c.eval(params, 1.0f), 0.0f);
+    }
+
+    // the addition wraps around, so that x + 1 < x holds for the largest
+    // integer, which is not a model for the VM computing in float32, and
+    // the constraint is left to the gradient descent
+    std::vector<gymbo::Sym> overflow = {gymbo::Sym(
+        gymbo::SymType::SLt, new gymbo::Sym(gymbo::SymType::SAdd, x, one), x)};
+    params.clear();
+    ASSERT_FALSE(gymbo::bitblast_solver(is_sat, overflow, int_vars, params));
+    ASSERT_EQ(params.size(), 0);
+
+    // x * x < 0 only holds by wrapping around
+    std::vector<gymbo::Sym> square = {
+        gymbo::Sym(gymbo::SymType::SLt,
+                   new gymbo::Sym(gymbo::SymType::SMul, x, x), zero)};
+    ASSERT_FALSE(gymbo::bitblast_solver(is_sat, square, int_vars, params));
+
+    // x * 65536 * 65536 is always 0 in 32 bits but not in float32, so the
+    // refutation of its disequality is not final
+    gymbo::Sym *scale =
+        new gymbo::Sym(gymbo::SymType::SCon, gymbo::FloatToWord(65536.0f));
+    std::vector<gymbo::Sym> nonzero = {gymbo::Sym(
+        gymbo::SymType::SNot,
+        new gymbo::Sym(
+            gymbo::SymType::SEq,
+            new gymbo::Sym(gymbo::SymType::SMul,
+                           new gymbo::Sym(gymbo::SymType::SMul, x, scale),
+                           scale),
+            zero))};
+    ASSERT_FALSE(gymbo::bitblast_solver(is_sat, nonzero, int_vars, params));
+
+    // (x & 255) + (y & 255) == 600 is refuted, since its arithmetic is exact
+    std::vector<gymbo::Sym> masked = {gymbo::Sym(
+        gymbo::SymType::SEq,
+        new gymbo::Sym(gymbo::SymType::SAdd,
+                       new gymbo::Sym(gymbo::SymType::SBitAnd, x, mask),
+                       new gymbo::Sym(gymbo::SymType::SBitAnd, y, mask)),
+        new gymbo::Sym(gymbo::SymType::SCon, gymbo::FloatToWord(600.0f)))};
+    ASSERT_TRUE(gymbo::bitblast_solver(is_sat, masked, int_vars, params));
+    ASSERT_FALSE(is_sat);
+
+    // x & 1 == 1 && x << 31 == 0 is infeasible
+    std::vector<gymbo::Sym> infeasible = {
+        gymbo::Sym(gymbo::SymType::SEq,
+                   new gymbo::Sym(gymbo::SymType::SBitAnd, x, one), one),
+        gymbo::Sym(gymbo::SymType::SEq,
+                   new gymbo::Sym(gymbo::SymType::SShl, x,
+                                  new gymbo::Sym(gymbo::SymType::SCon,
+                                                 gymbo::FloatToWord(31.0f))),
+                   zero)};
+    ASSERT_TRUE(gymbo::bitblast_solver(is_sat, infeasible, int_vars, params));
+    ASSERT_FALSE(is_sat);
+
+    // x * -3 == -21 has the unique solution since 3 is odd
+    std::vector<gymbo::Sym> negative = {gymbo::Sym(
+        gymbo::SymType::SEq,
+        new gymbo::Sym(gymbo::SymType::SMul, x,
+                       new gymbo::Sym(gymbo::SymType::SCon,
+                                      gymbo::FloatToWord(-3.0f))),
+        new gymbo::Sym(gymbo::SymType::SCon, gymbo::FloatToWord(-21.0f)))};
+    params.clear();
+    ASSERT_TRUE(gymbo::bitblast_solver(is_sat, negative, int_vars, params));
+    ASSERT_TRUE(is_sat);
+    ASSERT_FLOAT_EQ(params[0], 7.0f);
+
+    // a variable of float type is left to the gradient descent
+    std::unordered_set<int> only_x = {0};
+    ASSERT_FALSE(gymbo::bitblast_solver(is_sat, path_constraints, only_x,
+                                        params));
+}
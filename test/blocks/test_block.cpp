@@ -0,0 +1,71 @@
+#include "../../libgymbo/symbolic.h"
+#include "gtest/gtest.h"
+
+TEST(GymboBlockTest, Summary) {
+    // a = x * 2 + 1; b = a + y; a = 3; c = a + b * a;
+    // with the addresses x: 0, a: 1, y: 2, b: 3, c: 4
+    using gymbo::Instr;
+    using gymbo::InstrType;
+    gymbo::Prog prg = {
+        Instr(InstrType::Push, 0),
+        Instr(InstrType::Load),
+        Instr(InstrType::Push, gymbo::FloatToWord(2.0f)),
+        Instr(InstrType::Mul),
+        Instr(InstrType::Push, gymbo::FloatToWord(1.0f)),
+        Instr(InstrType::Add),
+        Instr(InstrType::Push, 1),
+        Instr(InstrType::Store),
+        Instr(InstrType::Push, 1),
+        Instr(InstrType::Load),
+        Instr(InstrType::Push, 2),
+        Instr(InstrType::Load),
+        Instr(InstrType::Add),
+        Instr(InstrType::Push, 3),
+        Instr(InstrType::Store),
+        Instr(InstrType::Push, gymbo::FloatToWord(3.0f)),
+        Instr(InstrType::Push, 1),
+        Instr(InstrType::Store),
+        Instr(InstrType::Push, 1),
+        Instr(InstrType::Load),
+        Instr(InstrType::Push, 3),
+        Instr(InstrType::Load),
+        Instr(InstrType::Push, 1),
+        Instr(InstrType::Load),
+        Instr(InstrType::Mul),
+        Instr(InstrType::Add),
+        Instr(InstrType::Push, 4),
+        Instr(InstrType::Store),
+        Instr(InstrType::Done)};
+
+    gymbo::BlockSummary summary = gymbo::summarize_block(prg, 0);
+    ASSERT_TRUE(summary.valid);
+    ASSERT_EQ(summary.end_pc, prg.size() - 1);
+    ASSERT_EQ(summary.stores.size(), 4);
+
+    // applying the summary results in the same state as the execution of
+    // the instructions
+    gymbo::SymState stepped, applied;
+    stepped.set_concrete_val(2, 4.0f);
+    applied.set_concrete_val(2, 4.0f);
+    while (stepped.pc < summary.end_pc) {
+        gymbo::symStepStraight(&stepped, prg[stepped.pc]);
+    }
+    gymbo::apply_block(summary, applied);
+
+    ASSERT_EQ(applied.pc, stepped.pc);
+    ASSERT_EQ(applied.mem.size(), stepped.mem.size());
+    for (auto &m : stepped.mem) {
+        ASSERT_EQ(applied.mem[m.first], m.second);
+    }
+    ASSERT_EQ(applied.smem.size(), stepped.smem.size());
+    for (auto &m : stepped.smem) {
+        ASSERT_EQ(applied.smem[m.first].toString(true),
+                  m.second.toString(true));
+    }
+    ASSERT_EQ(gymbo::wordToFloat(applied.mem[1]), 3.0f);
+    ASSERT_EQ(applied.smem.count(4), 1);
+
+    // the address of a load computed from the stack is unknown
+    gymbo::Prog indirect = {Instr(InstrType::Load), Instr(InstrType::Done)};
+    ASSERT_FALSE(gymbo::summarize_block(indirect, 0).valid);
+}
@@ -1,4 +1,5 @@
 #include "../../libgymbo/compiler.h"
+#include "../../libgymbo/pipeline.h"
 #include "gtest/gtest.h"
 
 TEST(GymboCompilerTest, Pipeline) {
@@ -28,3 +29,285 @@ TEST(GymboCompilerTest, Pipeline) {
         ASSERT_EQ(prg[j].instr, instrstypes[j]);
     }
 }
+
+TEST(GymboCompilerTest, RandomVariables) {
+    char user_input[] =
+        "x ~ bernoulli(0.3); y ~ categorical(-1, 1, 2, 3); if (x == y) return "
+        "1;";
+
+    std::unordered_map<std::string, int> vc;
+    std::vector<gymbo::Node *> code;
+    gymbo::Prog prg;
+    std::unordered_map<int, gymbo::DiscreteDist> var2dist;
+
+    gymbo::Token *token = gymbo::tokenize(user_input, vc);
+    gymbo::generate_ast(token, user_input, code);
+    gymbo::compile_ast(code, prg, var2dist);
+
+    // the names of the distributions are not variables
+    ASSERT_EQ(vc.size(), 2);
+    ASSERT_EQ(var2dist.size(), 2);
+
+    gymbo::DiscreteDist &xdist = var2dist[vc["x"]];
+    ASSERT_EQ(xdist.vals.size(), 2);
+    ASSERT_FLOAT_EQ(xdist.probs[1], 0.3f);
+
+    gymbo::DiscreteDist &ydist = var2dist[vc["y"]];
+    ASSERT_EQ(ydist.vals[0], -1);
+    ASSERT_EQ(ydist.vals[1], 2);
+    ASSERT_FLOAT_EQ(ydist.probs[0], 0.25f);
+
+    // declarations do not emit any instruction
+    ASSERT_EQ(prg[0].instr, gymbo::InstrType::Push);
+    ASSERT_EQ(prg.size(), 13);
+}
+
+TEST(GymboCompilerTest, RandomVariableInFunction) {
+    // a declaration in a function is rejected instead of being dropped
+    char user_input[] =
+        "def f(a) { if (a > 0) { r ~ bernoulli(0.5); } return a + r; }\n"
+        "y = f(x); if (y == 7) return 1;";
+
+    std::unordered_map<std::string, int> vc;
+    std::vector<gymbo::Node *> code;
+    gymbo::Token *token = gymbo::tokenize(user_input, vc);
+    ASSERT_THROW(gymbo::generate_ast(token, user_input, code),
+                 gymbo::ParseError);
+}
+
+TEST(GymboCompilerTest, Loops) {
+    char user_input[] =
+        "s = 0; for (i = 0; i < 4; i = i + 1) s = s + x; while (s < y) s = s + "
+        "1;";
+
+    std::unordered_map<std::string, int> vc;
+    std::vector<gymbo::Node *> code;
+    gymbo::Token *token = gymbo::tokenize(user_input, vc);
+    gymbo::generate_ast(token, user_input, code);
+
+    // each loop has a loop condition and a backward jump
+    gymbo::Prog prg;
+    gymbo::compile_ast(code, prg);
+    int num_loop_conds = 0, num_backward_jmps = 0;
+    for (size_t j = 0; j < prg.size(); j++) {
+        if (prg[j].instr == gymbo::InstrType::JmpIf &&
+            prg[j].word == gymbo::JMPIF_LOOP) {
+            num_loop_conds++;
+        }
+        if (prg[j].instr == gymbo::InstrType::Jmp &&
+            gymbo::wordToInt(prg[j - 1].word) < 0) {
+            // the backward jump goes to the condition of the loop
+            ASSERT_GE(j + gymbo::wordToInt(prg[j - 1].word), 0);
+            num_backward_jmps++;
+        }
+    }
+    ASSERT_EQ(num_loop_conds, 2);
+    ASSERT_EQ(num_backward_jmps, 2);
+
+    // only the counting loop is summarized
+    gymbo::Prog sprg;
+    gymbo::compile_ast(code, sprg, true);
+    num_backward_jmps = 0;
+    for (size_t j = 0; j < sprg.size(); j++) {
+        if (sprg[j].instr == gymbo::InstrType::Jmp &&
+            gymbo::wordToInt(sprg[j - 1].word) < 0) {
+            num_backward_jmps++;
+        }
+    }
+    ASSERT_EQ(num_backward_jmps, 1);
+    ASSERT_LT(sprg.size(), prg.size());
+}
+
+TEST(GymboCompilerTest, LoopSummaryRefusal) {
+    // the summary `v = v + 4 * 0.5` would not truncate the partial sums of
+    // the integer `v`, so that the loop is kept as is
+    char user_input[] =
+        "int v = 0; for (i = 0; i < 4; i = i + 1) v = v + 0.5; if (v == 2) "
+        "return 1;";
+
+    std::unordered_map<std::string, int> vc;
+    std::vector<gymbo::Node *> code;
+    gymbo::Token *token = gymbo::tokenize(user_input, vc);
+    gymbo::generate_ast(token, user_input, code);
+
+    gymbo::Prog prg;
+    gymbo::compile_ast(code, prg, true);
+    int num_backward_jmps = 0;
+    for (size_t j = 0; j < prg.size(); j++) {
+        if (prg[j].instr == gymbo::InstrType::Jmp &&
+            gymbo::wordToInt(prg[j - 1].word) < 0) {
+            num_backward_jmps++;
+        }
+    }
+    ASSERT_EQ(num_backward_jmps, 1);
+
+    // the unrolled loop runs four times under the margin of `i < 4.5`,
+    // whereas the exact count is five
+    char fractional_input[] =
+        "s = 0; for (i = 0; i < 4.5; i = i + 1) s = s + 1; if (s == 5) "
+        "return 1;";
+    std::vector<gymbo::Node *> fractional_code;
+    token = gymbo::tokenize(fractional_input, vc);
+    gymbo::generate_ast(token, fractional_input, fractional_code);
+
+    gymbo::Prog fractional_prg;
+    gymbo::compile_ast(fractional_code, fractional_prg, true);
+    num_backward_jmps = 0;
+    for (size_t j = 0; j < fractional_prg.size(); j++) {
+        if (fractional_prg[j].instr == gymbo::InstrType::Jmp &&
+            gymbo::wordToInt(fractional_prg[j - 1].word) < 0) {
+            num_backward_jmps++;
+        }
+    }
+    ASSERT_EQ(num_backward_jmps, 1);
+}
+
+TEST(GymboCompilerTest, Functions) {
+    char user_input[] =
+        "def f(a, b) { c = a * b; return c; } y = f(x, 2); if (y == 4) "
+        "return 1;";
+
+    std::unordered_map<std::string, int> vc;
+    std::vector<gymbo::Node *> code;
+    gymbo::Prog prg;
+
+    gymbo::Token *token = gymbo::tokenize(user_input, vc);
+    gymbo::generate_ast(token, user_input, code);
+    gymbo::compile_ast(code, prg);
+
+    // the variables of a function are local to it, and the name of a
+    // function is not a variable
+    ASSERT_EQ(vc.size(), 5);
+    ASSERT_TRUE(vc.find("f::a") != vc.end());
+    ASSERT_TRUE(vc.find("f::c") != vc.end());
+    ASSERT_TRUE(vc.find("f") == vc.end());
+
+    // the function is placed after the main program
+    int entry = -1, num_calls = 0;
+    for (size_t j = 0; j < prg.size(); j++) {
+        if (prg[j].instr == gymbo::InstrType::Call) {
+            entry = gymbo::wordToInt(prg[j].word);
+            num_calls++;
+        }
+    }
+    ASSERT_EQ(num_calls, 1);
+    ASSERT_EQ(prg[entry].instr, gymbo::InstrType::Enter);
+    ASSERT_EQ(prg[entry].word, 2);
+    ASSERT_EQ(prg[entry - 1].instr, gymbo::InstrType::Done);
+    ASSERT_EQ(prg.back().instr, gymbo::InstrType::Ret);
+}
+
+TEST(GymboCompilerTest, Arrays) {
+    char user_input[] = "int t[3] = {5, 7}; if (t[i] == 7) return 1;";
+
+    std::unordered_map<std::string, int> vc;
+    std::vector<gymbo::Node *> code;
+    gymbo::Prog prg;
+
+    gymbo::Token *token = gymbo::tokenize(user_input, vc);
+    gymbo::generate_ast(token, user_input, code);
+    gymbo::compile_ast(code, prg);
+
+    // the elements have consecutive ids
+    ASSERT_EQ(vc.size(), 4);
+    ASSERT_EQ(vc["t[1]"], vc["t"] + 1);
+    ASSERT_EQ(vc["t[2]"], vc["t"] + 2);
+
+    // two initializers and a read
+    int num_index = 0;
+    for (size_t j = 0; j < prg.size(); j++) {
+        if (prg[j].instr == gymbo::InstrType::Index) {
+            ASSERT_EQ(prg[j].word, 3);
+            num_index++;
+        }
+    }
+    ASSERT_EQ(num_index, 3);
+}
+
+TEST(GymboCompilerTest, Division) {
+    char user_input[] =
+        "int n = 7; a = n / 2; b = n / 2.0; int c = x * 1.5; d = n % 3;";
+
+    std::unordered_map<std::string, int> vc;
+    std::vector<gymbo::Node *> code;
+    gymbo::Prog prg;
+    std::unordered_set<int> int_vars;
+
+    gymbo::Token *token = gymbo::tokenize(user_input, vc);
+    gymbo::generate_ast(token, user_input, code);
+    gymbo::compile_ast(code, prg);
+    for (gymbo::Node *node : code) {
+        gymbo::gather_int_vars(node, int_vars);
+    }
+
+    // only the variables declared with `int` are integers
+    ASSERT_EQ(int_vars.size(), 2);
+    ASSERT_TRUE(int_vars.find(vc["n"]) != int_vars.end());
+    ASSERT_TRUE(int_vars.find(vc["c"]) != int_vars.end());
+
+    // the division of integers and the assignment to an integer truncate
+    std::vector<gymbo::Word32> div_words;
+    int num_mod = 0;
+    for (size_t j = 0; j < prg.size(); j++) {
+        if (prg[j].instr == gymbo::InstrType::Div) {
+            div_words.emplace_back(prg[j].word);
+        } else if (prg[j].instr == gymbo::InstrType::Mod) {
+            num_mod++;
+        }
+    }
+    std::vector<gymbo::Word32> expected = {gymbo::DIV_TRUNC, 0,
+                                           gymbo::DIV_TRUNC};
+    ASSERT_EQ(div_words, expected);
+    ASSERT_EQ(num_mod, 1);
+}
+
+TEST(GymboCompilerTest, IntVarsFromPipeline) {
+    char user_input[] =
+        "int n = 7; int a[2]; b = n + x; if (a[1] == b) return 1;";
+    auto compiled = gymbo::gcompile(user_input);
+    std::unordered_map<std::string, int> &vc = std::get<0>(compiled);
+    std::unordered_set<int> &int_vars = std::get<2>(compiled);
+
+    std::unordered_set<int> expected = {vc["n"], vc["a"], vc["a"] + 1};
+    ASSERT_EQ(int_vars, expected);
+
+    char p_input[] = "r ~ bernoulli(0.5); int n = 2; if (r == n) return 1;";
+    auto p_compiled = gymbo::gpcompile(p_input);
+    std::unordered_set<int> p_expected = {std::get<0>(p_compiled)["n"]};
+    ASSERT_EQ(std::get<3>(p_compiled), p_expected);
+}
+
+TEST(GymboCompilerTest, Bitwise) {
+    char user_input[] = "a = x & 3 | y ^ z << 2 + 1; if (a && b) return 1;";
+
+    std::unordered_map<std::string, int> vc;
+    std::vector<gymbo::Node *> code;
+    gymbo::Prog prg;
+
+    gymbo::Token *token = gymbo::tokenize(user_input, vc);
+    gymbo::generate_ast(token, user_input, code);
+    gymbo::compile_ast(code, prg);
+
+    // the operators follow the precedence of C, i.e., x & 3 | (y ^ (z << (2
+    // + 1))), and `&&` is not confused with `&`
+    std::vector<gymbo::InstrType> ops;
+    for (size_t j = 0; j < prg.size(); j++) {
+        switch (prg[j].instr) {
+            case gymbo::InstrType::Add:
+            case gymbo::InstrType::BitAnd:
+            case gymbo::InstrType::BitOr:
+            case gymbo::InstrType::BitXor:
+            case gymbo::InstrType::Shl:
+            case gymbo::InstrType::And:
+                ops.emplace_back(prg[j].instr);
+                break;
+            default:
+                break;
+        }
+    }
+    std::vector<gymbo::InstrType> expected = {
+        gymbo::InstrType::BitAnd, gymbo::InstrType::Add,
+        gymbo::InstrType::Shl,    gymbo::InstrType::BitXor,
+        gymbo::InstrType::BitOr,  gymbo::InstrType::And};
+    ASSERT_EQ(ops, expected);
+}
@@ -80,3 +80,325 @@ TEST(GymboGDTest, Count) {
     ASSERT_TRUE(is_sat);
     ASSERT_TRUE(params[0] == 3.0 && params[1] == 7.0);
 }
+
+TEST(GymboGDTest, IntegerRounding) {
+    // 3 * x == 9, whose real-valued iterates rarely hit the solution exactly
+    gymbo::Word32 var_id = 0;
+    std::vector<gymbo::Sym> path_constraints = {gymbo::Sym(
+        gymbo::SymType::SEq,
+        new gymbo::Sym(
+            gymbo::SymType::SMul,
+            new gymbo::Sym(gymbo::SymType::SCon, gymbo::FloatToWord(3.0f)),
+            new gymbo::Sym(gymbo::SymType::SAny, var_id)),
+        new gymbo::Sym(gymbo::SymType::SCon, gymbo::FloatToWord(9.0f)))};
+
+    gymbo::GDOptimizer optimizer(num_itrs, 0.05f, eps, param_low, param_high,
+                                 false, false, seed);
+    optimizer.int_vars.emplace(var_id);
+
+    std::unordered_map<int, float> params = {};
+    ASSERT_TRUE(optimizer.solve(path_constraints, params));
+    ASSERT_EQ(params[0], 3.0f);
+}
+
+TEST(GymboGDTest, NativeLoss) {
+    // (x - 2 * y) * y == 6 && y < x && !(x == 9 || 0 < y % 5)
+    gymbo::Word32 var_id_0 = 0, var_id_1 = 1;
+    gymbo::Sym *x = new gymbo::Sym(gymbo::SymType::SAny, var_id_0);
+    gymbo::Sym *y = new gymbo::Sym(gymbo::SymType::SAny, var_id_1);
+    auto con = [](float v) {
+        return new gymbo::Sym(gymbo::SymType::SCon, gymbo::FloatToWord(v));
+    };
+    std::vector<gymbo::Sym> path_constraints = {
+        gymbo::Sym(
+            gymbo::SymType::SEq,
+            new gymbo::Sym(
+                gymbo::SymType::SMul,
+                new gymbo::Sym(gymbo::SymType::SSub, x,
+                               new gymbo::Sym(gymbo::SymType::SMul, con(2.0f),
+                                              y)),
+                y),
+            con(6.0f)),
+        gymbo::Sym(gymbo::SymType::SLt, y, x),
+        gymbo::Sym(
+            gymbo::SymType::SNot,
+            new gymbo::Sym(
+                gymbo::SymType::SOr,
+                new gymbo::Sym(gymbo::SymType::SEq, x, con(9.0f)),
+                new gymbo::Sym(gymbo::SymType::SLt, con(0.0f),
+                               new gymbo::Sym(gymbo::SymType::SMod, y,
+                                              con(5.0f)))))};
+
+    // the compiled loss agrees with the interpreter
+    std::shared_ptr<gymbo::JitLoss> jit = gymbo::compile_loss(path_constraints);
+    ASSERT_NE(jit, nullptr);
+    for (float vx : {-3.0f, 0.0f, 2.5f, 9.0f}) {
+        for (float vy : {-2.0f, 1.0f, 5.0f}) {
+            std::unordered_map<int, float> params = {{0, vx}, {1, vy}};
+            std::vector<float> values, grads(jit->vars.size());
+            for (int v : jit->vars) {
+                values.emplace_back(params[v]);
+            }
+            int num_unsat = 0;
+            gymbo::Grad expected = gymbo::Grad({});
+            for (const gymbo::Sym &c : path_constraints) {
+                num_unsat += !(c.eval(params, 1.0f) <= 0.0f);
+                if (c.eval(params, 1.0f) > 0.0f) {
+                    expected = expected + c.grad(params, 1.0f);
+                }
+            }
+            ASSERT_EQ(jit->run(values.data(), 1.0f, grads.data()), num_unsat);
+            for (size_t i = 0; i < jit->vars.size(); i++) {
+                ASSERT_FLOAT_EQ(grads[i], expected.val[jit->vars[i]]);
+            }
+        }
+    }
+
+    // the native gradient descent follows the interpreted one
+    gymbo::GDOptimizer interpreted(num_itrs, step_size, eps, param_low,
+                                   param_high, sign_grad,
+                                   init_param_uniform_int, seed);
+    gymbo::GDOptimizer native = interpreted;
+    native.use_jit = true;
+    native.jit_warmup_epochs = 2;
+    std::unordered_map<int, float> params_i = {}, params_n = {};
+    ASSERT_EQ(interpreted.solve(path_constraints, params_i),
+              native.solve(path_constraints, params_n));
+    ASSERT_EQ(params_i, params_n);
+    ASSERT_EQ(interpreted.num_used_itr, native.num_used_itr);
+
+    // the constraints of the same shape over other variables share the
+    // compiled function but not the variables
+    gymbo::Word32 var_id_2 = 2;
+    gymbo::Sym *z = new gymbo::Sym(gymbo::SymType::SAny, var_id_2);
+    std::vector<gymbo::Sym> on_y = {
+        gymbo::Sym(gymbo::SymType::SLt, y, con(-20.0f))};
+    std::vector<gymbo::Sym> on_z = {
+        gymbo::Sym(gymbo::SymType::SLt, z, con(-20.0f))};
+    std::shared_ptr<gymbo::JitLoss> jit_y = gymbo::compile_loss(on_y);
+    std::shared_ptr<gymbo::JitLoss> jit_z = gymbo::compile_loss(on_z);
+    ASSERT_NE(jit_y, nullptr);
+    ASSERT_NE(jit_z, nullptr);
+    ASSERT_EQ(jit_y->fn, jit_z->fn);
+    ASSERT_EQ(jit_y->vars, std::vector<int>({1}));
+    ASSERT_EQ(jit_z->vars, std::vector<int>({2}));
+    native.jit_warmup_epochs = 0;
+    for (std::vector<gymbo::Sym> *constraints : {&on_y, &on_z}) {
+        std::unordered_map<int, float> params = {};
+        ASSERT_TRUE(native.solve(*constraints, params));
+        ASSERT_LE((*constraints)[0].eval(params, eps), 0.0f);
+    }
+
+    // a counting constraint is left to the interpreter
+    std::vector<gymbo::Sym> count = {gymbo::Sym(
+        gymbo::SymType::SEq, new gymbo::Sym(gymbo::SymType::SCnt, x),
+        con(1.0f))};
+    ASSERT_EQ(gymbo::compile_loss(count), nullptr);
+
+    // nothing is loaded from a directory writable by other users
+    char shared_dir[] = "/tmp/gymbo_jit_test_XXXXXX";
+    ASSERT_NE(mkdtemp(shared_dir), nullptr);
+    ASSERT_TRUE(gymbo::prepare_jit_cache_dir(shared_dir));
+    chmod(shared_dir, 0777);
+    ASSERT_FALSE(gymbo::prepare_jit_cache_dir(shared_dir));
+    rmdir(shared_dir);
+}
+
+TEST(GymboGDTest, SmoothLoss) {
+    // x * x + 1 <= 0 || 20 < y, whose min picks the infeasible branch, so
+    // that the exact gradient stalls at x = 0
+    gymbo::Word32 var_id_0 = 0, var_id_1 = 1;
+    gymbo::Sym *x = new gymbo::Sym(gymbo::SymType::SAny, var_id_0);
+    gymbo::Sym *y = new gymbo::Sym(gymbo::SymType::SAny, var_id_1);
+    auto con = [](float v) {
+        return new gymbo::Sym(gymbo::SymType::SCon, gymbo::FloatToWord(v));
+    };
+    std::vector<gymbo::Sym> path_constraints = {gymbo::Sym(
+        gymbo::SymType::SOr,
+        new gymbo::Sym(gymbo::SymType::SLe,
+                       new gymbo::Sym(gymbo::SymType::SAdd,
+                                      new gymbo::Sym(gymbo::SymType::SMul, x,
+                                                     x),
+                                      con(1.0f)),
+                       con(0.0f)),
+        new gymbo::Sym(gymbo::SymType::SLt, con(20.0f), y))};
+
+    // the surrogates tend to the exact losses as the temperature decreases
+    std::unordered_map<int, float> params = {{0, 3.0f}, {1, 0.0f}};
+    float exact = path_constraints[0].eval(params, eps);
+    ASSERT_LT(path_constraints[0].eval(params, eps, nullptr, 1.0f), exact);
+    ASSERT_NEAR(path_constraints[0].eval(params, eps, nullptr, 1e-3f), exact,
+                1e-3f);
+    ASSERT_EQ(path_constraints[0].grad(params, eps).val[1], 0.0f);
+    ASSERT_LT(path_constraints[0].grad(params, eps, nullptr, 10.0f).val[1],
+              0.0f);
+
+    gymbo::GDOptimizer exact_optimizer(num_itrs, step_size, eps, param_low,
+                                       param_high, sign_grad,
+                                       init_param_uniform_int, seed);
+    ASSERT_FALSE(exact_optimizer.solve(path_constraints, params, false));
+
+    gymbo::GDOptimizer smooth_optimizer = exact_optimizer;
+    smooth_optimizer.smooth_temperature = 10.0f;
+    params = {{0, 3.0f}, {1, 0.0f}};
+    ASSERT_TRUE(smooth_optimizer.solve(path_constraints, params, false));
+    ASSERT_GT(params[1], 20.0f);
+}
+
+TEST(GymboGDTest, Precondition) {
+    // 5 < 1000 * x + y / 1000 && 3 < y / 1000 - 1000 * x, where y needs to
+    // exceed 4000 while x stays small
+    gymbo::Word32 var_id_0 = 0, var_id_1 = 1;
+    gymbo::Sym *x = new gymbo::Sym(gymbo::SymType::SAny, var_id_0);
+    gymbo::Sym *y = new gymbo::Sym(gymbo::SymType::SAny, var_id_1);
+    auto con = [](float v) {
+        return new gymbo::Sym(gymbo::SymType::SCon, gymbo::FloatToWord(v));
+    };
+    gymbo::Sym *ax = new gymbo::Sym(gymbo::SymType::SMul, con(1000.0f), x);
+    gymbo::Sym *ay = new gymbo::Sym(gymbo::SymType::SMul, con(0.001f), y);
+    std::vector<gymbo::Sym> path_constraints = {
+        gymbo::Sym(gymbo::SymType::SLt, con(5.0f),
+                   new gymbo::Sym(gymbo::SymType::SAdd, ax, ay)),
+        gymbo::Sym(gymbo::SymType::SLt, con(3.0f),
+                   new gymbo::Sym(gymbo::SymType::SSub, ay, ax))};
+
+    gymbo::GDOptimizer optimizer(1000, step_size, 0.001f, param_low,
+                                 param_high, sign_grad, false, seed);
+    std::unordered_map<int, float> params = {};
+    ASSERT_FALSE(optimizer.solve(path_constraints, params));
+
+    // the bounds of x are narrower, and the step of y is larger
+    optimizer.precondition = true;
+    optimizer.var_bounds[0] = std::make_pair(-0.001f, 0.001f);
+    optimizer.num_used_itr = 0;
+    params = {};
+    ASSERT_TRUE(optimizer.solve(path_constraints, params));
+    ASSERT_LT(optimizer.num_used_itr, 10);
+    ASSERT_LE(std::abs(params[0]), 0.01f);
+    ASSERT_GT(params[1], 4000.0f);
+
+    // a given learning rate overrides the inferred one
+    std::unordered_set<int> var_ids = {0, 1};
+    optimizer.var_lr[1] = 0.5f;
+    ASSERT_FLOAT_EQ(
+        optimizer.learning_rates(path_constraints, params, var_ids)[1], 0.5f);
+}
+
+TEST(GymboGDTest, VarBounds) {
+    // 100 < x cannot be satisfied within 0 <= x <= 3, and the descent stays
+    // within the bounds
+    gymbo::Word32 var_id_0 = 0;
+    gymbo::Sym *x = new gymbo::Sym(gymbo::SymType::SAny, var_id_0);
+    auto con = [](float v) {
+        return new gymbo::Sym(gymbo::SymType::SCon, gymbo::FloatToWord(v));
+    };
+    std::vector<gymbo::Sym> path_constraints = {
+        gymbo::Sym(gymbo::SymType::SLt, con(100.0f), x)};
+
+    gymbo::GDOptimizer interpreted(num_itrs, step_size, eps, param_low,
+                                   param_high, sign_grad,
+                                   init_param_uniform_int, seed);
+    interpreted.var_bounds[0] = std::make_pair(0.0f, 3.0f);
+    gymbo::GDOptimizer native = interpreted;
+    native.use_jit = true;
+    native.jit_warmup_epochs = 0;
+    for (gymbo::GDOptimizer *optimizer : {&interpreted, &native}) {
+        std::unordered_map<int, float> params = {};
+        ASSERT_FALSE(optimizer->solve(path_constraints, params));
+        ASSERT_EQ(params[0], 3.0f);
+    }
+
+    // 2 < x holds at the upper bound
+    path_constraints = {gymbo::Sym(gymbo::SymType::SLt, con(2.0f), x)};
+    std::unordered_map<int, float> params = {};
+    ASSERT_TRUE(interpreted.solve(path_constraints, params));
+    ASSERT_EQ(params[0], 3.0f);
+
+    // a range without integers does not break the initialization
+    interpreted.var_bounds[0] = std::make_pair(0.2f, 0.8f);
+    params = {};
+    interpreted.solve(path_constraints, params);
+    ASSERT_GE(params[0], 0.2f);
+    ASSERT_LE(params[0], 0.8f);
+}
+
+TEST(GymboGDTest, Initializers) {
+    ASSERT_FLOAT_EQ(gymbo::radical_inverse(3, 2), 0.75f);
+    ASSERT_FLOAT_EQ(gymbo::radical_inverse(5, 3), 7.0f / 9.0f);
+    ASSERT_EQ(gymbo::nth_prime(0), 2);
+    ASSERT_EQ(gymbo::nth_prime(4), 11);
+
+    // x <= 100 && y <= 100 holds at the initial values
+    gymbo::Word32 var_id_0 = 0, var_id_1 = 1;
+    gymbo::Sym *x = new gymbo::Sym(gymbo::SymType::SAny, var_id_0);
+    gymbo::Sym *y = new gymbo::Sym(gymbo::SymType::SAny, var_id_1);
+    gymbo::Sym *hundred =
+        new gymbo::Sym(gymbo::SymType::SCon, gymbo::FloatToWord(100.0f));
+    std::vector<gymbo::Sym> path_constraints = {
+        gymbo::Sym(gymbo::SymType::SLe, x, hundred),
+        gymbo::Sym(gymbo::SymType::SLe, y, hundred)};
+
+    // each of the 5 strata of each variable is visited once in 5 restarts
+    gymbo::GDOptimizer optimizer(num_itrs, step_size, eps, 0.0f, 5.0f,
+                                 sign_grad, false, 0);
+    optimizer.init_type = gymbo::InitType::LatinHypercube;
+    optimizer.num_strata = 5;
+    std::unordered_set<int> strata_x, strata_y;
+    for (int j = 0; j < 5; j++) {
+        std::unordered_map<int, float> params = {};
+        ASSERT_TRUE(optimizer.solve(path_constraints, params));
+        strata_x.insert((int)std::floor(params[0]));
+        strata_y.insert((int)std::floor(params[1]));
+        optimizer.seed += 1;
+    }
+    ASSERT_EQ(strata_x.size(), 5);
+    ASSERT_EQ(strata_y.size(), 5);
+
+    // the restarts take the successive points of the Halton sequence
+    optimizer.init_type = gymbo::InitType::Halton;
+    optimizer.seed = 2;
+    std::unordered_map<int, float> params = {};
+    ASSERT_TRUE(optimizer.solve(path_constraints, params));
+    ASSERT_FLOAT_EQ(params[0], 5.0f * gymbo::radical_inverse(3, 2));
+    ASSERT_FLOAT_EQ(params[1], 5.0f * gymbo::radical_inverse(3, 3));
+
+    // x is sampled near the interval inferred from x > 200
+    optimizer.init_within_intervals = true;
+    optimizer.interval_bounds[0] =
+        std::make_pair(200.0f, std::numeric_limits<float>::infinity());
+    std::vector<gymbo::Sym> above = {gymbo::Sym(
+        gymbo::SymType::SLt,
+        new gymbo::Sym(gymbo::SymType::SCon, gymbo::FloatToWord(200.0f)), x)};
+    optimizer.num_used_itr = 0;
+    params = {};
+    ASSERT_TRUE(optimizer.solve(above, params));
+    ASSERT_EQ(optimizer.num_used_itr, 0);
+    ASSERT_GE(params[0], 200.0f);
+    ASSERT_LE(params[0], 205.0f);
+
+    // the last model is the starting point of the next solve
+    optimizer.reuse_models = true;
+    params = {};
+    ASSERT_TRUE(optimizer.solve(above, params));
+    float last = params[0];
+    ASSERT_FLOAT_EQ(optimizer.warm_start[0], last);
+    optimizer.init_within_intervals = false;
+    params = {};
+    ASSERT_TRUE(optimizer.solve(above, params));
+    ASSERT_FLOAT_EQ(params[0], last);
+
+    // every initializer maps into a range without integers or an empty one
+    optimizer.reuse_models = false;
+    optimizer.var_bounds[0] = std::make_pair(0.2f, 0.8f);
+    optimizer.init_param_uniform_int = true;
+    for (gymbo::InitType init_type :
+         {gymbo::InitType::Uniform, gymbo::InitType::Halton,
+          gymbo::InitType::LatinHypercube}) {
+        optimizer.init_type = init_type;
+        std::mt19937 gen(seed);
+        ASSERT_EQ(optimizer.sample(0, 0, gen), 1.0f);
+    }
+    optimizer.init_param_uniform_int = false;
+    ASSERT_EQ(optimizer.scale(std::make_pair(3.0f, 2.0f), 0.5f), 3.0f);
+    ASSERT_EQ(optimizer.scale(std::make_pair(2.0f, 4.0f), 0.5f), 3.0f);
+}
@@ -0,0 +1,47 @@
+#include "../../libgymbo/interval.h"
+#include "gtest/gtest.h"
+
+TEST(GymboIntervalTest, Domain) {
+    gymbo::Word32 var_id_0 = 0, var_id_1 = 1;
+    gymbo::Sym *x = new gymbo::Sym(gymbo::SymType::SAny, var_id_0);
+    gymbo::Sym *y = new gymbo::Sym(gymbo::SymType::SAny, var_id_1);
+    gymbo::Sym *one =
+        new gymbo::Sym(gymbo::SymType::SCon, gymbo::FloatToWord(1.0f));
+    gymbo::Sym *two =
+        new gymbo::Sym(gymbo::SymType::SCon, gymbo::FloatToWord(2.0f));
+    gymbo::Sym *three =
+        new gymbo::Sym(gymbo::SymType::SCon, gymbo::FloatToWord(3.0f));
+    gymbo::Sym *five =
+        new gymbo::Sym(gymbo::SymType::SCon, gymbo::FloatToWord(5.0f));
+    gymbo::Sym *ten =
+        new gymbo::Sym(gymbo::SymType::SCon, gymbo::FloatToWord(10.0f));
+
+    // 2 * x < 10 && !(x <= 3)
+    std::vector<gymbo::Sym> path_constraints = {
+        gymbo::Sym(gymbo::SymType::SLt,
+                   new gymbo::Sym(gymbo::SymType::SMul, two, x), ten),
+        gymbo::Sym(gymbo::SymType::SNot,
+                   new gymbo::Sym(gymbo::SymType::SLe, x, three))};
+
+    gymbo::IntervalDomain domain(1.0f);
+    domain.add(path_constraints);
+    ASSERT_FALSE(domain.is_empty);
+    ASSERT_TRUE(domain.is_box);
+    ASSERT_FLOAT_EQ(domain.bounds[0].lo, 4.0f);
+    ASSERT_FLOAT_EQ(domain.bounds[0].hi, 4.5f);
+
+    std::unordered_map<int, float> params;
+    domain.witness(params);
+    ASSERT_FLOAT_EQ(params[0], 4.0f);
+
+    // a constraint between two variables is not a box constraint
+    domain.add(gymbo::Sym(gymbo::SymType::SEq,
+                          new gymbo::Sym(gymbo::SymType::SAdd, x, one), y),
+               false);
+    ASSERT_FALSE(domain.is_empty);
+    ASSERT_FALSE(domain.is_box);
+
+    // but it does not prevent refuting the box
+    domain.add(gymbo::Sym(gymbo::SymType::SLt, x, five), true);
+    ASSERT_TRUE(domain.is_empty);
+}
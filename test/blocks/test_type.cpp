@@ -43,8 +43,75 @@ TEST(GymboTypeTest, BinomialDist) {
 
     for (int i = 0; i < 3; i++) {
         ASSERT_EQ(bdist.vals[i], true_vals[i]);
-        ASSERT_EQ(bdist.probs[i], true_probs[i]);
+        ASSERT_FLOAT_EQ(bdist.probs[i], true_probs[i]);
+    }
+
+    // the pascal triangle of long long overflows for n > 60
+    gymbo::BinomialDist ldist(1000, 0.3);
+    ASSERT_EQ(ldist.probs.size(), 1001);
+    ASSERT_NEAR(ldist.mass(), 1.0f, 1e-5);
+    float mean = 0.0f;
+    for (int i = 0; i <= 1000; i++) {
+        mean += ldist.vals[i] * ldist.probs[i];
     }
+    ASSERT_NEAR(mean, 300.0f, 1e-2);
+    ASSERT_NEAR(ldist.log_probs[300],
+                std::lgamma(1001.0) - std::lgamma(301.0) - std::lgamma(701.0) +
+                    300.0 * std::log(0.3) + 700.0 * std::log(0.7),
+                1e-3);
+}
+
+TEST(GymboTypeTest, GeometricPoissonCategoricalDist) {
+    gymbo::GeometricDist gdist(0.5, 3);
+    ASSERT_EQ(gdist.vals.size(), 4);
+    ASSERT_FLOAT_EQ(gdist.probs[0], 8.0f / 15.0f);
+    ASSERT_FLOAT_EQ(gdist.probs[3], 1.0f / 15.0f);
+    ASSERT_FLOAT_EQ(gdist.cdf[3], 1.0f);
+
+    gymbo::GeometricDist gdist_auto(0.5);
+    ASSERT_NEAR(gdist_auto.probs[0], 0.5f, 1e-6);
+
+    gymbo::PoissonDist pdist(2.0);
+    ASSERT_NEAR(pdist.probs[0], std::exp(-2.0f), 1e-6);
+    ASSERT_NEAR(pdist.probs[3], std::exp(-2.0f) * 8.0f / 6.0f, 1e-6);
+    ASSERT_NEAR(pdist.mass(), 1.0f, 1e-6);
+
+    gymbo::CategoricalDist cdist({-1, 5, 7}, {1.0, 2.0, 1.0});
+    ASSERT_EQ(cdist.vals[1], 5);
+    ASSERT_FLOAT_EQ(cdist.probs[0], 0.25f);
+    ASSERT_FLOAT_EQ(cdist.probs[1], 0.5f);
+    ASSERT_FLOAT_EQ(cdist.log_probs[2], std::log(0.25f));
+    ASSERT_FLOAT_EQ(cdist.cdf[1], 0.75f);
+}
+
+TEST(GymboTypeTest, MakeDist) {
+    gymbo::DiscreteDist dist;
+    ASSERT_TRUE(gymbo::make_dist("geometric", {0.5}, dist));
+    ASSERT_NEAR(dist.probs[0], 0.5f, 1e-6);
+    ASSERT_TRUE(gymbo::make_dist("poisson", {0.0}, dist));
+    ASSERT_FLOAT_EQ(dist.probs[0], 1.0f);
+
+    // the arguments out of the domains are rejected
+    ASSERT_FALSE(gymbo::make_dist("geometric", {0.0}, dist));
+    ASSERT_FALSE(gymbo::make_dist("bernoulli", {1.5}, dist));
+    ASSERT_FALSE(gymbo::make_dist("binomial", {-1.0, 0.5}, dist));
+    ASSERT_FALSE(gymbo::make_dist("poisson", {-2.0}, dist));
+    ASSERT_FALSE(gymbo::make_dist("uniform", {3.0, 1.0}, dist));
+    ASSERT_FALSE(gymbo::make_dist("categorical", {1.0, -1.0, 2.0, 2.0}, dist));
+    ASSERT_FALSE(gymbo::make_dist("categorical", {1.0, 0.0}, dist));
+
+    // so are the supports too large to enumerate
+    ASSERT_FALSE(gymbo::make_dist("geometric", {1e-10}, dist));
+    ASSERT_FALSE(gymbo::make_dist("geometric", {0.5, 1e8}, dist));
+    ASSERT_FALSE(gymbo::make_dist("poisson", {1e12}, dist));
+    ASSERT_FALSE(gymbo::make_dist("binomial", {1e9, 0.5}, dist));
+    ASSERT_FALSE(gymbo::make_dist("uniform", {0.0, 1e10}, dist));
+    ASSERT_FALSE(gymbo::make_dist("uniform", {-2e9, 2e9}, dist));
+    ASSERT_TRUE(gymbo::make_dist("geometric", {1e-4}, dist));
+
+    // the constructors cap the automatic supports
+    gymbo::GeometricDist gdist(1e-10);
+    ASSERT_EQ(gdist.vals.size(), gymbo::MAX_SUPPORT_SIZE);
 }
 
 TEST(GymboTypeTest, SymProbSimple) {
@@ -89,3 +156,297 @@ TEST(GymboTypeTest, SymProbSimple) {
     std::unordered_map<int, float> params = {};
     ASSERT_EQ(0.5, prob.eval(params, 1.0, var2dist, D));
 }
+
+TEST(GymboTypeTest, SymProbFactorized) {
+    std::unordered_map<int, gymbo::DiscreteDist> var2dist;
+    for (int i = 0; i < 10; i++) {
+        var2dist.emplace(i, gymbo::BernoulliDist(0.3));
+    }
+
+    gymbo::Sym d_cond(
+        gymbo::SymType::SEq,
+        new gymbo::Sym(gymbo::SymType::SAny, (gymbo::Word32)0),
+        new gymbo::Sym(gymbo::SymType::SCon, gymbo::FloatToWord(1.0)));
+    gymbo::Sym n_cond(
+        gymbo::SymType::SAnd, &d_cond,
+        new gymbo::Sym(gymbo::SymType::SEq,
+                       new gymbo::Sym(gymbo::SymType::SAny, (gymbo::Word32)1),
+                       new gymbo::Sym(gymbo::SymType::SAny, (gymbo::Word32)2)));
+
+    std::unordered_map<int, float> params = {};
+    ASSERT_NEAR(0.3f * 0.58f,
+                gymbo::factorized_prob(&n_cond, params, 1.0, var2dist), 1e-6);
+    ASSERT_NEAR(0.3f, gymbo::factorized_prob(&d_cond, params, 1.0, var2dist),
+                1e-6);
+
+    gymbo::SymProb prob(&n_cond, &d_cond);
+    ASSERT_NEAR(0.58f, prob.eval(params, 1.0, var2dist), 1e-6);
+}
+
+TEST(GymboTypeTest, WeightedModelCounterChain) {
+    // Pr(var_0 == var_1 && var_1 == var_2 && ... && var_38 == var_39)
+    int n = 40;
+    std::unordered_map<int, gymbo::DiscreteDist> var2dist;
+    for (int i = 0; i < n; i++) {
+        var2dist.emplace(i, gymbo::BernoulliDist(0.3));
+    }
+
+    gymbo::Sym *cond = nullptr;
+    for (int i = 0; i < n - 1; i++) {
+        gymbo::Sym *eq = new gymbo::Sym(
+            gymbo::SymType::SEq,
+            new gymbo::Sym(gymbo::SymType::SAny, (gymbo::Word32)i),
+            new gymbo::Sym(gymbo::SymType::SAny, (gymbo::Word32)(i + 1)));
+        cond = (cond == nullptr)
+                   ? eq
+                   : new gymbo::Sym(gymbo::SymType::SAnd, cond, eq);
+    }
+
+    std::unordered_map<int, float> params = {};
+    gymbo::WeightedModelCounter counter(params, 1.0, var2dist);
+    ASSERT_NEAR(std::pow(0.3f, n) + std::pow(0.7f, n), counter.count(cond),
+                1e-9);
+    ASSERT_GT(counter.cache.size(), 0);
+
+    // fixing a variable of the chain
+    params.emplace(0, 1.0f);
+    ASSERT_NEAR(std::pow(0.3f, n - 1),
+                gymbo::factorized_prob(cond, params, 1.0, var2dist), 1e-12);
+}
+
+TEST(GymboTypeTest, WeightedModelCounterBranch) {
+    // branching on every variable gives the same weight as the enumeration,
+    // although the branches share the cached components
+    std::unordered_map<int, gymbo::DiscreteDist> var2dist = {
+        {0, gymbo::DiscreteUniformDist(1, 3)},
+        {1, gymbo::BernoulliDist(0.3)},
+        {2, gymbo::DiscreteUniformDist(0, 2)},
+        {3, gymbo::BernoulliDist(0.6)}};
+    auto var = [](int i) {
+        return new gymbo::Sym(gymbo::SymType::SAny, (gymbo::Word32)i);
+    };
+
+    // (var_0 < var_2 + var_1) && (var_1 == var_3) && (var_2 != var_3)
+    gymbo::Sym *cond = new gymbo::Sym(
+        gymbo::SymType::SAnd,
+        new gymbo::Sym(
+            gymbo::SymType::SAnd,
+            new gymbo::Sym(gymbo::SymType::SLt, var(0),
+                           new gymbo::Sym(gymbo::SymType::SAdd, var(2),
+                                          var(1))),
+            new gymbo::Sym(gymbo::SymType::SEq, var(1), var(3))),
+        new gymbo::Sym(gymbo::SymType::SNot,
+                       new gymbo::Sym(gymbo::SymType::SEq, var(2), var(3))));
+
+    std::unordered_map<int, float> params = {};
+    gymbo::WeightedModelCounter enumerator(params, 1.0, var2dist, 1 << 20);
+    gymbo::WeightedModelCounter brancher(params, 1.0, var2dist, 1);
+    float expected = enumerator.count(cond);
+    ASSERT_GT(expected, 0.0f);
+    ASSERT_NEAR(expected, brancher.count(cond), 1e-6);
+}
+
+TEST(GymboTypeTest, SymProbEstimate) {
+    std::unordered_map<int, gymbo::DiscreteDist> var2dist = {
+        {0, gymbo::DiscreteUniformDist(1, 6)},
+        {1, gymbo::BinomialDist(20, 0.1)}};
+
+    // Pr(var_1 < 4 | var_0 <= 3)
+    gymbo::Sym d_cond(
+        gymbo::SymType::SLe,
+        new gymbo::Sym(gymbo::SymType::SAny, (gymbo::Word32)0),
+        new gymbo::Sym(gymbo::SymType::SCon, gymbo::FloatToWord(3.0)));
+    gymbo::Sym n_cond(
+        gymbo::SymType::SAnd, &d_cond,
+        new gymbo::Sym(
+            gymbo::SymType::SLt,
+            new gymbo::Sym(gymbo::SymType::SAny, (gymbo::Word32)1),
+            new gymbo::Sym(gymbo::SymType::SCon, gymbo::FloatToWord(4.0))));
+
+    std::unordered_map<int, float> params = {};
+    gymbo::SymProb prob(&n_cond, &d_cond);
+    float exact = prob.eval(params, 1.0, var2dist);
+
+    gymbo::ProbEstimate mc = prob.estimate(params, 1.0, var2dist, 0.01);
+    ASSERT_LE(mc.upper - mc.prob, 0.01 + 1e-6);
+    ASSERT_NEAR(mc.prob, exact, 0.02);
+    ASSERT_LE(mc.lower, mc.prob);
+    ASSERT_GE(mc.upper, mc.prob);
+
+    gymbo::ProbEstimate is =
+        prob.estimate(params, 1.0, var2dist, 0.01, 1.96, 1 << 20, 42, true);
+    ASSERT_NEAR(is.prob, exact, 0.02);
+}
+
+TEST(GymboTypeTest, SymProbCache) {
+    std::unordered_map<int, gymbo::DiscreteDist> var2dist = {
+        {0, gymbo::DiscreteUniformDist(1, 3)},
+        {1, gymbo::DiscreteUniformDist(1, 3)}};
+
+    gymbo::Sym d_cond(
+        gymbo::SymType::SEq,
+        new gymbo::Sym(gymbo::SymType::SAny, (gymbo::Word32)0),
+        new gymbo::Sym(gymbo::SymType::SCon, gymbo::FloatToWord(1.0)));
+    gymbo::Sym d_cond_copy(
+        gymbo::SymType::SEq,
+        new gymbo::Sym(gymbo::SymType::SAny, (gymbo::Word32)0),
+        new gymbo::Sym(gymbo::SymType::SCon, gymbo::FloatToWord(1.0)));
+    gymbo::Sym n_cond(
+        gymbo::SymType::SAnd, &d_cond,
+        new gymbo::Sym(gymbo::SymType::SLt,
+                       new gymbo::Sym(gymbo::SymType::SAny, (gymbo::Word32)1),
+                       new gymbo::Sym(gymbo::SymType::SAny, (gymbo::Word32)2)));
+    ASSERT_EQ(d_cond.hash(), d_cond_copy.hash());
+    ASSERT_NE(d_cond.hash(), n_cond.hash());
+
+    gymbo::SymProbCache cache;
+    gymbo::SymProb prob(&n_cond, &d_cond_copy);
+    std::unordered_map<int, float> params = {{2, 3.0f}};
+
+    float p = prob.eval(params, 1.0, var2dist, cache);
+    ASSERT_NEAR(p, 2.0f / 3.0f, 1e-6);
+    ASSERT_EQ(cache.num_misses, 2);
+    ASSERT_EQ(prob.eval(params, 1.0, var2dist, cache), p);
+    ASSERT_EQ(cache.num_hits, 2);
+
+    // the value of a fixed variable is a part of the key
+    params[2] = 2.0f;
+    ASSERT_NEAR(prob.eval(params, 1.0, var2dist, cache), 1.0f / 3.0f, 1e-6);
+    ASSERT_EQ(cache.num_misses, 3);
+
+    // an entry of another query under the same hash is not returned
+    for (auto &bucket : cache.table) {
+        for (auto &e : bucket.second) {
+            if (e.cond == &d_cond_copy) {
+                e.cond = &n_cond;
+            }
+        }
+    }
+    ASSERT_NEAR(cache.prob(&d_cond, params, 1.0, var2dist,
+                           gymbo::dist_signature(var2dist)),
+                1.0f / 3.0f, 1e-6);
+    ASSERT_EQ(cache.num_misses, 4);
+}
+
+TEST(GymboTypeTest, Normalize) {
+    gymbo::Word32 var_id_0 = 0, var_id_1 = 1;
+    gymbo::Sym *x = new gymbo::Sym(gymbo::SymType::SAny, var_id_0);
+    gymbo::Sym *y = new gymbo::Sym(gymbo::SymType::SAny, var_id_1);
+    auto con = [](float v) {
+        return new gymbo::Sym(gymbo::SymType::SCon, gymbo::FloatToWord(v));
+    };
+
+    // x - x is 0, and (x + 1) + 2 is x + 3
+    gymbo::Sym diff(gymbo::SymType::SSub, x, x);
+    ASSERT_EQ(diff.normalize()->toString(true), "0");
+    gymbo::Sym nested(gymbo::SymType::SAdd,
+                      new gymbo::Sym(gymbo::SymType::SAdd, x, con(1.0f)),
+                      con(2.0f));
+    ASSERT_EQ(nested.normalize()->toString(true), "(var_0+3)");
+
+    // 2 * (y + x) - x * y + y * x - y is x + y
+    gymbo::Sym linear(
+        gymbo::SymType::SSub,
+        new gymbo::Sym(
+            gymbo::SymType::SAdd,
+            new gymbo::Sym(
+                gymbo::SymType::SSub,
+                new gymbo::Sym(gymbo::SymType::SMul, con(2.0f),
+                               new gymbo::Sym(gymbo::SymType::SAdd, y, x)),
+                new gymbo::Sym(gymbo::SymType::SMul, x, y)),
+            new gymbo::Sym(gymbo::SymType::SMul, y, x)),
+        y);
+    ASSERT_EQ(linear.normalize()->toString(true), "((2*var_0)+var_1)");
+
+    // atoms are identified by their structures rather than their printed
+    // forms, which round the constants
+    gymbo::Sym close(
+        gymbo::SymType::SSub,
+        new gymbo::Sym(gymbo::SymType::SDiv, x, con(0.1234561f)),
+        new gymbo::Sym(gymbo::SymType::SDiv, x, con(0.1234564f)));
+    ASSERT_NE(close.normalize()->symtype, gymbo::SymType::SCon);
+    gymbo::Sym masks(
+        gymbo::SymType::SSub,
+        new gymbo::Sym(gymbo::SymType::SBitAnd, x, con(3000000000.0f)),
+        new gymbo::Sym(gymbo::SymType::SBitAnd, x, con(4000000000.0f)));
+    ASSERT_NE(masks.normalize()->symtype, gymbo::SymType::SCon);
+    gymbo::Sym same(gymbo::SymType::SSub,
+                    new gymbo::Sym(gymbo::SymType::SDiv, x, con(0.5f)),
+                    new gymbo::Sym(gymbo::SymType::SDiv, x, con(0.5f)));
+    ASSERT_EQ(same.normalize()->toString(true), "0");
+
+    // 3 == 2 - x and x + 1 == 0 have the same normal form
+    gymbo::Sym eq1(gymbo::SymType::SEq, con(3.0f),
+                   new gymbo::Sym(gymbo::SymType::SSub, con(2.0f), x));
+    gymbo::Sym eq2(gymbo::SymType::SEq,
+                   new gymbo::Sym(gymbo::SymType::SAdd, x, con(1.0f)),
+                   con(0.0f));
+    ASSERT_EQ(eq1.normalize()->toString(true), "(var_0==-1)");
+    ASSERT_EQ(eq2.normalize()->toString(true), "(var_0==-1)");
+
+    // !((x < y) && (y <= 1)) is (y <= x) || (1 < y)
+    gymbo::Sym neg(
+        gymbo::SymType::SNot,
+        new gymbo::Sym(gymbo::SymType::SAnd,
+                       new gymbo::Sym(gymbo::SymType::SLt, x, y),
+                       new gymbo::Sym(gymbo::SymType::SLe, y, con(1.0f))));
+    gymbo::Sym *normalized = neg.normalize();
+    ASSERT_EQ(normalized->toString(true), "((var_1<=var_0)||(1<var_1))");
+
+    // the rewrites keep the values of the losses
+    for (float vx : {-2.0f, 0.0f, 1.5f, 4.0f}) {
+        for (float vy : {-1.0f, 1.0f, 3.0f}) {
+            std::unordered_map<int, float> params = {{0, vx}, {1, vy}};
+            ASSERT_FLOAT_EQ(neg.eval(params, 1.0f),
+                            normalized->eval(params, 1.0f));
+            ASSERT_FLOAT_EQ(linear.eval(params, 1.0f),
+                            linear.normalize()->eval(params, 1.0f));
+            ASSERT_FLOAT_EQ(eq1.eval(params, 1.0f),
+                            eq1.normalize()->eval(params, 1.0f));
+        }
+    }
+}
+
+TEST(GymboTypeTest, LinearForm) {
+    gymbo::Word32 var_id_0 = 0, var_id_1 = 1, var_id_2 = 2;
+    gymbo::Sym *x = new gymbo::Sym(gymbo::SymType::SAny, var_id_0);
+    gymbo::Sym *y = new gymbo::Sym(gymbo::SymType::SAny, var_id_1);
+    gymbo::Sym *z = new gymbo::Sym(gymbo::SymType::SAny, var_id_2);
+    auto con = [](float v) {
+        return new gymbo::Sym(gymbo::SymType::SCon, gymbo::FloatToWord(v));
+    };
+
+    // 3 * x - (y - 2 * z) - 5 is a dense form with the same string
+    gymbo::Sym affine(
+        gymbo::SymType::SSub,
+        new gymbo::Sym(
+            gymbo::SymType::SSub,
+            new gymbo::Sym(gymbo::SymType::SMul, con(3.0f), x),
+            new gymbo::Sym(gymbo::SymType::SSub, y,
+                           new gymbo::Sym(gymbo::SymType::SMul, con(2.0f),
+                                          z))),
+        con(5.0f));
+    gymbo::Sym *lin = affine.normalize();
+    ASSERT_EQ(lin->symtype, gymbo::SymType::SLin);
+    ASSERT_EQ(lin->toString(true), "((((3*var_0)-var_1)+(2*var_2))-5)");
+    ASSERT_EQ(lin->toString(true), lin->expand()->toString(true));
+
+    // the gradient is constant
+    std::unordered_map<int, float> params = {{0, 1.5f}, {1, -2.0f}, {2, 4.0f}};
+    gymbo::Grad g = lin->grad(params, 1.0f);
+    ASSERT_FLOAT_EQ(g.val[0], 3.0f);
+    ASSERT_FLOAT_EQ(g.val[1], -1.0f);
+    ASSERT_FLOAT_EQ(g.val[2], 2.0f);
+    ASSERT_EQ(lin->eval(params, 1.0f), lin->expand()->eval(params, 1.0f));
+    ASSERT_FLOAT_EQ(lin->eval(params, 1.0f), affine.eval(params, 1.0f));
+
+    // folding the known variables leaves a single variable as a tree
+    gymbo::Mem cvals = {{1, gymbo::FloatToWord(2.0f)},
+                        {2, gymbo::FloatToWord(1.0f)}};
+    ASSERT_EQ(lin->psimplify(cvals)->toString(true), "((3*var_0)-5)");
+
+    // a product of variables keeps the form as a tree
+    gymbo::Sym mixed(gymbo::SymType::SAdd,
+                     new gymbo::Sym(gymbo::SymType::SMul, x, y), z);
+    ASSERT_NE(mixed.normalize()->symtype, gymbo::SymType::SLin);
+}
@@ -56,3 +56,28 @@ TEST(LinkedlistTest, Len) {
     // Check the length of the linked list
     EXPECT_EQ(list.len(), 3);
 }
+
+// Test MixedRadixCounter enumerates every combination once
+TEST(MixedRadixCounterTest, Next) {
+    gymbo::MixedRadixCounter counter({2, 3});
+    ASSERT_TRUE(counter.valid());
+
+    std::vector<std::vector<int>> combinations;
+    do {
+        combinations.push_back(counter.digits);
+    } while (counter.next() != 0);
+
+    std::vector<std::vector<int>> expected = {{0, 0}, {1, 0}, {0, 1},
+                                              {1, 1}, {0, 2}, {1, 2}};
+    EXPECT_EQ(combinations, expected);
+    EXPECT_FALSE(gymbo::MixedRadixCounter({2, 0}).valid());
+}
+
+// Test cartesianProduct keeps the nested-loop order
+TEST(CartesianProductTest, Order) {
+    std::vector<std::vector<int>> result =
+        gymbo::cartesianProduct({{1, 2}, {3, 4, 5}});
+    std::vector<std::vector<int>> expected = {{1, 3}, {1, 4}, {1, 5},
+                                              {2, 3}, {2, 4}, {2, 5}};
+    EXPECT_EQ(result, expected);
+}
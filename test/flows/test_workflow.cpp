@@ -1,5 +1,6 @@
 #include "../../libgymbo/compiler.h"
 #include "../../libgymbo/psymbolic.h"
+#include "../../libgymbo/query.h"
 #include "gtest/gtest.h"
 
 int max_depth = 65536;
@@ -18,6 +19,64 @@ bool ignore_memory = false;
 bool use_dpll = false;
 bool init_param_uniform_int = true;
 
+/**
+ * @brief Compiles the source of a test program.
+ *
+ * @param code_str The source.
+ * @param var_counter The mapping from variable name to variable id.
+ * @param prg The compiled program.
+ * @param summarize_loops If true, simple counting loops are summarized.
+ * @param int_vars If given, the variables declared as integers are gathered
+ * into it.
+ */
+void compile(const std::string &code_str,
+             std::unordered_map<std::string, int> &var_counter,
+             gymbo::Prog &prg, bool summarize_loops = false,
+             std::unordered_set<int> *int_vars = nullptr) {
+    // the tokens point into the source
+    char *user_input = strdup(code_str.c_str());
+    std::vector<gymbo::Node *> code;
+    gymbo::Token *token = gymbo::tokenize(user_input, var_counter);
+    gymbo::generate_ast(token, user_input, code);
+    gymbo::compile_ast(code, prg, summarize_loops);
+    if (int_vars != nullptr) {
+        for (gymbo::Node *node : code) {
+            gymbo::gather_int_vars(node, *int_vars);
+        }
+    }
+}
+
+/**
+ * @brief Returns the pc of the first `return` of the main program, so that
+ * only the paths reaching it are solved.
+ */
+std::unordered_set<int> first_return(const gymbo::Prog &prg) {
+    std::unordered_set<int> target_pcs;
+    for (size_t j = 0; j < prg.size(); j++) {
+        if (prg[j].instr == gymbo::InstrType::Done) {
+            target_pcs.emplace(j);
+            break;
+        }
+    }
+    return target_pcs;
+}
+
+/**
+ * @brief Returns the optimizer with the default parameters of the tests.
+ */
+gymbo::GDOptimizer default_optimizer() {
+    return gymbo::GDOptimizer(num_itrs, step_size, eps, param_low, param_high,
+                              sign_grad, init_param_uniform_int, seed);
+}
+
+/**
+ * @brief Returns the executor with the default parameters of the tests.
+ */
+gymbo::SExecutor default_executor(const gymbo::GDOptimizer &optimizer) {
+    return gymbo::SExecutor(optimizer, maxSAT, maxUNSAT, max_num_trials,
+                            ignore_memory, use_dpll, verbose_level);
+}
+
 TEST(GymboWorkflowTest, Block) {
     std::string code_str =
         "if (a > 2) {\n"
@@ -180,3 +239,910 @@ TEST(GymboWorkflowTest, MontyHall) {
         ASSERT_NEAR(expected_value, true_expected_val[i], 1e-6f);
     }
 }
+
+TEST(GymboWorkflowTest, ProbabilityGuidedSearch) {
+    std::string code_str = R"(
+    a ~ bernoulli(0.9);
+    b ~ bernoulli(0.5);
+    if (a == 1) {
+        if (b == 1) {
+            r = 1;
+        } else {
+            r = 2;
+        }
+    } else {
+        if (b == 1) {
+            r = 3;
+        } else {
+            r = 4;
+        }
+    }
+    return r;)";
+
+    char *user_input = const_cast<char *>(code_str.c_str());
+
+    std::unordered_map<std::string, int> var_counter;
+    std::vector<gymbo::Node *> code;
+    std::unordered_map<int, gymbo::DiscreteDist> var2dist;
+
+    gymbo::Prog prg;
+    gymbo::GDOptimizer optimizer(num_itrs, step_size, eps, param_low,
+                                 param_high, sign_grad, init_param_uniform_int,
+                                 seed);
+    std::unordered_set<int> target_pcs;
+
+    gymbo::Token *token = gymbo::tokenize(user_input, var_counter);
+    gymbo::generate_ast(token, user_input, code);
+    gymbo::compile_ast(code, prg, var2dist);
+
+    auto summarize = [&](gymbo::PSExecutor &executor, float &total_prob,
+                         float &expected_value) {
+        std::unordered_map<int, float> params;
+        total_prob = 0.0f;
+        expected_value = 0.0f;
+        for (auto &cc : executor.prob_constraints_table) {
+            for (auto &ccv : cc.second) {
+                float p = executor.eval_prob(std::get<2>(ccv), params);
+                total_prob += p;
+                expected_value +=
+                    p *
+                    gymbo::wordToFloat(std::get<1>(ccv)[var_counter["r"]]);
+            }
+        }
+    };
+    float total_prob, expected_value;
+
+    // exhaustive best-first search
+    gymbo::SymState init_1;
+    gymbo::PSExecutor executor_1(optimizer, maxSAT, maxUNSAT, max_num_trials,
+                                 ignore_memory, use_dpll, verbose_level);
+    executor_1.register_random_vars(var2dist);
+    executor_1.run_best_first(prg, target_pcs, init_1, max_depth);
+    summarize(executor_1, total_prob, expected_value);
+    ASSERT_NEAR(total_prob, 1.0f, 1e-6f);
+    ASSERT_NEAR(expected_value, 1.7f, 1e-6f);
+    ASSERT_EQ(executor_1.frontier_mass, 0.0f);
+
+    // depth-first search pruning the paths with a == 0
+    gymbo::SymState init_2;
+    gymbo::PSExecutor executor_2(optimizer, maxSAT, maxUNSAT, max_num_trials,
+                                 ignore_memory, use_dpll, verbose_level);
+    executor_2.register_random_vars(var2dist);
+    executor_2.prob_threshold = 0.2f;
+    executor_2.run(prg, target_pcs, init_2, max_depth);
+    summarize(executor_2, total_prob, expected_value);
+    ASSERT_NEAR(total_prob, 0.9f, 1e-6f);
+    ASSERT_NEAR(executor_2.pruned_mass, 0.1f, 1e-6f);
+
+    // anytime best-first search
+    gymbo::SymState init_3;
+    gymbo::PSExecutor executor_3(optimizer, maxSAT, maxUNSAT, max_num_trials,
+                                 ignore_memory, use_dpll, verbose_level);
+    executor_3.register_random_vars(var2dist);
+    executor_3.mass_tolerance = 0.15f;
+    executor_3.run_best_first(prg, target_pcs, init_3, max_depth);
+    summarize(executor_3, total_prob, expected_value);
+    ASSERT_NEAR(total_prob, 0.9f, 1e-6f);
+    ASSERT_NEAR(expected_value, 0.45f * 1.0f + 0.45f * 2.0f, 1e-6f);
+    ASSERT_NEAR(executor_3.frontier_mass, 0.1f, 1e-6f);
+
+    // the states cut by the depth bound are pruned
+    for (bool best_first : {false, true}) {
+        gymbo::SymState init_4;
+        gymbo::PSExecutor executor_4(optimizer, maxSAT, maxUNSAT,
+                                     max_num_trials, ignore_memory, use_dpll,
+                                     verbose_level);
+        executor_4.register_random_vars(var2dist);
+        if (best_first) {
+            executor_4.run_best_first(prg, target_pcs, init_4, 20);
+        } else {
+            executor_4.run(prg, target_pcs, init_4, 20);
+        }
+        summarize(executor_4, total_prob, expected_value);
+        ASSERT_GT(total_prob, 0.0f);
+        ASSERT_LT(total_prob, 1.0f);
+        ASSERT_NEAR(total_prob + executor_4.pruned_mass, 1.0f, 1e-6f);
+    }
+}
+
+TEST(GymboWorkflowTest, ProbabilisticLoopUnrollBound) {
+    // the loop is iterated `n` times, and the paths with n > 3 are cut by the
+    // unroll bound
+    std::string code_str = R"(
+    n ~ uniform(1, 6);
+    i = 0;
+    while (i < n) {
+        i = i + 1;
+    }
+    return i;)";
+
+    char *user_input = const_cast<char *>(code_str.c_str());
+
+    std::unordered_map<std::string, int> var_counter;
+    std::vector<gymbo::Node *> code;
+    std::unordered_map<int, gymbo::DiscreteDist> var2dist;
+
+    gymbo::Prog prg;
+    gymbo::GDOptimizer optimizer = default_optimizer();
+    std::unordered_set<int> target_pcs;
+
+    gymbo::Token *token = gymbo::tokenize(user_input, var_counter);
+    gymbo::generate_ast(token, user_input, code);
+    gymbo::compile_ast(code, prg, var2dist);
+
+    for (bool best_first : {false, true}) {
+        gymbo::SymState init;
+        gymbo::PSExecutor executor(optimizer, maxSAT, maxUNSAT,
+                                   max_num_trials, ignore_memory, use_dpll,
+                                   verbose_level);
+        executor.register_random_vars(var2dist);
+        executor.max_unroll = 3;
+        if (best_first) {
+            executor.run_best_first(prg, target_pcs, init, max_depth);
+        } else {
+            executor.run(prg, target_pcs, init, max_depth);
+        }
+
+        std::unordered_map<int, float> params;
+        float total_prob = 0.0f;
+        for (auto &cc : executor.prob_constraints_table) {
+            for (auto &ccv : cc.second) {
+                float p = executor.eval_prob(std::get<2>(ccv), params);
+                total_prob += p;
+                if (p > 0.0f) {
+                    ASSERT_LE(gymbo::wordToFloat(
+                                  std::get<1>(ccv)[var_counter["i"]]),
+                              3.0f);
+                }
+            }
+        }
+        ASSERT_NEAR(total_prob, 0.5f, 1e-5f);
+        ASSERT_NEAR(executor.pruned_mass, 0.5f, 1e-5f);
+    }
+}
+
+TEST(GymboWorkflowTest, ProbQuery) {
+    std::string code_str = R"(
+    a ~ bernoulli(0.9);
+    b ~ bernoulli(0.5);
+    if (a == 1) {
+        if (b == 1) {
+            r = 1;
+        } else {
+            r = 2;
+        }
+    } else {
+        if (b == 1) {
+            r = 3;
+        } else {
+            r = 4;
+        }
+    }
+    return r;)";
+
+    char *user_input = const_cast<char *>(code_str.c_str());
+
+    std::unordered_map<std::string, int> var_counter;
+    std::vector<gymbo::Node *> code;
+    std::unordered_map<int, gymbo::DiscreteDist> var2dist;
+
+    gymbo::Prog prg;
+    gymbo::GDOptimizer optimizer(num_itrs, step_size, eps, param_low,
+                                 param_high, sign_grad, init_param_uniform_int,
+                                 seed);
+    gymbo::SymState init;
+    std::unordered_set<int> target_pcs;
+
+    gymbo::Token *token = gymbo::tokenize(user_input, var_counter);
+    gymbo::generate_ast(token, user_input, code);
+    gymbo::compile_ast(code, prg, var2dist);
+
+    gymbo::PSExecutor executor(optimizer, maxSAT, maxUNSAT, max_num_trials,
+                               ignore_memory, use_dpll, verbose_level);
+    executor.register_random_vars(var2dist);
+    executor.run(prg, target_pcs, init, max_depth);
+
+    gymbo::ProbQuery query(executor);
+    int r = var_counter["r"];
+    ASSERT_NEAR(query.mass(), 1.0f, 1e-6f);
+    ASSERT_NEAR(query.expectation(r), 1.7f, 1e-5f);
+    ASSERT_NEAR(query.variance(r), 3.5f - 1.7f * 1.7f, 1e-5f);
+    ASSERT_NEAR(query.cdf(r, 2.0f), 0.9f, 1e-6f);
+    // a random variable not stored in the memory is marginalized
+    ASSERT_NEAR(query.expectation(var_counter["b"]), 0.5f, 1e-6f);
+
+    ASSERT_NEAR(query.query("E[r]", var_counter), 1.7f, 1e-5f);
+    ASSERT_NEAR(query.query("P[r <= 2]", var_counter), 0.9f, 1e-6f);
+    ASSERT_NEAR(query.query("P[r == 1 | b == 1]", var_counter), 0.9f, 1e-6f);
+    ASSERT_NEAR(query.query("P[a == 0 | r == 3 || r == 4]", var_counter),
+                1.0f, 1e-6f);
+    // a parenthesized `|` is a bitwise OR
+    ASSERT_NEAR(query.query("P[(r | 0) == 1]", var_counter), 0.45f, 1e-6f);
+    ASSERT_NEAR(query.query("P[(r | 0) == 1 | b == 1]", var_counter), 0.9f,
+                1e-6f);
+    // a query on a variable outside the program is rejected
+    size_t num_vars = var_counter.size();
+    ASSERT_TRUE(std::isnan(query.query("P[r == 1 | zz == 1]", var_counter)));
+    ASSERT_TRUE(std::isnan(query.query("E[zz]", var_counter)));
+    ASSERT_EQ(var_counter.size(), num_vars);
+    // so is an expression that is not an event
+    ASSERT_TRUE(std::isnan(query.query("P[r = 1]", var_counter)));
+    // a malformed query is rejected without exiting
+    ASSERT_TRUE(std::isnan(query.query("P[r <]", var_counter)));
+    ASSERT_TRUE(std::isnan(query.query("E[(r]", var_counter)));
+    ASSERT_EQ(gymbo::ProbQuery::parse_event("r < $", var_counter), nullptr);
+    // so are an unknown query and a pc that is not a number
+    ASSERT_TRUE(std::isnan(query.query("M[r]", var_counter)));
+    ASSERT_TRUE(std::isnan(query.query("E[r]@foo", var_counter)));
+    ASSERT_TRUE(std::isnan(query.query("E[r]@", var_counter)));
+    ASSERT_TRUE(std::isnan(query.query("E[r]x", var_counter)));
+    // while a valid answer may be zero
+    ASSERT_EQ(query.query("P[r == 5]", var_counter), 0.0f);
+
+    int done_pc = executor.prob_constraints_table.begin()->first;
+    ASSERT_NEAR(query.expectation(r, done_pc), 1.7f, 1e-5f);
+    ASSERT_NEAR(query.query("E[r]@" + std::to_string(done_pc), var_counter),
+                1.7f, 1e-5f);
+}
+
+TEST(GymboWorkflowTest, ProbQuerySampling) {
+    std::string code_str = R"(
+    a ~ uniform(1, 6);
+    b ~ binomial(20, 0.3);
+    if (a <= 2) {
+        r = 1;
+    } else {
+        r = 2;
+    }
+    return r;)";
+
+    char *user_input = const_cast<char *>(code_str.c_str());
+
+    std::unordered_map<std::string, int> var_counter;
+    std::vector<gymbo::Node *> code;
+    std::unordered_map<int, gymbo::DiscreteDist> var2dist;
+
+    gymbo::Prog prg;
+    gymbo::GDOptimizer optimizer = default_optimizer();
+    std::unordered_set<int> target_pcs;
+
+    gymbo::Token *token = gymbo::tokenize(user_input, var_counter);
+    gymbo::generate_ast(token, user_input, code);
+    gymbo::compile_ast(code, prg, var2dist);
+
+    std::vector<std::string> queries = {"E[r]", "P[r == 1]", "P[b < 5]",
+                                        "P[b < 5 | r == 1]", "E[b]"};
+    std::vector<std::vector<float>> answers;
+    for (bool use_sampling : {false, true}) {
+        gymbo::SymState init;
+        gymbo::PSExecutor executor(optimizer, maxSAT, maxUNSAT,
+                                   max_num_trials, ignore_memory, use_dpll,
+                                   verbose_level);
+        executor.register_random_vars(var2dist);
+        executor.prob_cache.use_sampling = use_sampling;
+        executor.run(prg, target_pcs, init, max_depth);
+
+        gymbo::ProbQuery query(executor);
+        std::vector<float> answer;
+        for (const std::string &q : queries) {
+            answer.emplace_back(query.query(q, var_counter));
+        }
+        answers.emplace_back(answer);
+    }
+
+    ASSERT_NEAR(answers[0][0], 2.0f - 1.0f / 3.0f, 1e-5f);
+    ASSERT_NEAR(answers[0][4], 6.0f, 1e-4f);
+    for (size_t j = 0; j < queries.size(); j++) {
+        // E[b] adds up the estimates of the 21 values of b
+        float tolerance = (j == 4) ? 0.3f : 0.03f;
+        ASSERT_NEAR(answers[1][j], answers[0][j], tolerance) << queries[j];
+    }
+}
+
+TEST(GymboWorkflowTest, ProbQueryDerivedVariable) {
+    // `y` is kept in the symbolic memory as `r + 1`
+    std::string code_str = R"(
+    r ~ bernoulli(0.5);
+    y = r + 1;
+    if (y == 2) {
+        z = 1;
+    }
+    return 0;)";
+
+    char *user_input = const_cast<char *>(code_str.c_str());
+
+    std::unordered_map<std::string, int> var_counter;
+    std::vector<gymbo::Node *> code;
+    std::unordered_map<int, gymbo::DiscreteDist> var2dist;
+
+    gymbo::Prog prg;
+    gymbo::GDOptimizer optimizer = default_optimizer();
+    gymbo::SymState init;
+    std::unordered_set<int> target_pcs;
+
+    gymbo::Token *token = gymbo::tokenize(user_input, var_counter);
+    gymbo::generate_ast(token, user_input, code);
+    gymbo::compile_ast(code, prg, var2dist);
+
+    gymbo::PSExecutor executor(optimizer, maxSAT, maxUNSAT, max_num_trials,
+                               ignore_memory, use_dpll, verbose_level);
+    executor.register_random_vars(var2dist);
+    executor.run(prg, target_pcs, init, max_depth);
+
+    gymbo::ProbQuery query(executor);
+    ASSERT_NEAR(query.expectation(var_counter["y"]), 1.5f, 1e-6f);
+    ASSERT_NEAR(query.variance(var_counter["y"]), 0.25f, 1e-6f);
+    ASSERT_NEAR(query.query("E[y]", var_counter), 1.5f, 1e-6f);
+    ASSERT_NEAR(query.query("P[y == 2]", var_counter), 0.5f, 1e-6f);
+    ASSERT_NEAR(query.query("P[z == 1 | y == 2]", var_counter), 1.0f, 1e-6f);
+    ASSERT_EQ(query.dropped_mass, 0.0f);
+}
+
+TEST(GymboWorkflowTest, ProbQueryDroppedMass) {
+    // `y` depends on the non-random input `x` when `r == 1`
+    std::string code_str = R"(
+    r ~ bernoulli(0.5);
+    if (r == 1) {
+        y = x;
+    } else {
+        y = 2;
+    }
+    return 0;)";
+
+    char *user_input = const_cast<char *>(code_str.c_str());
+
+    std::unordered_map<std::string, int> var_counter;
+    std::vector<gymbo::Node *> code;
+    std::unordered_map<int, gymbo::DiscreteDist> var2dist;
+
+    gymbo::Prog prg;
+    gymbo::GDOptimizer optimizer = default_optimizer();
+    gymbo::SymState init;
+    std::unordered_set<int> target_pcs;
+
+    gymbo::Token *token = gymbo::tokenize(user_input, var_counter);
+    gymbo::generate_ast(token, user_input, code);
+    gymbo::compile_ast(code, prg, var2dist);
+
+    gymbo::PSExecutor executor(optimizer, maxSAT, maxUNSAT, max_num_trials,
+                               ignore_memory, use_dpll, verbose_level);
+    executor.register_random_vars(var2dist);
+    executor.run(prg, target_pcs, init, max_depth);
+
+    gymbo::ProbQuery query(executor);
+    ASSERT_NEAR(query.expectation(var_counter["y"]), 2.0f, 1e-6f);
+    ASSERT_NEAR(query.dropped_mass, 0.5f, 1e-6f);
+
+    // the value is determined once the input is given as a parameter
+    gymbo::ProbQuery query_x(executor, {{var_counter["x"], 4.0f}});
+    ASSERT_NEAR(query_x.expectation(var_counter["y"]), 3.0f, 1e-6f);
+    ASSERT_EQ(query_x.dropped_mass, 0.0f);
+}
+
+TEST(GymboWorkflowTest, Loop) {
+    std::string code_str =
+        "s = 0;\n"
+        "for (i = 0; i < 5; i = i + 1) {\n"
+        "    s = s + x;\n"
+        "}\n"
+        "if (s == 10)\n"
+        "    return 1;";
+
+    for (bool summarize_loops : {false, true}) {
+        std::unordered_map<std::string, int> var_counter;
+        gymbo::Prog prg;
+        compile(code_str, var_counter, prg, summarize_loops);
+
+        gymbo::SymState init;
+        std::unordered_set<int> target_pcs;
+        gymbo::SExecutor executor = default_executor(default_optimizer());
+        executor.run(prg, target_pcs, init, max_depth);
+
+        // the concrete loop condition does not fork the paths
+        ASSERT_EQ(executor.constraints_cache.size(), 2);
+        bool found = false;
+        for (auto &cc : executor.constraints_cache) {
+            ASSERT_TRUE(cc.second.first);
+            auto itr = cc.second.second.find(var_counter["x"]);
+            if (itr != cc.second.second.end() && itr->second == 2.0f) {
+                found = true;
+            }
+        }
+        ASSERT_TRUE(found);
+    }
+}
+
+TEST(GymboWorkflowTest, LoopConditionMargin) {
+    // a concrete loop condition is evaluated with the margin of the strict
+    // inequalities used by the solver, i.e., 0.5 < 1 does not hold when
+    // eps = 1.
+    std::string code_str =
+        "s = 0;\n"
+        "for (i = 0; i < 1; i = i + 0.5) {\n"
+        "    s = s + 1;\n"
+        "}\n"
+        "if (x == s)\n"
+        "    return 1;";
+
+    std::unordered_map<std::string, int> var_counter;
+    gymbo::Prog prg;
+    compile(code_str, var_counter, prg);
+
+    gymbo::SymState init;
+    std::unordered_set<int> target_pcs = first_return(prg);
+    gymbo::SExecutor executor = default_executor(default_optimizer());
+    executor.run(prg, target_pcs, init, max_depth);
+
+    ASSERT_EQ(executor.constraints_cache.size(), 1);
+    for (auto &cc : executor.constraints_cache) {
+        ASSERT_TRUE(cc.second.first);
+        ASSERT_EQ(cc.second.second[var_counter["x"]], 1.0f);
+    }
+}
+
+TEST(GymboWorkflowTest, LoopUnrollBound) {
+    std::string code_str =
+        "i = 0;\n"
+        "while (i < x) {\n"
+        "    i = i + 1;\n"
+        "}\n"
+        "if (i == 3)\n"
+        "    return 1;";
+
+    std::unordered_map<std::string, int> var_counter;
+    gymbo::Prog prg;
+    compile(code_str, var_counter, prg);
+
+    // solve only the paths reaching `return 1`
+    std::unordered_set<int> target_pcs = first_return(prg);
+
+    for (int max_unroll : {2, 4}) {
+        gymbo::SymState init;
+        gymbo::SExecutor executor = default_executor(default_optimizer());
+        executor.max_unroll = max_unroll;
+        executor.run(prg, target_pcs, init, max_depth);
+
+        // `return 1` is reachable only when the loop is iterated three times
+        bool reached = false;
+        for (auto &cc : executor.constraints_cache) {
+            if (cc.second.first) {
+                ASSERT_EQ(cc.second.second[var_counter["x"]], 3.0f);
+                reached = true;
+            }
+        }
+        ASSERT_EQ(reached, max_unroll >= 3);
+    }
+}
+
+TEST(GymboWorkflowTest, FunctionSummary) {
+    std::string code_str =
+        "def relu(v) {\n"
+        "    if (v > 0) {\n"
+        "        return v;\n"
+        "    }\n"
+        "    return 0;\n"
+        "}\n"
+        "def neuron(a, b) {\n"
+        "    return relu(2 * a - b);\n"
+        "}\n"
+        "y = neuron(x, 3) + neuron(x, 1);\n"
+        "if (y == 8)\n"
+        "    return 1;";
+
+    std::unordered_map<std::string, int> var_counter;
+    gymbo::Prog prg;
+    compile(code_str, var_counter, prg);
+
+    // solve only the paths reaching `return 1`
+    std::unordered_set<int> target_pcs = first_return(prg);
+
+    for (bool use_summaries : {true, false}) {
+        gymbo::SymState init;
+        gymbo::SExecutor executor = default_executor(default_optimizer());
+        executor.use_summaries = use_summaries;
+        executor.run(prg, target_pcs, init, max_depth);
+
+        // only relu(3) + relu(5) is equal to 8
+        int num_sat = 0;
+        for (auto &cc : executor.constraints_cache) {
+            if (cc.second.first) {
+                ASSERT_EQ(cc.second.second[var_counter["x"]], 3.0f);
+                num_sat++;
+            }
+        }
+        ASSERT_EQ(num_sat, 1);
+
+        if (use_summaries) {
+            // relu has two paths, each of which is reused by neuron
+            ASSERT_EQ(executor.summaries.size(), 2);
+            for (auto &s : executor.summaries) {
+                ASSERT_EQ(s.second.size(), 2);
+            }
+        }
+    }
+
+    // the functions with more paths than the limit are executed inline
+    gymbo::SymState init;
+    gymbo::SExecutor executor = default_executor(default_optimizer());
+    executor.max_summary_paths = 1;
+    executor.run(prg, target_pcs, init, max_depth);
+    ASSERT_EQ(executor.summaries.size(), 0);
+    ASSERT_EQ(executor.unsummarizable.size(), 2);
+    int num_sat = 0;
+    for (auto &cc : executor.constraints_cache) {
+        if (cc.second.first) {
+            ASSERT_EQ(cc.second.second[var_counter["x"]], 3.0f);
+            num_sat++;
+        }
+    }
+    ASSERT_EQ(num_sat, 1);
+}
+
+TEST(GymboWorkflowTest, FunctionSummaryAcrossPrograms) {
+    // both programs define the function at the same entry pc, so that a
+    // stale summary would solve the second one with the first body
+    gymbo::SExecutor executor = default_executor(default_optimizer());
+    for (int c : {1, 2}) {
+        std::string code_str = "def f(v) {\n"
+                               "    return v + " +
+                               std::to_string(c) +
+                               ";\n"
+                               "}\n"
+                               "y = f(x);\n"
+                               "if (y == 8)\n"
+                               "    return 1;";
+
+        std::unordered_map<std::string, int> var_counter;
+        gymbo::Prog prg;
+        compile(code_str, var_counter, prg);
+
+        gymbo::SymState init;
+        std::unordered_set<int> target_pcs = first_return(prg);
+        executor.constraints_cache.clear();
+        executor.run(prg, target_pcs, init, max_depth);
+
+        ASSERT_EQ(executor.summaries.size(), 1);
+        int num_sat = 0;
+        for (auto &cc : executor.constraints_cache) {
+            if (cc.second.first) {
+                ASSERT_EQ(cc.second.second[var_counter["x"]], 8.0f - c);
+                num_sat++;
+            }
+        }
+        ASSERT_EQ(num_sat, 1);
+    }
+}
+
+TEST(GymboWorkflowTest, ArrayIndex) {
+    std::string code_str =
+        "int t[4] = {3, 1, 4, 1};\n"
+        "int x[2];\n"
+        "y = x[0];\n"
+        "x[i] = t[i + 1];\n"
+        "if (x[1] == 4 && x[0] == y && y == 2)\n"
+        "    return 1;";
+
+    std::unordered_map<std::string, int> var_counter;
+    gymbo::Prog prg;
+    compile(code_str, var_counter, prg);
+
+    // solve only the paths reaching `return 1`
+    gymbo::SymState init;
+    std::unordered_set<int> target_pcs = first_return(prg);
+    gymbo::SExecutor executor = default_executor(default_optimizer());
+    executor.run(prg, target_pcs, init, max_depth);
+
+    // t[i + 1] == 4 only when i == 1, which overwrites x[1] but keeps x[0],
+    // so that y is equal to the input value of x[0].
+    int num_sat = 0;
+    for (auto &cc : executor.constraints_cache) {
+        if (cc.second.first) {
+            ASSERT_EQ(cc.second.second[var_counter["i"]], 1.0f);
+            ASSERT_EQ(cc.second.second[var_counter["x"]], 2.0f);
+            num_sat++;
+        }
+    }
+    ASSERT_EQ(num_sat, 1);
+}
+
+TEST(GymboWorkflowTest, MemorySemantics) {
+    // a variable read into an expression keeps referring to its symbolic
+    // input after it is overwritten, a constant store stays concrete, and an
+    // input overwritten after being read is not pinned to its current value.
+    std::string code_str =
+        "s = x;\n"
+        "x = 0;\n"
+        "i = 0;\n"
+        "i = i + 1;\n"
+        "i = i + 1;\n"
+        "if (s == 5 && x == 0 && z == i) {\n"
+        "    z = 7;\n"
+        "    if (y < 1)\n"
+        "        return 1;\n"
+        "}";
+
+    for (bool use_block_summaries : {false, true}) {
+        std::unordered_map<std::string, int> var_counter;
+        gymbo::Prog prg;
+        compile(code_str, var_counter, prg);
+
+        gymbo::SymState init;
+        std::unordered_set<int> target_pcs;
+        gymbo::SExecutor executor = default_executor(default_optimizer());
+        executor.use_block_summaries = use_block_summaries;
+        executor.run(prg, target_pcs, init, max_depth);
+
+        bool found = false;
+        for (auto &cc : executor.constraints_cache) {
+            auto &params = cc.second.second;
+            if (cc.second.first &&
+                params.find(var_counter["y"]) != params.end()) {
+                ASSERT_EQ(params[var_counter["x"]], 5.0f);
+                ASSERT_EQ(params[var_counter["z"]], 2.0f);
+                found |= params[var_counter["y"]] < 1.0f;
+            }
+        }
+        ASSERT_TRUE(found);
+    }
+}
+
+TEST(GymboWorkflowTest, BlockSummariesAcrossPrograms) {
+    // both programs have the same blocks at the same pcs, except for the
+    // constants, so that a stale summary would solve the second one with
+    // the values of the first one
+    gymbo::SExecutor executor = default_executor(default_optimizer());
+    for (int v : {3, 4}) {
+        std::string code_str = "a = " + std::to_string(v) +
+                               ";\n"
+                               "b = a + 1;\n"
+                               "if (x == b)\n"
+                               "    return 1;";
+
+        std::unordered_map<std::string, int> var_counter;
+        gymbo::Prog prg;
+        compile(code_str, var_counter, prg);
+
+        gymbo::SymState init;
+        std::unordered_set<int> target_pcs = first_return(prg);
+        executor.constraints_cache.clear();
+        executor.run(prg, target_pcs, init, max_depth);
+
+        ASSERT_EQ(executor.constraints_cache.size(), 1);
+        for (auto &cc : executor.constraints_cache) {
+            ASSERT_TRUE(cc.second.first);
+            ASSERT_EQ(cc.second.second[var_counter["x"]], v + 1.0f);
+        }
+    }
+}
+
+TEST(GymboWorkflowTest, TreeEnsemble) {
+    std::string code_str =
+        "def t0(a, b) {\n"
+        "    if (a <= 2) { return 1; }\n"
+        "    else { if (b <= 0) { return 0; } else { return 1; } }\n"
+        "}\n"
+        "def t1(a, b) {\n"
+        "    if (a <= 5) { return 0; } else { return 1; }\n"
+        "}\n"
+        "y = t0(x, z) + t1(x, z);\n"
+        "if (y == 2)\n"
+        "    return 1;";
+
+    std::unordered_map<std::string, int> var_counter;
+    gymbo::Prog prg;
+    compile(code_str, var_counter, prg);
+
+    gymbo::SymState init;
+    std::unordered_set<int> target_pcs;
+    gymbo::SExecutor executor = default_executor(default_optimizer());
+    executor.use_intervals = true;
+    executor.run(prg, target_pcs, init, max_depth);
+
+    // both trees return 1 only when x > 5 and z > 0, and all threshold
+    // comparisons are decided without gradient descent.
+    ASSERT_EQ(executor.optimizer.num_used_itr, 0);
+    int num_sat = 0;
+    for (auto &cc : executor.constraints_cache) {
+        // y == 2 with y = 2 is normalized into 0 == 0
+        if (cc.second.first && cc.first.find("(0==0)") != std::string::npos) {
+            ASSERT_GT(cc.second.second[var_counter["x"]], 5.0f);
+            ASSERT_GT(cc.second.second[var_counter["z"]], 0.0f);
+            num_sat++;
+        }
+    }
+    ASSERT_EQ(num_sat, 1);
+
+    // the intervals only skip the gradient descent, and gradient descent
+    // alone, the default, gives the same verdict on every path
+    gymbo::SExecutor plain = default_executor(default_optimizer());
+    gymbo::SymState plain_init;
+    plain.run(prg, target_pcs, plain_init, max_depth);
+    ASSERT_GT(plain.optimizer.num_used_itr, 0);
+    ASSERT_EQ(plain.constraints_cache.size(),
+              executor.constraints_cache.size());
+    for (auto &cc : plain.constraints_cache) {
+        ASSERT_EQ(cc.second.first,
+                  executor.constraints_cache.at(cc.first).first);
+    }
+}
+
+TEST(GymboWorkflowTest, Division) {
+    std::string code_str =
+        "int x;\n"
+        "y = 12 / (x - 3);\n"
+        "if (y == 4 && x % 2 == 0)\n"
+        "    return 1;";
+
+    std::unordered_map<std::string, int> var_counter;
+    gymbo::Prog prg;
+    gymbo::GDOptimizer optimizer = default_optimizer();
+    compile(code_str, var_counter, prg, false, &optimizer.int_vars);
+
+    // solve only the paths reaching `return 1`
+    gymbo::SymState init;
+    std::unordered_set<int> target_pcs = first_return(prg);
+    gymbo::SExecutor executor = default_executor(optimizer);
+    executor.run(prg, target_pcs, init, max_depth);
+
+    // the quotient of integers is truncated, so that 12 / (x - 3) == 4 iff
+    // x is 6, while a real x in (5.4, 6] would also satisfy it.
+    int num_sat = 0;
+    for (auto &cc : executor.constraints_cache) {
+        if (cc.second.first) {
+            ASSERT_EQ(cc.second.second[var_counter["x"]], 6.0f);
+            num_sat++;
+        }
+    }
+    ASSERT_EQ(num_sat, 1);
+}
+
+TEST(GymboWorkflowTest, BitVector) {
+    std::string code_str =
+        "int x;\n"
+        "h = (x * 31 + 7) & 1023;\n"
+        "if (h == 1000 && (x >> 10) == 0 && x > 0)\n"
+        "    return 1;";
+
+    std::unordered_map<std::string, int> var_counter;
+    gymbo::Prog prg;
+    gymbo::GDOptimizer optimizer = default_optimizer();
+    compile(code_str, var_counter, prg, false, &optimizer.int_vars);
+
+    gymbo::SymState init;
+    std::unordered_set<int> target_pcs = first_return(prg);
+    gymbo::SExecutor executor = default_executor(optimizer);
+    executor.run(prg, target_pcs, init, max_depth);
+
+    // the hash is inverted by bit-blasting without gradient descent, since
+    // 31 * 1023 + 7 = 1000 (mod 1024) is its only solution in (0, 1024)
+    ASSERT_EQ(executor.optimizer.num_used_itr, 0);
+    int num_sat = 0;
+    for (auto &cc : executor.constraints_cache) {
+        if (cc.second.first) {
+            ASSERT_EQ(cc.second.second[var_counter["x"]], 1023.0f);
+            num_sat++;
+        }
+    }
+    ASSERT_EQ(num_sat, 1);
+}
+
+TEST(GymboWorkflowTest, StraightLine) {
+    // a long run of straight-line instructions is executed in a loop rather
+    // than by a recursion per instruction, which would overflow the stack
+    std::string code_str =
+        "s = 0;\n"
+        "for (i = 0; i < 5000; i = i + 1) {\n"
+        "    s = s + i * 2;\n"
+        "}\n"
+        "if (x == s)\n"
+        "    return 1;";
+
+    std::unordered_map<std::string, int> var_counter;
+    gymbo::Prog prg;
+    compile(code_str, var_counter, prg);
+
+    gymbo::SymState init;
+    std::unordered_set<int> target_pcs;
+    gymbo::SExecutor executor = default_executor(default_optimizer());
+    executor.max_unroll = -1;
+    // x == 24995000 is decided by the intervals
+    executor.use_intervals = true;
+    executor.run(prg, target_pcs, init, 1 << 20);
+
+    ASSERT_EQ(executor.constraints_cache.size(), 2);
+    for (auto &cc : executor.constraints_cache) {
+        ASSERT_TRUE(cc.second.first);
+    }
+}
+
+TEST(GymboWorkflowTest, Portfolio) {
+    // x * x + 1 <= 0 || 20 < y from (3, 0) with x bounded to 3, where the
+    // exact gradient only follows the nearer disjunct on x, which the bounds
+    // hold still, while the smooth one raises y
+    gymbo::Word32 var_id_0 = 0, var_id_1 = 1;
+    gymbo::Sym *x = new gymbo::Sym(gymbo::SymType::SAny, var_id_0);
+    gymbo::Sym *y = new gymbo::Sym(gymbo::SymType::SAny, var_id_1);
+    auto con = [](float v) {
+        return new gymbo::Sym(gymbo::SymType::SCon, gymbo::FloatToWord(v));
+    };
+    gymbo::SymState state;
+    state.path_constraints = {gymbo::Sym(
+        gymbo::SymType::SOr,
+        new gymbo::Sym(gymbo::SymType::SLe,
+                       new gymbo::Sym(gymbo::SymType::SAdd,
+                                      new gymbo::Sym(gymbo::SymType::SMul, x,
+                                                     x),
+                                      con(1.0f)),
+                       con(0.0f)),
+        new gymbo::Sym(gymbo::SymType::SLt, con(20.0f), y))};
+
+    gymbo::GDOptimizer optimizer(num_itrs, step_size, eps, 0, 0, sign_grad,
+                                 init_param_uniform_int, seed);
+    optimizer.var_bounds[0] = std::make_pair(3.0f, 3.0f);
+    gymbo::GDOptimizer smooth = optimizer;
+    smooth.smooth_temperature = 10.0f;
+
+    bool is_sat = true;
+    std::unordered_map<int, float> params;
+    gymbo::smt_portfolio_solver(is_sat, state, params, optimizer,
+                                max_num_trials, ignore_memory,
+                                {{optimizer, false}});
+    ASSERT_FALSE(is_sat);
+
+    // the DPLL and the smooth configurations find a model, which cancels
+    // the others
+    for (gymbo::PortfolioConfig config :
+         {gymbo::PortfolioConfig{optimizer, true},
+          gymbo::PortfolioConfig{smooth, false}}) {
+        params = {};
+        gymbo::smt_portfolio_solver(is_sat, state, params, optimizer,
+                                    max_num_trials, ignore_memory,
+                                    {{optimizer, false}, config});
+        ASSERT_TRUE(is_sat);
+        ASSERT_GT(params[1], 20.0f);
+    }
+
+    // a cancelled optimizer stops before its first epoch
+    std::atomic<bool> cancel(true);
+    optimizer.cancel = &cancel;
+    optimizer.num_used_itr = 0;
+    params = {};
+    ASSERT_FALSE(optimizer.solve(state.path_constraints, params));
+    ASSERT_EQ(optimizer.num_used_itr, 0);
+
+    // the portfolio keeps the answers of the sequential solvers
+    std::string code_str =
+        "if (a > 2) {\n"
+        "    b = 1;\n"
+        "    if (b == 3) {\n"
+        "        return 1;\n"
+        "    }\n"
+        "}\n"
+        "if (a * a == 9)\n"
+        "    return 2;";
+
+    std::unordered_map<std::string, int> var_counter;
+    gymbo::Prog prg;
+    compile(code_str, var_counter, prg);
+
+    std::vector<std::pair<int, int>> counts;
+    for (bool use_portfolio : {false, true}) {
+        gymbo::SymState init;
+        std::unordered_set<int> target_pcs;
+        gymbo::SExecutor executor = default_executor(default_optimizer());
+        executor.use_portfolio = use_portfolio;
+        executor.run(prg, target_pcs, init, max_depth);
+
+        int num_sat = 0, num_unsat = 0;
+        for (auto &cc : executor.constraints_cache) {
+            if (cc.second.first) {
+                num_sat++;
+            } else {
+                num_unsat++;
+            }
+        }
+        counts.emplace_back(num_sat, num_unsat);
+    }
+    ASSERT_EQ(counts[0], counts[1]);
+    ASSERT_GT(counts[1].first, 0);
+}